@@ -29,6 +29,29 @@ extern "C" {
 U_EXPORT uint32_t u_gz_deflate(const char* restrict input, uint32_t len, char* restrict result, bool bheader);
 U_EXPORT uint32_t u_gz_inflate(const char* restrict input, uint32_t len, char* restrict result);
 
+/**
+ * Synopsis: Incremental compression of a source feeded in chunk (ex: dynamic response with Transfer-Encoding: chunked)
+ *
+ * u_gz_deflate_level() is the policy for the compression level by size of the content (0 => unknown): for a big content we
+ * prefer the speed, so that the compression don't become the bottleneck of the response. u_gz_deflate_chunk() return the
+ * number of bytes written in result (U_NOT_FOUND for error); if the result is full (stream->avail_out == 0) it must be called
+ * again with input == 0
+ *
+ * u_gz_inflate_chunk() is the counterpart for a raw deflate stream that continue between call (ex: the messages of a websocket
+ * with permessage-deflate), with the same convention for the result; at the end of the stream (BFINAL) the context is reset
+ */
+
+#ifdef USE_LIBZ
+U_EXPORT int      u_gz_deflate_level(uint32_t size) __pure;
+U_EXPORT bool     u_gz_deflate_init(z_stream* restrict stream, int level, bool bheader);
+U_EXPORT uint32_t u_gz_deflate_chunk(z_stream* restrict stream, const char* restrict input, uint32_t len, char* restrict result, uint32_t size, int flush);
+U_EXPORT void     u_gz_deflate_end(z_stream* restrict stream);
+
+U_EXPORT bool     u_gz_inflate_init(z_stream* restrict stream);
+U_EXPORT uint32_t u_gz_inflate_chunk(z_stream* restrict stream, const char* restrict input, uint32_t len, char* restrict result, uint32_t size);
+U_EXPORT void     u_gz_inflate_end(z_stream* restrict stream);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
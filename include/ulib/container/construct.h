@@ -75,7 +75,7 @@ template <> inline void u_construct(const UStringRep* rep, uint32_t n)
 
 // coverity[RESOURCE_LEAK]
 #ifndef U_COVERITY_FALSE_POSITIVE
-   ((UStringRep*)rep)->references += n;
+   ((UStringRep*)rep)->hold(n);
 
    U_INTERNAL_DUMP("references = %d", rep->references + 1)
 #endif
@@ -298,8 +298,12 @@ protected:
 
       U_CHECK_MEMORY
 
+      bool barena = UArena::suspend(this);
+
       table     = (UHashMapNode**) UMemoryPool::_malloc(&n, sizeof(UHashMapNode*), true);
       _capacity = n;
+
+      UArena::resume(barena);
       }
 
    void _deallocate()
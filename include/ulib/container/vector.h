@@ -412,8 +412,12 @@ protected:
 
       U_INTERNAL_ASSERT_MINOR(n, ((0xfffffff / sizeof(void*)) - sizeof(UVector<void*>)))
 
+      bool barena = UArena::suspend(this);
+
       vec       = (const void**) UMemoryPool::_malloc(&n, sizeof(void*));
       _capacity = n;
+
+      UArena::resume(barena);
       }
 
    void deallocate()
@@ -27,6 +27,11 @@
 // ---------------------------------------------------------------------------------
 #define U_CAPACITY (U_MAX_SIZE_PREALLOCATE - (1 + sizeof(ustringrep)))
 // ---------------------------------------------------------------------------------
+// NB: short string (header name, json key, ...) are served by the stack type 3, so
+//     that the data stay inline with the rep without wasting a 128 bytes block...
+// ---------------------------------------------------------------------------------
+#define U_CAPACITY_SMALL (U_STACK_TYPE_3 - (1 + sizeof(ustringrep)))
+// ---------------------------------------------------------------------------------
 #define U_STRING_MAX_SIZE (((U_NOT_FOUND-sizeof(ustringrep))/sizeof(char))-4096)
 
 // default move assignment operator
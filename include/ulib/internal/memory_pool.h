@@ -556,6 +556,116 @@ private:
    template <class T> friend class UVector;
 };
 
+/**
+ * @class UArena
+ *
+ * @brief Bump allocator for the objects that live only for the processing of a request
+ *
+ * Between begin() and end() the memory pool serve the allocation (UString, UHashMap node, UValue, ...) from a block of the process
+ * advancing a pointer, the free of that memory is a no-op and the server rewind the block at the end of the request (see
+ * UClientImage_Base::endRequest()). A request that don't fit in the block is serviced by the pool as usual. The growth of an object
+ * that is not a temporary of the region (ex: UClientImage_Base::wbuffer) stay out of the arena (see suspend()), but it is opt-in
+ * because an object created in the region MUST not survive the request (ex: assigned to a static UString or inserted in a table
+ * created out of the region). In DEBUG the rewinded block is poisoned and such a store is an assertion (see isEscape())...
+ */
+
+class U_EXPORT UArena {
+public:
+   static char* pstart; // the block (0 => disabled)
+   static char* pcurrent;
+   static char* pend;
+   static char* pframe; // the frame of the caller of begin()
+   static bool bactive;
+
+   static void init(uint32_t size);
+
+   static bool isActive() { return bactive; }
+   static bool isUsed()   { return (pcurrent != pstart); }
+
+   // NB: the default argument is evaluated in the frame of the caller...
+
+   static void begin(void* frame = __builtin_frame_address(0))
+      {
+      U_TRACE(0, "UArena::begin(%p)", frame)
+
+      if (pstart)
+         {
+         pframe  = (char*)frame;
+         bactive = true;
+         }
+      }
+
+   static void end() { bactive = false; }
+
+   static bool isOwner(const void* ptr) { return ((uintptr_t)((const char*)ptr - pstart) < (uintptr_t)(pend - pstart)); }
+
+   // NB: an object is a temporary of the region if it is in the arena or on the stack under the frame of the caller of begin()...
+
+   static bool isTemporary(const void* pobj)
+      {
+      return (isOwner(pobj) ||
+              ((const char*)pobj <  pframe &&
+               (const char*)pobj >= (const char*)__builtin_frame_address(0)));
+      }
+
+   // NB: used for the growth of an object, return the state to pass to resume(). Out of a region it is only the test of bactive,
+   //     the check of the object (that need the frame address, so a frame pointer in the caller) is out of line in _suspend()...
+
+   static bool suspend(const void* pobj)
+      {
+      if (LIKELY(bactive == false)) return false;
+
+      _suspend(pobj);
+
+      return true;
+      }
+
+   static void resume(bool bsave) { if (bsave) bactive = true; }
+
+#ifdef DEBUG
+   // NB: a reference to the arena (string rep, element of a container) stored in an object that is not a temporary of the region
+   //     is a dangling pointer after reset() (ex: assigned to a static UString, inserted in a table created out of the region)...
+
+   static bool isEscape(const void* ptr, const void* pobj) { return (isOwner(ptr) && isTemporary(pobj) == false); }
+#endif
+
+   static void* allocate(uint32_t sz)
+      {
+      U_TRACE(0+256, "UArena::allocate(%u)", sz)
+
+      U_INTERNAL_ASSERT(bactive)
+
+      char* ptr = pcurrent;
+
+      sz = (sz + sizeof(long)-1) & ~(sizeof(long)-1);
+
+      if ((uint32_t)(pend - ptr) < sz) return 0; // NB: the caller use the pool...
+
+      pcurrent = ptr + sz;
+
+      return ptr;
+      }
+
+   static void reset()
+      {
+      U_TRACE_NO_PARAM(0, "UArena::reset()")
+
+      U_INTERNAL_DUMP("used = %u", pcurrent - pstart)
+
+#  ifdef DEBUG
+      (void) memset(pstart, 0xA5, pcurrent - pstart); // NB: to catch an object of the arena that survived the request...
+#  endif
+
+      bactive  = false;
+      pcurrent = pstart;
+      }
+
+private:
+   static void _suspend(const void* pobj);
+
+   U_DISALLOW_COPY_AND_ASSIGN(UArena)
+};
+
 #ifdef DEBUG
 template <class T> bool u_check_memory_vector(T* _vec, uint32_t n)
 {
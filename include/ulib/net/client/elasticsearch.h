@@ -18,6 +18,17 @@
 #include <ulib/net/tcpsocket.h>
 #include <ulib/net/client/http.h>
 
+#define U_ES_BULK_MAX_SIZE (5U * 1024U * 1024U) // the bulk body is sent when it reach this size
+#define U_ES_BULK_MAX_DOC   1000U                // ...or this number of document
+#define U_ES_BULK_FLUSH_MS  1000U                // ...or it is older than this time (millisecond)
+#define U_ES_BULK_MAX_QUEUE    8U                // number of bulk body waiting to be sent, after that the producer wait (backpressure)
+#define U_ES_BULK_RETRY        3U                // max number of retry for a document rejected with a temporary error (429, 503)
+#define U_ES_BULK_BACKOFF_MS 100U                // wait before to send again after the server is overloaded (429, 503), doubled at every retry
+
+class UEventTime;
+class UElasticSearchAsync;
+class UElasticSearchTimer;
+
 /**
  * @class UElasticSearchClient
  *
@@ -38,16 +49,19 @@ public:
       {
       U_TRACE_REGISTER_OBJECT(0, UElasticSearchClient, "", 0)
 
-      client = 0;
-      }
-
-   ~UElasticSearchClient()
-      {
-      U_TRACE_UNREGISTER_OBJECT(0, UElasticSearchClient)
+      client      = 0;
+      bulk_client = 0;
+      bulk_queue  = 0;
+      pasync      = 0;
+      ptimer      = 0;
 
-      if (client) delete client;
+      bulk_ndoc = bulk_head = bulk_len = bulk_indexed = bulk_failed = 0;
+      bulk_start = bulk_backoff = 0;
+      bulk_inflight = bulk_notifier = false;
       }
 
+   ~UElasticSearchClient();
+
    // Connect to ElasticSearch server
 
    bool connect(const char* host = 0, unsigned int _port = 9200);
@@ -200,15 +214,69 @@ public:
 
    bool sendPOST(const UString& _uri, const UString& data) { return sendPOST(U_STRING_TO_PARAM(_uri), U_STRING_TO_PARAM(data)); }
 
+   // BULK API
+   //
+   // The document are accumulated in a NDJSON body for the _bulk endpoint, sent on a dedicated connection when it reach max_size bytes,
+   // max_doc document or it is older than flush_ms. Only one request is in flight, the body ready meanwhile wait in a queue of max_queue
+   // entry and when the queue is full bulkIndex() wait the response (backpressure). With an event loop (UNotifier::max_connection != 0)
+   // the response are read by UNotifier and the age of the body is checked by UTimer, otherwise the response are read before to send
+   // the next body and by flushBulk(). The document rejected for a temporary error (429, 503) are sent again in a new body, and when
+   // the server is overloaded nothing is sent for U_ES_BULK_BACKOFF_MS (doubled at every retry of the same document)...
+
+   bool setBulk(uint32_t max_size = U_ES_BULK_MAX_SIZE, uint32_t max_doc = U_ES_BULK_MAX_DOC, uint32_t flush_ms = U_ES_BULK_FLUSH_MS, uint32_t max_queue = U_ES_BULK_MAX_QUEUE);
+
+   // NB: return false if the server is not available (the document is kept and sent again later)...
+
+   bool bulkIndex(const char* _index, uint32_t index_len, const char* type, uint32_t type_len, const char* id, uint32_t id_len, const char* data, uint32_t data_len);
+
+   bool bulkIndex(const UString& _index, const UString& type, const UString& id, const UString& data)
+      { return bulkIndex(U_STRING_TO_PARAM(_index), U_STRING_TO_PARAM(type), U_STRING_TO_PARAM(id), U_STRING_TO_PARAM(data)); }
+
+   bool flushBulk(); // send all the document and wait the response, return false if some document is not indexed
+
+   uint32_t getBulkIndexed() const { return bulk_indexed; }
+   uint32_t getBulkFailed() const  { return bulk_failed; }
+
 #if defined(U_STDCPP_ENABLE) && defined(DEBUG)
    const char* dump(bool reset) const;
 #endif
 
 protected:
+   typedef struct bulk_entry {
+      UString body;
+      uint32_t ndoc, retry;
+   } bulk_entry;
+
    UString uri;
    UHttpClient<UTCPSocket>* client;
 
+   UString bulk, bulk_reply;   // body in construction, response in progress
+   UClient<UTCPSocket>* bulk_client;
+   bulk_entry* bulk_queue;     // ring buffer of the body ready (the head is the one in flight)
+   UElasticSearchAsync* pasync;
+   UEventTime* ptimer;
+   long bulk_start;            // time of the first document of the body in construction (millisecond)
+   long bulk_backoff;          // time before which we don't send because the server is overloaded (millisecond)
+   uint32_t bulk_ndoc, bulk_max_size, bulk_max_doc, bulk_flush_ms, bulk_max_queue, bulk_head, bulk_len, bulk_indexed, bulk_failed;
+   bool bulk_inflight, bulk_notifier;
+
+   void handlerBulkTime();
+
 private:
+   bool sealBulk(bool bwait) U_NO_EXPORT;
+   bool sendBulk() U_NO_EXPORT;
+   bool waitBulk() U_NO_EXPORT;
+    int readBulk(int timeoutMS) U_NO_EXPORT;
+   void abortBulk() U_NO_EXPORT;
+   void pushBulk(const UString& body, uint32_t ndoc, uint32_t retry) U_NO_EXPORT;
+   void processBulk(uint32_t status, const char* ptr, uint32_t len) U_NO_EXPORT;
+   void popBulk() U_NO_EXPORT;
+   void setBackoff(uint32_t retry) U_NO_EXPORT;
+   long getBackoff() U_NO_EXPORT;
+
    U_DISALLOW_COPY_AND_ASSIGN(UElasticSearchClient)
+
+   friend class UElasticSearchAsync;
+   friend class UElasticSearchTimer;
 };
 #endif
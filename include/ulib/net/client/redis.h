@@ -44,6 +44,125 @@
 #define U_RC_ERR_BUFFER_OVERFLOW      -105
 #define U_RC_ERR_DATA_FORMAT          -106
 #define U_RC_ERR_DATA_BUFFER_OVERFLOW -107
+
+#define U_RC_CLUSTER_SLOTS    16384 // number of hash slot of REDIS Cluster
+#define U_RC_CLUSTER_REDIRECT     5 // max number of redirection (MOVED/ASK) for a command
+
+#define U_RESP_MAX_DEPTH 32 // max level of nested aggregate in a reply
+
+/**
+ * @class URESPParser
+ *
+ * @brief Streaming parser of the REDIS protocol (RESP2 and RESP3, @see https://github.com/redis/redis-specifications)
+ *
+ * Every element of a reply is passed to the callback as pointer and length into the buffer of the data read (without copy and
+ * without allocation). The state (the stack of the aggregate open) is kept between the call, so when a read is not complete the
+ * next call, with more data in the same buffer, restart from the element where it stopped without scanning again the reply...
+ */
+
+class U_EXPORT URESPParser {
+public:
+
+   // Check for memory error
+   U_MEMORY_TEST
+
+   // Allocator e Deallocator
+   U_MEMORY_ALLOCATOR
+   U_MEMORY_DEALLOCATOR
+
+   typedef struct element {
+      const char* ptr; // string, error, verbatim: the data - other type: the line after the prefix
+      uint32_t len,
+               depth;  // 0 -> the element is the reply
+      long num;        // aggregate: number of element (-1 -> null) - string: length (-1 -> null) - integer: the value
+      char type;       // prefix of the element ('$', '*', ':', '+', '-', '%', '~', '>', '|', '_', ',', '#', '!', '=', '(')
+   } element;
+
+   typedef void (*vPFpvpe)(void*,const element*);
+
+   URESPParser()
+      {
+      U_TRACE_REGISTER_OBJECT(0, URESPParser, "", 0)
+
+      pos = depth = 0;
+      }
+
+   ~URESPParser()
+      {
+      U_TRACE_UNREGISTER_OBJECT(0, URESPParser)
+      }
+
+   // SERVICES
+
+   void reset()
+      {
+      U_TRACE_NO_PARAM(0, "URESPParser::reset()")
+
+      pos = depth = 0;
+      }
+
+   uint32_t getPos() const { return pos; } // offset in the buffer of the first element not complete
+
+   void rebase(uint32_t n) // NB: the first n byte of the buffer are been discarded...
+      {
+      U_TRACE(0, "URESPParser::rebase(%u)", n)
+
+      U_INTERNAL_ASSERT(n <= pos)
+
+      pos -= n;
+      }
+
+   // Parse the buffer from the current position, call the callback (if any) for every element complete and stop after max reply.
+   // Return the number of reply complete, or -1 for a protocol error
+
+   int parse(const char* data, uint32_t size, vPFpvpe callback = 0, void* arg = 0, uint32_t max = U_NOT_FOUND);
+
+   int parse(const UString& buffer, vPFpvpe callback = 0, void* arg = 0, uint32_t max = U_NOT_FOUND) { return parse(U_STRING_TO_PARAM(buffer), callback, arg, max); }
+
+   static const char* skip(const char* ptr, const char* end) __pure; // return the pointer after the reply if it is complete, otherwise null
+
+   static bool isString(char type)
+      {
+      U_TRACE(0, "URESPParser::isString(%C)", type)
+
+      if (type == '$' || // blob string
+          type == '!' || // blob error
+          type == '=')   // verbatim string
+         {
+         U_RETURN(true);
+         }
+
+      U_RETURN(false);
+      }
+
+   static bool isAggregate(char type)
+      {
+      U_TRACE(0, "URESPParser::isAggregate(%C)", type)
+
+      if (type == '*' || // array
+          type == '%' || // map (key and value)
+          type == '~' || // set
+          type == '>' || // push
+          type == '|')   // attribute (key and value, before the reply)
+         {
+         U_RETURN(true);
+         }
+
+      U_RETURN(false);
+      }
+
+#if defined(U_STDCPP_ENABLE) && defined(DEBUG)
+   const char* dump(bool reset) const;
+#endif
+
+protected:
+   uint32_t pos, depth;
+   long remain[U_RESP_MAX_DEPTH]; // number of element still to read for every aggregate open
+   char   type[U_RESP_MAX_DEPTH];
+
+private:
+   U_DISALLOW_COPY_AND_ASSIGN(URESPParser)
+};
  
 /**
  * @class UREDISClient
@@ -51,13 +170,15 @@
  * @brief UREDISClient is a wrapper to REDIS API
  */
 
+class UREDISAsync;
+class UREDISClient_Base;
+
+typedef void (*vPFrcpv)(UREDISClient_Base*,void*); // callback for the reply of a command sent in async mode
+
 class U_EXPORT UREDISClient_Base : public UClient_Base {
 public:
 
-   ~UREDISClient_Base()
-      {
-      U_TRACE_UNREGISTER_OBJECT(0, UREDISClient_Base)
-      }
+   ~UREDISClient_Base();
 
    UVector<UString> vitem;
 
@@ -69,6 +190,99 @@ public:
 
    bool connect(const char* host = 0, unsigned int _port = 6379);
 
+   // PIPELINE (@see http://redis.io/topics/pipelining)
+   //
+   // Between startPipeline() and endPipeline() the commands (the methods of this class that return bool) are only queued
+   // in a buffer: endPipeline() write all of them with one write and read all the replies in one round trip. After it vitem
+   // contains the items of all the replies in the order of the commands, getReplyPos(i) the index in vitem of the first item
+   // of the i-th reply. NB: the methods that use the reply (ex. operator+=, ttl(), deleteKeys()) cannot be queued...
+
+   void startPipeline();
+   bool   endPipeline();
+
+   bool isPipeline() const
+      {
+      U_TRACE_NO_PARAM(0, "UREDISClient_Base::isPipeline()")
+
+      U_RETURN(bpipeline);
+      }
+
+   uint32_t getReplyNum() const { return nreply - reply_start; }
+
+   uint32_t getReplyPos(uint32_t i) const
+      {
+      U_TRACE(0, "UREDISClient_Base::getReplyPos(%u)", i)
+
+      U_INTERNAL_ASSERT_MINOR(reply_start + i, nreply)
+
+      U_RETURN(preply[reply_start + i].pos);
+      }
+
+   bool isReplyError(uint32_t i) const
+      {
+      U_TRACE(0, "UREDISClient_Base::isReplyError(%u)", i)
+
+      U_INTERNAL_ASSERT_MINOR(reply_start + i, nreply)
+
+      if (preply[reply_start + i].recv != preply[reply_start + i].type &&
+          preply[reply_start + i].type != U_RC_ANY)
+         {
+         U_RETURN(true);
+         }
+
+      U_RETURN(false);
+      }
+
+   // ASYNC
+   //
+   // sendAsync() write the commands queued since startPipeline() and return without waiting: the connection is registered with
+   // UNotifier and every reply, when arrived, is passed (in vitem, with err) to the callback by the event loop. The replies can be
+   // pending for more sendAsync() at the same time, but a synchronous command cannot be sent while there are replies pending...
+
+   bool sendAsync(vPFrcpv callback, void* arg = 0);
+
+   uint32_t getAsyncPending() const { return nreply - reply_head; }
+
+   // CLUSTER (@see http://redis.io/topics/cluster-spec)
+   //
+   // connectCluster() connect to a node of the cluster and load the map of the hash slots (CLUSTER NODES): after it every
+   // command is sent to the master that serve the slot of its key (the first one for multi-key command), following the
+   // redirection MOVED (the map is updated) and ASK (only for the command). NB: the pipeline and the async mode must be used
+   // on the connection of the node returned by getClusterNode() (for the keys with the same hash tag {...})
+
+   bool connectCluster(const char* host = 0, unsigned int _port = 6379);
+
+   bool isCluster() const
+      {
+      U_TRACE_NO_PARAM(0, "UREDISClient_Base::isCluster()")
+
+      if (pnode) U_RETURN(true);
+
+      U_RETURN(false);
+      }
+
+   UREDISClient_Base* getClusterNode(const char* key, uint32_t keylen) __pure;
+
+   static uint32_t hashSlot(const char* key, uint32_t keylen) __pure; // CRC16(key) mod 16384 (only the hash tag {...} if present)
+
+   // ZERO-COPY
+   //
+   // With setElementCallback() every element of the reply of the (synchronous) commands is passed to the callback as pointer and
+   // length into the read buffer (@see URESPParser) instead of to be copied in vitem as UString (ex. MGET or LRANGE of thousands
+   // of items). NB: the methods that use the reply (ex. operator+=, ttl(), deleteKeys()) cannot be used in this mode...
+
+   void setElementCallback(URESPParser::vPFpvpe callback, void* arg = 0)
+      {
+      U_TRACE(0, "UREDISClient_Base::setElementCallback(%p,%p)", callback, arg)
+
+      element_cb  = callback;
+      element_arg = arg;
+      }
+
+   // Put in vec the items of the reply that start at ptr (substr of response), return the pointer to the end of the reply
+
+   static char* getResponseItem(const UString& response, char* ptr, UVector<UString>& vec, uint32_t depth);
+
    // STRING (@see http://redis.io/commands#string)
 
    bool get(const char* key, uint32_t keylen) // Get the value of a key
@@ -105,6 +319,8 @@ public:
       {
       U_TRACE(0, "UREDISClient_Base::operator+=(%S)", key)
 
+      U_INTERNAL_ASSERT_EQUALS(bpipeline, false)
+
       if (processRequest(U_RC_INT, U_CONSTANT_TO_PARAM("INCR"), key, u__strlen(key, __PRETTY_FUNCTION__))) return vitem[0].strtol();
 
       U_RETURN(-1);
@@ -114,6 +330,8 @@ public:
       {
       U_TRACE(0, "UREDISClient_Base::operator-=(%S)", key)
 
+      U_INTERNAL_ASSERT_EQUALS(bpipeline, false)
+
       if (processRequest(U_RC_INT, U_CONSTANT_TO_PARAM("DECR"), key, u__strlen(key, __PRETTY_FUNCTION__))) return vitem[0].strtol();
 
       U_RETURN(-1);
@@ -207,6 +425,8 @@ public:
       {
       U_TRACE(0, "UREDISClient_Base::deleteKeys(%.*S,%u)", keylen, key, keylen)
 
+      U_INTERNAL_ASSERT_EQUALS(bpipeline, false)
+
       if (smembers(key, keylen)) return srem(key, keylen, vitem.join(' '));
 
       U_RETURN(false);
@@ -241,6 +461,8 @@ public:
       {
       U_TRACE(0, "UREDISClient_Base::deleteKeys(%.*S,%u)", len, pattern, len)
 
+      U_INTERNAL_ASSERT_EQUALS(bpipeline, false)
+
       if (keys(pattern, len)) return del(vitem.join(' '));
 
       U_RETURN(false);
@@ -271,6 +493,8 @@ public:
       {
       U_TRACE(0, "UREDISClient_Base::ttl(%.*S,%u)", keylen, key, keylen)
 
+      U_INTERNAL_ASSERT_EQUALS(bpipeline, false)
+
       if (processRequest(U_RC_INT, U_CONSTANT_TO_PARAM("TTL"), key, keylen)) return vitem[0].strtoul();
 
       U_RETURN(-1);
@@ -280,6 +504,8 @@ public:
       {
       U_TRACE(0, "UREDISClient_Base::pttl(%.*S,%u)", keylen, key, keylen)
 
+      U_INTERNAL_ASSERT_EQUALS(bpipeline, false)
+
       if (processRequest(U_RC_INT, U_CONSTANT_TO_PARAM("PTTL"), key, keylen)) return vitem[0].strtoul();
 
       U_RETURN(-1);
@@ -391,22 +617,59 @@ public:
 #endif
 
 protected:
+   typedef struct reply {
+      vPFrcpv callback; // async mode
+      void* arg;
+      uint32_t pos;     // index in vitem of the first item of the reply
+      char type, recv;  // type of reply expected and received
+   } reply;
+
+   UString pipe;           // buffer of the commands queued
+   URESPParser parser;     // to check the end of the replies between the read
+   URESPParser::vPFpvpe element_cb; // zero-copy mode
+   void* element_arg;
+   reply* preply;          // queue of the replies expected (for pipeline and async mode)
+   uint16_t* pslot;        // cluster mode: index in pnode of the master that serve the slot
+   UREDISAsync* pasync;    // async mode: the event of the connection registered with UNotifier
+   UREDISClient_Base** pnode; // cluster mode: the connections to the masters
+   uint32_t nreply, reply_max, reply_head, reply_start, nnode, node_max;
    int err;
+   bool bpipeline;
 
    UREDISClient_Base() : UClient_Base(0)
       {
       U_TRACE_REGISTER_OBJECT(0, UREDISClient_Base, "", 0)
 
-      err = 0;
+      element_cb  = 0;
+      element_arg = 0;
+
+      preply    = 0;
+      pslot     = 0;
+      pasync    = 0;
+      pnode     = 0;
+      nreply    = reply_max = reply_head = reply_start = nnode = node_max = 0;
+      err       = 0;
+      bpipeline = false;
       }
 
+   void handlerAsync(bool bread);
+
 private:
    void processResponse() U_NO_EXPORT;
+   void pushReply(char recvtype) U_NO_EXPORT;
+   bool readReply(uint32_t n) U_NO_EXPORT;
+   bool sendPipeline() U_NO_EXPORT;
    bool processRequest(char recvtype) U_NO_EXPORT;
+   bool processClusterRequest(char recvtype) U_NO_EXPORT;
+   void clearClusterNode() U_NO_EXPORT;
+   bool loadClusterSlot(const UString& nodes) U_NO_EXPORT;
+
+   uint32_t getNode(const char* host, uint32_t len, unsigned int _port) U_NO_EXPORT;
 
-   static char* getResponseItem(const UString& response, char* ptr, UVector<UString>& vec, uint32_t depth) U_NO_EXPORT;
 
    U_DISALLOW_COPY_AND_ASSIGN(UREDISClient_Base)
+
+   friend class UREDISAsync;
 };
 
 template <class Socket> class U_EXPORT UREDISClient : public UREDISClient_Base {
@@ -40,13 +40,13 @@ class UHttpPlugIn;
 class UNoCatPlugIn;
 class UServer_Base;
 class UStreamPlugIn;
-class UBandWidthThrottling;
 
 template <class T> class UServer;
 
 #define U_ClientImage_http(obj)   (obj)->UClientImage_Base::flag.c[0]
 #define U_ClientImage_idle(obj)   (obj)->UClientImage_Base::flag.c[1]
 #define U_ClientImage_pclose(obj) (obj)->UClientImage_Base::flag.c[2]
+#define U_ClientImage_handshake(obj) (obj)->UClientImage_Base::flag.c[3] // NB: the TLS handshake is in progress on a helper thread...
 
 #define U_ClientImage_request_is_cached UClientImage_Base::cbuffer[0]
 
@@ -393,15 +393,15 @@ public:
 protected:
    USocket* socket;
 #ifdef U_THROTTLING_SUPPORT
-   UString uri;
-   uint64_t bytes_sent;
-   uint32_t min_limit, max_limit, started_at;
+   uint64_t bytes_sent;                          // bytes written not yet charged to the token buckets
+   uint32_t throttling_rule, throttling_sending; // bitmask of the rules matched by the URI (see UServer_Base::checkThrottling())
 #endif
    UString* data_pending;
    uint32_t start, count;
    int sfd;
    uucflag flag;
-   long last_event;
+   long last_event,
+        request_start; // time of the connection or of the first byte of a partial request header (0 => none pending, see REQ_HEADER_TIMEOUT)
 
 #ifndef U_LOG_DISABLE
    static int log_request_partial;
@@ -438,6 +438,7 @@ protected:
 
    int  handlerResponse();
    void prepareForSendfile();
+   void deferPipeline();
 
    void setPendingSendfile()
       {
@@ -513,12 +514,14 @@ private:
                       friend class UHTTP;
                       friend class UHTTP2;
                       friend class USocketExt;
+                      friend class UPubSub;
+                      friend class UMetrics;
+                      friend class UWebSocket;
                       friend class USSIPlugIn;
                       friend class UHttpPlugIn;
                       friend class UNoCatPlugIn;
                       friend class UServer_Base;
                       friend class UStreamPlugIn;
-                      friend class UBandWidthThrottling;
 
    template <class T> friend class UServer;
    template <class T> friend void u_delete_vector(      T* _vec, uint32_t offset, uint32_t n);
@@ -32,7 +32,9 @@ public:
    // Server-wide hooks
 
    virtual int handlerConfig(UFileConfig& cfg) U_DECL_FINAL;
+   virtual int handlerInit() U_DECL_FINAL;
    virtual int handlerRun() U_DECL_FINAL;
+   virtual int handlerFork() U_DECL_FINAL;
 
    // Connection-wide hooks
 
@@ -45,7 +47,6 @@ public:
 #endif
 
 protected:
-   static vPFi on_message;
    static UCommand* command;
 
    static RETSIGTYPE handlerForSigTERM(int signo);
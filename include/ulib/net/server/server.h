@@ -28,6 +28,10 @@
 #define SIGWINCH 28
 #endif
 
+#if defined(USE_LIBSSL) && defined(ENABLE_THREAD) && defined(U_LINUX) && !defined(USE_LIBEVENT)
+#  define U_SSL_HANDSHAKE_OFFLOAD // the TLS handshake can be done by helper thread (see SSL_HANDSHAKE_THREAD)
+#endif
+
 /**
  * @class UServer
  *
@@ -175,6 +179,8 @@ public:
    // ORM_DRIVER_DIR directory where there are ORM drivers to load
    //
    // REQ_TIMEOUT    timeout for request from client
+   // REQ_HEADER_TIMEOUT max time (seconds) for a client to send a complete request header, since the connection or the first byte of the request (0 => disabled)
+   // READ_BUDGET    max number of pipelined requests of a connection processed for each event, the rest are processed after the other ready connections (0 => no limit)
    // MAX_KEEP_ALIVE Specifies the maximum number of requests that can be served through a Keep-Alive (Persistent) session.
    //                (Value <= 0 will disable Keep-Alive)
    //
@@ -185,6 +191,8 @@ public:
    // CA_FILE       locations of trusted CA certificates used in the verification
    // CA_PATH       locations of trusted CA certificates used in the verification
    // VERIFY_MODE   mode of verification (SSL_VERIFY_NONE=0, SSL_VERIFY_PEER=1, SSL_VERIFY_FAIL_IF_NO_PEER_CERT=2, SSL_VERIFY_CLIENT_ONCE=4)
+   // KTLS          flag to enable kernel TLS offload (if supported by the kernel we can use sendfile() also with SSL)
+   // SSL_HANDSHAKE_THREAD number of helper thread for the TLS handshake (0 => the handshake is done inline by the event loop)
    //
    // PREFORK_CHILD number of child server processes created at startup ( 0 - serialize, no forking
    //                                                                     1 - classic, forking after client accept
@@ -234,7 +242,9 @@ public:
 
    static char mod_name[2][16];
    static UEventFd* handler_other;
+   static UEventFd* handler_pubsub;
    static UEventFd* handler_inotify;
+   static UEventFd* handler_handshake;
 
    static int loadPlugins(UString& plugin_dir, const UString& plugin_list); // load plugin modules and call server-wide hooks handlerConfig()...
 
@@ -296,19 +306,15 @@ public:
    // ---------------------------------
       sem_t lock_user1;
       sem_t lock_user2;
-      sem_t lock_throttling;
       sem_t lock_rdb_server;
       sem_t lock_data_session;
       sem_t lock_db_not_found;
       char spinlock_user1[1];
       char spinlock_user2[1];
-      char spinlock_throttling[1];
       char spinlock_rdb_server[1];
       char spinlock_data_session[1];
       char spinlock_db_not_found[1];
 #  ifdef USE_LIBSSL
-      sem_t    lock_ssl_session;
-      char spinlock_ssl_session[1];
 #    if defined(ENABLE_THREAD) && !defined(OPENSSL_NO_OCSP) && defined(SSL_CTRL_SET_TLSEXT_STATUS_REQ_CB) && !defined(_MSWINDOWS_)
       sem_t    lock_ocsp_staple;
       char spinlock_ocsp_staple[1];
@@ -349,16 +355,12 @@ public:
 #define U_SRV_CNT_PARALLELIZATION   UServer_Base::ptr_shared_data->cnt_parallelization
 #define U_SRV_LOCK_USER1          &(UServer_Base::ptr_shared_data->lock_user1)
 #define U_SRV_LOCK_USER2          &(UServer_Base::ptr_shared_data->lock_user2)
-#define U_SRV_LOCK_THROTTLING     &(UServer_Base::ptr_shared_data->lock_throttling)
 #define U_SRV_LOCK_RDB_SERVER     &(UServer_Base::ptr_shared_data->lock_rdb_server)
-#define U_SRV_LOCK_SSL_SESSION    &(UServer_Base::ptr_shared_data->lock_ssl_session)
 #define U_SRV_LOCK_DATA_SESSION   &(UServer_Base::ptr_shared_data->lock_data_session)
 #define U_SRV_LOCK_DB_NOT_FOUND   &(UServer_Base::ptr_shared_data->lock_db_not_found)
 #define U_SRV_SPINLOCK_USER1        UServer_Base::ptr_shared_data->spinlock_user1
 #define U_SRV_SPINLOCK_USER2        UServer_Base::ptr_shared_data->spinlock_user2
-#define U_SRV_SPINLOCK_THROTTLING   UServer_Base::ptr_shared_data->spinlock_throttling
 #define U_SRV_SPINLOCK_RDB_SERVER   UServer_Base::ptr_shared_data->spinlock_rdb_server
-#define U_SRV_SPINLOCK_SSL_SESSION  UServer_Base::ptr_shared_data->spinlock_ssl_session
 #define U_SRV_SPINLOCK_DATA_SESSION UServer_Base::ptr_shared_data->spinlock_data_session
 #define U_SRV_SPINLOCK_DB_NOT_FOUND UServer_Base::ptr_shared_data->spinlock_db_not_found
 
@@ -558,6 +560,9 @@ protected:
    static int timeoutMS,       // the time-out value in milliseconds for client request
               verify_mode;     // mode of verification ssl connection
 
+   static uint32_t header_timeout, // the max time in seconds to receive a complete request header
+                   read_budget;    // the max number of pipelined requests of a connection processed for each event
+
    static UString* server;     // host name or ip address for the listening socket
    static UString* as_user;    // change the current working directory to the user's home dir, and downgrade security to that user account
    static UString* dh_file;    // These are the 1024 bit DH parameters from "Assigned Number for SKIP Protocols"
@@ -580,6 +585,7 @@ protected:
    static bool monitoring_process, set_realtime_priority, public_address, binsert, set_tcp_keep_alive, called_from_handlerTime;
 
    static uint32_t                 vplugin_size;
+   static uint32_t                 plugin_index; // the plugin that has stopped the chain of the request hook (U_NOT_FOUND => none)
    static UVector<UString>*        vplugin_name;
    static UVector<UString>*        vplugin_name_static;
    static UVector<UServerPlugIn*>* vplugin;
@@ -589,6 +595,7 @@ protected:
    static void loadConfigParam();
    static void runLoop(const char* user);
    static bool handlerTimeoutConnection(void* cimg);
+   static bool handlerTimeoutHeader(void* cimg);
 
 #ifdef U_WELCOME_SUPPORT
    static UString* msg_welcome;
@@ -616,17 +623,22 @@ protected:
 #endif
 
 #ifdef U_THROTTLING_SUPPORT
-   static bool         throttling_chk;
-   static UString*     throttling_mask;
-   static UThrottling* throttling_rec;
-   static URDBObjectHandler<UDataStorage*>* db_throttling;
+   static UString* throttling_mask;
+   static uint32_t throttling_client_rate,  // max requests for second from a client (IP address)
+                   throttling_client_krate, // max kB/s sent to a client (IP address)
+                   throttling_client_max;   // number of slot of the table of client
+
+   static bool isThrottling() { return (throttling_mask || throttling_client_rate || throttling_client_krate); }
 
    static void clearThrottling();
-   static bool checkThrottling();
-   static bool checkThrottlingBeforeSend(bool bwrite);
+   static int  checkThrottling(bool bget); // NB: return 0 or the HTTP status code of the refusal...
+   static uint32_t checkThrottlingBeforeSend(UClientImage_Base* pclient, bool bwrite); // NB: return 0 (wait) or the max bytes to send...
 
    static void initThrottlingClient();
    static void initThrottlingServer();
+   static void runThrottlingServer();
+
+   static uint64_t getThrottlingKey(UClientImage_Base* pclient) U_NO_EXPORT;
 #endif
 
             UServer_Base(UFileConfig* pcfg = 0);
@@ -705,6 +717,10 @@ protected:
 private:
    static void manageSigHUP() U_NO_EXPORT;
    static bool clientImageHandlerRead() U_NO_EXPORT;
+#ifdef U_SSL_HANDSHAKE_OFFLOAD
+   static void handlerHandshake(UClientImage_Base* cimg) U_NO_EXPORT;
+   static void handlerHandshakeDone(UClientImage_Base* cimg) U_NO_EXPORT;
+#endif
    static void logMemUsage(const char* signame) U_NO_EXPORT;
    static void loadStaticLinkedModules(const char* name) U_NO_EXPORT;
 
@@ -715,6 +731,8 @@ private:
    friend class UDayLight;
    friend class UTimeStat;
    friend class USSLSocket;
+   friend class UPubSub;
+   friend class UMetrics;
    friend class USSIPlugIn;
    friend class UWebSocket;
    friend class USocketExt;
@@ -731,13 +749,15 @@ private:
    friend class UClient_Base;
    friend class UStreamPlugIn;
    friend class UClientThread;
+   friend class USSLHandshake;
+   friend class USSLHandshakeThread;
    friend class UModNoCatPeer;
    friend class UHttpClient_Base;
    friend class UWebSocketPlugIn;
    friend class UModProxyService;
    friend class UClientImage_Base;
    friend class UTimeoutConnection;
-   friend class UBandWidthThrottling;
+   friend class UTimeoutHeader;
 };
 
 template <class Socket> class U_EXPORT UServer : public UServer_Base {
@@ -99,7 +99,8 @@ public:
       SK_RAW        = 0x002,
       SK_UNIX       = 0x004,
       SK_SSL        = 0x008,
-      SK_SSL_ACTIVE = 0x010
+      SK_SSL_ACTIVE = 0x010,
+      SK_SSL_KTLS   = 0x020
    };
 
    USocket(bool bSocketIsIPv6 = false);
@@ -223,6 +224,35 @@ public:
 #  endif
       }
 
+   // NB: with kernel TLS offload the record encryption is done by the kernel, so we can write on the socket descriptor (sendfile)...
+
+   bool isKTLS() const
+      {
+      U_TRACE_NO_PARAM(0, "USocket::isKTLS()")
+
+      U_INTERNAL_DUMP("U_socket_Type = %d %B", U_socket_Type(this), U_socket_Type(this))
+
+#  ifdef USE_LIBSSL
+      if ((U_socket_Type(this) & SK_SSL_KTLS) != 0) U_RETURN(true);
+#  endif
+
+      U_RETURN(false);
+      }
+
+   void setKTLS(bool _flag)
+      {
+      U_TRACE(0, "USocket::setKTLS(%b)", _flag)
+
+#  ifdef USE_LIBSSL
+      U_ASSERT(isSSL())
+
+      if (_flag) U_socket_Type(this) |=  SK_SSL_KTLS;
+      else       U_socket_Type(this) &= ~SK_SSL_KTLS;
+
+      U_INTERNAL_DUMP("U_socket_Type = %d %B", U_socket_Type(this), U_socket_Type(this))
+#  endif
+      }
+
    /**
     * The getsockopt() function is called with the provided parameters to obtain the desired value
     */
@@ -360,6 +360,7 @@ public:
 
    virtual void handlerError() U_DECL_FINAL;
    virtual void handlerDisConnect() U_DECL_FINAL;
+   virtual bool handlerPing() U_DECL_FINAL;
    virtual void execute(USqlStatement* pstmt) U_DECL_FINAL;
    virtual bool nextRow(USqlStatement* pstmt) U_DECL_FINAL;
    virtual void handlerStatementReset(USqlStatement* pstmt) U_DECL_FINAL;
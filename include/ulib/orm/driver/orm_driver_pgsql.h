@@ -388,10 +388,12 @@ public:
    bool resultFormat;        // is zero to obtain results in text format, or one to obtain results in binary format
 };
 
+class UPgSqlAsync;
+
 class U_EXPORT UOrmDriverPgSql : public UOrmDriver {
 public:
 
-   UOrmDriverPgSql()
+   UOrmDriverPgSql() : vres(0), pasync(0), psession(0), callback(0), arg(0), nres_max(0), nres(0), ires(0), npending(0), nunsync(0), nsync(0), bpipeline(false)
       {
       U_TRACE_REGISTER_OBJECT(0, UOrmDriverPgSql, "")
 
@@ -400,7 +402,7 @@ public:
       UOrmDriver::name = *UString::str_pgsql_name;
       }
 
-   UOrmDriverPgSql(const UString& name_drv) : UOrmDriver(name_drv)
+   UOrmDriverPgSql(const UString& name_drv) : UOrmDriver(name_drv), vres(0), pasync(0), psession(0), callback(0), arg(0), nres_max(0), nres(0), ires(0), npending(0), nunsync(0), nsync(0), bpipeline(false)
       {
       U_TRACE_REGISTER_OBJECT(0, UOrmDriverPgSql, "%V", name_drv.rep)
       }
@@ -411,6 +413,7 @@ public:
 
    virtual void handlerError() U_DECL_FINAL;
    virtual void handlerDisConnect() U_DECL_FINAL;
+   virtual bool handlerPing() U_DECL_FINAL;
    virtual void execute(USqlStatement* pstmt) U_DECL_FINAL;
    virtual bool nextRow(USqlStatement* pstmt) U_DECL_FINAL;
    virtual void handlerStatementReset(USqlStatement* pstmt) U_DECL_FINAL;
@@ -421,6 +424,11 @@ public:
    virtual unsigned long long affected(USqlStatement* pstmt) U_DECL_FINAL;
    virtual unsigned long long last_insert_rowid(USqlStatement* pstmt, const char* sequence) U_DECL_FINAL;
 
+   virtual bool handlerPipeline(bool benter) U_DECL_FINAL;
+   virtual bool asyncExecute(USqlStatement* pstmt) U_DECL_FINAL;
+   virtual bool asyncResult(USqlStatement* pstmt) U_DECL_FINAL;
+   virtual bool sendAsync(UOrmSession* psession, vPFospv callback, void* arg) U_DECL_FINAL;
+
    virtual UOrmDriver*    handlerConnect(const UString& option) U_DECL_FINAL;
    virtual USqlStatement* handlerStatementCreation(const char* stmt, uint32_t len) U_DECL_FINAL
       {
@@ -509,11 +517,35 @@ public:
    const char* dump(bool reset) const;
 #endif
 
+protected:
+   PGresult** vres;       // async mode: the results arrived by the event loop, not yet read with asyncResult()
+   UPgSqlAsync* pasync;   // async mode: the event of the connection registered with UNotifier
+   UOrmSession* psession; // async mode: the arguments of the callback
+   vPFospv callback;      // async mode: the callback (0 => no results pending)
+   void* arg;
+   uint32_t nres_max, // async mode: capacity of vres
+            nres,     // async mode: number of the results arrived
+            ires,     // async mode: number of the results read with asyncResult()
+            npending, // number of statement sent in pipeline mode whose result is not yet read
+            nunsync,  // number of statement sent after the last sync point
+            nsync;    // number of sync point whose PGRES_PIPELINE_SYNC result is not yet read
+   bool bpipeline;
+
 private:
    bool checkExecution(PGresult* res);
 
+#ifdef LIBPQ_HAS_PIPELINING
+   bool flush() U_NO_EXPORT;
+   bool readResult(PGresult** pres) U_NO_EXPORT;
+   bool enterPipeline() U_NO_EXPORT;
+   void  exitPipeline() U_NO_EXPORT;
+   bool handlerAsync(bool bread) U_NO_EXPORT;
+   void  clearAsync() U_NO_EXPORT;
+#endif
+
    U_DISALLOW_COPY_AND_ASSIGN(UOrmDriverPgSql)
 
+   friend class UPgSqlAsync;
    friend class UPgSqlStatement;
 };
 
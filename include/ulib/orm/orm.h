@@ -16,9 +16,18 @@
 
 #include <ulib/string.h>
 
+#ifndef U_ORM_BATCH_SIZE
+#define U_ORM_BATCH_SIZE 1024 // max number of row of a batch in flight with the server (drivers with pipeline mode)
+#endif
+
+class UOrmPool;
 class UOrmDriver;
+class UEventTime;
 class UOrmStatement;
 class USqlStatement;
+class UOrmSession;
+
+typedef void (*vPFospv)(UOrmSession*,void*); // callback for the results of the statements sent in async mode
 
 /**
  * \brief SQL session object that represents a single connection and is the gateway to SQL database
@@ -36,7 +45,13 @@ public:
    U_MEMORY_ALLOCATOR
    U_MEMORY_DEALLOCATOR
 
-   UOrmSession(const char* dbname,  uint32_t len);
+   UOrmSession(const char* dbname,  uint32_t len)
+      {
+      U_TRACE_REGISTER_OBJECT(0, UOrmSession, "%.*S,%u", len, dbname, len)
+
+      init(dbname, len, false);
+      }
+
    UOrmSession(const char* backend, uint32_t len, const UString& option)
       {
       U_TRACE_REGISTER_OBJECT(0, UOrmSession, "%.*S,%u,%V", len, backend, len, option.rep)
@@ -65,6 +80,18 @@ public:
 
    unsigned long long last_insert_rowid(const char* sequence = 0);
 
+   // Pipeline mode: the statement executed with UOrmStatement::asyncExecute() are sent without waiting the result,
+   // that must be read (in the same order) with UOrmStatement::asyncResult(). It returns false if not supported
+
+   bool startPipeline();
+   void   endPipeline();
+
+   // Async mode: sendAsync() send the statements executed with UOrmStatement::asyncExecute() and return without waiting, the connection
+   // is registered with UNotifier and the callback is called by the event loop when all the results are arrived, so that the following
+   // UOrmStatement::asyncResult() don't block. A driver without pipeline mode (the statements are already executed) call it at once...
+
+   bool sendAsync(vPFospv callback, void* arg = 0);
+
    // STREAM
 
 #ifdef U_STDCPP_ENABLE
@@ -81,16 +108,79 @@ public:
 protected:
    UOrmDriver* pdrv;
 
-   void loadDriver(const char* backend, uint32_t len, const UString& option);
+   void init(const char* dbname, uint32_t len, bool bnew);
+   void loadDriver(const char* backend, uint32_t len, const UString& option, bool bnew = false);
 
 private:
+   // NB: the session of the pool must have always its own connection...
+
+   UOrmSession(UOrmPool* ppool, const char* dbname, uint32_t len)
+      {
+      U_TRACE_REGISTER_OBJECT(0, UOrmSession, "%p,%.*S,%u", ppool, len, dbname, len)
+
+      init(dbname, len, true);
+      }
+
    static void loadDriverFail(const char* ptr, uint32_t len) __noreturn U_NO_EXPORT;
 
    U_DISALLOW_COPY_AND_ASSIGN(UOrmSession)
 
+   friend class UOrmPool;
    friend class UOrmStatement;
 };
 
+/**
+ * \brief Pool of SQL session of the (worker) process
+ *
+ * The session are opened on demand up to max and given back to the pool after the use, the most recently used first (the
+ * one with the warmest cache of prepared statement). A timer closes the session idle for more than idle_timeout seconds
+ * (keeping at least min of them open) and checks with a ping that the others are still usable, so the connection setup
+ * is out of the request path
+ */
+
+class U_EXPORT UOrmPool {
+public:
+
+   // Check for memory error
+   U_MEMORY_TEST
+
+   // Allocator e Deallocator
+   U_MEMORY_ALLOCATOR
+   U_MEMORY_DEALLOCATOR
+
+    UOrmPool(const char* dbname, uint32_t len, uint32_t min = 1, uint32_t max = 8, uint32_t idle_timeout = 60);
+   ~UOrmPool();
+
+   // SERVICES
+
+   UOrmSession* get(); // NB: return 0 if all the session are busy...
+   void     release(UOrmSession* psession);
+
+   uint32_t size() const { return nidle + nbusy; }
+
+   void reap(); // close the idle session expired and check the others (called by the timer)
+
+#if defined(U_STDCPP_ENABLE) && defined(DEBUG)
+   const char* dump(bool reset) const;
+#endif
+
+protected:
+   typedef struct idle_session {
+      UOrmSession* psession;
+      long last; // time of the release
+   } idle_session;
+
+   UString dbname;
+   idle_session* vidle; // stack of idle session, the last released on top
+   UEventTime* reaper;
+   uint32_t nidle, nbusy, min, max, idle_timeout;
+
+   UOrmSession* open();
+
+private:
+   U_DISALLOW_COPY_AND_ASSIGN(UOrmPool)
+};
+
 class U_EXPORT UOrmTypeHandler_Base {
 public:
    // Check for memory error
@@ -206,10 +296,49 @@ public:
     UOrmStatement(UOrmSession& session, const char* query, uint32_t query_len);
    ~UOrmStatement();
 
+   // NB: the statement prepared on the connection, the one of the cache of the connection if there was already the same SQL text...
+
+   USqlStatement* getStatement() const { return pstmt; }
+
    // Execute the statement
 
    void execute();
 
+   // Execute the statement in pipeline mode (see UOrmSession::startPipeline()) and read its result
+
+   bool asyncExecute();
+   bool asyncResult();
+
+   // Batch: the statement is executed for many rows in one transaction, and with one round trip for U_ORM_BATCH_SIZE rows where
+   // the driver supports the pipeline mode. Every addBatch() takes the current value of the variables bound with use() (the string
+   // are bound by content, so they must be bound again as executeBatch() does), endBatch() commits (or rolls back if a row failed)
+   // and returns false if the batch failed
+
+   bool beginBatch();
+   bool   addBatch();
+   bool   endBatch();
+
+   template <class T> bool executeBatch(UVector<T*>& vrow) // NB: every row is bound with UOrmTypeHandler<T>...
+      {
+      U_TRACE(0, "UOrmStatement::executeBatch<T>(%p)", &vrow)
+
+      if (beginBatch())
+         {
+         for (uint32_t i = 0, n = vrow.size(); i < n; ++i)
+            {
+            if (i) reset(); // NB: the statement is reset after the bind of the previous row...
+
+            use(*vrow[i]);
+
+            (void) addBatch();
+            }
+
+         if (endBatch()) U_RETURN(true);
+         }
+
+      U_RETURN(false);
+      }
+
    // This function returns the number of database rows that were changed
    // or inserted or deleted by the most recently completed SQL statement
 
@@ -332,6 +461,10 @@ public:
 protected:
    UOrmDriver* pdrv;
    USqlStatement* pstmt;
+   uint32_t nbatch, npending; // rows of the batch, rows sent whose result is not yet read
+   bool bpipeline, berror;
+
+   void readBatch();
 
 private:
    U_DISALLOW_COPY_AND_ASSIGN(UOrmStatement)
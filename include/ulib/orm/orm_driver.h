@@ -17,6 +17,10 @@
 #include <ulib/dynamic/plugin.h>
 #include <ulib/container/vector.h>
 
+#ifndef U_ORM_STMT_CACHE_SIZE
+#define U_ORM_STMT_CACHE_SIZE 32 // number of prepared statement cached for connection (LRU keyed by the SQL text)
+#endif
+
 typedef enum ParamType {
       NULL_VALUE =  0, // null value
    BOOLEAN_VALUE =  1, // bool value
@@ -221,6 +225,8 @@ class UOrmSession;
 class UServer_Base;
 class UOrmStatement;
 
+typedef void (*vPFospv)(UOrmSession*,void*); // callback for the results of the statements sent in async mode
+
 class U_EXPORT UOrmDriver {
 public:
 
@@ -233,8 +239,11 @@ public:
 
       errmsg     = errname = 0;
       errcode    = 0;
+      num_error  = 0;
       SQLSTATE   = 0;
       connection = 0;
+      vstmt      = 0;
+      stmt_clock = 0;
       }
 
    UOrmDriver(const UString& name_drv) : name(name_drv)
@@ -243,8 +252,11 @@ public:
 
       errmsg     = errname = 0;
       errcode    = 0;
+      num_error  = 0;
       SQLSTATE   = 0;
       connection = 0;
+      vstmt      = 0;
+      stmt_clock = 0;
       }
 
    virtual ~UOrmDriver();
@@ -316,6 +328,13 @@ public:
       handlerStatementRemove(pstmt);
       }
 
+   // PREPARED STATEMENT CACHE: the statement released by UOrmStatement stay prepared on the connection (with the bindings
+   // reset) and are given back to the next UOrmStatement created with the same SQL text, evicting the least recently used
+
+   USqlStatement* getStatement(const char* stmt, uint32_t len);
+   void       releaseStatement(USqlStatement* pstmt);
+   void         clearStatement();
+
    // BIND
 
    void bindParam(USqlStatement* pstmt)
@@ -448,6 +467,56 @@ public:
 
    virtual unsigned int cols(USqlStatement* pstmt) { return 0; }
 
+   // Check if the connection is still usable (health check of the connection pool)
+
+   virtual bool handlerPing()
+      {
+      U_TRACE_NO_PARAM(0, "UOrmDriver::handlerPing()")
+
+      U_RETURN(true);
+      }
+
+   // Pipeline mode: the statements are sent with asyncExecute() without waiting the results, that are
+   // read in the same order with asyncResult(). A driver without support execute them synchronously
+
+   virtual bool handlerPipeline(bool benter)
+      {
+      U_TRACE(0, "UOrmDriver::handlerPipeline(%b)", benter)
+
+      U_RETURN(false);
+      }
+
+   virtual bool asyncExecute(USqlStatement* pstmt)
+      {
+      U_TRACE(0, "UOrmDriver::asyncExecute(%p)", pstmt)
+
+      uint32_t n = num_error;
+
+      execute(pstmt);
+
+      // NB: we can't check errcode, printError() clear it if bexit is false...
+
+      if (num_error == n) U_RETURN(true);
+
+      U_RETURN(false);
+      }
+
+   virtual bool asyncResult(USqlStatement* pstmt)
+      {
+      U_TRACE(0, "UOrmDriver::asyncResult(%p)", pstmt)
+
+      U_RETURN(true);
+      }
+
+   virtual bool sendAsync(UOrmSession* psession, vPFospv callback, void* arg)
+      {
+      U_TRACE(0, "UOrmDriver::sendAsync(%p,%p,%p)", psession, callback, arg)
+
+      callback(psession, arg); // NB: the statements are already executed...
+
+      U_RETURN(true);
+      }
+
    /**
     * The string must consist of a single SQL statement. You should not add a terminating semicolon (;) or \g to the statement.
     * The application can include one or more parameter markers in the SQL statement by embedding question mark (?) characters into
@@ -529,9 +598,20 @@ public:
    const char* errmsg;
    const char* errname;
    const char* SQLSTATE;
+   uint32_t num_error; // number of the error reported by printError()
    int errcode;
 
 protected:
+   typedef struct stmt_cache {
+      UString sql;
+      USqlStatement* pstmt;
+      uint32_t last; // value of stmt_clock at the last use
+      bool busy;     // owned by a UOrmStatement
+   } stmt_cache;
+
+   stmt_cache* vstmt;
+   uint32_t stmt_clock;
+
    static bool                  bexit;
    static uint32_t              vdriver_size, env_driver_len;
    static const char*           env_driver;
@@ -15,53 +15,99 @@
 #define ULIB_SSL_SESSION_H 1
 
 #include <ulib/ssl/net/sslsocket.h>
-#include <ulib/utility/data_session.h>
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#  include <openssl/core_names.h>
+#endif
 
 /**
- * SSL Session Information
+ * SSL Session Cache
  *
- * This class contains data about an SSL session
+ * Fixed-size table of session (ASN1 representation) living in the shared memory of the server, so the session
+ * resumption work between preforked process without lock: every slot is protected by a seqlock (the writer
+ * acquire the slot with a CAS on the sequence number, the reader retry or miss if the sequence changed).
+ *
+ * It manages also the keys for the stateless session ticket (TLS 1.2 and TLS 1.3), shared by all the process
+ * and rotated by a timer: the previous key is still accepted (the ticket is renewed) for one rotation interval
  */
 
+#ifndef U_SSL_SESSION_CACHE_SIZE
+#define U_SSL_SESSION_CACHE_SIZE 4096 // number of slot of the cache (~4M)
+#endif
+
+#ifndef U_SSL_SESSION_MAX_SIZE
+#define U_SSL_SESSION_MAX_SIZE 960 // max size of the ASN1 representation of a session, the bigger one are not cached
+#endif
+
+#ifndef U_SSL_TICKET_KEY_ROTATION
+#define U_SSL_TICKET_KEY_ROTATION (12 * U_ONE_HOUR_IN_SECOND) // life of the key for the session ticket
+#endif
+
+#ifndef U_SSL_TICKET_KEY_MAX_RETRY
+#define U_SSL_TICKET_KEY_MAX_RETRY 1024 // max number of read of the ticket keys during a rotation, then we do a full handshake
+#endif
+
 class UHTTP;
 class UHttpPlugIn;
+class USSLSessionTicketKey;
 
-class U_EXPORT USSLSession : public UDataStorage {
+class U_EXPORT USSLSession {
 public:
 
-   USSLSession()
-      {
-      U_TRACE_REGISTER_OBJECT(0, USSLSession, "", 0)
-      }
+   typedef struct slot {
+      uint32_t seq, len, id_len; // seq: seqlock (odd -> writer in progress)
+      long expire;
+      unsigned char id[SSL_MAX_SSL_SESSION_ID_LENGTH];
+      unsigned char data[U_SSL_SESSION_MAX_SIZE];
+   } slot;
 
-   virtual ~USSLSession() U_DECL_FINAL
-      {
-      U_TRACE_UNREGISTER_OBJECT(0, USSLSession)
-      }
+   typedef struct ticket_key {
+      unsigned char name[16], aes_key[32], hmac_key[32];
+   } ticket_key;
 
-   // define method VIRTUAL of class UDataStorage
+   typedef struct cache {
+      uint32_t key_seq;  // seqlock for the ticket keys
+      long key_rotate;   // time of the next rotation
+      ticket_key key[2]; // [0] current, [1] previous (only decrypt)
+      slot slots[U_SSL_SESSION_CACHE_SIZE];
+   } cache;
 
-   virtual char* toBuffer() U_DECL_FINAL;
-   virtual void  fromData(const char* ptr, uint32_t len) U_DECL_FINAL;
+   static cache* ptr;
 
    // SERVICES
 
-#if defined(DEBUG) && defined(U_STDCPP_ENABLE)
-   const char* dump(bool reset) const { return UDataStorage::dump(reset); }
-#endif
+   static long checkTicketKey(); // NB: make the rotation if it is due, return the seconds to the next rotation...
+   static bool rotateTicketKey();
 
-private:
-   static SSL_SESSION* sess;
+   static uint32_t getSlot(const unsigned char* id, uint32_t len)
+      {
+      U_TRACE(0, "USSLSession::getSlot(%.*S,%u)", len, id, len)
+
+      uint32_t index = u_hash(id, len) % U_SSL_SESSION_CACHE_SIZE;
+
+      U_RETURN(index);
+      }
+
+   static void init(SSL_CTX* ctx);
+   static bool getTicketKey(ticket_key* key);
 
    static int     newSession(SSL* ssl,     SSL_SESSION* sess);
    static void removeSession(SSL_CTX* ctx, SSL_SESSION* sess);
 
    static SSL_SESSION* getSession(SSL* ssl, unsigned char* id, int len, int* copy);
 
+#if OPENSSL_VERSION_NUMBER < 0x30000000L
+   static int ticketKeyCallback(SSL* ssl, unsigned char* name, unsigned char* iv, EVP_CIPHER_CTX* ectx, HMAC_CTX* hctx, int enc);
+#else
+   static int ticketKeyCallback(SSL* ssl, unsigned char* name, unsigned char* iv, EVP_CIPHER_CTX* ectx, EVP_MAC_CTX* hctx, int enc);
+#endif
+
+private:
    U_DISALLOW_COPY_AND_ASSIGN(USSLSession)
 
    friend class UHTTP;
    friend class UHttpPlugIn;
+   friend class USSLSessionTicketKey;
 };
 
 #endif
@@ -32,6 +32,10 @@
 #  define U_USE_NPN  1
 #endif
 
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+#  define U_USE_KTLS 1
+#endif
+
 #if !defined(OPENSSL_NO_OCSP) && defined(SSL_CTRL_SET_TLSEXT_STATUS_REQ_CB)
 #  include <openssl/ocsp.h>
 #  ifndef U_OCSP_MAX_RESPONSE_SIZE
@@ -75,7 +79,11 @@ public:
    ~USSLSocket();
 
    bool secureConnection();
-   bool acceptSSL(USSLSocket* pcConnection);
+   bool acceptSSL(USSLSocket* pcConnection, int timeoutMS = U_SSL_TIMEOUT_MS); // NB: the timeout is for the whole handshake...
+
+   // NB: if set the accept of the listening socket don't do the handshake, it must be done later by acceptSSL() (see handshake offload)...
+
+   static bool bdefer_handshake;
 
    static long getOptions(const UVector<UString>& vec);
 
@@ -213,6 +221,29 @@ public:
       U_RETURN(0);
       }
 
+   /**
+    * Kernel TLS offload (Linux >= 4.13 with the tls module): after the handshake the keys of the connection are passed to the
+    * kernel (setsockopt TCP_ULP/TLS_TX) that encrypt the records, so we can use sendfile() also for HTTPS. If the kernel or the
+    * negotiated cipher don't support it OpenSSL continue silently in userspace, so we must check it for every connection
+    */
+
+   static bool bktls, bktls_checked; // NB: bktls_checked -> the state of the first connection is reported...
+
+   static bool enableKTLS(SSL_CTX* ctx);
+
+   bool isKTLSActive() const
+      {
+      U_TRACE_NO_PARAM(0, "USSLSocket::isKTLSActive()")
+
+      U_INTERNAL_ASSERT_POINTER(ssl)
+
+#  ifdef U_USE_KTLS
+      if (BIO_get_ktls_send(SSL_get_wbio(ssl))) U_RETURN(true);
+#  endif
+
+      U_RETURN(false);
+      }
+
    // VIRTUAL METHOD
 
    virtual int send(const char* pData,   uint32_t iDataLen) U_DECL_FINAL;
@@ -273,7 +304,15 @@ protected:
 
    static int session_cache_index;
 
-   static void setStatus(SSL* _ssl, int _ret, bool _flag);
+   static uint32_t setStatus(char* buffer, uint32_t size, SSL* _ssl, int _ret, bool _flag); // NB: it can be called by more thread...
+
+   static void setStatus(SSL* _ssl, int _ret, bool _flag)
+      {
+      U_INTERNAL_ASSERT_EQUALS(u_buffer_len, 0)
+
+      u_buffer_len = setStatus(u_buffer, U_BUFFER_SIZE, _ssl, _ret, _flag);
+      }
+
    static void info_callback(const SSL* ssl, int where, int ret);
 
    void setStatus(bool _flag) const { setStatus(ssl, ret, _flag); }
@@ -139,9 +139,26 @@ public:
 
       U_INTERNAL_DUMP("this = %p parent = %p references = %d child = %d", this, parent, references, child)
 
+#  ifdef U_THREAD_SAFE_STRING
+      if (bthread) (void) __atomic_fetch_add(&references, 1, __ATOMIC_RELAXED);
+      else
+#  endif
       ++references;
       }
 
+   void hold(uint32_t n)
+      {
+      U_TRACE(0, "UStringRep::hold(%u)", n)
+
+      U_CHECK_MEMORY
+
+#  ifdef U_THREAD_SAFE_STRING
+      if (bthread) (void) __atomic_fetch_add(&references, n, __ATOMIC_RELAXED);
+      else
+#  endif
+      references += n;
+      }
+
    void release() // NB: we don't use delete (dtor) because add a deallocation to the destroy object process...
       {
       U_TRACE_NO_PARAM(0, "UStringRep::release()")
@@ -156,6 +173,23 @@ public:
          }
 #  endif
 
+#  ifdef U_THREAD_SAFE_STRING
+      if (bthread)
+         {
+         // NB: if we hold the only reference nobody else can touch the counter, so we can skip the atomic op...
+
+         if (__atomic_load_n(&references, __ATOMIC_ACQUIRE) == 0 ||
+             __atomic_fetch_sub(&references, 1, __ATOMIC_ACQ_REL) == 0)
+            {
+            references = 0;
+
+            _release();
+            }
+
+         return;
+         }
+#  endif
+
       if (references) --references;
       else _release();
       }
@@ -750,6 +784,10 @@ public:
 
    static UStringRep* string_rep_null; // This storage is init'd to 0 by the linker, resulting (carefully) in an empty string with one(=>0) reference...
 
+#ifdef U_THREAD_SAFE_STRING
+   static bool bthread; // NB: set by UThread::start(), after that the reference counting is atomic...
+#endif
+
 #if defined(U_SUBSTR_INC_REF) || defined(DEBUG)
    UStringRep* parent; // manage substring to increment reference of source string
 # ifdef DEBUG
@@ -1158,6 +1196,7 @@ protected:
 
       U_INTERNAL_ASSERT_POINTER(r)
       U_INTERNAL_ASSERT_DIFFERS(rep, r)
+      U_INTERNAL_ASSERT_MSG(UArena::isEscape(r, this) == false, "a string of the request arena is stored in an object that survive the request")
 
       rep->release(); // 1. release existing resource
       rep = r;        // 2. bind copy to self
@@ -1170,6 +1209,7 @@ protected:
       U_TRACE(0, "UString::_copy(%V)", r)
 
       U_INTERNAL_ASSERT_POINTER(r)
+      U_INTERNAL_ASSERT_MSG(UArena::isEscape(r, this) == false, "a string of the request arena is stored in an object that survive the request")
 
       rep = r;  // bind copy to self
       rep->hold();
@@ -1183,6 +1223,7 @@ public:
       U_TRACE(0, "UString::_assign(%V)", r)
 
       U_INTERNAL_ASSERT_POINTER(r)
+      U_INTERNAL_ASSERT_MSG(UArena::isEscape(r, this) == false, "a string of the request arena is stored in an object that survive the request")
 
       // NB: it works also in the case of (rep == r)...
 
@@ -1208,6 +1249,8 @@ public:
       {
       U_TRACE_REGISTER_OBJECT_WITHOUT_CHECK_MEMORY(0, UString, "%V", r)
 
+      U_INTERNAL_ASSERT_MSG(UArena::isEscape(r, this) == false, "a string of the request arena is stored in an object that survive the request")
+
       rep->hold();
 
       U_INTERNAL_ASSERT(invariant())
@@ -1355,6 +1398,8 @@ public:
       {
       U_TRACE_REGISTER_OBJECT_WITHOUT_CHECK_MEMORY(0, UString, "%p", &str)
 
+      U_INTERNAL_ASSERT_MSG(UArena::isEscape(rep, this) == false, "a string of the request arena is stored in an object that survive the request")
+
       rep->hold();
 
       U_INTERNAL_ASSERT(invariant())
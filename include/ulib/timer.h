@@ -77,11 +77,11 @@ public:
 
    // deschedule a timer. Note that non-periodic timers are automatically descheduled when they run, so you don't have to call this on them
 
-   static void erase(UTimer* item)
+   static void erase(UTimer* item) // NB: the item is already removed from the active list (that can be empty now)...
       {
       U_TRACE(0, "UTimer::erase(%p)", item)
 
-      U_INTERNAL_ASSERT_POINTER(first)
+      U_INTERNAL_ASSERT_POINTER(item)
 
       if (mode != NOSIGNAL) delete item;
       else
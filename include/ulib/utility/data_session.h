@@ -123,6 +123,7 @@ protected:
 private:
    U_DISALLOW_COPY_AND_ASSIGN(UDataStorage)
 
+                      friend class USessionStore;
    template <class T> friend class URDBObjectHandler;
 };
 
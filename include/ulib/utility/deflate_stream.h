@@ -0,0 +1,113 @@
+// ============================================================================
+//
+// = LIBRARY
+//    ULib - c++ library
+//
+// = FILENAME
+//    deflate_stream.h - incremental gzip compression of a content feeded in chunk
+//
+// = AUTHOR
+//    Stefano Casazza
+//
+// ============================================================================
+
+#ifndef ULIB_DEFLATE_STREAM_H
+#define ULIB_DEFLATE_STREAM_H 1
+
+#include <ulib/string.h>
+#include <ulib/base/coder/gzio.h>
+
+/**
+ * @class UDeflateStream
+ *
+ * @brief Context for the compression of a content that is not all available (ex: a big report generated by a dynamic page or
+ *        a proxied response): every chunk is compressed and appended to the output, so the memory used is bounded by the size
+ *        of the chunk and not by the size of the content. writeChunk() append the data with the format of Transfer-Encoding:
+ *        chunked (HTTP/1.1), while write() append only the compressed data (ex: for the DATA frames of HTTP/2)
+ */
+
+class U_EXPORT UDeflateStream {
+public:
+
+   // Check for memory error
+   U_MEMORY_TEST
+
+   // Allocator e Deallocator
+   U_MEMORY_ALLOCATOR
+   U_MEMORY_DEALLOCATOR
+
+   UDeflateStream()
+      {
+      U_TRACE_REGISTER_OBJECT(0, UDeflateStream, "", 0)
+
+      bactive = false;
+      }
+
+   ~UDeflateStream()
+      {
+      U_TRACE_UNREGISTER_OBJECT(0, UDeflateStream)
+
+      end();
+      }
+
+   // SERVICES
+
+   bool isActive() const { return bactive; }
+
+   // NB: size is the length of the content if known (0 => unknown), it select the compression level with u_gz_deflate_level()...
+
+   bool init(uint32_t size = 0, bool bheader = true);
+
+   void end();
+
+   uint32_t getTotalIn() const
+      {
+      U_TRACE_NO_PARAM(0, "UDeflateStream::getTotalIn()")
+
+#  ifdef USE_LIBZ
+      if (bactive) U_RETURN(stream.total_in);
+#  endif
+
+      U_RETURN(0);
+      }
+
+   uint32_t getTotalOut() const
+      {
+      U_TRACE_NO_PARAM(0, "UDeflateStream::getTotalOut()")
+
+#  ifdef USE_LIBZ
+      if (bactive) U_RETURN(stream.total_out);
+#  endif
+
+      U_RETURN(0);
+      }
+
+   // append to output the compressed data (bflush => the data can be decompressed by the peer without waiting the next chunk)
+
+   bool write(const char* ptr, uint32_t len, UString& output, bool bflush = false, bool bfinish = false);
+   bool write(const UString& data,           UString& output, bool bflush = false, bool bfinish = false) { return write(U_STRING_TO_PARAM(data), output, bflush, bfinish); }
+
+   // append to output the compressed data as a chunk of Transfer-Encoding: chunked (bfinish => with the last-chunk)
+
+   bool writeChunk(const char* ptr, uint32_t len, UString& output, bool bfinish = false);
+   bool writeChunk(const UString& data,           UString& output, bool bfinish = false) { return writeChunk(U_STRING_TO_PARAM(data), output, bfinish); }
+
+   // NB: without compression (ex: the client don't accept gzip) we need anyway the format of Transfer-Encoding: chunked...
+
+   static void addChunk(const char* ptr, uint32_t len, UString& output, bool bfinish = false);
+
+#if defined(U_STDCPP_ENABLE) && defined(DEBUG)
+   const char* dump(bool reset) const;
+#endif
+
+protected:
+#ifdef USE_LIBZ
+   z_stream stream;
+#endif
+   bool bactive;
+
+private:
+   U_DISALLOW_COPY_AND_ASSIGN(UDeflateStream)
+};
+
+#endif
@@ -21,12 +21,18 @@
 /**
  * FTW - walks through the directory tree starting from the indicated directory.
  *       For each found entry in the tree, it calls foundFile()
+ *
+ * On Linux the directory are read with getdents64() in large block, and the d_type of the entry is used to avoid
+ * the lstat() of the directory. With setPrefetch() walk(vec) stat() and read ahead the found files with a pool of
+ * thread that is joined before return, so that the (serial) work of the caller on the list find usually the inode
+ * and the data in cache (the read ahead is only a hint, the caller can still wait for the disk)...
  */
 
 class IR;
 class UFile;
 class UHTTP;
 class PEC_report;
+class UDirWalkPrefetch;
 
 template <class T> class UTree;
 template <class T> class UVector;
@@ -146,6 +152,16 @@ public:
       U_NEW(UString, suffix_file_type, UString(str, len));
       }
 
+   // NB: num_thread <= 1 => disabled (default), the files greater than max_size are only stat()-ed...
+
+   static void setPrefetch(uint32_t num_thread, uint32_t max_size = 500U * 1024U)
+      {
+      U_TRACE(0, "UDirWalk::setPrefetch(%u,%u)", num_thread, max_size)
+
+      prefetch_thread   = num_thread;
+      prefetch_max_size = max_size;
+      }
+
    static void setFilter(const char* _filter, uint32_t _filter_len, int _filter_flags = 0)
       {
       U_TRACE(0, "UDirWalk::setFilter(%.*S,%u,%d)", _filter_len, _filter, _filter_len, _filter_flags)
@@ -179,7 +195,7 @@ protected:
    static qcompare sort_by;
    static const char* filter;
    static UTree<UString>* ptree;
-   static uint32_t max, filter_len;
+   static uint32_t max, filter_len, prefetch_thread, prefetch_max_size;
    static UString* suffix_file_type;
    static UVector<UString>* pvector;
    static vPF call_if_up, call_internal;
@@ -206,8 +222,12 @@ protected:
 private:
    bool isFile() U_NO_EXPORT;
    void recurse() U_NO_EXPORT; // performs the actual work
+   void readEntry(dir_s* pqdir, char* d_name, uint32_t d_namlen, ino_t d_ino, unsigned char d_type) U_NO_EXPORT;
    void prepareForCallingRecurse(char* d_name, uint32_t d_namlen, unsigned char d_type) U_NO_EXPORT;
 
+   static void prefetch() U_NO_EXPORT;
+   static void prefetchRange() U_NO_EXPORT;
+
    static void treeUp() U_NO_EXPORT;
    static void treePush() U_NO_EXPORT;
    static void vectorPush() U_NO_EXPORT;
@@ -219,5 +239,6 @@ private:
    friend class IR;
    friend class UHTTP;
    friend class PEC_report;
+   friend class UDirWalkPrefetch;
 };
 #endif
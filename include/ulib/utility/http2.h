@@ -25,7 +25,10 @@
 #define HTTP2_FRAME_HEADER_SIZE               9 // The number of bytes of the frame header
 #define HTTP2_DEFAULT_WINDOW_SIZE         65535 
 #define HTTP2_HEADER_TABLE_OFFSET            62
+#define HTTP2_MIN_STREAMS                     4 // initial size of the stream table of a connection (it grow on demand)
 #define HTTP2_MAX_CONCURRENT_STREAMS        128
+#define HTTP2_MAX_BATCH_FRAMES               32 // max number of DATA frames written with a single writev() by the scheduler
+#define HTTP2_MAX_PUSH_STREAMS               16 // max number of resources pushed for a response
 #define HTTP2_HEADER_TABLE_ENTRY_SIZE_OFFSET 32
 
 #define HTTP2_CONNECTION_PREFACE "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n" // (24 bytes)
@@ -84,9 +87,21 @@ public:
       HpackHeaderTableEntry* entries; // ring buffer
    };
 
-   struct Stream {
-      UString headers, body;
-      uint32_t id, state, clength;
+   class Stream {
+   public:
+
+   // Allocator e Deallocator
+   U_MEMORY_ALLOCATOR
+   U_MEMORY_DEALLOCATOR
+
+   UString headers, body, // request
+           output;        // response body not yet sent (the DATA frames are written by the scheduler)
+   uint64_t vfinish;      // virtual finish time of the last DATA frame (weighted fair queuing)
+   int32_t out_window;    // send flow control window of the stream
+   uint32_t id, state, clength, offset, weight, dependency,
+            parent;       // slot (+1) of the stream on which it depend, so the scheduler don't search it for every DATA frame (0 if not in the table)
+
+   Stream() : vfinish(0), out_window(0), id(0), state(0), clength(0), offset(0), weight(0), dependency(0), parent(0) {}
    };
 
    class Connection {
@@ -106,8 +121,13 @@ public:
    UHashMap<UString> itable;           // headers request
    HpackDynamicTable idyntbl, odyntbl; // hpack dynamic table (request, response)
    // streams
-   uint32_t max_processed_stream_id;
-   Stream streams[HTTP2_MAX_CONCURRENT_STREAMS];
+   uint32_t max_processed_stream_id,
+            max_pushed_stream_id, // the id of the streams reserved with PUSH_PROMISE are even
+            streams_capacity,     // number of slot of the stream table (allocated on demand, up to HTTP2_MAX_CONCURRENT_STREAMS)
+            npending,             // number of streams with a response body not yet sent
+            last_slot;            // last slot in use kept between the events (the DATA frames deferred until a WINDOW_UPDATE)
+   uint64_t vclock;               // virtual time of the scheduler
+   Stream* streams;
    bool bnghttp2;
 #ifdef DEBUG
    UHashMap<UString> dtable;
@@ -118,6 +138,8 @@ public:
    ~Connection()
       {
       U_TRACE_UNREGISTER_OBJECT(0, Connection)
+
+      if (streams) delete[] streams;
       }
 
    void reset()
@@ -127,9 +149,15 @@ public:
       inp_window              =
       out_window              = HTTP2_DEFAULT_WINDOW_SIZE;
       peer_settings           = settings;
-      max_processed_stream_id = 0;
+      max_processed_stream_id =
+      max_pushed_stream_id    =
+      npending                =
+      last_slot               = 0;
+      vclock                  = 0;
       }
 
+   void resizeStreams(uint32_t n);
+
    // SERVICES
 
    static void preallocate(uint32_t max_connection)
@@ -255,7 +283,10 @@ protected:
    static uint32_t wait_for_continuation;
    static bool bcontinue100, bsetting_ack, bsetting_send;
 
-   static uint8_t  priority_weight;     // 0 if not set
+   static uint32_t npush, push_id[HTTP2_MAX_PUSH_STREAMS]; // streams reserved with PUSH_PROMISE for the current response
+   static UHTTP::UFileCacheData* push_data[HTTP2_MAX_PUSH_STREAMS];
+
+   static uint16_t priority_weight;     // 0 if not set
    static bool     priority_exclusive;
    static uint32_t priority_dependency; // 0 if not set
 
@@ -288,9 +319,16 @@ protected:
    static void sendResetStream();
    static void sendWindowUpdate();
    static void sendGoAway(USocket* psocket);
-
+   static void sendEarlyHints();
+   static void sendPushPromise();
+   static void writePushResponse();
+
+   static void flushStreams();
+   static Stream* addStream();
+   static Stream* pickStream();
+   static Stream* findStream(uint32_t id);
+   static void updateWindow(int32_t* pwindow);
    static void updateSetting(unsigned char* ptr, uint32_t len);
-   static void writeData(struct iovec* iov, bool bdata, bool flag);
    static void handlerDelete(UClientImage_Base* pclient, bool& bsocket_open);
 
    static void startRequest()
@@ -320,19 +358,25 @@ protected:
       for (pStream = pConnection->streams; pStream <= pStreamEnd; ++pStream)
          {
          pStream->body.clear();
+         pStream->output.clear();
          pStream->headers.clear();
 
          pStream->id      =
          pStream->state   =
+         pStream->offset  =
          pStream->clength = 0;
          }
 
+      pConnection->npending  =
+      pConnection->last_slot = 0;
+
 #  ifdef DEBUG
-      for (pStreamEnd = (pConnection->streams+HTTP2_MAX_CONCURRENT_STREAMS); pStream < pStreamEnd; ++pStream)
+      for (pStreamEnd = (pConnection->streams+pConnection->streams_capacity); pStream < pStreamEnd; ++pStream)
          {
       // U_INTERNAL_DUMP("pStream index = %u", pStream - pConnection->streams)
 
          U_ASSERT(pStream->body.empty())
+         U_ASSERT(pStream->output.empty())
          U_ASSERT(pStream->headers.empty())
 
          U_INTERNAL_ASSERT_EQUALS(pStream->clength, 0)
@@ -340,6 +384,35 @@ protected:
 #  endif
       }
 
+   static void setPriority(Stream* ps)
+      {
+      U_TRACE(0, "UHTTP2::setPriority(%p)", ps)
+
+      ps->weight     = (priority_weight ? priority_weight : 16); // NB: the exclusive flag is ignored...
+      ps->dependency = priority_dependency;
+      ps->parent     = 0;
+
+      if (priority_dependency)
+         {
+         Stream* dep = findStream(priority_dependency);
+
+         if (dep) ps->parent = (dep - pConnection->streams) + 1; // NB: the slot of a stream don't change while it is in use...
+         }
+
+      U_INTERNAL_DUMP("ps->id = %u ps->weight = %u ps->dependency = %u ps->parent = %u", ps->id, ps->weight, ps->dependency, ps->parent)
+      }
+
+   static void initStream()
+      {
+      U_TRACE_NO_PARAM(0, "UHTTP2::initStream()")
+
+      pStream->offset     = 0;
+      pStream->vfinish    = pConnection->vclock;
+      pStream->out_window = pConnection->peer_settings.initial_window_size;
+
+      setPriority(pStream);
+      }
+
    static void readPriority(unsigned char* ptr)
       {
       U_TRACE(0, "UHTTP2::readPriority(%p)", ptr)
@@ -365,9 +438,9 @@ protected:
 
       U_INTERNAL_DUMP("Accept-Encoding: = %V", x.rep)
 
-      U_INTERNAL_ASSERT(u_find(x.data(), 30, U_CONSTANT_TO_PARAM("gzip")))
+      // NB: the client can send 'identity' (or only 'br', 'deflate', ...), and then it don't accept a gzip content...
 
-      U_http_flag |= HTTP_IS_ACCEPT_GZIP;
+      if (u_find(U_STRING_TO_PARAM(x), U_CONSTANT_TO_PARAM("gzip"))) U_http_flag |= HTTP_IS_ACCEPT_GZIP;
 
       U_INTERNAL_DUMP("U_http_is_accept_gzip = %b", U_http_is_accept_gzip)
       }
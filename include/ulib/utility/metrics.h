@@ -0,0 +1,112 @@
+// ============================================================================
+//
+// = LIBRARY
+//    ULib - c++ library
+//
+// = FILENAME
+//    metrics.h - latency histograms and counters of the server (Prometheus format)
+//
+// = AUTHOR
+//    Stefano Casazza
+//
+// ============================================================================
+
+#ifndef ULIB_METRICS_H
+#define ULIB_METRICS_H 1
+
+#include <ulib/string.h>
+
+#define U_METRICS_PHASE_ACCEPT  0 // accept => first byte of the first request of the connection
+#define U_METRICS_PHASE_PARSE   1 // read hook of the plugins (the parsing of the request)
+#define U_METRICS_PHASE_HANDLER 2 // request hook of the plugins
+#define U_METRICS_PHASE_WRITE   3 // write of the response
+#define U_METRICS_PHASE_MAX     4
+
+#define U_METRICS_SUB_BUCKET    8                           // 3 bit of precision for each power of 2 (max error 12.5%)
+#define U_METRICS_BUCKET      ((36-1) * U_METRICS_SUB_BUCKET) // values in nanosecond up to 2^36 (~68 sec)
+#define U_METRICS_STATUS_MAX  500                           // status code 100-599
+#define U_METRICS_PLUGIN_MAX   16
+
+class UClientImage_Base;
+
+/**
+ * @class UMetrics
+ *
+ * @brief Latency histograms for each phase of the processing of a request and counters for each status code and plugin
+ *
+ * Every preforked worker has a slot in the shared memory (claimed with his pid when it start, so a respawned worker continue the
+ * counters of the dead one) and it is the only writer of the slot: the update is a plain increment without lock. The histogram is
+ * log-linear (HDR style): a bucket for each 1/8 of a power of 2 of the value in nanosecond, so the relative error is bounded and the
+ * quantile can be computed without keeping the samples. The URI configured (METRICS_URI) return the sum of all the slots in the text
+ * format of Prometheus, with the quantile of each phase as gauge...
+ */
+
+class U_EXPORT UMetrics {
+public:
+
+   typedef struct histogram {
+      uint64_t sum; // in nanosecond (the count is the sum of the buckets)
+      uint64_t bucket[U_METRICS_BUCKET];
+   } histogram;
+
+   typedef struct worker_data {
+      pid_t pid; // the worker that own the slot
+      uint64_t status[U_METRICS_STATUS_MAX];
+      uint64_t plugin_count[U_METRICS_PLUGIN_MAX], plugin_time[U_METRICS_PLUGIN_MAX];
+      histogram phase[U_METRICS_PHASE_MAX];
+   } worker_data;
+
+   static UString* uri; // the URI of the scrape
+
+   // SERVICES
+
+   static bool isActive() { return (pworker != 0); }
+
+   // NB: these are called by the server: init() before the shared memory is allocated, run() after, start() in the worker...
+
+   static void init();
+   static void run(uint32_t max_connection);
+   static void start();
+   static void clear();
+
+   static uint64_t now()
+      {
+      struct timespec ts;
+
+      (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+
+      return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+      }
+
+   // NB: the hooks of the processing of a request, must be called only if isActive()...
+
+   static void setAccept(uint32_t idx) { vaccept[idx] = now(); }
+
+   static void startRequest(UClientImage_Base* pclient);
+   static void setPhase(int phase);
+   static void endRequest();
+
+   static void observe(int phase, uint64_t value);
+
+   // NB: the response of the scrape (text/plain - version 0.0.4)...
+
+   static void getText(UString& body); // the sum of all the slots in the text format of Prometheus
+   static void handlerRequest();
+
+   static uint32_t getBucket(uint64_t value) __pure;
+   static uint64_t getBucketLimit(uint32_t idx) __pure; // the upper bound (exclusive) of the bucket
+   static uint64_t getQuantile(const histogram& h, uint64_t count, double q) __pure; // the upper bound of the bucket of the quantile q
+
+private:
+   static worker_data* pworker;
+   static worker_data* vworker;
+   static uint64_t* vaccept; // the time of accept() for each connection of the worker (0 => the first request was already seen)
+   static uint64_t t_start, t_last;
+   static uint32_t num_slot, max_connection;
+
+   static void sum(histogram& h, int phase) U_NO_EXPORT;
+
+   U_DISALLOW_COPY_AND_ASSIGN(UMetrics)
+};
+
+#endif
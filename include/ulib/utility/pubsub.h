@@ -0,0 +1,133 @@
+// ============================================================================
+//
+// = LIBRARY
+//    ULib - c++ library
+//
+// = FILENAME
+//    pubsub.h - topic based broadcast to WebSocket and SSE clients
+//
+// = AUTHOR
+//    Stefano Casazza
+//
+// ============================================================================
+
+#ifndef ULIB_PUBSUB_H
+#define ULIB_PUBSUB_H 1
+
+#include <ulib/string.h>
+#include <ulib/utility/lock.h>
+
+#define U_PUBSUB_TOPIC_MAX      64 // NB: the subscriptions of a connection are a bitmask (uint64_t)...
+#define U_PUBSUB_TOPIC_NAME_MAX 32
+
+class UEventFd;
+class UClientImage_Base;
+
+/**
+ * @class UPubSub
+ *
+ * @brief Topic based broadcast to the WebSocket and SSE (text/event-stream) connections of all the preforked workers
+ *
+ * Every topic has a ring in the shared memory: a publisher (a USP page, the UNIX socket control channel) write the message once in
+ * the ring (under a lock shared by the publishers) and signal the eventfd of every worker (created before the fork, two for each
+ * preforked process: a worker claim a slot with his pid when it start).
+ * Every worker keep a cursor for each topic and read the ring without lock: the message is checked after the copy against the head
+ * of the ring, so a worker that don't keep up lose the message overwritten instead of blocking the publisher. The message is encoded
+ * once (websocket frame header, SSE 'data:' lines) and sent with writev to every subscribed connection of the worker; a connection
+ * that can't accept the whole frame without blocking (slow consumer) is shut down...
+ *
+ * The record in the ring is [uint32_t length|binary flag][payload] aligned to 8 bytes, the size of a message is limited to half of the ring
+ */
+
+class U_EXPORT UPubSub {
+public:
+
+   typedef struct topic_info {
+      uint64_t head; // bytes written in the ring since the start (the position of the next record)
+      uint32_t name_len;
+      char     name[U_PUBSUB_TOPIC_NAME_MAX];
+   } topic_info;
+
+   typedef struct pubsub_data {
+      sem_t    lock_publish;
+      char     spinlock_publish[1];
+      uint32_t num_topic;
+      uint64_t num_message;
+      topic_info topic[U_PUBSUB_TOPIC_MAX];
+   } pubsub_data;
+
+   static UString* sse_uri;     // the URI of the SSE subscription
+   static UString* socket_path; // the UNIX socket of the control channel
+   static uint32_t topic_max, ring_size;
+
+   // SERVICES
+
+   static bool isActive() { return (ptr != 0); }
+
+   static uint32_t getMaxMessageSize() { return (ring_size / 2) - sizeof(uint32_t) - 8; }
+
+   // NB: these must be called by the plugin: init() in handlerInit() (before the shared memory is allocated), run() in handlerRun(), start() in handlerFork()...
+
+   static bool init();
+   static void run(uint32_t max_connection);
+   static void start(); // NB: we are after the fork...
+   static void clear();
+
+   // NB: subscribe() and unsubscribe() act on the current connection (UServer_Base::pClientImage), that must be upgraded to websocket or SSE,
+   //     and the topic must already exist (it is created by the first publish())...
+
+   static bool   subscribe(const char* topic, uint32_t len);
+   static bool unsubscribe(const char* topic, uint32_t len);
+
+   static bool   subscribe(const UString& topic) { return   subscribe(U_STRING_TO_PARAM(topic)); }
+   static bool unsubscribe(const UString& topic) { return unsubscribe(U_STRING_TO_PARAM(topic)); }
+
+   static bool publish(const char* topic, uint32_t len, const char* data, uint32_t data_len, bool binary = false);
+
+   static bool publish(const UString& topic, const UString& data, bool binary = false) { return publish(U_STRING_TO_PARAM(topic), U_STRING_TO_PARAM(data), binary); }
+
+   // SSE (text/event-stream): GET <SSE_URI>?topic=name1,name2,...
+
+   static int  initSSE();
+   static int  handlerRequest();
+   static void handlerDelete(UClientImage_Base* pclient);
+
+   // NB: called on the wakeup of the worker, fan out the new message of the rings to the subscribed connections...
+
+   static void drain();
+
+   // NB: read in buffer the next message of the topic t from the cursor of the worker, the message overwritten by the publisher are lost...
+
+   static bool readMessage(uint32_t t, bool& binary);
+
+   static const UString& getMessage() { return *buffer; }
+
+   static int getTopic(const char* topic, uint32_t len) { return (ptr ? getTopic(topic, len, false) : -1); }
+
+private:
+   static ULock* lock;
+   static char* vring;
+   static int* vslot_fd;  // the eventfd for the wakeup of every worker
+   static pid_t* vslot_pid; // (in the shared memory) the worker that own the slot
+   static uint32_t num_slot;
+   static pubsub_data* ptr;
+   static UString* buffer;  // the copy of the message read from the ring
+   static UString* frame;   // the message encoded as SSE event (or the websocket frame for a SSL connection)
+   static UEventFd* control;
+   static uint64_t* vmask;   // the subscriptions of every connection of the worker (indexed like UServer_Base::vClientImage)
+   static uint64_t cursor[U_PUBSUB_TOPIC_MAX];
+   static uint32_t num_subscriber[U_PUBSUB_TOPIC_MAX], index_max, max_connection;
+
+   static int  getTopic(const char* topic, uint32_t len, bool bcreate);
+   static bool setSubscription(const char* topic, uint32_t len, bool bsubscribe) U_NO_EXPORT;
+   static void fanOut(uint32_t t, const char* data, uint32_t len, bool binary) U_NO_EXPORT;
+
+   static void readRing( const char* ring, uint64_t pos,       char* data, uint32_t len) U_NO_EXPORT;
+   static void writeRing(      char* ring, uint64_t pos, const char* data, uint32_t len) U_NO_EXPORT;
+
+   U_DISALLOW_COPY_AND_ASSIGN(UPubSub)
+
+   friend class UPubSubControl;
+};
+
+#endif
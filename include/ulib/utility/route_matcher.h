@@ -0,0 +1,114 @@
+// ============================================================================
+//
+// = LIBRARY
+//    ULib - c++ library
+//
+// = FILENAME
+//    route_matcher.h - compiled matcher for a set of DOS mask and regex
+//
+// = AUTHOR
+//    Stefano Casazza
+//
+// ============================================================================
+
+#ifndef ULIB_ROUTE_MATCHER_H
+#define ULIB_ROUTE_MATCHER_H 1
+
+#include <ulib/string.h>
+
+/**
+ * @class URouteMatcher
+ *
+ * @brief Single-pass matcher for an ordered set of rule (DOS mask with '|' for OR or PCRE regular expression)
+ *
+ * Every rule is compiled when it is added: the literal part of each alternative (exact name, prefix 'abc*', suffix '*.abc') is
+ * inserted in a radix trie (the suffix in a second trie of the reversed literal), and only the alternative that are not pure
+ * literal are checked with u_dosmatch() when the walk reach their node. So match() walk the string once for each trie and the
+ * cost don't depend on the number of rule. The alternative without literal part (ex: '*cgi-bin*') and the inverted mask are
+ * checked sequentially in order of rule...
+ *
+ * For a regex the trie is only a prefilter on the anchored literal prefix (ex: '^/blog/(.*)' => '/blog/'): the caller must verify the
+ * candidate with PCRE and, if it fail, continue the search with match(s, len, id+1)
+ */
+
+class U_EXPORT URouteMatcher {
+public:
+
+   // Check for memory error
+   U_MEMORY_TEST
+
+   // Allocator e Deallocator
+   U_MEMORY_ALLOCATOR
+   U_MEMORY_DEALLOCATOR
+
+   // NB: flags can be FNM_IGNORECASE...
+
+   URouteMatcher(int _flags = 0);
+
+   ~URouteMatcher();
+
+   // SERVICES
+
+   uint32_t size() const { return num_rule; }
+
+   // NB: return the id of the rule (the order of insertion), flags can be FNM_INVERT...
+
+   uint32_t addMask(const char* mask, uint32_t len, int mflags = 0);
+   uint32_t addMask(const UString& mask,            int mflags = 0) { return addMask(U_STRING_TO_PARAM(mask), mflags); }
+
+   uint32_t addRegex(const char* pattern, uint32_t len);
+   uint32_t addRegex(const UString& pattern) { return addRegex(U_STRING_TO_PARAM(pattern)); }
+
+   // return the id of the first rule (in order of insertion, starting from the id 'from') that match, U_NOT_FOUND otherwise
+
+   uint32_t match(const char* s, uint32_t len, uint32_t from = 0) const __pure;
+   uint32_t match(const UString& s,            uint32_t from = 0) const { return match(U_STRING_TO_PARAM(s), from); }
+
+   bool isMatch(const char* s, uint32_t len) const { return (match(s, len) != U_NOT_FOUND); }
+   bool isMatch(const UString& s) const            { return (match(U_STRING_TO_PARAM(s)) != U_NOT_FOUND); }
+
+#if defined(U_STDCPP_ENABLE) && defined(DEBUG)
+   const char* dump(bool reset) const;
+#endif
+
+protected:
+   typedef struct node {
+      uint32_t label, label_len, // the label is an offset in text
+               child, sibling,   // index in vnode (0 => none)
+               entry;            // index in ventry (0 => none)
+   } node;
+
+   typedef struct entry {
+      uint32_t id, next,         // next entry of the same node (or of the generic list)
+               mask, mask_len;   // offset in text of the alternative to verify
+      int type;
+   } entry;
+
+   UString text;                 // literal (folded if FNM_IGNORECASE, reversed for the suffix) and alternative
+   node* vnode;                  // [1] root of the prefix trie, [2] root of the suffix trie
+   entry* ventry;
+   uint32_t num_node, max_node, num_entry, max_entry, num_rule, generic, generic_last;
+   int flags;
+
+   uint32_t newNode(uint32_t label, uint32_t label_len);
+   uint32_t newEntry(uint32_t id, int type, uint32_t mask, uint32_t mask_len);
+   uint32_t insert(uint32_t root, uint32_t key, uint32_t key_len);
+
+   void addEntry(uint32_t n, uint32_t e)
+      {
+      U_TRACE(0, "URouteMatcher::addEntry(%u,%u)", n, e)
+
+      ventry[e].next  = vnode[n].entry;
+      vnode[n].entry  = e;
+      }
+
+   void addGeneric(uint32_t e);
+   void addAlternative(uint32_t id, const char* mask, uint32_t len);
+
+   bool check(const entry* e, const char* s, uint32_t len, bool bend) const __pure;
+
+private:
+   U_DISALLOW_COPY_AND_ASSIGN(URouteMatcher)
+};
+
+#endif
@@ -0,0 +1,105 @@
+// ============================================================================
+//
+// = LIBRARY
+//    ULib - c++ library
+//
+// = FILENAME
+//    session_store.h - HTTP session data in the shared memory
+//
+// = AUTHOR
+//    Stefano Casazza
+//
+// ============================================================================
+
+#ifndef ULIB_SESSION_STORE_H
+#define ULIB_SESSION_STORE_H 1
+
+#include <ulib/string.h>
+
+#define U_SESSION_STORE_WAY     4 // slot for each bucket (the bucket is the unit of lock)
+#define U_SESSION_STORE_SWEEP  60 // (second) time between the sweep of the expired sessions (and the snapshot)
+
+class URDB;
+class UDataStorage;
+
+/**
+ * @class USessionStore
+ *
+ * @brief Session data (UDataSession) in fixed size slot of the shared memory, instead of the URDB db (journal and global lock)
+ *
+ * The store is a table of bucket, each with U_SESSION_STORE_WAY slot and a spinlock that is held only for the copy of the record:
+ * a session is found by the hash of his key id and, if the bucket is full, the least recently used slot of the bucket is evicted.
+ * A session idle for more than the TTL is freed by a sweep that run in one of the workers every U_SESSION_STORE_SWEEP second (the
+ * workers compete with CAS on the time of the last sweep), that can also write the modified sessions in the db (write-behind) so
+ * they survive a restart. A record that don't fit in a slot is stored in the db as before (and removed from the store), as a
+ * modified session evicted from his slot...
+ */
+
+class U_EXPORT USessionStore {
+public:
+
+   typedef struct slot {
+      uint32_t hash; // 0 => free
+      uint32_t key_len, data_len;
+      uint32_t dirty; // modified after the last snapshot
+      long last_access;
+   } slot; // NB: followed by the key and the data (slot_size)...
+
+   typedef struct bucket {
+      uint32_t lock, pad;
+   } bucket; // NB: followed by U_SESSION_STORE_WAY slot...
+
+   typedef struct store_info {
+      long     last_sweep;
+      uint32_t num_bucket, num_session;
+      uint64_t num_evicted, num_expired;
+   } store_info;
+
+   static bool bsnapshot;         // write-behind of the sessions in the db (SESSION_STORE_SNAPSHOT)
+   static uint32_t max_session,   // SESSION_STORE_MAX (0 => disabled)
+                   slot_size,     // max size of key id + data of a session (SESSION_STORE_SLOT)
+                   ttl;           // (second) max idle time of a session (SESSION_STORE_TTL)
+
+   // SERVICES
+
+   static bool isActive() { return (vbucket != 0); }
+
+   // NB: these are called by mod_http: init() before the shared memory is allocated, run() after, start() in the worker...
+
+   static void init();
+   static void run();
+   static void start();
+   static void clear();
+
+   // NB: get() and put() serialize the record with UDataStorage::fromData() and UDataStorage::toBuffer()...
+
+   static bool    get(UDataStorage* pdata);
+   static bool    put(UDataStorage* pdata); // NB: false => the record don't fit in a slot...
+   static bool remove(const UString& key);
+
+   static void sweep();
+   static void load(URDB* pdb); // NB: the sessions of the last snapshot...
+
+private:
+   static store_info* info;
+   static char* vbucket;
+   static char* buffer; // the copy of the record read from the slot
+   static URDB* db;
+   static uint32_t bucket_size;
+
+   static bucket* getBucket(uint32_t hash) { return (bucket*)(vbucket + (hash & (info->num_bucket-1)) * bucket_size); }
+
+   static slot* getSlot(bucket* b, uint32_t i) { return (slot*)((char*)(b+1) + i * (sizeof(slot) + slot_size)); }
+
+   static void   lock(bucket* b) { while (__sync_lock_test_and_set(&(b->lock), 1)) (void) sched_yield(); }
+   static void unlock(bucket* b) { __sync_lock_release(&(b->lock)); }
+
+   static uint32_t getHash(const char* key, uint32_t len) __pure U_NO_EXPORT;
+   static slot*    find(bucket* b, uint32_t hash, const char* key, uint32_t len) __pure U_NO_EXPORT;
+   static bool     store(const char* key, uint32_t len, const char* data, uint32_t data_len, bool bdirty) U_NO_EXPORT;
+   static int      loadEntry(UStringRep* key, UStringRep* data) U_NO_EXPORT;
+
+   U_DISALLOW_COPY_AND_ASSIGN(USessionStore)
+};
+
+#endif
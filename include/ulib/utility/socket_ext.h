@@ -32,6 +32,8 @@ class UStreamPlugIn;
 class URPCClient_Base;
 class UHttpClient_Base;
 class UClientImage_Base;
+class UREDISClient_Base;
+class UElasticSearchClient;
 
 class U_EXPORT USocketExt {
 public:
@@ -215,6 +217,7 @@ private:
    friend class URPC;
    friend class UHTTP;
    friend class UHTTP2;
+   friend class UPubSub;
    friend class UWebSocket;
    friend class UMimeHeader;
    friend class USmtpClient;
@@ -225,6 +228,8 @@ private:
    friend class URPCClient_Base;
    friend class UHttpClient_Base;
    friend class UClientImage_Base;
+   friend class UREDISClient_Base;
+   friend class UElasticSearchClient;
 };
 
 #endif
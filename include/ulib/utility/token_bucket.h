@@ -0,0 +1,126 @@
+// ============================================================================
+//
+// = LIBRARY
+//    ULib - c++ library
+//
+// = FILENAME
+//    token_bucket.h - lock-free token bucket (GCRA) for the shared memory
+//
+// = AUTHOR
+//    Stefano Casazza
+//
+// ============================================================================
+
+#ifndef ULIB_TOKEN_BUCKET_H
+#define ULIB_TOKEN_BUCKET_H 1
+
+#include <ulib/internal/common.h>
+
+#define U_TOKEN_BUCKET_PROBE 8 // max number of slot checked for a key (open addressing)
+
+/**
+ * @class UTokenBucket
+ *
+ * @brief Rate limiter that is a single 64 bit word (can live in the shared memory and be updated with CAS without lock)
+ *
+ * The bucket is stored as the theoretical arrival time (TAT, nanosecond of CLOCK_MONOTONIC) of the next unit (GCRA): a
+ * request of n unit move TAT forward of n/rate second, and it conform if after that TAT is no more than burst/rate second
+ * in the future. It is equivalent to a bucket of burst token refilled at rate token for second, but without a timer for
+ * the refill and with only one word to update. The table of slot is a fixed size hash (open addressing on the key) where
+ * a slot is reused when the bucket of the old key is full (idle)...
+ */
+
+class U_EXPORT UTokenBucket {
+public:
+
+   typedef struct slot {
+      uint64_t key; // 0 => free
+      uint64_t tat[2];
+   } slot;
+
+   static uint64_t now()
+      {
+      struct timespec ts;
+
+      (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+
+      return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+      }
+
+   // NB: return 0 if the request of n unit conform (and it is charged), otherwise the nanosecond to wait before it can conform.
+   //     With bforce the unit are charged anyway (they are already consumed, ex: bytes sent) and it return the time to wait...
+
+   static uint64_t consume(uint64_t* ptat, uint64_t n, uint64_t rate, uint64_t burst, uint64_t t, bool bforce = false)
+      {
+      U_TRACE(0, "UTokenBucket::consume(%p,%llu,%llu,%llu,%llu,%b)", ptat, n, rate, burst, t, bforce)
+
+      U_INTERNAL_ASSERT_MAJOR(rate, 0)
+
+      uint64_t old_tat, tat, limit = t + (burst * 1000000000ULL) / rate;
+
+      do {
+         old_tat = *(volatile uint64_t*)ptat;
+
+         tat = (old_tat > t ? old_tat : t) + (n * 1000000000ULL) / rate;
+
+         if (tat > limit &&
+             bforce == false)
+            {
+            U_RETURN(tat - limit);
+            }
+         }
+      while (__sync_bool_compare_and_swap(ptat, old_tat, tat) == false);
+
+      if (tat > limit) U_RETURN(tat - limit);
+
+      U_RETURN(0);
+      }
+
+   // NB: the debt of the bucket (how far TAT is in the future), 0 => the bucket is full...
+
+   static uint64_t getDebt(const uint64_t* ptat, uint64_t t)
+      {
+      uint64_t tat = *(volatile const uint64_t*)ptat;
+
+      return (tat > t ? tat - t : 0);
+      }
+
+   // NB: size must be a power of 2, return 0 if all the slot checked are busy with other key...
+
+   static slot* find(slot* vslot, uint32_t size, uint64_t key, uint64_t t)
+      {
+      U_TRACE(0, "UTokenBucket::find(%p,%u,%llu,%llu)", vslot, size, key, t)
+
+      U_INTERNAL_ASSERT_DIFFERS(key, 0)
+      U_INTERNAL_ASSERT_EQUALS(size & (size-1), 0)
+
+      slot* s;
+      uint64_t k;
+      uint32_t i, idx = (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32);
+
+      for (i = 0; i < U_TOKEN_BUCKET_PROBE; ++i)
+         {
+         s = vslot + ((idx + i) & (size-1));
+         k = *(volatile uint64_t*)&(s->key);
+
+         if (k == key) U_RETURN_POINTER(s, slot);
+
+         // NB: we can take the slot if it is free or if the buckets of the old key are full (the key is idle)...
+
+         if ((k == 0 ||
+              (getDebt(s->tat, t)   == 0 &&
+               getDebt(s->tat+1, t) == 0)) &&
+             __sync_bool_compare_and_swap(&(s->key), k, key))
+            {
+            U_RETURN_POINTER(s, slot);
+            }
+         }
+
+      U_RETURN_POINTER(0, slot);
+      }
+
+private:
+   U_DISALLOW_COPY_AND_ASSIGN(UTokenBucket)
+};
+
+#endif
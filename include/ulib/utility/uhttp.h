@@ -32,6 +32,10 @@
 #define U_MAX_UPLOAD_PROGRESS   16
 #define U_MIN_SIZE_FOR_DEFLATE 150 // NB: google advice...
 
+#ifndef U_PRELOAD_LEARN_MAX
+#define U_PRELOAD_LEARN_MAX 1024 // default max number of uri of the preload table, over it we don't learn from the Link header
+#endif
+
 #define U_HTTP_URI_EQUAL(str)               ((str).equal(U_HTTP_URI_TO_PARAM))
 #define U_HTTP_URI_DOSMATCH(mask,len,flags) (UServices::dosMatchWithOR(U_HTTP_URI_TO_PARAM, mask, len, flags))
 
@@ -46,6 +50,8 @@ class UHttpPlugIn;
 class USSLSession;
 class UMimeMultipart;
 class UModProxyService;
+class URouteMatcher;
+class UDeflateStream;
 
 template <class T> class UClient;
 template <class T> class URDBObjectHandler;
@@ -56,6 +62,8 @@ public:
    static void init();
    static void dtor();
 
+   static void initRouteMatcher(); // compile the alias, rewrite rule and (no)cache mask
+
    // TYPE
 
    static bool isMobile() __pure;
@@ -185,7 +193,7 @@ public:
    static char response_buffer[64];
    static int mime_index, cgi_timeout; // the time-out value in seconds for output cgi process
    static bool enable_caching_by_proxy_servers, skip_check_cookie_ip_address;
-   static uint32_t limit_request_body, request_read_timeout, range_start, range_size;
+   static uint32_t limit_request_body, request_read_timeout, request_body_min_rate, range_start, range_size;
 
    static int  handlerREAD();
    static bool readRequest();
@@ -285,7 +293,20 @@ public:
       if (U_http_version != '2')
 #  endif
       {
-      if (sz >= UServer_Base::min_size_for_sendfile) U_RETURN(true);
+      if (sz >= UServer_Base::min_size_for_sendfile)
+         {
+#     ifdef USE_LIBSSL
+         // NB: with SSL we can use sendfile() only if the kernel do the encryption of the records for this connection...
+
+         if (UServer_Base::bssl &&
+             UServer_Base::csocket->isKTLS() == false)
+            {
+            U_RETURN(false);
+            }
+#     endif
+
+         U_RETURN(true);
+         }
       }
 
       U_RETURN(false);
@@ -380,6 +401,22 @@ public:
    };
 
    static void setDynamicResponse();
+
+   /**
+    * Streaming of a dynamic response (ex: a big report generated by USP) that is sent while it is produced: the content is sent with
+    * Transfer-Encoding: chunked (HTTP/1.1) or until the close of the connection (HTTP/1.0), compressed on the fly if the client accept gzip.
+    * With HTTP/2 (or a pipelined request) the body is compressed incrementally and sent at the end with the normal response...
+    *
+    * NB: content_type is the value of the header without CRLF, size is the length of the content if known (0 => unknown)
+    */
+
+   static bool startStreamResponse(const UString& content_type, uint32_t size = 0);
+   static bool writeStreamResponse(const char* ptr, uint32_t len, bool bflush = false);
+   static bool writeStreamResponse(const UString& data,           bool bflush = false) { return writeStreamResponse(U_STRING_TO_PARAM(data), bflush); }
+   static bool endStreamResponse();
+
+   static bool isStreamResponse() { return (stream_mode != 0); }
+
    static void setResponse(bool btype, const UString& content_type, UString* pbody);
    static void setRedirectResponse(int mode, const char* ptr_location, uint32_t len_location);
    static void setErrorResponse(const UString& content_type, int code, const char* fmt, uint32_t fmt_size, bool flag);
@@ -454,6 +491,15 @@ public:
                                            "Please contact the server administrator and inform them about this"), true);
       }
 
+   static void setTooManyRequests()
+      {
+      U_TRACE_NO_PARAM(0, "UHTTP::setTooManyRequests()")
+
+      setErrorResponse(*UString::str_ctype_html, HTTP_TOO_MANY_REQUESTS,
+                       U_CONSTANT_TO_PARAM("Sorry, you have sent too many requests in a given amount of time. "
+                                           "Please slow down and try again later"), true);
+      }
+
 #ifdef U_HTTP_STRICT_TRANSPORT_SECURITY
    static UString* uri_strict_transport_security_mask;
 
@@ -484,6 +530,7 @@ public:
    static bool virtual_host;
    static UString* global_alias;
    static UVector<UString>* valias;
+   static URouteMatcher* alias_matcher;
    static UString* maintenance_mode_page;
 
    static void setGlobalAlias(const UString& alias);
@@ -587,11 +634,7 @@ public:
    static UString getSessionLastAccessedTime() { return data_session->getSessionLastAccessedTime(); }
 
 #ifdef USE_LIBSSL
-   static USSLSession* data_session_ssl;
-   static URDBObjectHandler<UDataStorage*>* db_session_ssl;
-
-   static void  initSessionSSL();
-   static void clearSessionSSL();
+   static void initSessionSSL();
 #endif
 
    static UString getKeyIdDataSession()
@@ -682,7 +725,11 @@ public:
       {
       U_TRACE_REGISTER_OBJECT(0, RewriteRule, "%V,%V", _key.rep, _replacement.rep)
 
+#  ifdef PCRE_STUDY_JIT_COMPILE
+      key.study(PCRE_STUDY_JIT_COMPILE);
+#  else
       key.study();
+#  endif
       }
 
    ~RewriteRule()
@@ -699,6 +746,7 @@ public:
    };
 
    static UVector<RewriteRule*>* vRewriteRule;
+   static URouteMatcher* rewrite_matcher;
 #endif      
 
    // ------------------------------------------------------------------------------------------------------------------------------------------------ 
@@ -1037,6 +1085,8 @@ public:
    static UString* cache_avoid_mask;
    static UString* cache_file_store;
    static UString* nocache_file_mask;
+   static URouteMatcher* cache_file_matcher;
+   static URouteMatcher* nocache_file_matcher;
    static UFileCacheData* file_data;
    static UHashMap<UFileCacheData*>* cache_file;
    static UFileCacheData* file_not_in_cache_data;
@@ -1124,9 +1174,45 @@ public:
       U_RETURN_POINTER(ptr_file_data, UHTTP::UFileCacheData);
       }
 
+   // PRELOAD MANIFEST (uri -> value of the Link header with the resources to preload)
+   //
+   // HTTP/2 use it to push (PUSH_PROMISE) the resources that are in the memory cache, HTTP/1.1 to send an interim
+   // response 103 (Early Hints) before the final response. It can be learned from the Link header of the responses
+
+   static bool preload_learn;
+   static uint32_t preload_learn_max;
+   static UHashMap<UString>* preload_manifest;
+
+   static UString getPreload()
+      {
+      U_TRACE_NO_PARAM(0, "UHTTP::getPreload()")
+
+      U_INTERNAL_ASSERT_POINTER(preload_manifest)
+
+      // NB: the manifest is indexed by the uri of the request before any alias...
+
+      UString result = (UClientImage_Base::request_uri->empty() ? preload_manifest->at(U_HTTP_URI_TO_PARAM)
+                                                                : preload_manifest->at(UClientImage_Base::request_uri->rep));
+
+      U_RETURN_STRING(result);
+      }
+
+   static void loadPreloadManifest(const UString& content);
+
 private:
    static uint32_t old_response_code;
 
+   static char stream_mode; // 'C' => chunked, 'R' => raw until close, 'B' => buffered (HTTP/2), 'E' => ended
+   static UString* stream_buffer;
+   static UString* stream_pending;
+   static UDeflateStream* stream_deflate;
+
+   static bool sendStream(const char* ptr, uint32_t len, bool bfinish) U_NO_EXPORT;
+
+   static void learnPreload();
+   static void sendEarlyHints();
+   static void addPreloadLink(UString& link, const char* path, uint32_t len) U_NO_EXPORT;
+
    static void setMimeIndex()
       {
       U_TRACE_NO_PARAM(0, "UHTTP::setMimeIndex()")
@@ -1193,6 +1279,8 @@ private:
    static void checkIPClient() U_NO_EXPORT;
    static bool runDynamicPage() U_NO_EXPORT;
    static bool readBodyRequest() U_NO_EXPORT;
+   static bool readBody(uint32_t count) U_NO_EXPORT;
+   static bool isBodyRateTooLow(uint32_t byte_read, long elapsed) __pure U_NO_EXPORT;
    static bool processFileCache() U_NO_EXPORT;
    static bool readHeaderRequest() U_NO_EXPORT;
    static void processGetRequest() U_NO_EXPORT;
@@ -1215,6 +1303,8 @@ private:
    static bool readDataChunked(USocket* sk, UString* pbuffer, UString& body) U_NO_EXPORT;
    static void setResponseForRange(uint32_t start, uint32_t end, uint32_t header) U_NO_EXPORT;
    static bool checkDataSession(const UString& token, time_t expire, UString* data) U_NO_EXPORT;
+   static bool getSessionRecord(UDataSession* ptr) U_NO_EXPORT;
+   static void putSessionRecord(UDataSession* ptr) U_NO_EXPORT;
 
    static inline void setUpgrade(const char* ptr) U_NO_EXPORT;
    static inline void setIfModSince(const char* ptr) U_NO_EXPORT;
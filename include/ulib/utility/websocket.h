@@ -38,33 +38,69 @@
 #define STATUS_CODE_RESERVED4         1015
 
 class USocket;
+class UClientImage_Base;
 
 class U_EXPORT UWebSocket {
 public:
 
    // SERVICES
 
+   static vPFi on_message;
    static UString* rbuffer;
    static uint32_t max_message_size;
    static const char* upgrade_settings;
    static int message_type, status_code;
 
+   // permessage-deflate (RFC 7692): the compression is negotiated by sendAccept() if the client offer it. With the context takeover the
+   // peers keep the LZ77 window between the messages (better ratio, but ~300k of memory for each connection); without, all the connections
+   // share the same stream that is reset at the end of every message...
+
+   static bool bdeflate, bcontext_takeover;
+
    typedef struct _WebSocketFrameData {
-      unsigned char* application_data;
-      uint32_t       application_data_offset;
-      unsigned char  fin;
-      unsigned char  opcode;
-      unsigned int   utf8_state;
+      uint32_t      application_data_offset;
+      unsigned char fin;
+      unsigned char opcode;
+      unsigned int  utf8_state;
    } WebSocketFrameData;
 
-   static WebSocketFrameData control_frame;
-   static WebSocketFrameData message_frame;
+   // NB: the state of the frame parser, kept for each connection to resume it when the next read complete a partial frame...
+
+   typedef struct _WebSocketConnection {
+      WebSocketFrameData control_frame, message_frame;
+      UString* message; // data of a message not yet complete between two read
+      int32_t payload_length, mask_offset;
+      int framing_state, payload_length_bytes_remaining, mask_index, masking;
+      unsigned char fin, opcode, mask[4];
+      unsigned char control_data[125];
+      unsigned char extension, rsv1; // extension: the flags of the extension negotiated, rsv1: the current message is compressed
+#  ifdef USE_LIBZ
+      z_stream* zinflate; // the context (with takeover) of the peers
+      z_stream* zdeflate;
+#  endif
+   } WebSocketConnection;
+
+   static WebSocketConnection* vconnection;
+
+   static void preallocate(uint32_t max_connection);
+   static void deallocate(uint32_t max_connection);
+   static void clear();
 
    static bool sendAccept();
    static void checkForInitialData();
    static int  handleDataFraming(USocket* socket);
    static bool sendData(int type, const unsigned char* buffer, uint32_t buffer_size);
 
+   // NB: return the size of the header (max 10 bytes) of a frame of the server (not masked)...
+
+   static uint32_t setFrameHeader(unsigned char* header, int type, uint32_t payload_length);
+
+   // NB: with these the connection is managed by the event loop of the server, a message is passed to on_message() when complete...
+
+   static int  initConnection();
+   static int  handlerRequest();
+   static void handlerDelete(UClientImage_Base* pclient);
+
    static bool sendClose()
       {
       U_TRACE_NO_PARAM(0, "UWebSocket::sendClose()")
@@ -82,6 +118,26 @@ public:
       }
 
 private:
+   static WebSocketConnection blocking; // for the blocking mode (the connection is served by handleDataFraming(USocket*))
+   static unsigned char deflate_negotiated;
+#ifdef USE_LIBZ
+   static UString* zbuffer;
+   static z_stream* zinflate_shared;
+   static z_stream* zdeflate_shared;
+#endif
+
+   static void unmask(unsigned char* dst, const unsigned char* src, uint32_t len, const unsigned char* mask, uint32_t mask_offset) U_NO_EXPORT;
+   static void negotiateDeflate() U_NO_EXPORT;
+   static void resetConnection(WebSocketConnection* pconn) U_NO_EXPORT;
+   static void clearDeflate(WebSocketConnection* pconn) U_NO_EXPORT;
+   static WebSocketConnection* getConnection() __pure U_NO_EXPORT;
+#ifdef USE_LIBZ
+   static int  inflateMessage(WebSocketConnection* pconn, uint32_t len) U_NO_EXPORT;
+   static bool deflateMessage(WebSocketConnection* pconn, const unsigned char* buffer, uint32_t buffer_size) U_NO_EXPORT;
+#endif
+   static int  handleDataFraming(WebSocketConnection* pconn, const unsigned char* block, uint32_t block_size, uint32_t& block_offset) U_NO_EXPORT;
+   static int  processData(WebSocketConnection* pconn, const char* ptr, uint32_t sz) U_NO_EXPORT;
+
    U_DISALLOW_COPY_AND_ASSIGN(UWebSocket)
 };
 
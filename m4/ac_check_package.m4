@@ -108,6 +108,53 @@ AC_DEFUN([AC_CHECK_PACKAGE],[
 	fi
 	], [AC_MSG_RESULT(no)])
 
+	AC_MSG_CHECKING(if libdeflate library is wanted)
+	wanted=1;
+	if test -z "$with_libdeflate" ; then
+		wanted=0;
+		if test -n "$CROSS_ENVIRONMENT" -o "$enable_shared" = "no"; then
+			with_libdeflate="no";
+		else
+			with_libdeflate="${CROSS_ENVIRONMENT}/usr";
+		fi
+	fi
+	AC_ARG_WITH(libdeflate, [  --with-libdeflate       use system libdeflate library - [[will check /usr /usr/local]] [[default=use if present]]], [
+	if test "$withval" = "no"; then
+		AC_MSG_RESULT(no)
+	else
+		AC_MSG_RESULT(yes)
+		for dir in $withval ${CROSS_ENVIRONMENT}/ ${CROSS_ENVIRONMENT}/usr ${CROSS_ENVIRONMENT}/usr/local; do
+			libdeflatedir="$dir"
+			if test -f "$dir/include/libdeflate.h"; then
+				found_libdeflate="yes";
+				break;
+			fi
+		done
+		if test x_$found_libdeflate != x_yes; then
+			msg="Cannot find libdeflate library";
+			if test $wanted = 1; then
+				AC_MSG_ERROR($msg)
+			else
+				AC_MSG_RESULT($msg)
+			fi
+		else
+			echo "${T_MD}libdeflate found in $libdeflatedir${T_ME}"
+			USE_LIBDEFLATE=yes
+			AC_DEFINE(USE_LIBDEFLATE, 1, [Define if enable libdeflate support])
+			libdeflate_version=$(grep LIBDEFLATE_VERSION_STRING $libdeflatedir/include/libdeflate.h 2>/dev/null | head -n1 | cut -d'"' -f2 2>/dev/null)
+			if test -z "${libdeflate_version}"; then
+				libdeflate_version="unknown"
+			fi
+         ULIB_LIBS="$ULIB_LIBS -ldeflate";
+			if test $libdeflatedir != "${CROSS_ENVIRONMENT}/" -a $libdeflatedir != "${CROSS_ENVIRONMENT}/usr" -a $libdeflatedir != "${CROSS_ENVIRONMENT}/usr/local"; then
+				CPPFLAGS="$CPPFLAGS -I$libdeflatedir/include"
+				LDFLAGS="$LDFLAGS -L$libdeflatedir/lib -Wl,-R$libdeflatedir/lib";
+				PRG_LDFLAGS="$PRG_LDFLAGS -L$libdeflatedir/lib";
+			fi
+		fi
+	fi
+	], [AC_MSG_RESULT(no)])
+
 	AC_MSG_CHECKING(if MAGIC library is wanted)
 	wanted=1;
 	if test -z "$with_magic" ; then
@@ -124,6 +124,17 @@ AC_DEFUN([AC_COMPILATION_OPTIONS],[
 	fi
 	AC_MSG_RESULT([$enable_thread_approach])
 
+	AC_MSG_CHECKING(if you want to enable atomic reference counting of string)
+	AC_ARG_ENABLE(atomic-string,
+				[  --enable-atomic-string    enable atomic reference counting of string (share between threads) [[default=no]]])
+	if test -z "$enable_atomic_string"; then
+		enable_atomic_string="no"
+	fi
+	if test "$enable_atomic_string" = "yes"; then
+		AC_DEFINE(U_THREAD_SAFE_STRING, 1, [enable atomic reference counting of string])
+	fi
+	AC_MSG_RESULT([$enable_atomic_string])
+
 	AC_MSG_CHECKING(if you want to enable HTTP inotify support)
 	AC_ARG_ENABLE(HIS,
 				[  --enable-HIS              enable HTTP Inotify Support [[default=no]]])
@@ -44,10 +44,15 @@
 #include "utility/uhttp.cpp"
 #include "utility/base64.cpp"
 #include "utility/dir_walk.cpp"
+#include "utility/route_matcher.cpp"
+#include "utility/deflate_stream.cpp"
 #include "utility/interrupt.cpp"
 #include "utility/services.cpp"
 #include "utility/semaphore.cpp"
 #include "utility/websocket.cpp"
+#include "utility/pubsub.cpp"
+#include "utility/metrics.cpp"
+#include "utility/session_store.cpp"
 #include "utility/string_ext.cpp"
 #include "utility/socket_ext.cpp"
 #include "utility/data_session.cpp"
@@ -109,6 +109,8 @@ void UHashMap<void*>::insertAfterFind(const UStringRep* _key, const void* _elem)
 
    U_INTERNAL_ASSERT_EQUALS(node, 0)
    U_INTERNAL_ASSERT_DIFFERS(_key, pkey)
+   U_INTERNAL_ASSERT_MSG(UArena::isEscape(_key,  this) == false, "a key of the request arena is inserted in a table that survive the request")
+   U_INTERNAL_ASSERT_MSG(UArena::isEscape(_elem, this) == false, "an element of the request arena is inserted in a table that survive the request")
 
    U_INTERNAL_DUMP("index = %u", index)
 
@@ -117,8 +119,12 @@ void UHashMap<void*>::insertAfterFind(const UStringRep* _key, const void* _elem)
     * the element at the beginning of the list of collisions
     */
 
+   bool barena = UArena::suspend(this); // NB: the table can be persistent...
+
    U_NEW(UHashMapNode, table[index], UHashMapNode(_key, _elem, table[index], hash));
 
+   UArena::resume(barena);
+
    node = table[index];
 
    ++_length;
@@ -29,6 +29,7 @@ void UVector<void*>::push(const void* elem) // add to end
 
    U_INTERNAL_ASSERT_MAJOR(_capacity, 0)
    U_INTERNAL_ASSERT(_length <= _capacity)
+   U_INTERNAL_ASSERT_MSG(UArena::isEscape(elem, this) == false, "an element of the request arena is inserted in a vector that survive the request")
 
    if (_length == _capacity)
       {
@@ -37,8 +38,12 @@ void UVector<void*>::push(const void* elem) // add to end
 
       _capacity <<= 1; // x 2...
 
+      bool barena = UArena::suspend(this); // NB: the vector can be persistent...
+
       vec = (const void**) UMemoryPool::_malloc(&_capacity, sizeof(void*));
 
+      UArena::resume(barena);
+
       if (_length) U_MEMCPY(vec, old_vec, _length * sizeof(void*));
 
       UMemoryPool::_free(old_vec, old_capacity, sizeof(void*));
@@ -62,8 +67,12 @@ void UVector<void*>::move(UVector<void*>& source) // add to end and reset source
 
       _capacity <<= 1; // x 2...
 
+      bool barena = UArena::suspend(this); // NB: the vector can be persistent...
+
       vec = (const void**) UMemoryPool::_malloc(&_capacity, sizeof(void*));
 
+      UArena::resume(barena);
+
       if (_length) U_MEMCPY(vec, old_vec, _length * sizeof(void*));
 
       UMemoryPool::_free(old_vec, old_capacity, sizeof(void*));
@@ -85,6 +94,7 @@ void UVector<void*>::insert(uint32_t pos, const void* elem) // add elem before p
 
    U_INTERNAL_ASSERT(pos <= _length)
    U_INTERNAL_ASSERT(_length <= _capacity)
+   U_INTERNAL_ASSERT_MSG(UArena::isEscape(elem, this) == false, "an element of the request arena is inserted in a vector that survive the request")
 
    if (_length == _capacity)
       {
@@ -93,8 +103,12 @@ void UVector<void*>::insert(uint32_t pos, const void* elem) // add elem before p
 
       _capacity <<= 1; // x 2...
 
+      bool barena = UArena::suspend(this); // NB: the vector can be persistent...
+
       vec = (const void**) UMemoryPool::_malloc(&_capacity, sizeof(void*));
 
+      UArena::resume(barena);
+
       U_MEMCPY(vec,           old_vec,                  pos  * sizeof(void*));
       U_MEMCPY(vec + pos + 1, old_vec + pos, (_length - pos) * sizeof(void*));
 
@@ -133,8 +147,12 @@ void UVector<void*>::insert(uint32_t pos, uint32_t n, const void* elem) // add n
 
       _capacity = new_length << 1; // x 2...
 
+      bool barena = UArena::suspend(this); // NB: the vector can be persistent...
+
       vec = (const void**) UMemoryPool::_malloc(&_capacity, sizeof(void*));
 
+      UArena::resume(barena);
+
       U_MEMCPY(vec,           old_vec,                  pos  * sizeof(void*));
       U_MEMCPY(vec + pos + n, old_vec + pos, (_length - pos) * sizeof(void*));
 
@@ -355,6 +355,12 @@ void UMemoryPool::push(void* ptr, int stack_index)
    U_INTERNAL_ASSERT_POINTER(ptr)
    U_INTERNAL_ASSERT_MINOR(stack_index, U_NUM_STACK_TYPE) // 10
 
+   if (UNLIKELY(UArena::isUsed()) &&
+       UArena::isOwner(ptr))
+      {
+      return; // NB: the arena is rewinded at the end of the request...
+      }
+
    if (stack_index) ((UStackMemoryPool*)(UStackMemoryPool::mem_stack+stack_index))->push(ptr);
 }
 
@@ -380,6 +386,13 @@ void* UMemoryPool::pop(int stack_index)
 
    U_INTERNAL_ASSERT_MINOR(stack_index, U_NUM_STACK_TYPE) // 10
 
+   if (UArena::bactive)
+      {
+      void* ptr = UArena::allocate(U_STACK_INDEX_TO_SIZE[stack_index]);
+
+      if (ptr) return ptr;
+      }
+
    UStackMemoryPool* pstack = (UStackMemoryPool*)(UStackMemoryPool::mem_stack+stack_index);
 
 #ifdef DEBUG
@@ -433,6 +446,41 @@ bool UMemoryPool::check(void* ptr)
 #  endif
 #endif
 
+char* UArena::pstart;
+char* UArena::pcurrent;
+char* UArena::pend;
+char* UArena::pframe;
+bool  UArena::bactive;
+
+void UArena::_suspend(const void* pobj)
+{
+   U_TRACE(0, "UArena::_suspend(%p)", pobj)
+
+   U_INTERNAL_ASSERT(bactive)
+
+   // NB: the frame of this function is under the frame of the caller, so an object on the stack of the caller is still in the range...
+
+   if (isTemporary(pobj) == false) bactive = false;
+}
+
+void UArena::init(uint32_t size)
+{
+   U_TRACE(0, "UArena::init(%u)", size)
+
+   U_INTERNAL_ASSERT_MAJOR(size, 0)
+   U_INTERNAL_ASSERT_EQUALS(pstart, 0)
+
+#ifdef ENABLE_MEMPOOL // NB: without the memory pool the arena is never used...
+   char* ptr = UFile::mmap(&size, -1, PROT_READ | PROT_WRITE, MAP_PRIVATE | U_MAP_ANON, 0);
+
+   if (ptr != MAP_FAILED)
+      {
+      pstart = pcurrent = ptr;
+      pend   = ptr + size;
+      }
+#endif
+}
+
 void* UMemoryPool::_malloc(uint32_t num, uint32_t type_size, bool bzero)
 {
    U_TRACE(0, "UMemoryPool::_malloc(%u,%u,%b)", num, type_size, bzero)
@@ -11,8 +11,145 @@
 //
 // ============================================================================
 
+#include <ulib/timer.h>
+#include <ulib/notifier.h>
+#include <ulib/utility/escape.h>
+#include <ulib/utility/socket_ext.h>
 #include <ulib/net/client/elasticsearch.h>
 
+class U_NO_EXPORT UElasticSearchAsync : public UEventFd {
+public:
+
+   // Check for memory error
+   U_MEMORY_TEST
+
+   // Allocator e Deallocator
+   U_MEMORY_ALLOCATOR
+   U_MEMORY_DEALLOCATOR
+
+   UElasticSearchAsync(UElasticSearchClient* _es) : es(_es)
+      {
+      U_TRACE_REGISTER_OBJECT(0, UElasticSearchAsync, "%p", _es)
+
+      UEventFd::fd = _es->bulk_client->getFd();
+      }
+
+   virtual ~UElasticSearchAsync() U_DECL_FINAL
+      {
+      U_TRACE_UNREGISTER_OBJECT(0, UElasticSearchAsync)
+      }
+
+   // define method VIRTUAL of class UEventFd
+
+   virtual int handlerRead() U_DECL_FINAL
+      {
+      U_TRACE_NO_PARAM(0, "UElasticSearchAsync::handlerRead()")
+
+      if (es->bulk_inflight == false) U_RETURN(U_NOTIFIER_DELETE); // NB: the server has closed the connection (keep-alive timeout)...
+
+      if (es->readBulk(0) == 1 &&
+          es->bulk_len           &&
+          es->getBackoff() == 0)
+         {
+         (void) es->sendBulk(); // NB: the next body in queue (with backoff it is sent by the timer)...
+         }
+
+      if (es->bulk_client->isOpen()) U_RETURN(U_NOTIFIER_OK);
+
+      U_RETURN(U_NOTIFIER_DELETE);
+      }
+
+   virtual void handlerDelete() U_DECL_FINAL
+      {
+      U_TRACE_NO_PARAM(0, "UElasticSearchAsync::handlerDelete()")
+
+      U_INTERNAL_ASSERT_EQUALS(es->pasync, this)
+
+      // NB: with epoll the descriptor is removed from the interest list only by close(),
+      //     and with EPOLLHUP the reply can be already arrived before the close of the server...
+
+      if (es->bulk_inflight) (void) es->readBulk(0);
+
+      if (es->bulk_client->isOpen()) es->abortBulk();
+
+      es->pasync = 0;
+
+      delete this;
+      }
+
+#if defined(DEBUG) && defined(U_STDCPP_ENABLE)
+   const char* dump(bool _reset) const { return UEventFd::dump(_reset); }
+#endif
+
+protected:
+   UElasticSearchClient* es;
+
+private:
+   U_DISALLOW_COPY_AND_ASSIGN(UElasticSearchAsync)
+};
+
+class U_NO_EXPORT UElasticSearchTimer : public UEventTime {
+public:
+
+   UElasticSearchTimer(UElasticSearchClient* _es, uint32_t ms) : UEventTime(ms / 1000, (ms % 1000) * 1000), es(_es)
+      {
+      U_TRACE_REGISTER_OBJECT(0, UElasticSearchTimer, "%p,%u", _es, ms)
+      }
+
+   virtual ~UElasticSearchTimer() U_DECL_FINAL
+      {
+      U_TRACE_UNREGISTER_OBJECT(0, UElasticSearchTimer)
+      }
+
+   // define method VIRTUAL of class UEventTime
+
+   virtual int handlerTime() U_DECL_FINAL
+      {
+      U_TRACE_NO_PARAM(0, "UElasticSearchTimer::handlerTime()")
+
+      es->handlerBulkTime();
+
+      U_RETURN(0); // monitoring
+      }
+
+#if defined(DEBUG) && defined(U_STDCPP_ENABLE)
+   const char* dump(bool _reset) const { return UEventTime::dump(_reset); }
+#endif
+
+protected:
+   UElasticSearchClient* es;
+
+private:
+   U_DISALLOW_COPY_AND_ASSIGN(UElasticSearchTimer)
+};
+
+UElasticSearchClient::~UElasticSearchClient()
+{
+   U_TRACE_UNREGISTER_OBJECT(0, UElasticSearchClient)
+
+   if (bulk_queue)
+      {
+      (void) flushBulk();
+
+      if (pasync) UNotifier::handlerDelete(pasync);
+
+      // NB: if the timers are already cleared the timer is already deleted...
+
+      if (ptimer &&
+          UTimer::isHandler(ptimer))
+         {
+         UTimer::erase(ptimer);
+
+         delete ptimer;
+         }
+
+      delete[] bulk_queue;
+      delete   bulk_client;
+      }
+
+   if (client) delete client;
+}
+
 // Connect to ElasticSearch server
 
 bool UElasticSearchClient::connect(const char* phost, unsigned int _port)
@@ -46,13 +183,629 @@ bool UElasticSearchClient::connect(const char* phost, unsigned int _port)
    U_RETURN(false);
 }
 
+// BULK API
+
+bool UElasticSearchClient::setBulk(uint32_t max_size, uint32_t max_doc, uint32_t flush_ms, uint32_t max_queue)
+{
+   U_TRACE(0, "UElasticSearchClient::setBulk(%u,%u,%u,%u)", max_size, max_doc, flush_ms, max_queue)
+
+   U_INTERNAL_ASSERT_POINTER(client)
+   U_INTERNAL_ASSERT_MAJOR(max_doc, 0)
+   U_INTERNAL_ASSERT_MAJOR(max_size, 0)
+   U_INTERNAL_ASSERT_MAJOR(max_queue, 0)
+   U_INTERNAL_ASSERT_EQUALS(bulk_queue, 0)
+
+   // NB: the bulk use a dedicated connection, so the other API can be used while a request is in flight...
+
+   U_NEW(UClient<UTCPSocket>, bulk_client, UClient<UTCPSocket>(0));
+
+   if (bulk_client->setHostPort(client->UClient_Base::server, client->UClient_Base::port) == false ||
+       bulk_client->connect()                                                             == false)
+      {
+      delete bulk_client;
+             bulk_client = 0;
+
+      U_RETURN(false);
+      }
+
+   bulk_max_size  = max_size;
+   bulk_max_doc   = max_doc;
+   bulk_flush_ms  = flush_ms;
+   bulk_max_queue = max_queue;
+   bulk_notifier  = (UNotifier::max_connection != 0);
+
+   bulk_queue = new bulk_entry[max_queue];
+
+   bulk.setBuffer(U_CAPACITY);
+
+   if (bulk_notifier)
+      {
+      // NB: the timer check also the end of the backoff...
+
+      U_NEW(UElasticSearchTimer, ptimer, UElasticSearchTimer(this, (flush_ms && flush_ms < U_ES_BULK_BACKOFF_MS ? flush_ms : U_ES_BULK_BACKOFF_MS)));
+
+      UTimer::insert(ptimer);
+      }
+
+   U_RETURN(true);
+}
+
+static void appendString(UString& buffer, const char* s, uint32_t n)
+{
+   U_TRACE(0, "appendString(%V,%.*S,%u)", buffer.rep, n, s, n)
+
+   // NB: the name and the id are usually plain ascii, we escape them only if needed (u_escape_encode() emit in octal the byte > 126)...
+
+   for (uint32_t i = 0; i < n; ++i)
+      {
+      unsigned char c = s[i];
+
+      if (c < 32   ||
+          c == '"' ||
+          c == '\\')
+         {
+         UEscape::encode(s, n, buffer); // NB: it add also the quote...
+
+         return;
+         }
+      }
+
+   (void) buffer.push_back('"');
+   (void) buffer.append(s, n);
+   (void) buffer.push_back('"');
+}
+
+bool UElasticSearchClient::bulkIndex(const char* _index, uint32_t index_len, const char* type, uint32_t type_len, const char* id, uint32_t id_len, const char* data, uint32_t data_len)
+{
+   U_TRACE(0, "UElasticSearchClient::bulkIndex(%.*S,%u,%.*S,%u,%.*S,%u,%.*S,%u)", index_len, _index, index_len, type_len, type, type_len,
+                                                                                  id_len, id, id_len, data_len, data, data_len)
+
+   U_INTERNAL_ASSERT_POINTER(data)
+   U_INTERNAL_ASSERT_POINTER(bulk_queue)
+   U_INTERNAL_ASSERT_MAJOR(data_len, 0)
+
+   u_gettimenow();
+
+   long now = u_now->tv_sec * 1000L + u_now->tv_usec / 1000L;
+
+   if (bulk_ndoc == 0) bulk_start = now;
+
+   uint32_t n = 100U + (index_len + type_len + id_len) * 4 + data_len; // NB: the escape of a byte is max 4 char (\DDD)...
+
+   if (bulk.space() < n) UString::_reserve(bulk, n);
+
+   // {"index":{"_index":"twitter","_type":"tweet","_id":"1"}}\n{"user":"kimchy",...}\n
+
+   (void) bulk.append(U_CONSTANT_TO_PARAM("{\"index\":{\"_index\":"));
+
+   appendString(bulk, _index, index_len);
+
+   (void) bulk.append(U_CONSTANT_TO_PARAM(",\"_type\":"));
+
+   appendString(bulk, type, type_len);
+
+   if (id_len)
+      {
+      (void) bulk.append(U_CONSTANT_TO_PARAM(",\"_id\":"));
+
+      appendString(bulk, id, id_len);
+      }
+
+   (void) bulk.append(U_CONSTANT_TO_PARAM("}}\n"));
+
+   n = bulk.size();
+
+   (void) bulk.append(data, data_len);
+
+   // NB: in NDJSON the document must be on one line (the newline in a valid JSON can be only between the token)...
+
+   for (char* ptr = bulk.c_pointer(n); (ptr = (char*) memchr(ptr, '\n', bulk.pend() - ptr)); ) *ptr++ = ' ';
+
+   (void) bulk.push_back('\n');
+
+   if (++bulk_ndoc >= bulk_max_doc   ||
+       bulk.size() >= bulk_max_size  ||
+       (now - bulk_start) >= (long)bulk_flush_ms)
+      {
+      return sealBulk(true);
+      }
+
+   U_RETURN(true);
+}
+
+bool UElasticSearchClient::flushBulk()
+{
+   U_TRACE_NO_PARAM(0, "UElasticSearchClient::flushBulk()")
+
+   if (bulk_queue == 0) U_RETURN(true);
+
+   uint32_t failed = bulk_failed;
+
+   // NB: every iteration send a body or process a response (the body are sent again max U_ES_BULK_RETRY times)...
+
+   while (bulk_ndoc ||
+          bulk_len)
+      {
+      if (bulk_ndoc) (void) sealBulk(true);
+      else           (void) waitBulk();
+      }
+
+   if (failed == bulk_failed) U_RETURN(true);
+
+   U_RETURN(false);
+}
+
+void UElasticSearchClient::handlerBulkTime()
+{
+   U_TRACE_NO_PARAM(0, "UElasticSearchClient::handlerBulkTime()")
+
+   u_gettimenow();
+
+   if (bulk_ndoc &&
+       (u_now->tv_sec * 1000L + u_now->tv_usec / 1000L - bulk_start) >= (long)bulk_flush_ms)
+      {
+      (void) sealBulk(false);
+      }
+   else if (bulk_len               &&
+            bulk_inflight == false &&
+            getBackoff()  == 0     &&
+            sendBulk()    == false)
+      {
+      processBulk(0, 0, 0); // NB: connection error, the body is sent again later...
+      }
+}
+
+U_NO_EXPORT void UElasticSearchClient::setBackoff(uint32_t retry)
+{
+   U_TRACE(0, "UElasticSearchClient::setBackoff(%u)", retry)
+
+   U_INTERNAL_ASSERT_RANGE(1, retry, U_ES_BULK_RETRY)
+
+   // NB: exponential backoff, with the server overloaded an immediate retry make it worse...
+
+   u_gettimenow();
+
+   bulk_backoff = u_now->tv_sec * 1000L + u_now->tv_usec / 1000L + (U_ES_BULK_BACKOFF_MS << (retry - 1));
+}
+
+U_NO_EXPORT long UElasticSearchClient::getBackoff()
+{
+   U_TRACE_NO_PARAM(0, "UElasticSearchClient::getBackoff()")
+
+   // NB: return the millisecond that we must still wait before to send...
+
+   if (bulk_backoff)
+      {
+      u_gettimenow();
+
+      long ms = bulk_backoff - (u_now->tv_sec * 1000L + u_now->tv_usec / 1000L);
+
+      if (ms > 0) U_RETURN(ms);
+
+      bulk_backoff = 0;
+      }
+
+   U_RETURN(0);
+}
+
+U_NO_EXPORT void UElasticSearchClient::pushBulk(const UString& body, uint32_t ndoc, uint32_t retry)
+{
+   U_TRACE(0, "UElasticSearchClient::pushBulk(%V,%u,%u)", body.rep, ndoc, retry)
+
+   U_INTERNAL_ASSERT(bulk_len < bulk_max_queue)
+
+   bulk_entry* e = bulk_queue + (bulk_head + bulk_len++) % bulk_max_queue;
+
+   e->body  = body;
+   e->ndoc  = ndoc;
+   e->retry = retry;
+}
+
+U_NO_EXPORT void UElasticSearchClient::popBulk()
+{
+   U_TRACE_NO_PARAM(0, "UElasticSearchClient::popBulk()")
+
+   U_INTERNAL_ASSERT_MAJOR(bulk_len, 0)
+
+   bulk_queue[bulk_head].body.clear();
+
+   bulk_head = (bulk_head + 1) % bulk_max_queue;
+
+   --bulk_len;
+}
+
+U_NO_EXPORT bool UElasticSearchClient::sealBulk(bool bwait)
+{
+   U_TRACE(0, "UElasticSearchClient::sealBulk(%b)", bwait)
+
+   if (bulk_ndoc == 0) U_RETURN(true);
+
+   // NB: backpressure, a failed wait is not fatal: the body in flight is sent again and
+   //     after U_ES_BULK_RETRY attempt is discarded, so the queue is drained anyway...
+
+   while (bulk_len == bulk_max_queue)
+      {
+      if (bwait == false) U_RETURN(false);
+
+      (void) waitBulk();
+      }
+
+   pushBulk(bulk, bulk_ndoc, 0);
+
+   bulk.setBuffer(U_CAPACITY); // NB: the queue have a reference, so we have a new buffer...
+
+   bulk_ndoc = 0;
+
+   // NB: without event loop we read here the response of the previous body...
+
+   if (bulk_inflight &&
+       bulk_notifier == false)
+      {
+      (void) waitBulk();
+      }
+
+   if (bulk_inflight == false &&
+       bulk_len               &&
+       getBackoff()  == 0     &&
+       sendBulk()    == false)
+      {
+      processBulk(0, 0, 0); // NB: connection error, the body is sent again later...
+
+      U_RETURN(false);
+      }
+
+   U_RETURN(true);
+}
+
+U_NO_EXPORT bool UElasticSearchClient::sendBulk()
+{
+   U_TRACE_NO_PARAM(0, "UElasticSearchClient::sendBulk()")
+
+   U_INTERNAL_ASSERT_MAJOR(bulk_len, 0)
+   U_INTERNAL_ASSERT_EQUALS(bulk_inflight, false)
+
+   int count;
+   char buffer[256];
+   struct iovec iov[2];
+   bulk_entry* e = bulk_queue + bulk_head;
+   uint32_t len = u__snprintf(buffer, sizeof(buffer), U_CONSTANT_TO_PARAM("POST /_bulk HTTP/1.1\r\n"
+                                                                          "Host: %v\r\n"
+                                                                          "Content-Type: application/x-ndjson\r\n"
+                                                                          "Content-Length: %u\r\n"
+                                                                          "\r\n"), bulk_client->host_port.rep, e->body.size());
+
+   // NB: the server can have closed the connection (keep-alive timeout), so we try again with a new one...
+
+   for (int i = 0; i < 2; ++i)
+      {
+      if (bulk_client->isOpen() == false)
+         {
+         if (pasync) UNotifier::handlerDelete(pasync);
+
+         if (bulk_client->connect() == false) break;
+         }
+
+      iov[0].iov_base = (caddr_t)buffer;
+      iov[0].iov_len  =          len;
+      iov[1].iov_base = (caddr_t)e->body.data();
+      iov[1].iov_len  =          e->body.size();
+
+      count = len + e->body.size();
+
+      if (USocketExt::writev(bulk_client->socket, iov, 2, count, bulk_client->timeoutMS) == count)
+         {
+         bulk_inflight = true;
+
+         bulk_reply.setBuffer(U_CAPACITY);
+
+         if (bulk_notifier &&
+             pasync == 0)
+            {
+            bulk_client->socket->setNonBlocking(); // NB: the read from the event loop must not block...
+
+            U_NEW(UElasticSearchAsync, pasync, UElasticSearchAsync(this));
+
+            UNotifier::insert(pasync);
+            }
+
+         U_RETURN(true);
+         }
+
+      bulk_client->close();
+      }
+
+   U_RETURN(false);
+}
+
+U_NO_EXPORT bool UElasticSearchClient::waitBulk()
+{
+   U_TRACE_NO_PARAM(0, "UElasticSearchClient::waitBulk()")
+
+   if (bulk_inflight == false)
+      {
+      if (bulk_len == 0) U_RETURN(true);
+
+      long ms = getBackoff();
+
+      if (ms) UTimeVal::nanosleep(ms); // NB: the server is overloaded...
+
+      if (sendBulk() == false)
+         {
+         processBulk(0, 0, 0); // NB: connection error, the body is sent again later...
+
+         U_RETURN(false);
+         }
+      }
+
+   int result;
+
+   do { result = readBulk(bulk_client->timeoutMS); } while (result == 0);
+
+   if (result == 1) U_RETURN(true);
+
+   if (pasync) UNotifier::handlerDelete(pasync);
+
+   U_RETURN(false);
+}
+
+static const char* getHeaderValue(const char* ptr, const char* end, const char* name, uint32_t len)
+{
+   U_TRACE(0, "getHeaderValue(%.*S,%p,%.*S,%u)", end-ptr, ptr, end, len, name, len)
+
+   // NB: the name of the header is case insensitive (ElasticSearch use lowercase)...
+
+   for (ptr = (const char*) memchr(ptr, '\n', end-ptr); ptr && ++ptr < end; ptr = (const char*) memchr(ptr, '\n', end-ptr))
+      {
+      if (ptr[len] == ':' &&
+          u__strncasecmp(ptr, name, len) == 0)
+         {
+         for (ptr += len+1; *ptr == ' '; ++ptr) {}
+
+         return ptr;
+         }
+      }
+
+   return 0;
+}
+
+static bool getBodyChunked(const char* ptr, const char* end, UString& body)
+{
+   U_TRACE(0, "getBodyChunked(%.*S,%p,%V)", end-ptr, ptr, end, body.rep)
+
+   // NB: return true if the body is complete...
+
+   uint32_t n;
+   const char* eol;
+
+   while ((eol = (const char*) memchr(ptr, '\n', end-ptr)))
+      {
+      n   = strtoul(ptr, 0, 16);
+      ptr = eol+1;
+
+      if (n == 0) return (ptr+2 <= end); // NB: the last CRLF (we don't manage the trailer)...
+
+      if ((ptr+n+2) > end) break;
+
+      (void) body.append(ptr, n);
+
+      ptr += n+2;
+      }
+
+   return false;
+}
+
+U_NO_EXPORT int UElasticSearchClient::readBulk(int timeoutMS)
+{
+   U_TRACE(0, "UElasticSearchClient::readBulk(%d)", timeoutMS)
+
+   U_INTERNAL_ASSERT(bulk_inflight)
+
+   if (USocketExt::read(bulk_client->socket, bulk_reply, U_SINGLE_READ, timeoutMS) == false)
+      {
+      if (timeoutMS == 0 &&
+          bulk_client->isOpen())
+         {
+         U_RETURN(0); // NB: EAGAIN...
+         }
+
+      goto error;
+      }
+
+   {
+   // "HTTP/1.1 200 OK\r\ncontent-type: application/json; charset=UTF-8\r\ncontent-length: 123\r\n\r\n{"took":30,"errors":false,"items":[...]}"
+
+   const char* ptr = bulk_reply.data();
+   const char* end = bulk_reply.pend();
+   uint32_t sz = bulk_reply.size(), endHeader = u_findEndHeader1(ptr, sz);
+
+   if (endHeader == U_NOT_FOUND) U_RETURN(0);
+
+   if (sz < 12 ||
+       memcmp(ptr, U_CONSTANT_TO_PARAM("HTTP/1.")) != 0)
+      {
+      goto error;
+      }
+
+   UString chunked;
+   uint32_t status = u_strtoul(ptr+9, ptr+12);
+   const char* value = getHeaderValue(ptr, ptr+endHeader, U_CONSTANT_TO_PARAM("content-length"));
+
+   if (value)
+      {
+      uint32_t clen = strtoul(value, 0, 10);
+
+      if ((sz - endHeader) < clen) U_RETURN(0);
+
+      ptr += endHeader;
+      sz   = clen;
+      }
+   else
+      {
+      value = getHeaderValue(ptr, ptr+endHeader, U_CONSTANT_TO_PARAM("transfer-encoding"));
+
+      if (value == 0 ||
+          u__strncasecmp(value, U_CONSTANT_TO_PARAM("chunked")) != 0)
+         {
+         goto error;
+         }
+
+      chunked.setBuffer(sz);
+
+      if (getBodyChunked(ptr+endHeader, end, chunked) == false) U_RETURN(0);
+
+      ptr = chunked.data();
+      sz  = chunked.size();
+      }
+
+   bulk_inflight = false;
+
+   processBulk(status, ptr, sz);
+
+   bulk_reply.setBuffer(U_CAPACITY);
+
+   U_RETURN(1);
+   }
+
+error:
+   abortBulk();
+
+   U_RETURN(-1);
+}
+
+U_NO_EXPORT void UElasticSearchClient::abortBulk()
+{
+   U_TRACE_NO_PARAM(0, "UElasticSearchClient::abortBulk()")
+
+   bulk_client->close();
+
+   bulk_reply.setBuffer(U_CAPACITY);
+
+   if (bulk_inflight)
+      {
+      bulk_inflight = false;
+
+      processBulk(0, 0, 0); // NB: connection error, the body in flight is sent again...
+      }
+}
+
+U_NO_EXPORT void UElasticSearchClient::processBulk(uint32_t status, const char* ptr, uint32_t len)
+{
+   U_TRACE(0, "UElasticSearchClient::processBulk(%u,%.*S,%u)", status, len, ptr, len)
+
+   U_INTERNAL_ASSERT_MAJOR(bulk_len, 0)
+
+   bulk_entry* e = bulk_queue + bulk_head;
+
+   if (status != 200)
+      {
+      // NB: connection error (status 0), server overloaded (429) or not available (5xx), we send again the body...
+
+      if ((status == 0   ||
+           status == 429 ||
+           status >= 500) &&
+          ++e->retry <= U_ES_BULK_RETRY)
+         {
+         if (status == 429 ||
+             status == 503)
+            {
+            setBackoff(e->retry);
+            }
+
+         return;
+         }
+
+      bulk_failed += e->ndoc;
+
+      popBulk();
+
+      return;
+      }
+
+   if (u_find(ptr, len, U_CONSTANT_TO_PARAM("\"errors\":false")))
+      {
+      bulk_indexed += e->ndoc;
+
+      popBulk();
+
+      return;
+      }
+
+   /**
+    * {"took":3,"errors":true,"items":[{"index":{"_index":"twitter","_type":"tweet","_id":"1","status":201,...}},
+    *                                  {"index":{"_index":"twitter","_type":"tweet","_id":"2","status":429,"error":{...}}}]}
+    *
+    * NB: the items are in the same order of the document and every item have only one field "status"...
+    */
+
+   uint32_t code, i = 0, nretry = 0, retry = e->retry + 1;
+   const char* next;
+   const char* doc  = e->body.data();
+   const char* last = e->body.pend();
+   const char* end  = ptr + len;
+   UString body(U_CAPACITY);
+
+   while (i < e->ndoc &&
+          (ptr = (const char*) u_find(ptr, end - ptr, U_CONSTANT_TO_PARAM("\"status\":"))))
+      {
+      ptr += U_CONSTANT_SIZE("\"status\":");
+
+      code = strtoul(ptr, (char**)&ptr, 10);
+
+      next = (const char*) memchr(doc,  '\n', last - doc) + 1; // action
+      next = (const char*) memchr(next, '\n', last - next) + 1; // document
+
+      U_INTERNAL_DUMP("i = %u code = %u", i, code)
+
+      if (code < 300) ++bulk_indexed;
+      else if ((code == 429 ||
+                code == 503) &&
+               retry <= U_ES_BULK_RETRY)
+         {
+         (void) body.append(doc, next - doc);
+
+         ++nretry;
+         }
+      else
+         {
+         ++bulk_failed;
+         }
+
+      doc = next;
+
+      ++i;
+      }
+
+   bulk_failed += e->ndoc - i; // NB: the items missing in the response...
+
+   popBulk();
+
+   if (nretry)
+      {
+      pushBulk(body, nretry, retry);
+
+      setBackoff(retry);
+      }
+}
+
 // DEBUG
 
 #if defined(U_STDCPP_ENABLE) && defined(DEBUG)
 const char* UElasticSearchClient::dump(bool _reset) const
 {
-   *UObjectIO::os << "uri    (UString                 " << (void*)&uri   << ")\n"
-                  << "client (UHttpClient<UTCPSocket> " << (void*)client << ')';
+   *UObjectIO::os << "bulk_backoff                   " << bulk_backoff       << '\n'
+                  << "bulk_ndoc                      " << bulk_ndoc          << '\n'
+                  << "bulk_head                      " << bulk_head          << '\n'
+                  << "bulk_len                       " << bulk_len           << '\n'
+                  << "bulk_indexed                   " << bulk_indexed       << '\n'
+                  << "bulk_failed                    " << bulk_failed        << '\n'
+                  << "bulk_inflight                  " << bulk_inflight      << '\n'
+                  << "bulk_notifier                  " << bulk_notifier      << '\n'
+                  << "pasync                         " << (void*)pasync      << '\n'
+                  << "ptimer                         " << (void*)ptimer      << '\n'
+                  << "bulk        (UString           " << (void*)&bulk       << ")\n"
+                  << "bulk_client (UClient<UTCPSocket> " << (void*)bulk_client << ")\n"
+                  << "uri         (UString           " << (void*)&uri        << ")\n"
+                  << "client      (UHttpClient<UTCPSocket> " << (void*)client << ')';
 
    if (_reset)
       {
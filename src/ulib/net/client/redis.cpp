@@ -11,8 +11,117 @@
 //
 // ============================================================================
 
+#include <ulib/notifier.h>
+#include <ulib/net/tcpsocket.h>
+#include <ulib/utility/socket_ext.h>
 #include <ulib/net/client/redis.h>
 
+// CRC16 (XMODEM) used by REDIS Cluster to map the keys on the hash slots
+
+static const uint16_t crc16tab[256] = {
+   0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+   0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+   0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
+   0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+   0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
+   0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+   0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
+   0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+   0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
+   0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+   0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
+   0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+   0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
+   0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+   0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
+   0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+   0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
+   0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+   0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
+   0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+   0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
+   0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+   0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
+   0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+   0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
+   0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+   0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
+   0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+   0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
+   0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+   0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
+   0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0
+};
+
+class U_NO_EXPORT UREDISAsync : public UEventFd {
+public:
+
+   // Check for memory error
+   U_MEMORY_TEST
+
+   // Allocator e Deallocator
+   U_MEMORY_ALLOCATOR
+   U_MEMORY_DEALLOCATOR
+
+   UREDISAsync(UREDISClient_Base* rc) : client(rc)
+      {
+      U_TRACE_REGISTER_OBJECT(0, UREDISAsync, "%p", rc)
+
+      UEventFd::fd = rc->getFd();
+      }
+
+   virtual ~UREDISAsync() U_DECL_FINAL
+      {
+      U_TRACE_UNREGISTER_OBJECT(0, UREDISAsync)
+      }
+
+   // define method VIRTUAL of class UEventFd
+
+   virtual int handlerRead() U_DECL_FINAL
+      {
+      U_TRACE_NO_PARAM(0, "UREDISAsync::handlerRead()")
+
+      client->handlerAsync(true);
+
+      if (client->isOpen()) U_RETURN(U_NOTIFIER_OK);
+
+      U_RETURN(U_NOTIFIER_DELETE);
+      }
+
+   virtual void handlerDelete() U_DECL_FINAL
+      {
+      U_TRACE_NO_PARAM(0, "UREDISAsync::handlerDelete()")
+
+      U_INTERNAL_ASSERT_EQUALS(client->pasync, this)
+
+      client->pasync = 0;
+
+      if (client->nreply != client->reply_head) client->handlerAsync(false); // NB: the callbacks of the replies pending are called with error...
+
+      delete this;
+      }
+
+#if defined(DEBUG) && defined(U_STDCPP_ENABLE)
+   const char* dump(bool _reset) const { return UEventFd::dump(_reset); }
+#endif
+
+protected:
+   UREDISClient_Base* client;
+
+private:
+   U_DISALLOW_COPY_AND_ASSIGN(UREDISAsync)
+};
+
+UREDISClient_Base::~UREDISClient_Base()
+{
+   U_TRACE_UNREGISTER_OBJECT(0, UREDISClient_Base)
+
+   if (pasync) UNotifier::handlerDelete(pasync); // NB: the callbacks of the replies pending are called with error...
+
+   if (preply) delete[] preply;
+   if (pnode)  clearClusterNode();
+}
+
 // Connect to REDIS server
 
 bool UREDISClient_Base::connect(const char* phost, unsigned int _port)
@@ -90,8 +199,21 @@ U_NO_EXPORT bool UREDISClient_Base::processRequest(char recvtype)
 {
    U_TRACE(0, "UREDISClient_Base::processRequest(%C)", recvtype)
 
+   if (bpipeline)
+      {
+      for (int i = 0; i < UClient_Base::iovcnt; ++i) (void) pipe.append((const char*)UClient_Base::iov[i].iov_base, UClient_Base::iov[i].iov_len);
+
+      pushReply(recvtype);
+
+      U_RETURN(true);
+      }
+
+   if (pnode) return processClusterRequest(recvtype);
+
+   U_INTERNAL_ASSERT_EQUALS(reply_head, nreply) // NB: a synchronous command cannot be sent while there are replies pending in async mode...
+
    if (UClient_Base::sendRequest(false) &&
-       (vitem.clear(), UClient_Base::response.setBuffer(U_CAPACITY), UClient_Base::readResponse(U_SINGLE_READ)))
+       (vitem.clear(), UClient_Base::response.setBuffer(U_CAPACITY), readReply(1)))
       {
       char prefix = UClient_Base::response[0];
 
@@ -112,18 +234,161 @@ U_NO_EXPORT bool UREDISClient_Base::processRequest(char recvtype)
    U_RETURN(false);
 }
 
-U_NO_EXPORT char* UREDISClient_Base::getResponseItem(const UString& response, char* ptr, UVector<UString>& vec, uint32_t depth)
+int URESPParser::parse(const char* data, uint32_t size, vPFpvpe callback, void* arg, uint32_t max)
+{
+   U_TRACE(0, "URESPParser::parse(%.*S,%u,%p,%p,%u)", size, data, size, callback, arg, max)
+
+   U_INTERNAL_DUMP("pos = %u depth = %u", pos, depth)
+
+   U_INTERNAL_ASSERT(pos <= size)
+
+   element e;
+   uint32_t n = 0;
+   const char* eol;
+   const char* next;
+   const char* ptr = data + pos;
+   const char* end = data + size;
+
+   while (n < max &&
+          ptr < end)
+      {
+      e.type = *ptr;
+
+      if (memchr("$*:+-%~>|_,#!=(", e.type, U_CONSTANT_SIZE("$*:+-%~>|_,#!=(")) == 0) U_RETURN(-1); // NB: prefix unknown...
+
+      if ((eol = (const char*) memchr(ptr+1, '\r', end-ptr-1)) == 0 ||
+          (next = eol+2) > end)
+         {
+         break;
+         }
+
+      if (eol[1] != '\n') U_RETURN(-1);
+
+      e.depth = depth;
+
+      if (isString(e.type) == false)
+         {
+         e.ptr = ptr+1;
+         e.len = eol-ptr-1;
+         e.num = (e.type == ':' || isAggregate(e.type) ? u_strtol(e.ptr, eol) : 0);
+         }
+      else
+         {
+         e.num = u_strtol(ptr+1, eol);
+
+         if (e.num < 0) // NB: null...
+            {
+            e.ptr = 0;
+            e.len = 0;
+            }
+         else
+            {
+            if ((next + e.num + 2) > end) break; // NB: the data of the string are not complete...
+
+            e.ptr  = next;
+            e.len  = e.num;
+            next  += e.num + 2;
+            }
+         }
+
+      ptr = next;
+      pos = next - data;
+
+      if (callback) callback(arg, &e);
+
+      if (isAggregate(e.type))
+         {
+         if (e.num > 0)
+            {
+            if (depth == U_RESP_MAX_DEPTH) U_RETURN(-1);
+
+            remain[depth] = (e.type == '%' || e.type == '|' ? e.num * 2 : e.num);
+              type[depth] =  e.type;
+
+            ++depth;
+
+            continue;
+            }
+
+         if (e.type == '|') continue; // NB: an attribute is not an element of the reply...
+         }
+
+      // NB: the element is complete, we close the aggregate complete (the attribute don't count as element of the parent)...
+
+      for (;;)
+         {
+         if (depth == 0)
+            {
+            ++n;
+
+            break;
+            }
+
+         if (--remain[depth-1] > 0 ||
+             type[--depth] == '|')
+            {
+            break;
+            }
+         }
+      }
+
+   U_INTERNAL_DUMP("pos = %u depth = %u", pos, depth)
+
+   U_RETURN(n);
+}
+
+const char* URESPParser::skip(const char* ptr, const char* end)
+{
+   U_TRACE(0, "URESPParser::skip(%.*S,%p)", end-ptr, ptr, end)
+
+   if (ptr < end &&
+       *ptr == '|') // NB: we skip only the attribute (for the parser it is part of the reply that follow)...
+      {
+      const char* eol = (const char*) memchr(ptr, '\r', end-ptr);
+
+      if (eol == 0 ||
+          (eol+2) > end)
+         {
+         return 0;
+         }
+
+      long n = u_strtol(ptr+1, eol) * 2; // key and value
+
+      for (ptr = eol+2; n > 0 && ptr; --n) ptr = skip(ptr, end);
+
+      return ptr;
+      }
+
+   URESPParser parser;
+
+   if (parser.parse(ptr, end-ptr, 0, 0, 1) == 1) return ptr + parser.pos;
+
+   return 0;
+}
+
+char* UREDISClient_Base::getResponseItem(const UString& response, char* ptr, UVector<UString>& vec, uint32_t depth)
 {
    U_TRACE(0, "UREDISClient_Base::getResponseItem(%p,%p,%p,%u)", response.rep, ptr, &vec, depth)
 
    U_INTERNAL_DUMP("ptr = %.20S", ptr)
 
-   char prefix = *ptr++;
+   char prefix = *ptr;
 
    U_INTERNAL_DUMP("prefix = %C", prefix)
 
-   if (prefix != U_RC_BULK &&
-       prefix != U_RC_MULTIBULK)
+   if (prefix == '|') // NB: the attribute (RESP3) are skipped...
+      {
+      ptr = (char*) URESPParser::skip(ptr, response.pend());
+
+      U_INTERNAL_ASSERT_POINTER(ptr)
+
+      return getResponseItem(response, ptr, vec, depth);
+      }
+
+   ++ptr;
+
+   if (URESPParser::isString(prefix)    == false &&
+       URESPParser::isAggregate(prefix) == false)
       {
       char* start = ptr;
 
@@ -140,7 +405,7 @@ U_NO_EXPORT char* UREDISClient_Base::getResponseItem(const UString& response, ch
 
    U_INTERNAL_ASSERT_EQUALS(memcmp(ptr, "\r\n", 2), 0)
 
-   if (prefix == U_RC_BULK) // "$15\r\nmy-value-tester\r\n"
+   if (URESPParser::isString(prefix)) // "$15\r\nmy-value-tester\r\n"
       {
       if (len == -1) vec.push_back(UString::getStringNull());
       else
@@ -174,29 +439,33 @@ U_NO_EXPORT char* UREDISClient_Base::getResponseItem(const UString& response, ch
     *    4) "metavars"
     *
     * The second element of the multi-bulk reply to EXEC is a multi-bulk itself
+    *
+    * NB: the map (RESP3) are returned flat (key and value)...
     */
 
-   bool bnested;
-   UVector<UString> vec1(len);
+   if (prefix == '%') len *= 2;
 
    for (int i = 0; i < len; ++i)
       {
-      bnested = (ptr[2] == U_RC_MULTIBULK && ++depth);
+      if (ptr[2] == '|') ptr = (char*) URESPParser::skip(ptr+2, response.pend()) - 2; // NB: the attribute (RESP3) are skipped...
 
-      U_INTERNAL_DUMP("prefix = %C bnested = %b", ptr[2], bnested)
+      prefix = ptr[2];
 
-      ptr = getResponseItem(response, ptr+2, vec1, depth);
+      U_INTERNAL_DUMP("prefix = %C", prefix)
 
-      if (bnested == false) vec.move(vec1);
+      if (URESPParser::isAggregate(prefix) == false)
+         {
+         ptr = getResponseItem(response, ptr+2, vec, depth); // NB: we put the item directly in the vector (without copy)...
+         }
       else
          {
          typedef UVector<UString> uvectorstring;
 
-         UStringRep* rep = UObject2StringRep<uvectorstring>(vec1, true);
+         UVector<UString> vec1;
 
-         vec.push_back(rep);
+         ptr = getResponseItem(response, ptr+2, vec1, depth+1);
 
-         vec1.clear();
+         vec.push_back(UObject2StringRep<uvectorstring>(vec1, true));
          }
       }
 
@@ -205,6 +474,614 @@ U_NO_EXPORT char* UREDISClient_Base::getResponseItem(const UString& response, ch
    return ptr;
 }
 
+U_NO_EXPORT bool UREDISClient_Base::readReply(uint32_t n)
+{
+   U_TRACE(0, "UREDISClient_Base::readReply(%u)", n)
+
+   U_INTERNAL_ASSERT_MAJOR(n, 0)
+
+   // NB: a big reply (or the replies of a pipeline) can need more than one read, the parser restart from where it stopped...
+
+   int k;
+
+   parser.reset();
+
+   while (UClient_Base::readResponse(U_SINGLE_READ))
+      {
+      if ((k = parser.parse(UClient_Base::response, 0, 0, n)) < 0)
+         {
+         err = U_RC_ERR_PROTOCOL;
+
+         U_RETURN(false);
+         }
+
+      if ((n -= k) == 0) U_RETURN(true);
+      }
+
+   U_RETURN(false);
+}
+
+U_NO_EXPORT void UREDISClient_Base::pushReply(char recvtype)
+{
+   U_TRACE(0, "UREDISClient_Base::pushReply(%C)", recvtype)
+
+   U_INTERNAL_ASSERT(bpipeline)
+   U_INTERNAL_ASSERT(reply_head <= reply_start)
+
+   if (nreply == reply_max)
+      {
+      if (reply_head) // NB: we move at the beginning the replies still pending...
+         {
+         (void) U_SYSCALL(memmove, "%p,%p,%u", preply, preply + reply_head, (nreply - reply_head) * sizeof(reply));
+
+         nreply      -= reply_head;
+         reply_start -= reply_head;
+         reply_head   = 0;
+         }
+      else
+         {
+         reply* old = preply;
+
+         reply_max = (reply_max ? reply_max * 2 : 64);
+
+         preply = new reply[reply_max];
+
+         if (old)
+            {
+            U_MEMCPY(preply, old, nreply * sizeof(reply));
+
+            delete[] old;
+            }
+         }
+      }
+
+   reply* r = preply + nreply++;
+
+   r->callback = 0;
+   r->arg      = 0;
+   r->pos      = 0;
+   r->type     = recvtype;
+   r->recv     = U_RC_NONE;
+}
+
+U_NO_EXPORT bool UREDISClient_Base::sendPipeline()
+{
+   U_TRACE_NO_PARAM(0, "UREDISClient_Base::sendPipeline()")
+
+   U_INTERNAL_ASSERT(pipe)
+   U_INTERNAL_ASSERT_EQUALS(UClient_Base::iovcnt, 4)
+
+   UClient_Base::iovcnt = 1;
+
+   UClient_Base::iov[0].iov_base = (caddr_t)pipe.data();
+   UClient_Base::iov[0].iov_len  =          pipe.size();
+
+   bool result = UClient_Base::sendRequest(false);
+
+   UClient_Base::iovcnt = 4;
+
+   pipe.setEmpty();
+
+   U_RETURN(result);
+}
+
+void UREDISClient_Base::startPipeline()
+{
+   U_TRACE_NO_PARAM(0, "UREDISClient_Base::startPipeline()")
+
+   U_INTERNAL_ASSERT_EQUALS(pnode, 0)
+   U_INTERNAL_ASSERT_EQUALS(bpipeline, false)
+
+   if (reply_head == nreply) nreply = reply_head = 0;
+
+   reply_start = nreply;
+   bpipeline   = true;
+
+   pipe.setBuffer(U_CAPACITY);
+}
+
+bool UREDISClient_Base::endPipeline()
+{
+   U_TRACE_NO_PARAM(0, "UREDISClient_Base::endPipeline()")
+
+   U_INTERNAL_ASSERT(bpipeline)
+   U_INTERNAL_ASSERT_EQUALS(reply_head, reply_start) // NB: a synchronous pipeline cannot be sent while there are replies pending in async mode...
+
+   bpipeline = false;
+
+   if (nreply == reply_start) U_RETURN(true);
+
+   if (sendPipeline() &&
+       (vitem.clear(), UClient_Base::response.setBuffer(U_CAPACITY), readReply(nreply - reply_start)))
+      {
+      reply* r;
+      char* ptr = UClient_Base::response.data();
+
+      err = U_RC_OK;
+
+      if (element_cb) parser.reset();
+
+      for (uint32_t i = reply_start; i < nreply; ++i)
+         {
+         r = preply + i;
+
+         r->pos  = vitem.size();
+         r->recv = *ptr;
+
+         if (  r->recv != r->type &&
+             r->type != U_RC_ANY &&
+             err     == U_RC_OK)
+            {
+            err = (r->recv == U_RC_ERROR ? U_RC_ERROR
+                                         : U_RC_ERR_PROTOCOL);
+            }
+
+         if (element_cb)
+            {
+            (void) parser.parse(UClient_Base::response, element_cb, element_arg, 1);
+
+            ptr = UClient_Base::response.c_pointer(parser.getPos());
+
+            continue;
+            }
+
+         ptr = getResponseItem(UClient_Base::response, ptr, vitem, 0);
+
+         U_INTERNAL_ASSERT_EQUALS(memcmp(ptr, "\r\n", 2), 0)
+
+         ptr += 2;
+         }
+
+      U_DUMP_CONTAINER(vitem)
+
+      reply_head = nreply;
+
+      if (err == U_RC_OK) U_RETURN(true);
+
+      U_RETURN(false);
+      }
+
+   nreply = reply_head = reply_start;
+
+   U_RETURN(false);
+}
+
+bool UREDISClient_Base::sendAsync(vPFrcpv callback, void* arg)
+{
+   U_TRACE(0, "UREDISClient_Base::sendAsync(%p,%p)", callback, arg)
+
+   U_INTERNAL_ASSERT(bpipeline)
+   U_INTERNAL_ASSERT_POINTER(callback)
+
+   bpipeline = false;
+
+   if (nreply == reply_start) U_RETURN(true);
+
+   for (uint32_t i = reply_start; i < nreply; ++i)
+      {
+      preply[i].callback = callback;
+      preply[i].arg      = arg;
+      }
+
+   if (reply_head == reply_start) // NB: there are not replies pending, so the data in the buffer are already been processed...
+      {
+      parser.reset();
+
+      UClient_Base::response.setBuffer(U_CAPACITY);
+      }
+
+   if (sendPipeline())
+      {
+      if (pasync == 0)
+         {
+         UClient_Base::socket->setNonBlocking(); // NB: the read from the event loop must not block...
+
+         U_NEW(UREDISAsync, pasync, UREDISAsync(this));
+
+         UNotifier::insert(pasync);
+         }
+
+      U_RETURN(true);
+      }
+
+   nreply = reply_start;
+
+   U_RETURN(false);
+}
+
+void UREDISClient_Base::handlerAsync(bool bread)
+{
+   U_TRACE(0, "UREDISClient_Base::handlerAsync(%b)", bread)
+
+   int k;
+   reply* r;
+   uint32_t start, sz;
+
+   if (bread)
+      {
+      if (USocketExt::read(UClient_Base::socket, UClient_Base::response, U_SINGLE_READ, 0) == false &&
+          UClient_Base::isOpen()                                                          == false)
+         {
+         goto error;
+         }
+
+      // NB: the parser keep the state between the read, so a big reply is not scanned again every time...
+
+      start = 0; // NB: offset of the reply in progress (the buffer start always with it)...
+
+      while (reply_head < nreply)
+         {
+         if ((k = parser.parse(UClient_Base::response, 0, 0, 1)) <= 0)
+            {
+            if (k < 0) goto error;
+
+            break;
+            }
+
+         r = preply + reply_head++;
+
+         r->pos  = 0;
+         r->recv = UClient_Base::response.c_char(start);
+
+         err = (r->recv == r->type ||
+                r->type == U_RC_ANY ? U_RC_OK
+                                    : r->recv == U_RC_ERROR ? U_RC_ERROR
+                                                            : U_RC_ERR_PROTOCOL);
+
+         vitem.clear();
+
+         (void) getResponseItem(UClient_Base::response, UClient_Base::response.c_pointer(start), vitem, 0);
+
+         r->callback(this, r->arg); // NB: the callback can queue other commands (preply and the buffer can change)...
+
+         start = parser.getPos();
+         }
+
+      vitem.clear();
+
+      sz = UClient_Base::response.size();
+
+      if (start == sz)
+         {
+         parser.reset();
+
+         UClient_Base::response.setBuffer(U_CAPACITY);
+         }
+      else if (start)
+         {
+         UString rest(U_CAPACITY + sz - start);
+
+         (void) rest.append(UClient_Base::response.c_pointer(start), sz - start); // NB: the begin of a reply not complete...
+
+         UClient_Base::response = rest;
+
+         parser.rebase(start);
+         }
+
+      if (reply_head == nreply &&
+          bpipeline  == false)
+         {
+         nreply = reply_head = reply_start = 0;
+         }
+
+      return;
+      }
+
+error:
+   err = U_RC_ERR_CONECTION_CLOSE;
+
+   vitem.clear();
+
+   while (reply_head < nreply)
+      {
+      r = preply + reply_head++;
+
+      r->callback(this, r->arg);
+      }
+
+   nreply = reply_head = reply_start = 0;
+
+   UClient_Base::close();
+}
+
+// CLUSTER
+
+uint32_t UREDISClient_Base::hashSlot(const char* key, uint32_t keylen)
+{
+   U_TRACE(0, "UREDISClient_Base::hashSlot(%.*S,%u)", keylen, key, keylen)
+
+   // NB: if the key contains a {...} with at least one character inside only this part is hashed (hash tag)...
+
+   const char* start = (const char*) memchr(key, '{', keylen);
+
+   if (start)
+      {
+      ++start;
+
+      const char* end = (const char*) memchr(start, '}', key + keylen - start);
+
+      if (end &&
+          end > start)
+         {
+         key    = start;
+         keylen = end - start;
+         }
+      }
+
+   uint16_t crc = 0;
+
+   for (const char* end = key + keylen; key < end; ++key) crc = (crc << 8) ^ crc16tab[((crc >> 8) ^ *(unsigned char*)key) & 0x00FF];
+
+   uint32_t slot = crc & (U_RC_CLUSTER_SLOTS-1);
+
+   U_RETURN(slot);
+}
+
+UREDISClient_Base* UREDISClient_Base::getClusterNode(const char* key, uint32_t keylen)
+{
+   U_TRACE(0, "UREDISClient_Base::getClusterNode(%.*S,%u)", keylen, key, keylen)
+
+   if (pnode == 0) U_RETURN_POINTER(this, UREDISClient_Base);
+
+   UREDISClient_Base* node = pnode[pslot[hashSlot(key, keylen)]];
+
+   U_RETURN_POINTER(node, UREDISClient_Base);
+}
+
+U_NO_EXPORT uint32_t UREDISClient_Base::getNode(const char* host, uint32_t len, unsigned int _port)
+{
+   U_TRACE(0, "UREDISClient_Base::getNode(%.*S,%u,%u)", len, host, len, _port)
+
+   UREDISClient_Base* node;
+
+   for (uint32_t i = 0; i < nnode; ++i)
+      {
+      node = pnode[i];
+
+      if (node->UClient_Base::port == _port &&
+          node->UClient_Base::server.equal(host, len))
+         {
+         U_RETURN(i);
+         }
+      }
+
+   UString _host(host, len);
+
+   U_NEW(UREDISClient<UTCPSocket>, node, UREDISClient<UTCPSocket>);
+
+   if (node->connect(_host.c_str(), _port) == false)
+      {
+      delete node;
+
+      U_RETURN(U_NOT_FOUND);
+      }
+
+   if (nnode == node_max)
+      {
+      UREDISClient_Base** old = pnode;
+
+      node_max *= 2;
+
+      pnode = new UREDISClient_Base*[node_max];
+
+      U_MEMCPY(pnode, old, nnode * sizeof(UREDISClient_Base*));
+
+      delete[] old;
+      }
+
+   pnode[nnode++] = node;
+
+   U_RETURN(nnode-1);
+}
+
+U_NO_EXPORT void UREDISClient_Base::clearClusterNode()
+{
+   U_TRACE_NO_PARAM(0, "UREDISClient_Base::clearClusterNode()")
+
+   U_INTERNAL_ASSERT_POINTER(pnode)
+   U_INTERNAL_ASSERT_POINTER(pslot)
+
+   for (uint32_t i = 0; i < nnode; ++i) delete pnode[i];
+
+   delete[] pnode;
+   delete[] pslot;
+
+   pnode = 0;
+   pslot = 0;
+   nnode = node_max = 0;
+}
+
+U_NO_EXPORT bool UREDISClient_Base::loadClusterSlot(const UString& nodes)
+{
+   U_TRACE(0, "UREDISClient_Base::loadClusterSlot(%V)", nodes.rep)
+
+   /**
+    * Ex: "<id> 127.0.0.1:30002@31002 master - 0 1426238316232 2 connected 5461-10922\n"
+    *     "<id> 127.0.0.1:30004@31004 slave <id> 0 1426238317239 4 connected\n"
+    */
+
+   UString addr, flags, range;
+   uint32_t i, j, n, k, pos, at, index, start, end;
+   UVector<UString> vline(nodes, '\n'), vfield;
+
+   pnode = new UREDISClient_Base*[(node_max = 16)];
+   pslot = new uint16_t[U_RC_CLUSTER_SLOTS];
+
+   (void) U_SYSCALL(memset, "%p,%d,%u", pslot, 0, U_RC_CLUSTER_SLOTS * sizeof(uint16_t));
+
+   for (i = 0, n = vline.size(); i < n; ++i)
+      {
+      vfield.clear();
+
+      if (vfield.split(vline[i], ' ') < 8) continue;
+
+      flags = vfield[2];
+
+      if (U_STRING_FIND(flags, 0, "master") == U_NOT_FOUND ||
+          U_STRING_FIND(flags, 0, "fail")   != U_NOT_FOUND ||
+          U_STRING_FIND(flags, 0, "noaddr") != U_NOT_FOUND)
+         {
+         continue;
+         }
+
+      addr = vfield[1];
+      at   = addr.find('@');
+
+      if (at == U_NOT_FOUND) at = addr.size();
+
+      pos = addr.rfind(':', at);
+
+      if (pos == U_NOT_FOUND) continue;
+
+      index = getNode(addr.data(), pos, u_strtoul(addr.c_pointer(pos+1), addr.c_pointer(at)));
+
+      if (index == U_NOT_FOUND) goto error;
+
+      for (j = 8, k = vfield.size(); j < k; ++j)
+         {
+         range = vfield[j];
+
+         if (range.first_char() == '[') continue; // NB: slot in migration ([slot->-id] or [slot-<-id])...
+
+         pos   = range.find('-');
+         start = u_strtoul(range.data(), range.c_pointer(pos == U_NOT_FOUND ? range.size() : pos));
+         end   = (pos == U_NOT_FOUND ? start : u_strtoul(range.c_pointer(pos+1), range.pend()));
+
+         U_INTERNAL_DUMP("start = %u end = %u index = %u", start, end, index)
+
+         while (start <= end &&
+                start < U_RC_CLUSTER_SLOTS)
+            {
+            pslot[start++] = index;
+            }
+         }
+      }
+
+   if (nnode) U_RETURN(true);
+
+error:
+   clearClusterNode();
+
+   U_RETURN(false);
+}
+
+bool UREDISClient_Base::connectCluster(const char* phost, unsigned int _port)
+{
+   U_TRACE(0, "UREDISClient_Base::connectCluster(%S,%u)", phost, _port)
+
+   U_INTERNAL_ASSERT_EQUALS(pnode, 0)
+
+   if (connect(phost, _port)                                                                &&
+       processRequest(U_RC_BULK, U_CONSTANT_TO_PARAM("CLUSTER"), U_CONSTANT_TO_PARAM("NODES")) &&
+       loadClusterSlot(vitem[0]))
+      {
+      U_RETURN(true);
+      }
+
+   U_RETURN(false);
+}
+
+U_NO_EXPORT bool UREDISClient_Base::processClusterRequest(char recvtype)
+{
+   U_TRACE(0, "UREDISClient_Base::processClusterRequest(%C)", recvtype)
+
+   U_INTERNAL_ASSERT_POINTER(pnode)
+   U_INTERNAL_ASSERT_POINTER(pslot)
+
+   bool result, basking = false;
+   UREDISClient_Base* node = pnode[0]; // NB: the command without key go to the first master...
+
+   if (UClient_Base::iovcnt > 2)
+      {
+      const char* key = (const char*)UClient_Base::iov[2].iov_base;
+      uint32_t keylen =              UClient_Base::iov[2].iov_len;
+      const char* ptr = (const char*) memchr(key, ' ', keylen); // NB: for multi-key command (ex. MGET) the first one...
+
+      if (ptr) keylen = ptr - key;
+
+      node = pnode[pslot[hashSlot(key, keylen)]];
+      }
+
+   int iovcnt_save;
+   uint32_t slot, index;
+   struct iovec iov_save[6];
+   const char* ptr;
+   const char* end;
+
+   vitem.clear();
+
+   for (int nredirect = 0; ; ++nredirect)
+      {
+      if (basking &&
+          node->processRequest(U_RC_INLINE, U_CONSTANT_TO_PARAM("ASKING")) == false)
+         {
+         break;
+         }
+
+      iovcnt_save = node->UClient_Base::iovcnt;
+
+      U_MEMCPY(iov_save, node->UClient_Base::iov, sizeof(iov_save));
+
+      node->UClient_Base::iovcnt = UClient_Base::iovcnt;
+
+      U_MEMCPY(node->UClient_Base::iov, UClient_Base::iov, sizeof(iov_save));
+
+      result = node->processRequest(recvtype);
+
+      node->UClient_Base::iovcnt = iovcnt_save;
+
+      U_MEMCPY(node->UClient_Base::iov, iov_save, sizeof(iov_save));
+
+      UClient_Base::response.swap(node->UClient_Base::response);
+
+      err = node->err;
+
+      if (result) U_RETURN(true);
+
+      if (err       != U_RC_ERROR ||
+          nredirect == U_RC_CLUSTER_REDIRECT)
+         {
+         break;
+         }
+
+      // "-MOVED 3999 127.0.0.1:6381\r\n" or "-ASK 3999 127.0.0.1:6381\r\n"
+
+      ptr = UClient_Base::response.data();
+
+           if (memcmp(ptr, U_CONSTANT_TO_PARAM("-MOVED ")) == 0) { basking = false; ptr += U_CONSTANT_SIZE("-MOVED "); }
+      else if (memcmp(ptr, U_CONSTANT_TO_PARAM("-ASK "))   == 0) { basking = true;  ptr += U_CONSTANT_SIZE("-ASK "); }
+      else break;
+
+      slot = strtoul(ptr, (char**)&ptr, 10);
+
+      if (*ptr++ != ' ' ||
+          slot >= U_RC_CLUSTER_SLOTS)
+         {
+         break;
+         }
+
+      end = (const char*) memchr(ptr, '\r', UClient_Base::response.remain(ptr));
+
+      if (end == 0) break;
+
+      const char* colon = (const char*) memrchr(ptr, ':', end-ptr);
+
+      if (colon == 0 ||
+          (index = getNode(ptr, colon-ptr, u_strtoul(colon+1, end))) == U_NOT_FOUND)
+         {
+         break;
+         }
+
+      U_INTERNAL_DUMP("slot = %u index = %u basking = %b", slot, index, basking)
+
+      if (basking == false) pslot[slot] = index;
+
+      node = pnode[index];
+      }
+
+   U_RETURN(false);
+}
+
 U_NO_EXPORT void UREDISClient_Base::processResponse()
 {
    U_TRACE_NO_PARAM(0, "UREDISClient_Base::processResponse()")
@@ -213,6 +1090,15 @@ U_NO_EXPORT void UREDISClient_Base::processResponse()
 
    U_INTERNAL_ASSERT_EQUALS(err, U_RC_OK)
 
+   if (element_cb) // NB: zero-copy mode...
+      {
+      parser.reset();
+
+      (void) parser.parse(UClient_Base::response, element_cb, element_arg);
+
+      return;
+      }
+
          char* ptr = UClient_Base::response.data();
    const char* end = UClient_Base::response.pend();
 
@@ -252,7 +1138,7 @@ bool UREDISClient_Base::processRequest(char recvtype, const char* p1, uint32_t l
 
    if (result)
       {
-      processResponse();
+      if (bpipeline == false) processResponse();
 
       U_RETURN(true);
       }
@@ -275,7 +1161,7 @@ bool UREDISClient_Base::processRequest(char recvtype, const char* p1, uint32_t l
 
    if (processRequest(recvtype))
       {
-      processResponse();
+      if (bpipeline == false) processResponse();
 
       U_RETURN(true);
       }
@@ -313,7 +1199,7 @@ bool UREDISClient_Base::processRequest(char recvtype, const char* p1, uint32_t l
 
    if (result)
       {
-      processResponse();
+      if (bpipeline == false) processResponse();
 
       U_RETURN(true);
       }
@@ -324,12 +1210,40 @@ bool UREDISClient_Base::processRequest(char recvtype, const char* p1, uint32_t l
 // DEBUG
 
 #if defined(U_STDCPP_ENABLE) && defined(DEBUG)
+const char* URESPParser::dump(bool _reset) const
+{
+   *UObjectIO::os << "pos                                 " << pos   << '\n'
+                  << "depth                               " << depth;
+
+   if (_reset)
+      {
+      UObjectIO::output();
+
+      return UObjectIO::buffer_output;
+      }
+
+   return 0;
+}
+
 const char* UREDISClient_Base::dump(bool _reset) const
 {
    UClient_Base::dump(false);
 
    *UObjectIO::os << '\n'
                   << "err                                 " << err           << '\n'
+                  << "nreply                              " << nreply        << '\n'
+                  << "reply_max                           " << reply_max     << '\n'
+                  << "reply_head                          " << reply_head    << '\n'
+                  << "reply_start                         " << reply_start   << '\n'
+                  << "bpipeline                           " << bpipeline     << '\n'
+                  << "pslot                               " << (void*)pslot  << '\n'
+                  << "pasync                              " << (void*)pasync << '\n'
+                  << "pipe           (UString             " << (void*)&pipe  << ")\n"
+                  << "parser         (URESPParser         " << (void*)&parser << ")\n"
+                  << "element_cb                          " << (void*)element_cb << '\n'
+
+                  << "nnode                               " << nnode         << '\n'
+                  << "pnode                               " << (void*)pnode  << '\n'
                   << "vitem          (UVector             " << (void*)&vitem << ')';
 
    if (_reset)
@@ -12,6 +12,8 @@
 // ============================================================================
 
 #include <ulib/net/server/server.h>
+#include <ulib/utility/pubsub.h>
+#include <ulib/utility/metrics.h>
 #include <ulib/utility/websocket.h>
 #include <ulib/internal/error.h>
 
@@ -133,8 +135,9 @@ UClientImage_Base::UClientImage_Base()
 
    reset();
 
-   flag.u     = 0;
-   last_event = u_now->tv_sec;
+   flag.u        = 0;
+   last_event    = u_now->tv_sec;
+   request_start = 0;
 
    // NB: array are not pointers (virtual table can shift the address of 'this')...
 
@@ -473,6 +476,14 @@ void UClientImage_Base::handlerDelete()
    if (U_ClientImage_http(this) == '2') UHTTP2::handlerDelete(this, bsocket_open);
 #endif
 
+   if (U_ClientImage_http(this) == 'W') UWebSocket::handlerDelete(this);
+
+   if (U_ClientImage_http(this) == 'W' ||
+       U_ClientImage_http(this) == 'S')
+      {
+      UPubSub::handlerDelete(this);
+      }
+
    if (bsocket_open) socket->close();
 
    --UNotifier::num_connection;
@@ -683,10 +694,14 @@ void UClientImage_Base::endRequest()
 
    callerHandlerEndRequest();
 
+   if (UArena::isUsed()) UArena::reset(); // NB: the objects created in the arena by the request are dead...
+
    U_http_method_type = 0; // NB: this mark the end of http request processing...
 
    if (UServer_Base::isParallelizationParent() == false)
       {
+      if (UMetrics::isActive()) UMetrics::endRequest();
+
 #  ifdef U_SERVER_CHECK_TIME_BETWEEN_REQUEST
       time_run = chronometer->stop();
 
@@ -1008,7 +1023,10 @@ bool UClientImage_Base::genericRead()
 
    socket->iState = USocket::CONNECT; // prepare socket before read
 
-   if (USocketExt::read(socket, *rbuffer, U_SINGLE_READ, 0) == false) // NB: timeout == 0 means that we put the socket fd on epoll queue if EAGAIN...
+   if (USocketExt::read(socket, *rbuffer, U_SINGLE_READ, 0) == false && // NB: timeout == 0 means that we put the socket fd on epoll queue if EAGAIN...
+       (data_pending == 0  ||
+        socket->isClosed() ||
+        callerIsValidRequestExt(U_STRING_TO_PARAM(*rbuffer)) == false)) // NB: the data pending can be the rest of a pipeline deferred by the read budget (see deferPipeline())...
       {
       U_ClientImage_state = (socket->isOpen() ? U_PLUGIN_HANDLER_AGAIN
                                               : U_PLUGIN_HANDLER_ERROR);
@@ -1060,7 +1078,7 @@ int UClientImage_Base::handlerRead() // Connection-wide hooks
    U_TRACE_NO_PARAM(0, "UClientImage_Base::handlerRead()")
 
    int result;
-   uint32_t sz;
+   uint32_t sz, nbudget = 0;
 
    prepareForRead();
 
@@ -1155,6 +1173,8 @@ data_missing:
 
       if (U_ClientImage_parallelization == U_PARALLELIZATION_CHILD) goto loop;
 
+      if (request_start == 0) request_start = u_now->tv_sec; // NB: the request header must be complete before REQ_HEADER_TIMEOUT...
+
       U_NEW(UString, data_pending, UString((void*)U_STRING_TO_PARAM(*request)));
 
       U_INTERNAL_DUMP("data_pending(%u) = %V", data_pending->size(), data_pending->rep)
@@ -1165,6 +1185,10 @@ data_missing:
       U_RETURN(U_NOTIFIER_OK);
       }
 
+   // NB: the response from the cache of the request is measured as the others (the parse phase is the check of the cache)...
+
+   if (UMetrics::isActive()) UMetrics::startRequest(this);
+
 #ifndef U_CACHE_REQUEST_DISABLE
    if (U_ClientImage_request_is_cached)
       {
@@ -1176,8 +1200,12 @@ data_missing:
 
          U_INTERNAL_ASSERT_EQUALS(sz, 2)
 
+         if (UMetrics::isActive()) UMetrics::setPhase(U_METRICS_PHASE_PARSE);
+
          setRequestProcessed();
 
+         request_start = 0;
+
          goto next;
          }
 
@@ -1197,6 +1225,8 @@ data_missing:
 
    U_ClientImage_state = callerHandlerRead();
 
+   if (UMetrics::isActive()) UMetrics::setPhase(U_METRICS_PHASE_PARSE);
+
    U_INTERNAL_DUMP("socket->isClosed() = %b U_http_info.nResponseCode = %u U_ClientImage_close = %b U_ClientImage_state = %d %B",
                     socket->isClosed(),     U_http_info.nResponseCode,     U_ClientImage_close,     U_ClientImage_state, U_ClientImage_state)
 
@@ -1225,6 +1255,8 @@ data_missing:
 
    if (U_ClientImage_data_missing) goto data_missing;
 
+   request_start = 0;
+
    U_INTERNAL_DUMP("size_request = %u", size_request)
 
    if (size_request)
@@ -1340,6 +1372,8 @@ check:            U_INTERNAL_DUMP("nrequest = %u resto = %u", nrequest, resto)
 
       U_ClientImage_state = callerHandlerRequest();
 
+      if (UMetrics::isActive()) UMetrics::setPhase(U_METRICS_PHASE_HANDLER);
+
       if (UNLIKELY(socket->isClosed())) goto error;
       }
 
@@ -1365,6 +1399,8 @@ write:
 
          result = handlerResponse();
 
+         if (UMetrics::isActive()) UMetrics::setPhase(U_METRICS_PHASE_WRITE);
+
 #     ifndef U_PIPELINE_HOMOGENEOUS_DISABLE
          U_INTERNAL_DUMP("nrequest = %u resto = %u U_ClientImage_pipeline = %b U_ClientImage_close = %b rstart = %u",
                           nrequest,     resto,     U_ClientImage_pipeline,     U_ClientImage_close,     rstart)
@@ -1407,6 +1443,8 @@ write:
             {
             goto error;
             }
+
+         if (UMetrics::isActive()) UMetrics::setPhase(U_METRICS_PHASE_WRITE);
          }
       }
 
@@ -1416,10 +1454,17 @@ write:
       {
       if (U_ClientImage_pipeline)
          {
-           endRequest();
-         startRequest();
+         if (UServer_Base::read_budget == 0        ||
+             ++nbudget < UServer_Base::read_budget ||
+             U_ClientImage_parallelization == U_PARALLELIZATION_CHILD)
+            {
+              endRequest();
+            startRequest();
 
-         goto pipeline;
+            goto pipeline;
+            }
+
+         deferPipeline(); // NB: fair-share, the rest of the pipeline is processed after the other ready connections...
          }
       }
    else
@@ -1434,7 +1479,7 @@ error:
    endRequest();
 
 #ifdef U_THROTTLING_SUPPORT
-   if (uri) UServer_Base::clearThrottling();
+   if (UServer_Base::isThrottling()) UServer_Base::clearThrottling();
 #endif
 
    U_DUMP("U_ClientImage_close = %b UServer_Base::isParallelizationChild() = %b", U_ClientImage_close, UServer_Base::isParallelizationChild())
@@ -1739,6 +1784,28 @@ void UClientImage_Base::resetPipeline()
    size_request = 0; // NB: we don't want to process further the read buffer...
 }
 
+void UClientImage_Base::deferPipeline()
+{
+   U_TRACE_NO_PARAM(0, "UClientImage_Base::deferPipeline()")
+
+   U_INTERNAL_ASSERT_MAJOR(rstart, 0)
+   U_INTERNAL_ASSERT_EQUALS(count, 0)
+   U_INTERNAL_ASSERT_EQUALS(data_pending, 0)
+   U_INTERNAL_ASSERT_DIFFERS(U_http_version, '2')
+
+   U_NEW(UString, data_pending, UString((void*)rbuffer->c_pointer(rstart), rbuffer->size() - rstart));
+
+   U_INTERNAL_DUMP("data_pending(%u) = %V", data_pending->size(), data_pending->rep)
+
+   resetPipeline();
+
+   // NB: the socket is writable, so with EPOLLOUT we are notified again at the next iteration of the event loop (see handlerWrite())...
+
+   UEventFd::op_mask = EPOLLOUT;
+
+   if (UNotifier::isHandler(UEventFd::fd)) UNotifier::modify(this);
+}
+
 void UClientImage_Base::prepareForSendfile()
 {
    U_TRACE_NO_PARAM(0, "UClientImage_Base::prepareForSendfile()")
@@ -1819,6 +1886,16 @@ int UClientImage_Base::handlerWrite()
 {
    U_TRACE_NO_PARAM(0, "UClientImage_Base::handlerWrite()")
 
+   if (count == 0 &&
+       data_pending) // NB: the rest of a pipeline deferred by the read budget (see deferPipeline())...
+      {
+      UEventFd::op_mask = EPOLLIN | EPOLLRDHUP | EPOLLET;
+
+      UNotifier::modify(this);
+
+      U_RETURN(handlerRead());
+      }
+
    U_INTERNAL_ASSERT_DIFFERS(U_http_version, '2')
 
 #if !defined(USE_LIBEVENT) && defined(HAVE_EPOLL_WAIT) && defined(DEBUG)
@@ -1845,16 +1922,19 @@ int UClientImage_Base::handlerWrite()
 
    U_INTERNAL_DUMP("bwrite = %b", bwrite)
 
-#ifdef U_THROTTLING_SUPPORT
-   if (UServer_Base::checkThrottlingBeforeSend(bwrite) == false) U_RETURN(U_NOTIFIER_OK);
-#endif
-
    off_t offset;
    int iBytesWrite;
+   uint32_t chunk = U_NOT_FOUND;
+
+#ifdef U_THROTTLING_SUPPORT
+   chunk = UServer_Base::checkThrottlingBeforeSend(this, bwrite); // NB: the max bytes to send, the data are sent with pauses between each block...
+
+   if (chunk == 0) U_RETURN(U_NOTIFIER_OK);
+#endif
 
 write:
    offset      = start;
-   iBytesWrite = USocketExt::sendfile(socket, sfd, &offset, count, 0);
+   iBytesWrite = USocketExt::sendfile(socket, sfd, &offset, U_min(count, chunk), 0);
 
 #ifdef U_THROTTLING_SUPPORT
    if (iBytesWrite > 0) bytes_sent += iBytesWrite;
@@ -1949,6 +2029,7 @@ const char* UClientImage_Base::dump(bool _reset) const
                   << "count                              " << count               << '\n'
                   << "bIPv6                              " << bIPv6               << '\n'
                   << "last_event                         " << last_event          << '\n'
+                  << "request_start                      " << request_start       << '\n'
                   << "socket          (USocket           " << (void*)socket       << ")\n"
                   << "body            (UString           " << (void*)body         << ")\n"
                   << "logbuf          (UString           " << (void*)logbuf       << ")\n"
@@ -17,12 +17,17 @@
 #include <ulib/utility/uhttp.h>
 #include <ulib/net/server/server.h>
 #include <ulib/utility/string_ext.h>
+#include <ulib/utility/session_store.h>
 #include <ulib/net/server/plugin/mod_http.h>
 
 #ifndef U_HTTP2_DISABLE
 #  include <ulib/utility/http2.h>
 #endif
 
+#ifdef USE_LIBSSL
+#  include <ulib/ssl/net/ssl_session.h>
+#endif
+
 U_CREAT_FUNC(server_plugin_http, UHttpPlugIn)
 
 UHttpPlugIn::~UHttpPlugIn()
@@ -78,6 +83,10 @@ int UHttpPlugIn::handlerConfig(UFileConfig& cfg)
    // NOCACHE_FILE_MASK      mask (DOS regexp) of pathfile that content  NOT be cached in memory
    // CACHE_FILE_STORE       pathfile of memory cache stored on filesystem
    //
+   // PRELOAD_MANIFEST       pathfile of manifest (uri resource1 resource2 ...) of resource to push (HTTP/2) or to hint with 103 Early Hints (HTTP/1.1)
+   // PRELOAD_LEARN          learn the resource to preload for uri from the Link header (rel=preload) of the response
+   // PRELOAD_LEARN_MAX      max number of uri of the preload table (manifest included), over it we don't learn (default 1024)
+   //
    // CGI_TIMEOUT            timeout for cgi execution
    // VIRTUAL_HOST           flag to activate practice of maintaining more than one server on one machine, as differentiated by their apparent hostname
    // DIGEST_AUTHENTICATION  flag authentication method (yes = digest, no = basic)
@@ -88,15 +97,25 @@ int UHttpPlugIn::handlerConfig(UFileConfig& cfg)
    // URI_PROTECTED_ALLOWED_IP list of comma separated client address for IP-based access control (IPADDR[/MASK]) for URI_PROTECTED_MASK
    //
    // URI_REQUEST_CERT_MASK                      mask (DOS regexp) of URI where client must comunicate a certificate in the SSL connection
-   // BANDWIDTH_THROTTLING_MASK                  lets you set maximum byte rates on URLs or URL groups (*.jpg|*.gif 50)
+   // BANDWIDTH_THROTTLING_MASK                  lets you set maximum byte rates (kB/s) on URLs or URL groups (*.jpg|*.gif 50, *.mpg 20-100 for min-max)
+   // THROTTLING_CLIENT_REQUEST_RATE             max number of requests for second from a client (IP address), over is refused with 429
+   // THROTTLING_CLIENT_BANDWIDTH                max byte rate (kB/s) sent to a client (IP address)
+   // THROTTLING_CLIENT_MAX                      max number of client tracked in the shared memory for the limits above (default 4096)
    // URI_REQUEST_STRICT_TRANSPORT_SECURITY_MASK mask (DOS regexp) of URI where use HTTP Strict Transport Security to force client to use only SSL
    //
    // SESSION_COOKIE_OPTION  eventual params for session cookie (lifetime, path, domain, secure, HttpOnly)  
+   // SESSION_STORE_MAX      max number of session in the shared memory (default 1024, 0 => the sessions are only in the db)
+   // SESSION_STORE_SLOT     max size (bytes) of a session in the shared memory, over is stored in the db (default 1024)
+   // SESSION_STORE_TTL      max idle time (seconds) of a session in the shared memory (default 86400)
+   // SESSION_STORE_SNAPSHOT flag to write the modified sessions in the db every minute (to survive a restart)
+   //
+   // REQUEST_ARENA_SIZE     size of the block of memory for the objects created by the usp page between UArena::begin() and the end of the request (default 0 => disabled)
    // ----------------------------------------------------------------------------------------------------------------------------------------------------
    // This directive gives greater control over abnormal client request behavior, which may be useful for avoiding some forms of denial-of-service attacks
    // ----------------------------------------------------------------------------------------------------------------------------------------------------
    // LIMIT_REQUEST_BODY   restricts the total size of the HTTP request body sent from the client
    // REQUEST_READ_TIMEOUT set timeout for receiving requests
+   // REQUEST_BODY_MIN_RATE min rate (bytes per second) for receiving the body of a request, a slower client is disconnected (default 0 => disabled)
    // ------------------------------------------------------------------------------------------------------------------------------------------------
    //
    // ------------------------------------------------------------------------------------------------------------------------------------------------
@@ -188,6 +207,7 @@ int UHttpPlugIn::handlerConfig(UFileConfig& cfg)
       UHTTP::cgi_timeout                     = cfg.readLong(U_CONSTANT_TO_PARAM("CGI_TIMEOUT"));
       UHTTP::limit_request_body              = cfg.readLong(U_CONSTANT_TO_PARAM("LIMIT_REQUEST_BODY"), U_STRING_MAX_SIZE);
       UHTTP::request_read_timeout            = cfg.readLong(U_CONSTANT_TO_PARAM("REQUEST_READ_TIMEOUT"));
+      UHTTP::request_body_min_rate           = cfg.readLong(U_CONSTANT_TO_PARAM("REQUEST_BODY_MIN_RATE"));
       UHTTP::enable_caching_by_proxy_servers = cfg.readBoolean(U_CONSTANT_TO_PARAM("ENABLE_CACHING_BY_PROXY_SERVERS"));
 
       U_INTERNAL_DUMP("UHTTP::limit_request_body = %u", UHTTP::limit_request_body)
@@ -240,6 +260,29 @@ int UHttpPlugIn::handlerConfig(UFileConfig& cfg)
          }
 #  endif
 
+      // PRELOAD MANIFEST
+
+      x = cfg.at(U_CONSTANT_TO_PARAM("PRELOAD_MANIFEST"));
+
+      UHTTP::preload_learn     = cfg.readBoolean(U_CONSTANT_TO_PARAM("PRELOAD_LEARN"));
+      UHTTP::preload_learn_max = cfg.readLong(U_CONSTANT_TO_PARAM("PRELOAD_LEARN_MAX"), U_PRELOAD_LEARN_MAX);
+
+      if (x ||
+          UHTTP::preload_learn)
+         {
+         U_INTERNAL_ASSERT_EQUALS(UHTTP::preload_manifest, 0)
+
+         U_NEW(UHashMap<UString>, UHTTP::preload_manifest, UHashMap<UString>);
+
+         if (x)
+            {
+            UString content = UFile::contentOf(x);
+
+            if (content) UHTTP::loadPreloadManifest(content);
+            else         U_SRV_LOG("WARNING: preload manifest %V not found", x.rep);
+            }
+         }
+
       // COOKIE OPTION
 
       x = cfg.at(U_CONSTANT_TO_PARAM("SESSION_COOKIE_OPTION"));
@@ -251,6 +294,19 @@ int UHttpPlugIn::handlerConfig(UFileConfig& cfg)
          U_NEW(UString, UHTTP::cgi_cookie_option, UString(x));
          }
 
+      // SESSION STORE
+
+      USessionStore::max_session = cfg.readLong(U_CONSTANT_TO_PARAM("SESSION_STORE_MAX"),  USessionStore::max_session);
+      USessionStore::slot_size   = cfg.readLong(U_CONSTANT_TO_PARAM("SESSION_STORE_SLOT"), USessionStore::slot_size);
+      USessionStore::ttl         = cfg.readLong(U_CONSTANT_TO_PARAM("SESSION_STORE_TTL"),  USessionStore::ttl);
+      USessionStore::bsnapshot   = cfg.readBoolean(U_CONSTANT_TO_PARAM("SESSION_STORE_SNAPSHOT"));
+
+      // REQUEST ARENA
+
+      uint32_t arena_size = cfg.readLong(U_CONSTANT_TO_PARAM("REQUEST_ARENA_SIZE"));
+
+      if (arena_size) UArena::init(arena_size);
+
       // HTTP STRICT TRANSPORT SECURITY
 
 #  ifdef U_HTTP_STRICT_TRANSPORT_SECURITY
@@ -392,18 +448,36 @@ int UHttpPlugIn::handlerConfig(UFileConfig& cfg)
 #  ifdef U_THROTTLING_SUPPORT
       x = cfg.at(U_CONSTANT_TO_PARAM("BANDWIDTH_THROTTLING_MASK"));
 
-      if (x)
-         {
+      UServer_Base::throttling_client_rate  = cfg.readLong(U_CONSTANT_TO_PARAM("THROTTLING_CLIENT_REQUEST_RATE"));
+      UServer_Base::throttling_client_krate = cfg.readLong(U_CONSTANT_TO_PARAM("THROTTLING_CLIENT_BANDWIDTH"));
+      UServer_Base::throttling_client_max   = cfg.readLong(U_CONSTANT_TO_PARAM("THROTTLING_CLIENT_MAX"));
+
 #     if defined(ENABLE_THREAD) && defined(U_SERVER_THREAD_APPROACH_SUPPORT)
-         if (UServer_Base::preforked_num_kids == -1) // NB: in the thread approach this is not safe so far...
+      if (UServer_Base::preforked_num_kids == -1) // NB: in the thread approach this is not safe so far...
+         {
+         if (x ||
+             UServer_Base::throttling_client_rate ||
+             UServer_Base::throttling_client_krate)
             {
-            U_SRV_LOG("WARNING: Sorry, I can't enable bandwidth throttling because PREFORK_CHILD == -1 (server thread approach)");
+            U_SRV_LOG("WARNING: Sorry, I can't enable throttling because PREFORK_CHILD == -1 (server thread approach)");
             }
-         else
+
+         x.clear();
+
+         UServer_Base::throttling_client_rate  =
+         UServer_Base::throttling_client_krate = 0;
+         }
 #     endif
+
+      if (x) U_NEW(UString, UServer_Base::throttling_mask, UString(x));
+
+      // NB: the bandwidth is paced only for the response sent with sendfile(), so we must use it also for the small file...
+
+      if ((UServer_Base::throttling_mask ||
+           UServer_Base::throttling_client_krate) &&
+          UServer_Base::min_size_for_sendfile != U_NOT_FOUND)
          {
-         U_NEW(UString, UServer_Base::throttling_mask, UString(x));
-         }
+         UServer_Base::min_size_for_sendfile = 4096; // 4k
          }
 #  endif
 
@@ -507,9 +581,15 @@ int UHttpPlugIn::handlerInit()
 
       USSLSocket::staple.data = UServer_Base::getOffsetToDataShare(U_OCSP_MAX_RESPONSE_SIZE);
 #  endif
+
+      U_INTERNAL_ASSERT_EQUALS(USSLSession::ptr, 0)
+
+      USSLSession::ptr = (USSLSession::cache*) UServer_Base::getOffsetToDataShare(sizeof(USSLSession::cache));
       }
 #endif
 
+   if (USessionStore::max_session) USessionStore::init();
+
    UHTTP::init();
 
    U_RETURN(U_PLUGIN_HANDLER_PROCESSED | U_PLUGIN_HANDLER_GO_ON);
@@ -519,6 +599,10 @@ int UHttpPlugIn::handlerRun() // NB: we use this method instead of handlerInit()
 {
    U_TRACE_NO_PARAM(0, "UHttpPlugIn::handlerRun()")
 
+   UHTTP::initRouteMatcher(); // NB: the other plugin can have added some alias (ex: mod_fcgi)...
+
+   if (USessionStore::max_session) USessionStore::run(); // NB: before the init of the usp (UHTTP::initSession())...
+
 #ifndef U_HTTP2_DISABLE
    UHTTP2::Connection::preallocate(UNotifier::max_connection);
 #endif
@@ -601,6 +685,8 @@ int UHttpPlugIn::handlerFork()
 
    if (UHTTP::bcallInitForAllUSP) UHTTP::cache_file->callForAllEntry(UHTTP::callAfterForkForAllUSP);
 
+   if (USessionStore::isActive()) USessionStore::start();
+
    U_RETURN(U_PLUGIN_HANDLER_PROCESSED | U_PLUGIN_HANDLER_GO_ON);
 }
 
@@ -657,16 +743,6 @@ int UHttpPlugIn::handlerSigHUP()
 {
    U_TRACE_NO_PARAM(0, "UHttpPlugIn::handlerSigHUP()")
 
-#ifdef USE_LIBSSL
-   if (UServer_Base::bssl &&
-       UHTTP::db_session_ssl->compactionJournal() == false)
-      {
-      U_WARNING("SSL: compaction of db SSL session failed");
-
-      (void) U_SYSCALL(SSL_CTX_set_session_cache_mode, "%p,%d", USSLSocket::sctx, SSL_SESS_CACHE_OFF);
-      }
-#endif
-
    if (UHTTP::bcallInitForAllUSP) UHTTP::cache_file->callForAllEntry(UHTTP::callSigHUPForAllUSP);
 
    U_RETURN(U_PLUGIN_HANDLER_PROCESSED | U_PLUGIN_HANDLER_GO_ON);
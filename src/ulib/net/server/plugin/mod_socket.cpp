@@ -14,6 +14,7 @@
 #include <ulib/command.h>
 #include <ulib/file_config.h>
 #include <ulib/utility/uhttp.h>
+#include <ulib/utility/pubsub.h>
 #include <ulib/utility/services.h>
 #include <ulib/utility/websocket.h>
 #include <ulib/net/server/server.h>
@@ -21,7 +22,6 @@
 
 U_CREAT_FUNC(server_plugin_socket, UWebSocketPlugIn)
 
-vPFi      UWebSocketPlugIn::on_message;
 UCommand* UWebSocketPlugIn::command;
 
 UWebSocketPlugIn::UWebSocketPlugIn()
@@ -33,8 +33,12 @@ UWebSocketPlugIn::~UWebSocketPlugIn()
 {
    U_TRACE_UNREGISTER_OBJECT(0, UWebSocketPlugIn)
 
-   if (command)             delete command;
-   if (UWebSocket::rbuffer) delete UWebSocket::rbuffer;
+   if (command)                 delete command;
+   if (UWebSocket::rbuffer)     delete UWebSocket::rbuffer;
+   if (UWebSocket::vconnection) UWebSocket::deallocate(UNotifier::max_connection);
+
+   UWebSocket::clear();
+   UPubSub::clear();
 }
 
 RETSIGTYPE UWebSocketPlugIn::handlerForSigTERM(int signo)
@@ -56,6 +60,14 @@ int UWebSocketPlugIn::handlerConfig(UFileConfig& cfg)
    // ENVIRONMENT      environment for command (alternative to USP websocket) to execute
    //
    // MAX_MESSAGE_SIZE Maximum size (in bytes) of a message to accept; default is approximately 4GB
+   //
+   // PERMESSAGE_DEFLATE                 enable the compression of the messages (RFC 7692) if the client offer it
+   // PERMESSAGE_DEFLATE_CONTEXT_TAKEOVER keep the compression context between the messages (better ratio, ~300k of memory for each connection)
+   //
+   // PUBSUB_TOPIC_MAX max number of topic for the broadcast to the subscribed connection (max 64, 0 => disabled)
+   // PUBSUB_RING_SIZE size (in bytes) of the shared memory ring of each topic (default 1M, the max size of a message is half of it)
+   // PUBSUB_SOCKET    UNIX socket (datagram 'topic message') to publish from outside the server
+   // SSE_URI          URI for the subscription of a SSE (text/event-stream) client: GET <SSE_URI>?topic=name1,name2,...
    // ----------------------------------------------------------------------------------------------
 
    if (cfg.loadTable())
@@ -64,12 +76,49 @@ int UWebSocketPlugIn::handlerConfig(UFileConfig& cfg)
 
       UWebSocket::max_message_size = cfg.readLong(U_CONSTANT_TO_PARAM("MAX_MESSAGE_SIZE"), U_STRING_MAX_SIZE);
 
+#  ifdef USE_LIBZ
+      UWebSocket::bdeflate          = cfg.readBoolean(U_CONSTANT_TO_PARAM("PERMESSAGE_DEFLATE"));
+      UWebSocket::bcontext_takeover = cfg.readBoolean(U_CONSTANT_TO_PARAM("PERMESSAGE_DEFLATE_CONTEXT_TAKEOVER"), true);
+#  endif
+
+      UPubSub::topic_max = cfg.readLong(U_CONSTANT_TO_PARAM("PUBSUB_TOPIC_MAX"));
+
+      if (UPubSub::topic_max)
+         {
+         UPubSub::ring_size = cfg.readLong(U_CONSTANT_TO_PARAM("PUBSUB_RING_SIZE"), 1024 * 1024);
+
+         UString x = cfg.at(U_CONSTANT_TO_PARAM("PUBSUB_SOCKET"));
+
+         if (x) U_NEW(UString, UPubSub::socket_path, UString(x));
+
+         x = cfg.at(U_CONSTANT_TO_PARAM("SSE_URI"));
+
+         if (x) U_NEW(UString, UPubSub::sse_uri, UString(x));
+         }
+
       U_RETURN(U_PLUGIN_HANDLER_PROCESSED | U_PLUGIN_HANDLER_GO_ON);
       }
 
    U_RETURN(U_PLUGIN_HANDLER_GO_ON);
 }
 
+int UWebSocketPlugIn::handlerInit()
+{
+   U_TRACE_NO_PARAM(0, "UWebSocketPlugIn::handlerInit()")
+
+   // NB: the rings of the topic are in the shared memory, so we must ask for it before the mapping...
+
+   if (UPubSub::topic_max &&
+       UPubSub::init() == false)
+      {
+      U_WARNING("pubsub: initialization failed, the broadcast is disabled");
+
+      UPubSub::clear();
+      }
+
+   U_RETURN(U_PLUGIN_HANDLER_GO_ON);
+}
+
 int UWebSocketPlugIn::handlerRun()
 {
    U_TRACE_NO_PARAM(0, "UWebSocketPlugIn::handlerRun()")
@@ -78,6 +127,8 @@ int UWebSocketPlugIn::handlerRun()
 
    U_NEW(UString, UWebSocket::rbuffer, UString(U_CAPACITY));
 
+   if (UPubSub::isActive()) UPubSub::run(UNotifier::max_connection);
+
    UHTTP::UServletPage* usp = UHTTP::getUSP(U_CONSTANT_TO_PARAM("/modsocket"));
 
    if (usp)
@@ -86,27 +137,60 @@ int UWebSocketPlugIn::handlerRun()
 
       U_INTERNAL_ASSERT_POINTER(usp->runDynamicPage)
 
-      on_message = usp->runDynamicPage;
+      UWebSocket::on_message = usp->runDynamicPage;
+
+      // NB: the state of the frame parser is allocated for each connection, the websocket connection is managed by the event loop...
+
+      UWebSocket::preallocate(UNotifier::max_connection);
 
       U_RETURN(U_PLUGIN_HANDLER_PROCESSED | U_PLUGIN_HANDLER_GO_ON);
       }
 
-   if (command) U_RETURN(U_PLUGIN_HANDLER_PROCESSED | U_PLUGIN_HANDLER_GO_ON);
+   if (command ||
+       UPubSub::sse_uri)
+      {
+      U_RETURN(U_PLUGIN_HANDLER_PROCESSED | U_PLUGIN_HANDLER_GO_ON);
+      }
 
    U_RETURN(U_PLUGIN_HANDLER_ERROR);
 }
 
+int UWebSocketPlugIn::handlerFork()
+{
+   U_TRACE_NO_PARAM(0, "UWebSocketPlugIn::handlerFork()")
+
+   if (UPubSub::isActive()) UPubSub::start();
+
+   U_RETURN(U_PLUGIN_HANDLER_GO_ON);
+}
+
 // Connection-wide hooks
 
 int UWebSocketPlugIn::handlerRequest()
 {
    U_TRACE_NO_PARAM(0, "UWebSocketPlugIn::handlerRequest()")
 
+   if (UPubSub::sse_uri &&
+       U_HTTP_URI_EQUAL(*UPubSub::sse_uri))
+      {
+      U_RETURN(UPubSub::initSSE());
+      }
+
    if (U_http_websocket_len)
       {
+      if (UWebSocket::on_message &&
+          UServer_Base::isParallelizationChild() == false)
+         {
+         // NB: we don't block the worker, the next data on this connection are processed by UWebSocket::handlerRequest() (see UHTTP::handlerREAD())...
+
+         if (UWebSocket::initConnection() == U_PLUGIN_HANDLER_ERROR) U_RETURN(U_PLUGIN_HANDLER_ERROR);
+
+         U_RETURN(U_PLUGIN_HANDLER_FINISHED);
+         }
+
       int fdmax = 0;
       fd_set fd_set_read, read_set;
-      bool bcommand = (command && on_message == 0);
+      bool bcommand = (command && UWebSocket::on_message == 0);
 
       if (bcommand)
          {
@@ -142,7 +226,13 @@ int UWebSocketPlugIn::handlerRequest()
 
       UWebSocket::checkForInitialData(); // check if we have read more data than necessary...
 
-      if (bcommand == false) goto handle_data;
+      // NB: the frames read with the handshake must be processed now, the socket can be not readable anymore...
+
+      if (bcommand == false ||
+          UWebSocket::rbuffer->empty() == false)
+         {
+         goto handle_data;
+         }
 
 loop: read_set = fd_set_read;
 
@@ -164,12 +254,18 @@ loop: read_set = fd_set_read;
             {
 handle_data:
             if (UWebSocket::handleDataFraming(UServer_Base::csocket) == STATUS_CODE_OK &&
-                (bcommand == false ? (on_message(0), U_http_info.nResponseCode != HTTP_INTERNAL_ERROR)
+                (bcommand == false ? (UWebSocket::on_message(0), U_http_info.nResponseCode != HTTP_INTERNAL_ERROR)
                                    : UNotifier::write(UProcess::filedes[1], U_STRING_TO_PARAM(*UClientImage_Base::wbuffer))))
                {
-               UWebSocket::rbuffer->setEmpty();
+               UClientImage_Base::wbuffer->setEmpty();
+
+               // NB: the data after the message are kept in UWebSocket::rbuffer...
 
-               if (bcommand == false) goto handle_data;
+               if (bcommand == false ||
+                   UWebSocket::rbuffer->empty() == false)
+                  {
+                  goto handle_data;
+                  }
 
                goto loop;
                }
@@ -195,7 +291,7 @@ handle_data:
 #if defined(U_STDCPP_ENABLE) && defined(DEBUG)
 const char* UWebSocketPlugIn::dump(bool reset) const
 {
-   *UObjectIO::os << "on_message        " << (void*)on_message << '\n'
+   *UObjectIO::os << "on_message        " << (void*)UWebSocket::on_message << '\n'
                   << "command (UCommand " << (void*)command    << ')';
 
    if (reset)
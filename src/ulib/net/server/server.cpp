@@ -16,6 +16,9 @@
 #include <ulib/db/rdb.h>
 #include <ulib/net/udpsocket.h>
 #include <ulib/utility/escape.h>
+#include <ulib/utility/metrics.h>
+#include <ulib/utility/token_bucket.h>
+#include <ulib/utility/route_matcher.h>
 #include <ulib/orm/orm_driver.h>
 #include <ulib/net/client/http.h>
 #include <ulib/dynamic/dynamic.h>
@@ -105,8 +108,11 @@ char*         UServer_Base::client_address;
 ULock*        UServer_Base::lock_user1;
 ULock*        UServer_Base::lock_user2;
 uint32_t      UServer_Base::map_size;
+uint32_t      UServer_Base::read_budget;
 uint32_t      UServer_Base::vplugin_size;
+uint32_t      UServer_Base::plugin_index = U_NOT_FOUND;
 uint32_t      UServer_Base::nClientIndex;
+uint32_t      UServer_Base::header_timeout;
 uint32_t      UServer_Base::shared_data_add;
 uint32_t      UServer_Base::client_address_len;
 uint32_t      UServer_Base::document_root_size;
@@ -132,7 +138,9 @@ USocket*      UServer_Base::socket;
 USocket*      UServer_Base::csocket;
 UProcess*     UServer_Base::proc;
 UEventFd*     UServer_Base::handler_other;
+UEventFd*     UServer_Base::handler_pubsub;
 UEventFd*     UServer_Base::handler_inotify;
+UEventFd*     UServer_Base::handler_handshake;
 UEventTime*   UServer_Base::ptime;
 const char*   UServer_Base::document_root_ptr;
 unsigned int  UServer_Base::port;
@@ -338,322 +346,150 @@ private:
    U_DISALLOW_COPY_AND_ASSIGN(UTimeoutConnection)
 };
 
-/**
- * The throttle data lets you set maximum byte rates on URLs or URL groups. You can optionally set a minimum rate too.
- * The format of the throttle data is very simple, should consist of a pattern, whitespace, and a number. The pattern
- * is a simple shell-style filename pattern, using ?*, or multiple such patterns separated by |. The numbers are byte
- * rates, specified in units of kbytes per second. If you want to set a minimum rate as well, use number-number.
- *
- * For example assuming we have a bandwith of 150 kB/s
- *
- * a) *           20-100  => limit total web usage to 2/3, but never go below 20 kB/s
- * b) *.jpg|*.gif     50  => limit images to 1/3 of our bandwith
- * c) *.mpg           20  => and movies to even less
- *
- * Throttling is implemented by checking each incoming URL filename against all of the patterns in the throttle data.
- * The server accumulates statistics on how much bandwidth each pattern has accounted for recently (via a rolling average).
- * If a URL matches a pattern that has been exceeding its specified limit, then the data returned is actually slowed down,
- * with pauses between each block. If that's not possible or if the bandwidth has gotten way larger than the limit, then
- * the server returns a special code
- */
-
-#ifdef U_THROTTLING_SUPPORT
-#  define U_THROTTLE_TIME 2 // Time between updates of the throttle table's rolling averages
-
-class U_NO_EXPORT UThrottling : public UDataStorage {
+class U_NO_EXPORT UTimeoutHeader : public UEventTime {
 public:
 
-   uint64_t bytes_since_avg;
-   uint32_t krate, min_limit, max_limit, num_sending;
-
-   // COSTRUTTORE
-
-   UThrottling()
+   UTimeoutHeader() : UEventTime(1L, 0L)
       {
-      U_TRACE_REGISTER_OBJECT(0, UThrottling, "", 0)
-
-      (void) memset(&bytes_since_avg, 0, sizeof(uint32_t) * 6);
+      U_TRACE_REGISTER_OBJECT(0, UTimeoutHeader, "", 0)
       }
 
-   ~UThrottling()
+   virtual ~UTimeoutHeader() U_DECL_FINAL
       {
-      U_TRACE_UNREGISTER_OBJECT(0, UThrottling)
-
-      if (UServer_Base::db_throttling)
-         {
-                UServer_Base::db_throttling->close();
-         delete UServer_Base::db_throttling;
-         }
+      U_TRACE_UNREGISTER_OBJECT(0, UTimeoutHeader)
       }
 
-   // define method VIRTUAL of class UDataStorage
+   // define method VIRTUAL of class UEventTime
 
-   virtual char* toBuffer()
+   virtual int handlerTime() U_DECL_FINAL
       {
-      U_TRACE_NO_PARAM(0, "UThrottling::toBuffer()")
-
-      U_CHECK_MEMORY
-
-      U_INTERNAL_ASSERT_EQUALS(u_buffer_len, 0)
-
-      U_MEMCPY(u_buffer, &bytes_since_avg, u_buffer_len = sizeof(uint32_t) * 6);
+      U_TRACE_NO_PARAM(0, "UTimeoutHeader::handlerTime()")
 
-      U_INTERNAL_ASSERT_MINOR(u_buffer_len, U_BUFFER_SIZE)
-
-      buffer_len = u_buffer_len;
-
-      U_RETURN(u_buffer);
-      }
+      // NB: unlike the request timeout this is not postponed by the events of the other connections, so a client that trickle the request header (slowloris) can't keep alive his slot...
 
-   virtual void fromData(const char* ptr, uint32_t len)
-      {
-      U_TRACE(0, "UThrottling::fromData(%.*S,%u)", len, ptr, len)
+      U_gettimeofday // NB: optimization if it is enough a time resolution of one second...
 
-      U_CHECK_MEMORY
+      U_INTERNAL_DUMP("UNotifier::num_connection = %u UNotifier::min_connection = %u", UNotifier::num_connection, UNotifier::min_connection)
 
-      U_INTERNAL_ASSERT_POINTER(ptr)
-      U_INTERNAL_ASSERT(len >= sizeof(uint32_t) * 6)
+      if (UNotifier::num_connection > UNotifier::min_connection) UNotifier::callForAllEntryDynamic(UServer_Base::handlerTimeoutHeader);
 
-      U_MEMCPY(&bytes_since_avg, ptr, sizeof(uint32_t) * 6);
+      U_RETURN(0); // monitoring
       }
 
 #if defined(DEBUG) && defined(U_STDCPP_ENABLE)
-   const char* dump(bool breset) const { return ""; }
+   const char* dump(bool _reset) const { return UEventTime::dump(_reset); }
 #endif
 
 private:
-   U_DISALLOW_COPY_AND_ASSIGN(UThrottling)
+   U_DISALLOW_COPY_AND_ASSIGN(UTimeoutHeader)
 };
 
-class U_NO_EXPORT UBandWidthThrottling : public UEventTime {
-public:
-
-   UBandWidthThrottling() : UEventTime(U_THROTTLE_TIME, 0L)
-      {
-      U_TRACE_REGISTER_OBJECT(0, UBandWidthThrottling, "", 0)
-      }
-
-   virtual ~UBandWidthThrottling() U_DECL_FINAL
-      {
-      U_TRACE_UNREGISTER_OBJECT(0, UBandWidthThrottling)
-      }
-
-   // SERVICES
-
-   static int clearThrottling(UStringRep* key, UStringRep* data)
-      {
-      U_TRACE(0, "UBandWidthThrottling::clearThrottling(%p,%p)", key, data)
-
-      if (key)
-         {
-         if (UServices::dosMatchWithOR(U_STRING_TO_PARAM(UServer_Base::pClientImage->uri), U_STRING_TO_PARAM(*key))) U_RETURN(4); // NB: call us later (after set record value from db)
-
-         U_RETURN(1);
-         }
-
-      U_INTERNAL_DUMP("krate = %u min_limit = %u max_limit = %u num_sending = %u bytes_since_avg = %llu", UServer_Base::throttling_rec->krate, UServer_Base::throttling_rec->min_limit,
-                        UServer_Base::throttling_rec->max_limit, UServer_Base::throttling_rec->num_sending, UServer_Base::throttling_rec->bytes_since_avg)
-
-      U_INTERNAL_ASSERT_MAJOR(UServer_Base::throttling_rec->num_sending, 0)
+/**
+ * The throttle data lets you set maximum byte rates on URLs or URL groups. You can optionally set a minimum rate too.
+ * The format of the throttle data is very simple, should consist of a pattern, whitespace, and a number. The pattern
+ * is a simple shell-style filename pattern, using ?*, or multiple such patterns separated by |. The numbers are byte
+ * rates, specified in units of kbytes per second. If you want to set a minimum rate as well, use number-number.
+ *
+ * For example assuming we have a bandwith of 150 kB/s
+ *
+ * a) *           20-100  => limit total web usage to 2/3, but never go below 20 kB/s
+ * b) *.jpg|*.gif     50  => limit images to 1/3 of our bandwith
+ * c) *.mpg           20  => and movies to even less
+ *
+ * Throttling is implemented with token buckets in the shared memory (see UTokenBucket): every pattern of the throttle data has a
+ * bucket refilled at the max rate (with a burst of one second) that is charged with the bytes sent by all the connections serving
+ * a matching URL. If the bucket is in debt the data returned is actually slowed down, with pauses between each block. If the debt
+ * is way larger than the limit, or there isn't room for the minimum rate of one more connection, the server returns a special code.
+ * In the same way a table of buckets keyed by the client address limits the rate of the requests and of the bytes for each client.
+ * Every decision is O(1) with atomic operations, without lock or I/O
+ */
 
-      UServer_Base::throttling_rec->num_sending--;
+#ifdef U_THROTTLING_SUPPORT
+#  define U_THROTTLE_RULE_MAX 32 // NB: the rules matched by a request are a bitmask (uint32_t)...
+#  define U_THROTTLE_MAX_DEBT  2 // (second) if we're way over the limit, don't even start...
 
-      (void) UServer_Base::db_throttling->putDataStorage();
+class U_NO_EXPORT UThrottling {
+public:
 
-      // NB: db can have different pattern matching the same url...
+   typedef struct rule {
+      uint64_t tat;                  // the bucket of the byte rate (see UTokenBucket)
+      uint32_t max_limit, min_limit; // kB/s
+      uint32_t num_sending;          // connections that are serving a matching URL
+   } rule;
 
-      U_RETURN(1);
-      }
+   static rule* vrule;
+   static UTokenBucket::slot* vclient; // tat[0] => request rate, tat[1] => byte rate
+   static uint32_t num_rule;
+   static URouteMatcher* matcher;
 
-   static int checkThrottling(UStringRep* key, UStringRep* data)
+   static UTokenBucket::slot* getClient(uint64_t key, uint64_t t)
       {
-      U_TRACE(0, "UBandWidthThrottling::checkThrottling(%p,%p)", key, data)
-
-      if (key)
-         {
-         if (UServices::dosMatchWithOR(U_HTTP_URI_TO_PARAM, U_STRING_TO_PARAM(*key))) U_RETURN(4); // NB: call us later (after set record value from db)...
-
-         U_RETURN(1);
-         }
-
-      U_INTERNAL_DUMP("krate = %u min_limit = %u max_limit = %u num_sending = %u bytes_since_avg = %llu", UServer_Base::throttling_rec->krate, UServer_Base::throttling_rec->min_limit,
-                        UServer_Base::throttling_rec->max_limit, UServer_Base::throttling_rec->num_sending, UServer_Base::throttling_rec->bytes_since_avg)
-
-      if ( UServer_Base::throttling_rec->krate &&
-          (UServer_Base::throttling_rec->krate > (UServer_Base::throttling_rec->max_limit * 2) || // if we're way over the limit, don't even start...
-           UServer_Base::throttling_rec->krate <  UServer_Base::throttling_rec->min_limit))       // ...also don't start if we're under the minimum
-         {
-         UServer_Base::throttling_chk = false;
-
-         U_RETURN(0); // stop
-         }
-      
-      UServer_Base::throttling_rec->num_sending++;
-
-      (void) UServer_Base::db_throttling->putDataStorage();
-
-      uint32_t l = UServer_Base::throttling_rec->max_limit / UServer_Base::throttling_rec->num_sending;
-
-      UServer_Base::pClientImage->max_limit = (UServer_Base::pClientImage->max_limit == U_NOT_FOUND ?       l
-                                                                                                    : U_min(l, UServer_Base::pClientImage->max_limit));
-      l = UServer_Base::throttling_rec->min_limit;
+      U_TRACE(0, "UThrottling::getClient(%llu,%llu)", key, t)
 
-      UServer_Base::pClientImage->min_limit = (UServer_Base::pClientImage->min_limit == U_NOT_FOUND ?       l
-                                                                                                    : U_max(l, UServer_Base::pClientImage->min_limit));
+      UTokenBucket::slot* s = UTokenBucket::find(vclient, UServer_Base::throttling_client_max, key, t);
 
-      U_INTERNAL_DUMP("UServer_Base::pClientImage->min_limit = %u UServer_Base::pClientImage->max_limit = %u",
-                       UServer_Base::pClientImage->min_limit,     UServer_Base::pClientImage->max_limit)
-
-      // NB: db can have different pattern matching the same url...
-
-      U_RETURN(1);
+      U_RETURN_POINTER(s, UTokenBucket::slot);
       }
 
-   static int updateThrottling(UStringRep* key, UStringRep* data)
-      {
-      U_TRACE(0, "UBandWidthThrottling::updateThrottling(%p,%p)", key, data)
-
-      if (key) U_RETURN(4); // NB: call us later (after set record value from db)...
+   // NB: the max bytes for each sendfile(), so that the pause between the blocks is short (1/8 of second at the lowest rate)...
 
-      U_INTERNAL_DUMP("krate = %u min_limit = %u max_limit = %u num_sending = %u bytes_since_avg = %llu", UServer_Base::throttling_rec->krate, UServer_Base::throttling_rec->min_limit,
-                        UServer_Base::throttling_rec->max_limit, UServer_Base::throttling_rec->num_sending, UServer_Base::throttling_rec->bytes_since_avg)
-
-      UServer_Base::throttling_rec->krate = ( 2 * UServer_Base::throttling_rec->krate + UServer_Base::throttling_rec->bytes_since_avg / (U_THROTTLE_TIME * 1024ULL)) / 3;
-                                                                                        UServer_Base::throttling_rec->bytes_since_avg = 0;
-
-      U_INTERNAL_DUMP("krate = %u", UServer_Base::throttling_rec->krate)
+   static uint32_t getChunk(uint32_t mask)
+      {
+      U_TRACE(0, "UThrottling::getChunk(%u)", mask)
 
-      (void) UServer_Base::db_throttling->putDataStorage();
+      uint32_t klimit = UServer_Base::throttling_client_krate;
 
-#  ifndef U_LOG_DISABLE
-      if (UServer_Base::isLog())
+      for (uint32_t i = 0; mask; ++i, mask >>= 1)
          {
-         if (UServer_Base::throttling_rec->num_sending)
+         if ((mask & 1) != 0 &&
+             (klimit == 0 || vrule[i].max_limit < klimit))
             {
-            if (UServer_Base::throttling_rec->krate > UServer_Base::throttling_rec->max_limit)
-               {
-               ULog::log(U_CONSTANT_TO_PARAM("throttle %V: krate %u %sexceeding limit %u; %u sending"), UServer_Base::db_throttling->getKeyID().rep,
-                            UServer_Base::throttling_rec->krate,
-                           (UServer_Base::throttling_rec->krate > UServer_Base::throttling_rec->max_limit * 2  ? "greatly " : ""),
-                            UServer_Base::throttling_rec->max_limit, UServer_Base::throttling_rec->num_sending);
-               }
-
-            if (UServer_Base::throttling_rec->krate < UServer_Base::throttling_rec->min_limit)
-               {
-               ULog::log(U_CONSTANT_TO_PARAM("throttle %V: krate %u lower than minimum %u; %u sending"), UServer_Base::db_throttling->getKeyID().rep,
-                            UServer_Base::throttling_rec->krate,
-                            UServer_Base::throttling_rec->min_limit, UServer_Base::throttling_rec->num_sending);
-               }
+            klimit = vrule[i].max_limit;
             }
          }
-#  endif
-
-      U_RETURN(1);
-      }
-
-   static int updateSending(UStringRep* key, UStringRep* data)
-      {
-      U_TRACE(0, "UBandWidthThrottling::updateSending(%p,%p)", key, data)
-
-      if (key)
-         {
-         if (UServices::dosMatchWithOR(U_HTTP_URI_TO_PARAM, U_STRING_TO_PARAM(*key))) U_RETURN(4); // NB: call us later (after set record value from db)...
-
-         U_RETURN(1);
-         }
-
-      U_INTERNAL_DUMP("krate = %u min_limit = %u max_limit = %u num_sending = %u bytes_since_avg = %llu", UServer_Base::throttling_rec->krate, UServer_Base::throttling_rec->min_limit,
-                        UServer_Base::throttling_rec->max_limit, UServer_Base::throttling_rec->num_sending, UServer_Base::throttling_rec->bytes_since_avg)
-
-      UServer_Base::throttling_rec->bytes_since_avg += UServer_Base::pClientImage->bytes_sent;
-
-      (void) UServer_Base::db_throttling->putDataStorage();
 
-      // NB: db can have different pattern matching the same url...
+      if (klimit == 0) U_RETURN(U_NOT_FOUND);
 
-      U_RETURN(1);
+      U_RETURN(U_max(klimit * 128, 4096));
       }
 
-   static int updateSendingRate(UStringRep* key, UStringRep* data)
-      {
-      U_TRACE(0, "UBandWidthThrottling::updateSendingRate(%p,%p)", key, data)
-
-      if (key)
-         {
-         if (UServices::dosMatchWithOR(UServer_Base::pClientImage->uri, U_STRING_TO_PARAM(*key))) U_RETURN(4); // NB: call us later (after set record value from db)...
-
-         U_RETURN(1);
-         }
-
-      U_INTERNAL_DUMP("krate = %u min_limit = %u max_limit = %u num_sending = %u bytes_since_avg = %llu", UServer_Base::throttling_rec->krate, UServer_Base::throttling_rec->min_limit,
-                        UServer_Base::throttling_rec->max_limit, UServer_Base::throttling_rec->num_sending, UServer_Base::throttling_rec->bytes_since_avg)
-
-      uint32_t l = UServer_Base::throttling_rec->max_limit / UServer_Base::throttling_rec->num_sending;
+   // NB: charge the bytes to the buckets of the rules and of the client, return the nanosecond to wait to get back on schedule...
 
-      UServer_Base::pClientImage->max_limit = (UServer_Base::pClientImage->max_limit == U_NOT_FOUND
-                                                   ?       l
-                                                   : U_min(l, UServer_Base::pClientImage->max_limit));
-
-      U_RETURN(1);
-      }
-
-   static bool updateSendingRate(void* cimg)
+   static uint64_t charge(uint32_t mask, uint64_t key, uint64_t bytes, uint64_t t)
       {
-      U_TRACE(0, "UBandWidthThrottling::updateSendingRate(%p)", cimg)
-
-      U_INTERNAL_ASSERT_POINTER(cimg)
+      U_TRACE(0, "UThrottling::charge(%u,%llu,%llu,%llu)", mask, key, bytes, t)
 
-      U_INTERNAL_DUMP("pthis = %p handler_other = %p handler_inotify = %p ", UServer_Base::pthis, UServer_Base::handler_other, UServer_Base::handler_inotify)
+      uint64_t w, wait = 0, rate;
 
-      if (cimg == UServer_Base::pthis         ||
-          cimg == UServer_Base::handler_other ||
-          cimg == UServer_Base::handler_inotify)
+      for (uint32_t i = 0; mask; ++i, mask >>= 1)
          {
-         U_RETURN(false);
-         }
-
-      U_INTERNAL_ASSERT(((UClientImage_Base*)cimg)->socket->isOpen())
-
-      UServer_Base::pClientImage = ((UClientImage_Base*)cimg);
-
-      U_INTERNAL_DUMP("UServer_Base::pClientImage->min_limit = %u UServer_Base::pClientImage->max_limit = %u",
-                       UServer_Base::pClientImage->min_limit,     UServer_Base::pClientImage->max_limit)
-
-      UServer_Base::pClientImage->max_limit = U_NOT_FOUND;
-
-      UServer_Base::db_throttling->callForAllEntry(updateSendingRate);
-
-      U_RETURN(false);
-      }
-
-   // define method VIRTUAL of class UEventTime
+         if ((mask & 1) != 0)
+            {
+            rate = vrule[i].max_limit * 1024ULL;
+            w    = UTokenBucket::consume(&(vrule[i].tat), bytes, rate, rate, t, true);
 
-   virtual int handlerTime() U_DECL_FINAL
-      {
-      U_TRACE_NO_PARAM(0, "UBandWidthThrottling::handlerTime()")
+            if (wait < w) wait = w;
+            }
+         }
 
-      if (UServer_Base::db_throttling)
+      if (UServer_Base::throttling_client_krate)
          {
-         // Update the average sending rate for each throttle. This is only used when new connections start up
-
-         UServer_Base::db_throttling->callForAllEntry(updateThrottling);
-
-         // Now update the sending rate on all the currently-sending connections, redistributing it evenly
+         UTokenBucket::slot* s = getClient(key, t);
 
-         U_INTERNAL_DUMP("UNotifier::num_connection = %u UNotifier::min_connection = %u", UNotifier::num_connection, UNotifier::min_connection)
+         if (s)
+            {
+            rate = UServer_Base::throttling_client_krate * 1024ULL;
+            w    = UTokenBucket::consume(s->tat+1, bytes, rate, rate, t, true);
 
-         if (UNotifier::num_connection > UNotifier::min_connection) UNotifier::callForAllEntryDynamic(updateSendingRate);
+            if (wait < w) wait = w;
+            }
          }
 
-      U_RETURN(0); // monitoring
+      U_RETURN(wait);
       }
 
-#if defined(DEBUG) && defined(U_STDCPP_ENABLE)
-   const char* dump(bool _reset) const { return UEventTime::dump(_reset); }
-#endif
-
 private:
-   U_DISALLOW_COPY_AND_ASSIGN(UBandWidthThrottling)
+   U_DISALLOW_COPY_AND_ASSIGN(UThrottling)
 };
 
 class U_NO_EXPORT UClientThrottling : public UEventTime {
@@ -693,23 +529,40 @@ private:
    U_DISALLOW_COPY_AND_ASSIGN(UClientThrottling)
 };
 
-bool                              UServer_Base::throttling_chk;
-UString*                          UServer_Base::throttling_mask;
-UThrottling*                      UServer_Base::throttling_rec;
-URDBObjectHandler<UDataStorage*>* UServer_Base::db_throttling;
+UString*            UServer_Base::throttling_mask;
+uint32_t            UServer_Base::throttling_client_max;
+uint32_t            UServer_Base::throttling_client_rate;
+uint32_t            UServer_Base::throttling_client_krate;
+uint32_t            UThrottling::num_rule;
+URouteMatcher*      UThrottling::matcher;
+UThrottling::rule*  UThrottling::vrule;
+UTokenBucket::slot* UThrottling::vclient;
+
+U_NO_EXPORT uint64_t UServer_Base::getThrottlingKey(UClientImage_Base* pclient)
+{
+   U_TRACE(0, "UServer_Base::getThrottlingKey(%p)", pclient)
+
+   // NB: the key of the table of client is the IP address (IPv6 folded in 64 bit)...
+
+   UIPAddress& addr = pclient->socket->cRemoteAddress;
+
+   uint64_t key = (addr.iAddressLength <= 4 ? (uint64_t)addr.pcAddress.i | (1ULL << 63)
+                                            : u_get_unalignedp64(addr.pcAddress.p) ^ (u_get_unalignedp64(addr.pcAddress.p+8) * 0x9E3779B97F4A7C15ULL));
+
+   if (key == 0) key = 1;
+
+   U_RETURN(key);
+}
 
 void UServer_Base::initThrottlingClient()
 {
    U_TRACE_NO_PARAM(0, "UServer_Base::initThrottlingClient()")
 
-   if (db_throttling)
+   if (isThrottling())
       {
-      pClientImage->uri.clear();
-
-      pClientImage->min_limit  =
-      pClientImage->max_limit  = U_NOT_FOUND;
-      pClientImage->bytes_sent =
-      pClientImage->started_at = 0;
+      pClientImage->bytes_sent         = 0;
+      pClientImage->throttling_rule    =
+      pClientImage->throttling_sending = 0;
       }
 }
 
@@ -717,155 +570,243 @@ void UServer_Base::initThrottlingServer()
 {
    U_TRACE_NO_PARAM(0, "UServer_Base::initThrottlingServer()")
 
-   U_INTERNAL_ASSERT(*throttling_mask)
-   U_INTERNAL_ASSERT_EQUALS(db_throttling, 0)
+   U_INTERNAL_ASSERT(isThrottling())
+   U_INTERNAL_ASSERT_EQUALS(UThrottling::vrule, 0)
 
-   if (bssl == false) // NB: we can't use throttling with SSL...
+   if (bssl) // NB: we can't use throttling with SSL...
       {
-      U_NEW(UThrottling, throttling_rec, UThrottling);
-      U_NEW(URDBObjectHandler<UDataStorage*>, db_throttling, URDBObjectHandler<UDataStorage*>(U_STRING_FROM_CONSTANT("../db/BandWidthThrottling"), -1, throttling_rec));
+      U_SRV_LOG("WARNING: Sorry, I can't enable throttling with SSL");
 
-      if (isPreForked())
+      if (throttling_mask)
          {
-         U_INTERNAL_ASSERT_POINTER(ptr_shared_data)
-         U_INTERNAL_ASSERT_DIFFERS(ptr_shared_data, MAP_FAILED)
-
-         db_throttling->setShared(U_SRV_LOCK_THROTTLING, U_SRV_SPINLOCK_THROTTLING);
+         delete throttling_mask;
+                throttling_mask = 0;
          }
 
-      bool result = db_throttling->open(32 * 1024, false, true); // NB: we don't want truncate (we have only the journal)...
+      throttling_client_rate = throttling_client_krate = 0;
 
-      U_SRV_LOG("%sdb initialization of BandWidthThrottling %s: size(%u)", (result ? "" : "WARNING: "), (result ? "success" : "failed"), db_throttling->size());
+      return;
+      }
 
-      if (result == false)
-         {
-         delete db_throttling;
-                db_throttling = 0;
-         }
-      else
-         {
-         char* ptr;
-         UString pattern, number;
-         UVector<UString> vec(*throttling_mask);
+   uint32_t size = 0;
 
-         min_size_for_sendfile = 4096; // 4k
+   if (throttling_mask)
+      {
+      UVector<UString> vec(*throttling_mask);
 
-         db_throttling->reset(); // Initialize the db to contain no entries
+      U_NEW(URouteMatcher, UThrottling::matcher, URouteMatcher);
 
-         for (int32_t i = 0, n = vec.size(); i < n; i += 2)
+      for (uint32_t i = 0, n = vec.size(); i < n; i += 2)
+         {
+         if (UThrottling::num_rule == U_THROTTLE_RULE_MAX)
             {
-            pattern = vec[i];
-             number = vec[i+1];
-
-                                                                                      throttling_rec->max_limit = ::strtol(number.data(), &ptr, 10);
-            if (ptr[0] == '-') throttling_rec->min_limit = throttling_rec->max_limit, throttling_rec->max_limit = ::strtol(        ptr+1,    0, 10);
+            U_SRV_LOG("WARNING: throttling: too many pattern, only the first %u are used", U_THROTTLE_RULE_MAX);
 
-            (void) db_throttling->insertDataStorage(pattern, RDB_INSERT);
+            break;
             }
 
-#     ifdef DEBUG
-         db_throttling->resetKeyID(); // NB: to avoid DEAD OF SOURCE STRING WITH CHILD ALIVE...
-#     endif
+         (void) UThrottling::matcher->addMask(vec[i]);
+
+         ++UThrottling::num_rule;
          }
+
+      size += UThrottling::num_rule * sizeof(UThrottling::rule);
       }
+
+   if (throttling_client_rate ||
+       throttling_client_krate)
+      {
+      throttling_client_max = (throttling_client_max <= U_TOKEN_BUCKET_PROBE ? 4096 : 1U << (32 - __builtin_clz(throttling_client_max - 1)));
+
+      size += throttling_client_max * sizeof(UTokenBucket::slot);
+      }
+
+   U_INTERNAL_DUMP("num_rule = %u throttling_client_max = %u size = %u", UThrottling::num_rule, throttling_client_max, size)
+
+   // NB: +8 for the alignment of the word updated with CAS (see runThrottlingServer())...
+
+   UThrottling::vrule = (UThrottling::rule*) getOffsetToDataShare(size + 8);
 }
 
-void UServer_Base::clearThrottling()
+void UServer_Base::runThrottlingServer()
 {
-   U_TRACE_NO_PARAM(0, "UServer_Base::clearThrottling()")
+   U_TRACE_NO_PARAM(0, "UServer_Base::runThrottlingServer()")
+
+   U_INTERNAL_ASSERT(isThrottling())
+
+   char* ptr = (char*) getPointerToDataShare(UThrottling::vrule);
+
+   ptr = (char*)(((ptrdiff_t)ptr + 7) & ~7L);
+
+   UThrottling::vrule   = (UThrottling::rule*) ptr;
+   UThrottling::vclient = (throttling_client_max ? (UTokenBucket::slot*)(UThrottling::vrule + UThrottling::num_rule) : 0);
 
-   U_INTERNAL_ASSERT(pClientImage)
-   U_INTERNAL_ASSERT(pClientImage->uri)
-   U_INTERNAL_ASSERT_POINTER(db_throttling)
+   if (UThrottling::num_rule)
+      {
+      char* end;
+      UString number;
+      UThrottling::rule* r;
+      UVector<UString> vec(*throttling_mask);
+
+      for (uint32_t i = 0; i < UThrottling::num_rule; ++i)
+         {
+         r      = UThrottling::vrule + i;
+         number = vec[i*2+1];
+
+                              r->max_limit = ::strtol(number.data(), &end, 10);
+         if (end[0] == '-')   r->min_limit = r->max_limit, r->max_limit = ::strtol(end+1, 0, 10);
+         if (r->max_limit == 0) r->max_limit = 1;
 
-   U_INTERNAL_DUMP("pClientImage->uri = %V", pClientImage->uri.rep)
+         U_INTERNAL_DUMP("rule[%u] = %V max_limit = %u min_limit = %u", i, vec[i*2].rep, r->max_limit, r->min_limit)
+         }
+      }
 
-   db_throttling->callForAllEntry(UBandWidthThrottling::clearThrottling);
+   U_SRV_LOG("throttling: %u pattern, %u slot for the client (max %u request/s, %u kB/s)", UThrottling::num_rule, throttling_client_max, throttling_client_rate, throttling_client_krate);
 }
 
-bool UServer_Base::checkThrottling()
+void UServer_Base::clearThrottling()
 {
-   U_TRACE_NO_PARAM(0, "UServer_Base::checkThrottling()")
+   U_TRACE_NO_PARAM(0, "UServer_Base::clearThrottling()")
 
-   if (db_throttling)
-      {
-      throttling_chk = true;
+   U_INTERNAL_ASSERT(isThrottling())
+
+   U_INTERNAL_DUMP("pClientImage->throttling_sending = %u pClientImage->bytes_sent = %llu", pClientImage->throttling_sending, pClientImage->bytes_sent)
 
-      pClientImage->max_limit =
-      pClientImage->min_limit = U_NOT_FOUND;
+   uint32_t i, mask = pClientImage->throttling_sending;
 
-      db_throttling->callForAllEntry(UBandWidthThrottling::checkThrottling);
+   for (i = 0; mask; ++i, mask >>= 1)
+      {
+      if ((mask & 1) != 0) (void) __sync_sub_and_fetch(&(UThrottling::vrule[i].num_sending), 1);
+      }
 
-      if (throttling_chk == false) U_RETURN(false);
+   pClientImage->throttling_sending = 0;
 
-      (void) pClientImage->uri.replace(U_HTTP_URI_TO_PARAM);
+   // NB: the response is already written, so we charge the bytes without wait...
+
+   if (pClientImage->bytes_sent &&
+       (pClientImage->throttling_rule || throttling_client_krate))
+      {
+      (void) UThrottling::charge(pClientImage->throttling_rule, getThrottlingKey(pClientImage), pClientImage->bytes_sent, UTokenBucket::now());
       }
 
-   U_RETURN(true);
+   pClientImage->bytes_sent = 0;
 }
 
-bool UServer_Base::checkThrottlingBeforeSend(bool bwrite)
+int UServer_Base::checkThrottling(bool bget)
 {
-   U_TRACE(0, "UServer_Base::checkThrottlingBeforeSend(%b)", bwrite)
+   U_TRACE(0, "UServer_Base::checkThrottling(%b)", bget)
 
-   if (db_throttling)
+   U_INTERNAL_ASSERT(isThrottling())
+
+   if (pClientImage->throttling_sending) clearThrottling();
+
+   uint64_t t = UTokenBucket::now();
+
+   pClientImage->throttling_rule = 0;
+
+   if (throttling_client_rate)
       {
-      U_ASSERT(pClientImage->uri.equal(U_HTTP_URI_TO_PARAM))
+      // NB: if the table of client is full we don't limit the client...
 
-      U_INTERNAL_DUMP("pClientImage->max_limit = %u pClientImage->bytes_sent = %llu",
-                       pClientImage->max_limit,     pClientImage->bytes_sent)
+      UTokenBucket::slot* s = UThrottling::getClient(getThrottlingKey(pClientImage), t);
 
-      if (pClientImage->max_limit != U_NOT_FOUND)
+      if (s &&
+          UTokenBucket::consume(s->tat, 1, throttling_client_rate, throttling_client_rate, t))
          {
-         U_gettimeofday // NB: optimization if it is enough a time resolution of one second...
+         U_SRV_LOG_WITH_ADDR("throttling: too many requests (max %u for second) from", throttling_client_rate);
 
-         if (bwrite == false)
-            {
-            U_INTERNAL_ASSERT_EQUALS(pClientImage->started_at, 0)
-            U_ASSERT(pClientImage->uri.equal(U_HTTP_URI_TO_PARAM))
+         U_RETURN(HTTP_TOO_MANY_REQUESTS);
+         }
+      }
 
-            U_INTERNAL_DUMP("pClientImage->bytes_sent = %llu UClientImage_Base::ncount = %u", pClientImage->bytes_sent, UClientImage_Base::ncount)
+   if (bget &&
+       UThrottling::num_rule)
+      {
+      UThrottling::rule* r;
+      uint32_t i, mask = 0;
 
-            pClientImage->started_at = u_now->tv_sec;
+      for (i = UThrottling::matcher->match(U_HTTP_URI_TO_PARAM); i != U_NOT_FOUND; i = UThrottling::matcher->match(U_HTTP_URI_TO_PARAM, i+1))
+         {
+         r = UThrottling::vrule + i;
 
-            pClientImage->setPendingSendfile();
+         U_INTERNAL_DUMP("rule[%u]: max_limit = %u min_limit = %u num_sending = %u debt = %llu", i, r->max_limit, r->min_limit, r->num_sending, UTokenBucket::getDebt(&(r->tat), t))
 
-            db_throttling->callForAllEntry(UBandWidthThrottling::updateSending);
+         if (UTokenBucket::getDebt(&(r->tat), t) > (U_THROTTLE_MAX_DEBT * 1000000000ULL) || // if we're way over the limit, don't even start...
+             (r->min_limit &&
+              (r->num_sending + 1) * r->min_limit > r->max_limit))                         // ...also don't start if we can't give the minimum
+            {
+            U_SRV_LOG_WITH_ADDR("throttling: pattern %u exceeding limit %u kB/s (min %u, %u sending) for", i, r->max_limit, r->min_limit, r->num_sending);
 
-            U_RETURN(false);
+            U_RETURN(HTTP_UNAVAILABLE);
             }
 
-         // check if we're sending too fast
+         mask |= 1U << i; // NB: we can have different pattern matching the same url...
+         }
 
-         uint32_t elapsed     = u_now->tv_sec - pClientImage->started_at,
-                  kbytes_sent = pClientImage->bytes_sent / 1024ULL,
-                  krate       = (elapsed > 1 ? kbytes_sent / elapsed : kbytes_sent);
+      pClientImage->throttling_rule    =
+      pClientImage->throttling_sending = mask;
 
-         U_INTERNAL_DUMP("krate = %u", krate)
+      for (i = 0; mask; ++i, mask >>= 1)
+         {
+         if ((mask & 1) != 0) (void) __sync_add_and_fetch(&(UThrottling::vrule[i].num_sending), 1);
+         }
+      }
+
+   U_RETURN(0);
+}
+
+uint32_t UServer_Base::checkThrottlingBeforeSend(UClientImage_Base* pclient, bool bwrite)
+{
+   U_TRACE(0, "UServer_Base::checkThrottlingBeforeSend(%p,%b)", pclient, bwrite)
 
-         if (krate > pClientImage->max_limit)
+   if (isThrottling())
+      {
+      U_INTERNAL_DUMP("pclient->throttling_rule = %u pclient->bytes_sent = %llu", pclient->throttling_rule, pclient->bytes_sent)
+
+      if (pclient->throttling_rule ||
+          throttling_client_krate)
+         {
+         if (bwrite == false)
             {
-            // how long should we wait to get back on schedule? If less than a second (integer math rounding), use 1/2 second
+            // NB: the data are sent with pauses between each block, so we wait for the socket to be writable...
+
+            pclient->prepareForSendfile();
 
-            time_t coast = kbytes_sent / pClientImage->max_limit - elapsed;
+            U_RETURN(0);
+            }
+
+         // check if we're sending too fast
 
-            // set up the wakeup timer
+         uint64_t wait = UThrottling::charge(pclient->throttling_rule, getThrottlingKey(pclient), pclient->bytes_sent, UTokenBucket::now());
+
+         pclient->bytes_sent = 0;
+
+         U_INTERNAL_DUMP("wait = %llu", wait)
+
+         if (wait)
+            {
+            // set up the wakeup timer to get back on schedule
 
             UClientThrottling* pc;
 
-            U_NEW(UClientThrottling, pc, UClientThrottling(pClientImage, coast, coast ? 0 : U_SECOND / 2L));
+            U_NEW(UClientThrottling, pc, UClientThrottling(pclient, wait / 1000000000ULL, (wait % 1000000000ULL) / 1000ULL));
 
             UTimer::insert(pc);
 
-            U_RETURN(false);
+            U_RETURN(0);
             }
+
+         uint32_t chunk = UThrottling::getChunk(pclient->throttling_rule);
+
+         U_RETURN(chunk);
          }
       }
 
-   U_RETURN(true);
+   U_RETURN(U_NOT_FOUND);
 }
 #endif
 
+
 #ifdef ENABLE_THREAD
 #  include <ulib/thread.h>
 
@@ -1110,6 +1051,254 @@ private:
 ULock*   UServer_Base::lock_ocsp_staple;
 UThread* UServer_Base::pthread_ocsp;
 #  endif
+
+#  ifdef U_SSL_HANDSHAKE_OFFLOAD
+#     include <sys/eventfd.h>
+
+/**
+ * TLS handshake offload: the crypto of the handshake (RSA/ECDHE) is done by a small pool of helper thread (SSL_HANDSHAKE_THREAD), so
+ * a storm of new connection (ex. after a deploy) don't stall the event loop of the worker that serve the established keep-alive connection.
+ * The accepted connection is passed to the helpers by a queue, and the completion is signalled back to UNotifier by an eventfd: then the
+ * request is read and the connection is registered as usual...
+ */
+
+class U_NO_EXPORT USSLHandshake : public UEventFd {
+public:
+
+   // Check for memory error
+   U_MEMORY_TEST
+
+   // Allocator e Deallocator
+   U_MEMORY_ALLOCATOR
+   U_MEMORY_DEALLOCATOR
+
+   USSLHandshake(uint32_t n)
+      {
+      U_TRACE_REGISTER_OBJECT(0, USSLHandshake, "%u", n)
+
+      num_thread = n;
+      size       = head = tail = done_len = nexit = 0;
+      job        = done = done_swap = 0;
+      vth        = 0;
+      bstop      = false;
+
+      UEventFd::op_mask &= ~EPOLLRDHUP;
+      }
+
+   virtual ~USSLHandshake() U_DECL_FINAL
+      {
+      U_TRACE_UNREGISTER_OBJECT(0, USSLHandshake)
+      }
+
+   void start(); // NB: we are after the fork...
+   void  stop();
+
+   void push(UClientImage_Base* cimg)
+      {
+      U_TRACE(0, "USSLHandshake::push(%p)", cimg)
+
+      UThread::lock(&mutex);
+
+      job[tail] = cimg;
+          tail  = (tail + 1) % size;
+
+      UThread::unlock(&mutex);
+
+      UThread::signal(&cond);
+      }
+
+   UClientImage_Base* pop()
+      {
+      U_TRACE_NO_PARAM(0, "USSLHandshake::pop()")
+
+      UClientImage_Base* cimg = 0;
+
+      UThread::lock(&mutex);
+
+      while (head == tail &&
+             bstop == false)
+         {
+         UThread::wait(&mutex, &cond);
+         }
+
+      if (head != tail)
+         {
+         cimg = job[head];
+                head = (head + 1) % size;
+         }
+
+      UThread::unlock(&mutex);
+
+      U_RETURN_POINTER(cimg, UClientImage_Base); // NB: 0 => stop...
+      }
+
+   void quit()
+      {
+      U_TRACE_NO_PARAM(0, "USSLHandshake::quit()")
+
+      UThread::lock(&mutex);
+
+      ++nexit;
+
+      UThread::unlock(&mutex);
+
+      UThread::signalAll(&cond);
+      }
+
+   void complete(UClientImage_Base* cimg)
+      {
+      U_TRACE(1, "USSLHandshake::complete(%p)", cimg)
+
+      uint64_t one = 1;
+
+      UThread::lock(&mutex);
+
+      done[done_len++] = cimg;
+
+      UThread::unlock(&mutex);
+
+      (void) U_SYSCALL(write, "%d,%p,%u", UEventFd::fd, &one, sizeof(uint64_t));
+      }
+
+   // define method VIRTUAL of class UEventFd
+
+   virtual int handlerRead() U_DECL_FINAL;
+
+#if defined(DEBUG) && defined(U_STDCPP_ENABLE)
+   const char* dump(bool _reset) const { return UEventFd::dump(_reset); }
+#endif
+
+private:
+   UClientImage_Base** job;
+   UClientImage_Base** done;
+   UClientImage_Base** done_swap;
+   UThread** vth;
+   uint32_t num_thread, size, head, tail, done_len, nexit;
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;
+   bool bstop;
+
+   U_DISALLOW_COPY_AND_ASSIGN(USSLHandshake)
+};
+
+class U_NO_EXPORT USSLHandshakeThread : public UThread {
+public:
+
+   USSLHandshakeThread() : UThread(PTHREAD_CREATE_JOINABLE) {}
+
+   virtual void run() U_DECL_FINAL
+      {
+      U_TRACE_NO_PARAM(0, "USSLHandshakeThread::run()")
+
+      UClientImage_Base* cimg;
+      USSLHandshake* phandshake = (USSLHandshake*)UServer_Base::handler_handshake;
+
+      while ((cimg = phandshake->pop()))
+         {
+         UServer_Base::handlerHandshake(cimg);
+
+         phandshake->complete(cimg);
+         }
+
+      phandshake->quit();
+
+      // NB: we don't return from run() because UThread::threadStart() call close() that cancel the thread itself, the join is done by stop()...
+
+      U_SYSCALL_VOID(pthread_exit, "%p", 0);
+      }
+
+private:
+   U_DISALLOW_COPY_AND_ASSIGN(USSLHandshakeThread)
+};
+
+void USSLHandshake::start()
+{
+   U_TRACE_NO_PARAM(1, "USSLHandshake::start()")
+
+   U_INTERNAL_ASSERT_EQUALS(job, 0)
+   U_INTERNAL_ASSERT_MAJOR(num_thread, 0)
+   U_INTERNAL_ASSERT_MAJOR(UNotifier::max_connection, 0)
+
+   UEventFd::fd = U_SYSCALL(eventfd, "%u,%d", 0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+   if (UEventFd::fd == -1) U_ERROR("SSL: eventfd() for the handshake offload failed");
+
+   (void) U_SYSCALL(pthread_mutex_init, "%p,%p", &mutex, 0);
+   (void) U_SYSCALL(pthread_cond_init,  "%p,%p", &cond,  0);
+
+   // NB: the pending handshakes are at most one for every preallocated client image...
+
+   size      = UNotifier::max_connection+1;
+   job       = (UClientImage_Base**) UMemoryPool::_malloc(size, sizeof(UClientImage_Base*));
+   done      = (UClientImage_Base**) UMemoryPool::_malloc(size, sizeof(UClientImage_Base*));
+   done_swap = (UClientImage_Base**) UMemoryPool::_malloc(size, sizeof(UClientImage_Base*));
+   vth       = (UThread**)           UMemoryPool::_malloc(num_thread, sizeof(UThread*));
+
+   for (uint32_t i = 0; i < num_thread; ++i)
+      {
+      U_NEW(USSLHandshakeThread, vth[i], USSLHandshakeThread);
+
+      if (vth[i]->start(0) == false) U_ERROR("SSL: start of the helper thread for the handshake offload failed");
+      }
+
+   U_SRV_LOG("SSL: handshake offload activated (%u thread)", num_thread);
+}
+
+void USSLHandshake::stop()
+{
+   U_TRACE_NO_PARAM(0, "USSLHandshake::stop()")
+
+   if (vth == 0) return;
+
+   // NB: the helpers that are in the middle of a handshake finish it (it is bounded by the timeout), then all of them see the stop...
+
+   UThread::lock(&mutex);
+
+   bstop = true;
+
+   UThread::signalAll(&cond);
+
+   while (nexit < num_thread) UThread::wait(&mutex, &cond);
+
+   UThread::unlock(&mutex);
+
+   // NB: the helpers are not blocked on the mutex anymore, so the delete (pthread_cancel() + pthread_join()) is safe...
+
+   for (uint32_t i = 0; i < num_thread; ++i) delete vth[i];
+
+   UMemoryPool::_free(vth, num_thread, sizeof(UThread*));
+
+   vth = 0;
+
+   U_SRV_LOG("SSL: handshake offload stopped (%u thread joined)", num_thread);
+}
+
+int USSLHandshake::handlerRead()
+{
+   U_TRACE_NO_PARAM(1, "USSLHandshake::handlerRead()")
+
+   uint64_t value;
+
+   (void) U_SYSCALL(read, "%d,%p,%u", UEventFd::fd, &value, sizeof(uint64_t));
+
+   UThread::lock(&mutex);
+
+   uint32_t n = done_len;
+                done_len = 0;
+
+   UClientImage_Base** ptr = done;
+                             done = done_swap;
+                                    done_swap = ptr;
+
+   UThread::unlock(&mutex);
+
+   U_INTERNAL_DUMP("n = %u", n)
+
+   for (uint32_t i = 0; i < n; ++i) UServer_Base::handlerHandshakeDone(ptr[i]);
+
+   U_RETURN(U_NOTIFIER_OK);
+}
+#  endif
 #endif
 
 #ifdef U_LINUX
@@ -1226,6 +1415,8 @@ UServer_Base::~UServer_Base()
 
    UTimer::clear();
 
+   UMetrics::clear();
+
    UClientImage_Base::clear();
 
    delete socket;
@@ -1249,8 +1440,8 @@ UServer_Base::~UServer_Base()
 #endif
 
 #ifdef U_THROTTLING_SUPPORT
-   if (throttling_rec)  delete throttling_rec;
-   if (throttling_mask) delete throttling_mask;
+   if (throttling_mask)      delete throttling_mask;
+   if (UThrottling::matcher) delete UThrottling::matcher;
 #endif
 
 #ifdef U_WELCOME_SUPPORT
@@ -1520,10 +1711,14 @@ void UServer_Base::loadConfigParam()
    // ORM_DRIVER_DIR directory where there are ORM drivers to load
    //
    // REQ_TIMEOUT    timeout for request from client
+   // REQ_HEADER_TIMEOUT max time (seconds) for a client to send a complete request header, since the connection or the first byte of the request (0 => disabled)
+   // READ_BUDGET    max number of pipelined requests of a connection processed for each event, the rest are processed after the other ready connections (0 => no limit)
    // TCP_KEEP_ALIVE Specifies to active the TCP keepalive implementation in the linux kernel
    // TCP_LINGER_SET Specifies how the TCP initiated the close
    // MAX_KEEP_ALIVE Specifies the maximum number of requests that can be served through a Keep-Alive (Persistent) session. (Value <= 0 will disable Keep-Alive)
    //
+   // METRICS_URI    URI of the latency histograms and the counters of the server in the text format of Prometheus (ex: /metrics)
+   //
    // DH_FILE       DH param
    // CERT_FILE     server certificate
    // KEY_FILE      server private key
@@ -1532,6 +1727,8 @@ void UServer_Base::loadConfigParam()
    // CA_PATH       locations of trusted CA certificates used in the verification
    // VERIFY_MODE   mode of verification (SSL_VERIFY_NONE=0, SSL_VERIFY_PEER=1, SSL_VERIFY_FAIL_IF_NO_PEER_CERT=2, SSL_VERIFY_CLIENT_ONCE=4)
    // CIPHER_SUITE  cipher suite model (Intermediate=0, Modern=1, Old=2)
+   // KTLS          flag to enable kernel TLS offload (if supported by the kernel we can use sendfile() also with SSL)
+   // SSL_HANDSHAKE_THREAD number of helper thread for the TLS handshake (0 => the handshake is done inline by the event loop)
    //
    // PREFORK_CHILD number of child server processes created at startup: -1 - thread approach (experimental)
    //                                                                     0 - serialize, no forking
@@ -1562,6 +1759,9 @@ void UServer_Base::loadConfigParam()
 
    if (timeoutMS > 0) timeoutMS *= 1000;
 
+   header_timeout = cfg->readLong(U_CONSTANT_TO_PARAM("REQ_HEADER_TIMEOUT"));
+   read_budget    = cfg->readLong(U_CONSTANT_TO_PARAM("READ_BUDGET"));
+
    port = cfg->readLong(U_CONSTANT_TO_PARAM("PORT"), bssl ? 443 : 80);
 
    if ((port == 80 || port == 443) &&
@@ -1583,6 +1783,10 @@ void UServer_Base::loadConfigParam()
    num_client_threshold           = cfg->readLong(U_CONSTANT_TO_PARAM("CLIENT_THRESHOLD"));
    num_client_for_parallelization = cfg->readLong(U_CONSTANT_TO_PARAM("CLIENT_FOR_PARALLELIZATION"));
 
+   x = cfg->at(U_CONSTANT_TO_PARAM("METRICS_URI"));
+
+   if (x) U_NEW(UString, UMetrics::uri, UString(x));
+
    x = cfg->at(U_CONSTANT_TO_PARAM("PREFORK_CHILD"));
 
    if (x)
@@ -1653,7 +1857,27 @@ void UServer_Base::loadConfigParam()
    *dh_file    = cfg->at(U_CONSTANT_TO_PARAM("DH_FILE"));
    verify_mode = cfg->at(U_CONSTANT_TO_PARAM("VERIFY_MODE"));
 
-   if (bssl) min_size_for_sendfile = U_NOT_FOUND; // NB: we can't use sendfile with SSL...
+   USSLSocket::bktls = cfg->readBoolean(U_CONSTANT_TO_PARAM("KTLS"));
+
+   if (bssl &&
+       USSLSocket::bktls == false)
+      {
+      min_size_for_sendfile = U_NOT_FOUND; // NB: we can't use sendfile with SSL without kernel TLS offload...
+      }
+
+#  ifdef U_SSL_HANDSHAKE_OFFLOAD
+   uint32_t num_handshake_thread = cfg->readLong(U_CONSTANT_TO_PARAM("SSL_HANDSHAKE_THREAD"));
+
+   if (bssl                 &&
+       num_handshake_thread &&
+       isClassic() == false &&
+       preforked_num_kids != -1)
+      {
+      U_NEW(USSLHandshake, handler_handshake, USSLHandshake(num_handshake_thread));
+
+      USSLSocket::bdefer_handshake = true;
+      }
+#  endif
 #endif
 
    U_INTERNAL_DUMP("min_size_for_sendfile = %u", min_size_for_sendfile)
@@ -2073,7 +2297,12 @@ int UServer_Base::pluginsHandler##xxx()                                       \
    do {                                                                       \
       result = vplugin->at(i)->handler##xxx();                                \
                                                                               \
-      if ((result & U_PLUGIN_HANDLER_GO_ON) == 0) U_RETURN(result);           \
+      if ((result & U_PLUGIN_HANDLER_GO_ON) == 0)                             \
+         {                                                                    \
+         plugin_index = i;                                                    \
+                                                                              \
+         U_RETURN(result);                                                    \
+         }                                                                    \
       }                                                                       \
    while (++i < vplugin_size);                                                \
                                                                               \
@@ -2129,7 +2358,12 @@ int UServer_Base::pluginsHandler##xxx()
          mod_name[0][0] = '\0';                                                    \
          }                                                                         \
                                                                                    \
-      if ((result & U_PLUGIN_HANDLER_GO_ON) == 0) U_RETURN(result);                \
+      if ((result & U_PLUGIN_HANDLER_GO_ON) == 0)                                  \
+         {                                                                         \
+         plugin_index = i;                                                         \
+                                                                                   \
+         U_RETURN(result);                                                         \
+         }                                                                         \
       }                                                                            \
    while (++i < vplugin_size);                                                     \
                                                                                    \
@@ -2261,6 +2495,15 @@ void UServer_Base::init()
          {
          U_ERROR("SSL: server setContext() failed");
          }
+
+      if (USSLSocket::bktls)
+         {
+         USSLSocket::bktls = USSLSocket::enableKTLS(((USSLSocket*)socket)->ctx);
+
+         if (USSLSocket::bktls == false) min_size_for_sendfile = U_NOT_FOUND; // NB: we can't use sendfile with SSL...
+
+         U_SRV_LOG("SSL: kernel TLS offload is: %savailable", (USSLSocket::bktls ? "" : "NOT "));
+         }
       }
    else
 #endif
@@ -2456,6 +2699,12 @@ void UServer_Base::init()
 
    if (pluginsHandlerInit() != U_PLUGIN_HANDLER_FINISHED) U_ERROR("Plugins stage init failed");
 
+   if (UMetrics::uri) UMetrics::init();
+
+#ifdef U_THROTTLING_SUPPORT
+   if (isThrottling()) initThrottlingServer();
+#endif
+
    // manage shared data...
 
    U_INTERNAL_DUMP("shared_data_add = %u", shared_data_add)
@@ -2556,18 +2805,6 @@ void UServer_Base::init()
 
    UTimer::insert(pstat);
 #endif
-#ifdef U_THROTTLING_SUPPORT
-   if (db_throttling)
-      {
-      // set up the throttles timer
-
-      UEventTime* throttling_time;
-
-      U_NEW(UBandWidthThrottling, throttling_time, UBandWidthThrottling);
-
-      UTimer::insert(throttling_time);
-      }
-#endif
 
    // ---------------------------------------------------------------------------------------------------------
    // init notifier event manager
@@ -2618,12 +2855,21 @@ void UServer_Base::init()
          handler_other->UEventFd::op_mask &= ~EPOLLRDHUP;
          }
 
+      if (handler_pubsub)
+         {
+         UNotifier::min_connection++;
+
+         handler_pubsub->UEventFd::op_mask &= ~EPOLLRDHUP;
+         }
+
       if (handler_inotify)
          {
          UNotifier::min_connection++;
 
          handler_inotify->UEventFd::op_mask &= ~EPOLLRDHUP;
          }
+
+      if (handler_handshake) UNotifier::min_connection++;
       }
 
    UNotifier::max_connection = (UNotifier::max_connection ? UNotifier::max_connection : USocket::iBackLog) + (UNotifier::num_connection = UNotifier::min_connection);
@@ -2647,6 +2893,8 @@ void UServer_Base::init()
 
    if (pluginsHandlerRun() != U_PLUGIN_HANDLER_FINISHED) U_ERROR("Plugins stage run failed");
 
+   if (UMetrics::uri) UMetrics::run(UNotifier::max_connection);
+
    if (u_start_time     == 0 &&
        u_setStartTime() == false)
       {
@@ -2654,7 +2902,7 @@ void UServer_Base::init()
       }
 
 #ifdef U_THROTTLING_SUPPORT
-   if (throttling_mask) initThrottlingServer();
+   if (isThrottling()) runThrottlingServer();
 #endif
 
    if (cfg) cfg->clear();
@@ -2887,6 +3135,53 @@ RETSIGTYPE UServer_Base::handlerForSigTERM(int signo)
       }
 }
 
+#ifdef U_SSL_HANDSHAKE_OFFLOAD
+U_NO_EXPORT void UServer_Base::handlerHandshake(UClientImage_Base* cimg)
+{
+   U_TRACE(0, "UServer_Base::handlerHandshake(%p)", cimg)
+
+   U_INTERNAL_ASSERT(bssl)
+   U_INTERNAL_ASSERT(U_ClientImage_handshake(cimg))
+
+   // NB: we are on a helper thread, on failure the socket is closed by acceptSSL()...
+
+   (void) ((USSLSocket*)socket)->acceptSSL((USSLSocket*)cimg->socket);
+}
+
+U_NO_EXPORT void UServer_Base::handlerHandshakeDone(UClientImage_Base* cimg)
+{
+   U_TRACE(0, "UServer_Base::handlerHandshakeDone(%p)", cimg)
+
+   U_ClientImage_handshake(cimg) = false;
+
+   if (cimg->socket->isClosed())
+      {
+      U_SRV_LOG("WARNING: SSL handshake failed with client %S", cimg->socket->cRemoteAddress.pcStrAddress);
+
+      cimg->UClientImage_Base::handlerDelete();
+
+      return;
+      }
+
+   csocket            = cimg->socket;
+   pClientImage       = cimg;
+   client_address     = csocket->cRemoteAddress.pcStrAddress;
+   client_address_len = u__strlen(client_address, __PRETTY_FUNCTION__);
+
+#ifndef U_LOG_DISABLE
+   if (isLog() &&
+       cimg->logCertificate()) // NB: now the handshake is done and we have the certificate of the client...
+      {
+      USocketExt::setRemoteInfo(csocket, *cimg->logbuf);
+
+      ULog::log(U_CONSTANT_TO_PARAM("SSL handshake done with client %v"), cimg->logbuf->rep);
+      }
+#endif
+
+   if (clientImageHandlerRead()) UNotifier::insert((UEventFd*)cimg);
+}
+#endif
+
 U_NO_EXPORT bool UServer_Base::clientImageHandlerRead()
 {
    U_TRACE_NO_PARAM(0, "UServer_Base::clientImageHandlerRead()")
@@ -2973,6 +3268,15 @@ loop:
    U_INTERNAL_DUMP("vClientImage[%d].socket->iSockDesc = %d",    (CLIENT_IMAGE - vClientImage), CSOCKET->iSockDesc)
    U_INTERNAL_DUMP("----------------------------------------", 0)
 
+#ifdef U_SSL_HANDSHAKE_OFFLOAD
+   if (U_ClientImage_handshake(CLIENT_IMAGE)) // NB: the TLS handshake is in progress on a helper thread, we must not touch it...
+      {
+      if (cround >= 2) goto end;
+
+      goto try_next;
+      }
+#endif
+
    if (CSOCKET->isOpen()) // busy
       {
       if (cround >= 2) // polling mode
@@ -3174,6 +3478,10 @@ try_accept:
 
    ++UNotifier::num_connection;
 
+   if (UMetrics::isActive()) UMetrics::setAccept(CLIENT_IMAGE - vClientImage);
+
+   CLIENT_IMAGE->request_start = u_now->tv_sec; // NB: the first request header must be complete before REQ_HEADER_TIMEOUT...
+
 #ifdef DEBUG
    ++stats_connections;
 
@@ -3254,7 +3562,13 @@ retry:   pid = UProcess::waitpid(-1, &status, WNOHANG); // NB: to avoid too much
    if (isLog())
       {
 #  ifdef USE_LIBSSL
-      if (bssl) CLIENT_IMAGE->logCertificate();
+      if (bssl)
+         {
+#     ifdef U_SSL_HANDSHAKE_OFFLOAD
+         if (handler_handshake == 0) // NB: with the handshake offload the certificate is not arrived yet, it is logged on completion (see handlerHandshakeDone())...
+#     endif
+         CLIENT_IMAGE->logCertificate();
+         }
 #  endif
 
       USocketExt::setRemoteInfo(CSOCKET, *CLIENT_IMAGE->logbuf);
@@ -3284,6 +3598,21 @@ retry:   pid = UProcess::waitpid(-1, &status, WNOHANG); // NB: to avoid too much
       }
 #endif
 
+#ifdef U_SSL_HANDSHAKE_OFFLOAD
+   if (handler_handshake) // NB: the request is read on completion of the TLS handshake (see USSLHandshake::handlerRead())...
+      {
+      U_INTERNAL_ASSERT(bssl)
+
+      U_ClientImage_handshake(CLIENT_IMAGE) = true;
+
+      ((USSLHandshake*)handler_handshake)->push(CLIENT_IMAGE);
+
+      if (++CLIENT_IMAGE >= eClientImage) CLIENT_IMAGE = vClientImage;
+
+      goto next;
+      }
+#endif
+
 #if defined(ENABLE_THREAD) && !defined(USE_LIBEVENT) && defined(U_SERVER_THREAD_APPROACH_SUPPORT)
    if (preforked_num_kids == -1) lClientIndex->UEventFd::fd = psocket->iSockDesc;
    else
@@ -3418,9 +3747,11 @@ bool UServer_Base::handlerTimeoutConnection(void* cimg)
 
    U_INTERNAL_DUMP("pthis = %p handler_other = %p handler_inotify = %p", pthis, handler_other, handler_inotify)
 
-   if (cimg == pthis         ||
-       cimg == handler_other ||
-       cimg == handler_inotify)
+   if (cimg == pthis           ||
+       cimg == handler_other   ||
+       cimg == handler_pubsub  ||
+       cimg == handler_inotify ||
+       cimg == handler_handshake)
       {
       U_RETURN(false);
       }
@@ -3467,12 +3798,47 @@ bool UServer_Base::handlerTimeoutConnection(void* cimg)
    U_RETURN(false);
 }
 
+bool UServer_Base::handlerTimeoutHeader(void* cimg)
+{
+   U_TRACE(0, "UServer_Base::handlerTimeoutHeader(%p)", cimg)
+
+   U_INTERNAL_ASSERT_POINTER(cimg)
+   U_INTERNAL_ASSERT_MAJOR(header_timeout, 0)
+
+   if (cimg == pthis           ||
+       cimg == handler_other   ||
+       cimg == handler_pubsub  ||
+       cimg == handler_inotify ||
+       cimg == handler_handshake)
+      {
+      U_RETURN(false);
+      }
+
+   long request_start = ((UClientImage_Base*)cimg)->request_start;
+
+   U_INTERNAL_DUMP("request_start = %ld", request_start)
+
+   if (request_start &&
+       (u_now->tv_sec - request_start) >= (long)header_timeout)
+      {
+      U_SRV_LOG("handlerTimeoutHeader: client didn't send a complete request header in %u secs (%u bytes received), close connection %v",
+                  header_timeout, (((UClientImage_Base*)cimg)->data_pending ? ((UClientImage_Base*)cimg)->data_pending->size() : 0),
+                  ((UClientImage_Base*)cimg)->logbuf->rep);
+
+      U_RETURN(true); // NB: return true mean that we want to erase the item...
+      }
+
+   U_RETURN(false);
+}
+
 void UServer_Base::runLoop(const char* user)
 {
    U_TRACE(0, "UServer_Base::runLoop(%S)", user)
 
    if (pluginsHandlerFork() != U_PLUGIN_HANDLER_FINISHED) U_ERROR("Plugins stage fork failed");
 
+   if (UMetrics::uri) UMetrics::start();
+
    socket->reusePort(socket_flags);
 
 #ifdef U_LINUX
@@ -3545,7 +3911,17 @@ void UServer_Base::runLoop(const char* user)
       {
       if (binsert)         UNotifier::insert(pthis,           EPOLLEXCLUSIVE | EPOLLROUNDROBIN); // NB: we ask to be notified for request of connection (=> accept)
       if (handler_other)   UNotifier::insert(handler_other,   EPOLLEXCLUSIVE | EPOLLROUNDROBIN); // NB: we ask to be notified for request from generic system
+      if (handler_pubsub)  UNotifier::insert(handler_pubsub);                                    // NB: we ask to be notified for message to broadcast (=> eventfd of the worker)
       if (handler_inotify) UNotifier::insert(handler_inotify, EPOLLEXCLUSIVE | EPOLLROUNDROBIN); // NB: we ask to be notified for change of file system (=> inotify)
+
+#  ifdef U_SSL_HANDSHAKE_OFFLOAD
+      if (handler_handshake) // NB: we ask to be notified for completion of the TLS handshake (=> eventfd)
+         {
+         ((USSLHandshake*)handler_handshake)->start();
+
+         UNotifier::insert(handler_handshake);
+         }
+#  endif
       }
 
 #ifndef U_LOG_DISABLE
@@ -3596,6 +3972,15 @@ void UServer_Base::runLoop(const char* user)
       UTimer::insert(pdaylight);
       }
 
+   if (header_timeout)
+      {
+      UEventTime* pheader;
+
+      U_NEW(UTimeoutHeader, pheader, UTimeoutHeader);
+
+      UTimer::insert(pheader);
+      }
+
    while (flag_loop)
       {
       U_INTERNAL_DUMP("handler_other = %p handler_inotify = %p UNotifier::num_connection = %u UNotifier::min_connection = %u",
@@ -3635,6 +4020,10 @@ void UServer_Base::runLoop(const char* user)
 
       (void) pthis->UServer_Base::handlerRead();
       }
+
+#if defined(USE_LIBSSL) && defined(U_SSL_HANDSHAKE_OFFLOAD)
+   if (handler_handshake) ((USSLHandshake*)handler_handshake)->stop(); // NB: wake up and join the helper thread of the TLS handshake...
+#endif
 }
 
 void UServer_Base::run()
@@ -4013,6 +4402,8 @@ const char* UServer_Base::dump(bool reset) const
                   << "map_size                  " << map_size                   << '\n'
                   << "flag_loop                 " << flag_loop                  << '\n'
                   << "timeoutMS                 " << timeoutMS                  << '\n'
+                  << "read_budget               " << read_budget                << '\n'
+                  << "header_timeout            " << header_timeout             << '\n'
                   << "verify_mode               " << verify_mode                << '\n'
                   << "shared_data_add           " << shared_data_add            << '\n'
                   << "ptr_shared_data           " << (void*)ptr_shared_data     << '\n'
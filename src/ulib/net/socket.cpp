@@ -987,16 +987,17 @@ bool USocket::acceptClient(USocket* pcNewConnection)
 #endif
 */
 
+      U_socket_Type(pcNewConnection) = U_socket_Type(this); // NB: before acceptSSL() that can set SK_SSL_KTLS...
+
 #  ifdef USE_LIBSSL
-      if (isSSLActive() &&
+      if (isSSLActive()                        &&
+          USSLSocket::bdefer_handshake == false &&
           ((USSLSocket*)this)->acceptSSL((USSLSocket*)pcNewConnection) == false)
          {
          U_RETURN(false);
          }
 #  endif
 
-      U_socket_Type(pcNewConnection) = U_socket_Type(this);
-
       U_RETURN(true);
       }
 
@@ -57,6 +57,11 @@
 #else
 #  define LIBZOPFLI_ENABLE   "no"
 #endif
+#ifdef USE_LIBDEFLATE
+#  define LIBDEFLATE_ENABLE  "yes ( " _LIBDEFLATE_VERSION " )"
+#else
+#  define LIBDEFLATE_ENABLE  "no"
+#endif
 #ifdef USE_LIBTDB
 #  define LIBTDB_ENABLE      "yes ( " _LIBTDB_VERSION " )"
 #else
@@ -715,6 +720,7 @@ PYTHON language support: yes ( 2.7 )
       "memory pool support....:%W " MEMORY_POOL_ENABLE "%W\n\n" \
       "LIBZ support...........:%W " LIBZ_ENABLE "%W\n" \
       "LIBZOPFLI support......:%W " LIBZOPFLI_ENABLE "%W\n" \
+      "LIBDEFLATE support.....:%W " LIBDEFLATE_ENABLE "%W\n" \
       "LIBTDB support.........:%W " LIBTDB_ENABLE "%W\n" \
       "PCRE support...........:%W " LIBPCRE_ENABLE "%W\n" \
       "SSL support............:%W " LIBSSL_ENABLE "%W\n" \
@@ -236,6 +236,30 @@ void UOrmDriverMySql::handlerDisConnect()
    UOrmDriver::connection = 0;
 }
 
+bool UOrmDriverMySql::handlerPing()
+{
+   U_TRACE_NO_PARAM(0, "UOrmDriverMySql::handlerPing()")
+
+   U_INTERNAL_ASSERT_POINTER(UOrmDriver::connection)
+
+   // NB: with the option auto-reconnect mysql_ping() can reconnect, and the prepared statement are lost with the old connection...
+
+   unsigned long id = U_SYSCALL(mysql_thread_id, "%p", (MYSQL*)UOrmDriver::connection);
+
+   UOrmDriver::errcode = U_SYSCALL(mysql_ping, "%p", (MYSQL*)UOrmDriver::connection);
+
+   if (UOrmDriver::errcode)
+      {
+      UOrmDriver::printError(__PRETTY_FUNCTION__);
+
+      U_RETURN(false);
+      }
+
+   if (id != U_SYSCALL(mysql_thread_id, "%p", (MYSQL*)UOrmDriver::connection)) U_RETURN(false);
+
+   U_RETURN(true);
+}
+
 bool UOrmDriverMySql::handlerQuery(const char* query, uint32_t query_len)
 {
    U_TRACE(0, "UOrmDriverMySql::handlerQuery(%.*S,%u)", query_len, query, query_len)
@@ -11,11 +11,71 @@
 //
 // ============================================================================
 
+#include <ulib/notifier.h>
 #include <ulib/net/socket.h>
 #include <ulib/orm/driver/orm_driver_pgsql.h>
 
 U_CREAT_FUNC(orm_driver_pgsql, UOrmDriverPgSql)
 
+#ifdef LIBPQ_HAS_PIPELINING
+class U_NO_EXPORT UPgSqlAsync : public UEventFd {
+public:
+
+   // Check for memory error
+   U_MEMORY_TEST
+
+   // Allocator e Deallocator
+   U_MEMORY_ALLOCATOR
+   U_MEMORY_DEALLOCATOR
+
+   UPgSqlAsync(UOrmDriverPgSql* pdrv, int _fd) : drv(pdrv)
+      {
+      U_TRACE_REGISTER_OBJECT(0, UPgSqlAsync, "%p,%d", pdrv, _fd)
+
+      UEventFd::fd = _fd;
+      }
+
+   virtual ~UPgSqlAsync() U_DECL_FINAL
+      {
+      U_TRACE_UNREGISTER_OBJECT(0, UPgSqlAsync)
+      }
+
+   // define method VIRTUAL of class UEventFd
+
+   virtual int handlerRead() U_DECL_FINAL
+      {
+      U_TRACE_NO_PARAM(0, "UPgSqlAsync::handlerRead()")
+
+      if (drv->handlerAsync(true)) U_RETURN(U_NOTIFIER_OK);
+
+      U_RETURN(U_NOTIFIER_DELETE); // NB: libpq close the socket when the connection is lost...
+      }
+
+   virtual void handlerDelete() U_DECL_FINAL
+      {
+      U_TRACE_NO_PARAM(0, "UPgSqlAsync::handlerDelete()")
+
+      U_INTERNAL_ASSERT_EQUALS(drv->pasync, this)
+
+      drv->pasync = 0;
+
+      if (drv->callback) (void) drv->handlerAsync(false); // NB: the callback is called with the results arrived until now...
+
+      delete this;
+      }
+
+#if defined(DEBUG) && defined(U_STDCPP_ENABLE)
+   const char* dump(bool _reset) const { return UEventFd::dump(_reset); }
+#endif
+
+protected:
+   UOrmDriverPgSql* drv;
+
+private:
+   U_DISALLOW_COPY_AND_ASSIGN(UPgSqlAsync)
+};
+#endif
+
 UOrmDriverPgSql::~UOrmDriverPgSql()
 {
    U_TRACE_UNREGISTER_OBJECT(0, UOrmDriverPgSql)
@@ -99,11 +159,44 @@ void UOrmDriverPgSql::handlerDisConnect()
 
    U_INTERNAL_ASSERT_POINTER(UOrmDriver::connection)
 
+#ifdef LIBPQ_HAS_PIPELINING
+   if (pasync) UNotifier::handlerDelete(pasync); // NB: the callback of the results pending is called...
+
+   clearAsync();
+#endif
+
    U_SYSCALL_VOID(PQfinish, "%p", (PGconn*)UOrmDriver::connection);
 
    UOrmDriver::connection = 0;
 }
 
+bool UOrmDriverPgSql::handlerPing()
+{
+   U_TRACE_NO_PARAM(0, "UOrmDriverPgSql::handlerPing()")
+
+   U_INTERNAL_ASSERT_POINTER(UOrmDriver::connection)
+
+   // NB: PQstatus() don't check the socket, so we need a round trip with the server (the empty query is the cheapest)...
+
+   if (U_SYSCALL(PQstatus, "%p", (PGconn*)UOrmDriver::connection) == CONNECTION_OK)
+      {
+      PGresult* res = (PGresult*) U_SYSCALL(PQexec, "%p,%S", (PGconn*)UOrmDriver::connection, "");
+
+      if (res)
+         {
+         bool result = (U_SYSCALL(PQresultStatus, "%p", res) == PGRES_EMPTY_QUERY);
+
+         U_SYSCALL_VOID(PQclear, "%p", res);
+
+         if (result) U_RETURN(true);
+         }
+      }
+
+   UOrmDriver::printError(__PRETTY_FUNCTION__);
+
+   U_RETURN(false);
+}
+
 bool UOrmDriverPgSql::checkExecution(PGresult* res)
 {
    U_TRACE(0, "UOrmDriverPgSql::checkExecution(%p)", res)
@@ -579,6 +672,462 @@ bool UOrmDriverPgSql::nextRow(USqlStatement* pstmt)
    U_RETURN(true);
 }
 
+/**
+ * Pipeline mode: the statements are sent with PQsendQueryPrepared() without waiting the result, on a non-blocking connection,
+ * and the sync point with the flush of the output buffer is done only when we need the first result, so that N statements
+ * cost one round trip with the server. The wait for the socket go through UNotifier with the usual timeout instead of
+ * blocking inside libpq. With sendAsync() instead the socket is registered with UNotifier and the results are collected
+ * by the event loop (handlerAsync()), so the worker serve the other clients while waiting, and the callback is called when
+ * the result of the last statement is arrived. NB: PQprepare() is not allowed in pipeline mode, so a statement not yet
+ * prepared is prepared leaving temporarily the pipeline, and this is possible only if there are no results pending...
+ */
+
+#ifdef LIBPQ_HAS_PIPELINING
+bool UOrmDriverPgSql::enterPipeline()
+{
+   U_TRACE_NO_PARAM(0, "UOrmDriverPgSql::enterPipeline()")
+
+   U_INTERNAL_ASSERT_POINTER(UOrmDriver::connection)
+
+   if (U_SYSCALL(PQenterPipelineMode, "%p", (PGconn*)UOrmDriver::connection) == 0)
+      {
+      UOrmDriver::printError(__PRETTY_FUNCTION__);
+
+      U_RETURN(false);
+      }
+
+   (void) U_SYSCALL(PQsetnonblocking, "%p,%d", (PGconn*)UOrmDriver::connection, 1);
+
+   npending =
+   nunsync  =
+   nsync    = 0;
+
+   bpipeline = true;
+
+   U_RETURN(true);
+}
+
+void UOrmDriverPgSql::exitPipeline()
+{
+   U_TRACE_NO_PARAM(0, "UOrmDriverPgSql::exitPipeline()")
+
+   U_INTERNAL_ASSERT(bpipeline)
+   U_INTERNAL_ASSERT_POINTER(UOrmDriver::connection)
+
+   U_INTERNAL_DUMP("npending = %u nunsync = %u nsync = %u", npending, nunsync, nsync)
+
+   PGresult* res;
+
+   // NB: we must discard the result not read by the caller before to leave the pipeline...
+
+   callback = 0;
+
+   clearAsync();
+
+   if (flush())
+      {
+      while (nsync &&
+             readResult(&res))
+         {
+         if (res == 0) continue; // NB: the result of every statement is terminated by a null pointer...
+
+         if (U_SYSCALL(PQresultStatus, "%p", res) == PGRES_PIPELINE_SYNC) --nsync;
+
+         U_SYSCALL_VOID(PQclear, "%p", res);
+         }
+      }
+
+   if (U_SYSCALL(PQexitPipelineMode, "%p", (PGconn*)UOrmDriver::connection) == 0) UOrmDriver::printError(__PRETTY_FUNCTION__);
+
+   (void) U_SYSCALL(PQsetnonblocking, "%p,%d", (PGconn*)UOrmDriver::connection, 0);
+
+   npending  = 0;
+   bpipeline = false;
+}
+
+bool UOrmDriverPgSql::flush()
+{
+   U_TRACE_NO_PARAM(0, "UOrmDriverPgSql::flush()")
+
+   U_INTERNAL_ASSERT_POINTER(UOrmDriver::connection)
+
+   PGconn* conn = (PGconn*)UOrmDriver::connection;
+
+   if (nunsync)
+      {
+      if (U_SYSCALL(PQpipelineSync, "%p", conn) == 0) goto err;
+
+      nunsync = 0;
+
+      ++nsync;
+      }
+
+   for (int ret, n = U_TIMEOUT_MS / 100; n > 0; --n)
+      {
+      ret = U_SYSCALL(PQflush, "%p", conn);
+
+      if (ret ==  0) U_RETURN(true);
+      if (ret == -1) break;
+
+      // NB: the server can stop to read if we don't read its results, so we wait the socket in short slices consuming the input...
+
+      if (UNotifier::waitForWrite(PQsocket(conn), 100) == -1 ||
+          U_SYSCALL(PQconsumeInput, "%p", conn) == 0)
+         {
+         break;
+         }
+      }
+
+err:
+   UOrmDriver::printError(__PRETTY_FUNCTION__);
+
+   U_RETURN(false);
+}
+
+bool UOrmDriverPgSql::readResult(PGresult** pres)
+{
+   U_TRACE(0, "UOrmDriverPgSql::readResult(%p)", pres)
+
+   U_INTERNAL_ASSERT_POINTER(UOrmDriver::connection)
+
+   PGconn* conn = (PGconn*)UOrmDriver::connection;
+
+   while (U_SYSCALL(PQisBusy, "%p", conn))
+      {
+      if (UNotifier::waitForRead(PQsocket(conn), U_TIMEOUT_MS) != 1 ||
+          U_SYSCALL(PQconsumeInput, "%p", conn) == 0)
+         {
+         UOrmDriver::printError(__PRETTY_FUNCTION__);
+
+         U_RETURN(false);
+         }
+      }
+
+   *pres = (PGresult*) U_SYSCALL(PQgetResult, "%p", conn);
+
+   U_RETURN(true);
+}
+
+void UOrmDriverPgSql::clearAsync()
+{
+   U_TRACE_NO_PARAM(0, "UOrmDriverPgSql::clearAsync()")
+
+   U_INTERNAL_DUMP("nres = %u ires = %u nres_max = %u", nres, ires, nres_max)
+
+   if (vres)
+      {
+      while (ires < nres) U_SYSCALL_VOID(PQclear, "%p", vres[ires++]);
+
+      UMemoryPool::_free(vres, nres_max, sizeof(PGresult*));
+
+      vres = 0;
+      }
+
+   nres =
+   ires = 0;
+}
+
+bool UOrmDriverPgSql::handlerAsync(bool bread)
+{
+   U_TRACE(0, "UOrmDriverPgSql::handlerAsync(%b)", bread)
+
+   U_INTERNAL_ASSERT_POINTER(UOrmDriver::connection)
+
+   U_INTERNAL_DUMP("npending = %u nsync = %u nres = %u callback = %p", npending, nsync, nres, callback)
+
+   vPFospv _callback;
+   PGresult* res;
+   PGconn* conn = (PGconn*)UOrmDriver::connection;
+
+   if (bread == false) goto end;
+
+   // NB: the socket is non-blocking (libpq), so we read only the data arrived...
+
+   if (U_SYSCALL(PQconsumeInput, "%p", conn) == 0)
+      {
+      UOrmDriver::printError(__PRETTY_FUNCTION__);
+
+      bread = false;
+
+      goto end;
+      }
+
+   if (callback == 0) U_RETURN(true); // NB: there are no results pending...
+
+   while (nsync &&
+          U_SYSCALL(PQisBusy, "%p", conn) == 0)
+      {
+      res = (PGresult*) U_SYSCALL(PQgetResult, "%p", conn);
+
+      if (res == 0) continue; // NB: the result of every statement is terminated by a null pointer...
+
+      if (U_SYSCALL(PQresultStatus, "%p", res) == PGRES_PIPELINE_SYNC)
+         {
+         U_SYSCALL_VOID(PQclear, "%p", res);
+
+         --nsync;
+
+         continue;
+         }
+
+      if (nres == nres_max) // NB: it should not happen...
+         {
+         U_SYSCALL_VOID(PQclear, "%p", res);
+
+         continue;
+         }
+
+      vres[nres++] = res;
+      }
+
+   if (nsync) U_RETURN(true); // NB: we wait for the other results...
+
+end:
+   if (callback)
+      {
+      // NB: with error asyncResult() return false after the results arrived...
+
+      if (nres < npending) npending = nres;
+
+      _callback = callback;
+                  callback = 0;
+
+      _callback(psession, arg);
+      }
+
+   U_RETURN(bread);
+}
+#endif
+
+bool UOrmDriverPgSql::sendAsync(UOrmSession* _psession, vPFospv _callback, void* _arg)
+{
+   U_TRACE(0, "UOrmDriverPgSql::sendAsync(%p,%p,%p)", _psession, _callback, _arg)
+
+   U_INTERNAL_ASSERT_POINTER(_callback)
+   U_INTERNAL_ASSERT_POINTER(UOrmDriver::connection)
+
+#ifdef LIBPQ_HAS_PIPELINING
+   if (bpipeline &&
+       npending)
+      {
+      U_INTERNAL_DUMP("npending = %u nunsync = %u nsync = %u nres = %u ires = %u", npending, nunsync, nsync, nres, ires)
+
+      if (callback ||
+          ires < nres)
+         {
+         UOrmDriver::errmsg = "results pending of a previous async send";
+
+         UOrmDriver::printError(__PRETTY_FUNCTION__);
+
+         U_RETURN(false);
+         }
+
+      if (flush() == false) U_RETURN(false);
+
+      clearAsync();
+
+      nres_max = npending;
+
+      vres = (PGresult**) UMemoryPool::_malloc(&nres_max, sizeof(PGresult*));
+
+      psession = _psession;
+      callback = _callback;
+      arg      = _arg;
+
+      if (pasync == 0)
+         {
+         U_NEW(UPgSqlAsync, pasync, UPgSqlAsync(this, PQsocket((PGconn*)UOrmDriver::connection)));
+
+         UNotifier::insert(pasync);
+         }
+
+      // NB: the results can be already arrived (and the socket no more readable)...
+
+      if (handlerAsync(true) == false) UNotifier::handlerDelete(pasync);
+
+      U_RETURN(true);
+      }
+#endif
+
+   _callback(_psession, _arg); // NB: the statements are already executed...
+
+   U_RETURN(true);
+}
+
+bool UOrmDriverPgSql::handlerPipeline(bool benter)
+{
+   U_TRACE(0, "UOrmDriverPgSql::handlerPipeline(%b)", benter)
+
+   U_INTERNAL_DUMP("bpipeline = %b", bpipeline)
+
+#ifdef LIBPQ_HAS_PIPELINING
+   if (benter)
+      {
+      if (bpipeline ||
+          enterPipeline())
+         {
+         U_RETURN(true);
+         }
+      }
+   else if (bpipeline)
+      {
+      exitPipeline();
+      }
+#endif
+
+   U_RETURN(false);
+}
+
+bool UOrmDriverPgSql::asyncExecute(USqlStatement* pstmt)
+{
+   U_TRACE(0, "UOrmDriverPgSql::asyncExecute(%p)", pstmt)
+
+   U_INTERNAL_ASSERT_POINTER(pstmt)
+   U_INTERNAL_ASSERT_POINTER(UOrmDriver::connection)
+
+#ifdef LIBPQ_HAS_PIPELINING
+   if (bpipeline)
+      {
+      U_INTERNAL_DUMP("npending = %u nunsync = %u nsync = %u", npending, nunsync, nsync)
+
+      if (pstmt->pHandle == 0)
+         {
+         if (npending)
+            {
+            UOrmDriver::errmsg = "statement not yet prepared with results pending in pipeline mode";
+
+            UOrmDriver::printError(__PRETTY_FUNCTION__);
+
+            U_RETURN(false);
+            }
+
+         exitPipeline();
+
+         bool result = ((UPgSqlStatement*)pstmt)->setBindParam(this);
+
+         if (enterPipeline() == false ||
+             result          == false)
+            {
+            U_RETURN(false);
+            }
+         }
+      else if (((UPgSqlStatement*)pstmt)->setBindParam(this) == false)
+         {
+         U_RETURN(false);
+         }
+
+      if (U_SYSCALL(PQsendQueryPrepared, "%p,%S,%d,%p,%p,%p,%d",
+                    (PGconn*)UOrmDriver::connection,
+                    ((UPgSqlStatement*)pstmt)->stmtName,
+                    pstmt->num_bind_param,
+                    ((UPgSqlStatement*)pstmt)->paramValues,
+                    ((UPgSqlStatement*)pstmt)->paramLengths,
+                    ((UPgSqlStatement*)pstmt)->paramFormats,
+                    ((UPgSqlStatement*)pstmt)->resultFormat) == 0)
+         {
+         UOrmDriver::printError(__PRETTY_FUNCTION__);
+
+         U_RETURN(false);
+         }
+
+      ++nunsync;
+      ++npending;
+
+      U_RETURN(true);
+      }
+#endif
+
+   execute(pstmt);
+
+   U_RETURN(true);
+}
+
+bool UOrmDriverPgSql::asyncResult(USqlStatement* pstmt)
+{
+   U_TRACE(0, "UOrmDriverPgSql::asyncResult(%p)", pstmt)
+
+   U_INTERNAL_ASSERT_POINTER(pstmt)
+   U_INTERNAL_ASSERT_POINTER(UOrmDriver::connection)
+
+#ifdef LIBPQ_HAS_PIPELINING
+   if (bpipeline)
+      {
+      U_INTERNAL_DUMP("npending = %u nunsync = %u nsync = %u", npending, nunsync, nsync)
+
+      PGresult* res;
+
+      if (npending == 0) U_RETURN(false);
+
+      if (vres) // NB: async mode, the results are collected by the event loop (see sendAsync())...
+         {
+         if (callback)
+            {
+            UOrmDriver::errmsg = "results not yet arrived in async mode";
+
+            UOrmDriver::printError(__PRETTY_FUNCTION__);
+
+            U_RETURN(false);
+            }
+
+         U_INTERNAL_ASSERT_MINOR(ires, nres)
+
+         res = vres[ires++];
+
+         if (ires == nres) clearAsync();
+         }
+      else
+         {
+         if (flush() == false) U_RETURN(false);
+
+         while (true)
+            {
+            if (readResult(&res) == false) U_RETURN(false);
+
+            if (res == 0 ||
+                U_SYSCALL(PQresultStatus, "%p", res) != PGRES_PIPELINE_SYNC)
+               {
+               break;
+               }
+
+            U_SYSCALL_VOID(PQclear, "%p", res);
+
+            --nsync;
+            }
+
+         if (res)
+            {
+            PGresult* end;
+
+            // NB: the result of every statement is terminated by a null pointer...
+
+            if (readResult(&end) &&
+                end)
+               {
+               U_SYSCALL_VOID(PQclear, "%p", end);
+               }
+            }
+         }
+
+      --npending;
+
+      if (checkExecution(res) == false) U_RETURN(false);
+
+      U_INTERNAL_ASSERT_POINTER(((UPgSqlStatement*)pstmt)->res)
+
+      U_SYSCALL_VOID(PQclear, "%p", ((UPgSqlStatement*)pstmt)->res);
+
+      ((UPgSqlStatement*)pstmt)->res = res;
+
+      pstmt->current_row    =
+      pstmt->num_row_result = 0;
+
+      ((UPgSqlStatement*)pstmt)->setBindResult(this);
+      }
+#endif
+
+   U_RETURN(true);
+}
+
 unsigned long long UOrmDriverPgSql::affected(USqlStatement* pstmt)
 {
    U_TRACE(0, "UOrmDriverPgSql::affected(%p)", pstmt)
@@ -682,7 +1231,18 @@ const char* UOrmDriverPgSql::dump(bool _reset) const
 {
    UOrmDriver::dump(false);
 
-   *UObjectIO::os << '\n';
+   *UObjectIO::os << '\n'
+                  << "ires                                       " << ires              << '\n'
+                  << "nres                                       " << nres              << '\n'
+                  << "nsync                                      " << nsync             << '\n'
+                  << "nunsync                                    " << nunsync           << '\n'
+                  << "npending                                   " << npending          << '\n'
+                  << "nres_max                                   " << nres_max          << '\n'
+                  << "vres                                       " << (void*)vres       << '\n'
+                  << "pasync                                     " << (void*)pasync     << '\n'
+                  << "callback                                   " << (void*)callback   << '\n'
+                  << "psession                                   " << (void*)psession   << '\n'
+                  << "bpipeline                                  " << bpipeline;
 
    if (_reset)
       {
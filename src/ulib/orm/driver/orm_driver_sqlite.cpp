@@ -189,7 +189,7 @@ UOrmDriver* UOrmDriverSqlite::handlerConnect(const UString& option)
 
    (void) U_SYSCALL(sqlite3_busy_timeout, "%p,%d", (sqlite3*)pdrv->connection, x ? x.strtoul() : 8); // 8ms
 
-   (void) U_SYSCALL(sqlite3_exec, "%p,%S,%p,%p,%p", (sqlite3*)pdrv->connection, "PRAGMA journal_mode=OFF", 0, 0, 0);
+   (void) U_SYSCALL(sqlite3_exec, "%p,%S,%p,%p,%p", (sqlite3*)pdrv->connection, "PRAGMA journal_mode=MEMORY", 0, 0, 0); // NB: with OFF the ROLLBACK (f.e. of a failed batch) is undefined...
    (void) U_SYSCALL(sqlite3_exec, "%p,%S,%p,%p,%p", (sqlite3*)pdrv->connection, "PRAGMA mmap_size=44040192", 0, 0, 0);
    (void) U_SYSCALL(sqlite3_exec, "%p,%S,%p,%p,%p", (sqlite3*)pdrv->connection, "PRAGMA locking_mode=EXCLUSIVE", 0, 0, 0);
 
@@ -315,12 +315,9 @@ bool USqliteStatement::setBindParam(UOrmDriver* pdrv)
 
    U_ASSERT_EQUALS(num_bind_param, vparam.size())
 
-   if (param_binded)
-      {
-      pdrv->errcode = U_SYSCALL(sqlite3_reset, "%p", (sqlite3_stmt*)pHandle);
+   // NB: sqlite3_reset() return the error of the previous sqlite3_step(), it is already reported (f.e. a row of a batch that violate a constraint)...
 
-      if (pdrv->errcode) U_RETURN(false);
-      }
+   if (param_binded) (void) U_SYSCALL(sqlite3_reset, "%p", (sqlite3_stmt*)pHandle);
 
    int             int_value;
    double       double_value;
@@ -11,6 +11,7 @@
 //
 // ============================================================================
 
+#include <ulib/timer.h>
 #include <ulib/orm/orm.h>
 #include <ulib/orm/orm_driver.h>
 
@@ -27,9 +28,9 @@ __noreturn U_NO_EXPORT void UOrmSession::loadDriverFail(const char* ptr, uint32_
    U_EXIT(EXIT_FAILURE);   
 }
 
-void UOrmSession::loadDriver(const char* backend, uint32_t len, const UString& option)
+void UOrmSession::loadDriver(const char* backend, uint32_t len, const UString& option, bool bnew)
 {
-   U_TRACE(0, "UOrmSession::loadDriver(%.*S,%u,%V)", len, backend, len, option.rep)
+   U_TRACE(0, "UOrmSession::loadDriver(%.*S,%u,%V,%b)", len, backend, len, option.rep, bnew)
 
    U_INTERNAL_ASSERT_POINTER(UOrmDriver::vdriver)
    U_INTERNAL_ASSERT_POINTER(UOrmDriver::vdriver_name)
@@ -62,16 +63,23 @@ void UOrmSession::loadDriver(const char* backend, uint32_t len, const UString& o
    U_INTERNAL_ASSERT_POINTER(pdrv)
 
    if ((pdrv->connection == 0 ||
-        pdrv->opt != option)  &&
+        pdrv->opt != option   ||
+        bnew)                 &&
        connect(option) == false)
       {
-err:  loadDriverFail(backend, len);
+err:  U_INTERNAL_DUMP("bnew = %b", bnew)
+
+      // NB: for a session of a pool (bnew) it is not fatal: the session is not ready (pdrv == 0) and the pool retry later...
+
+      if (bnew == false) loadDriverFail(backend, len);
+
+      pdrv = 0;
       }
 }
 
-UOrmSession::UOrmSession(const char* dbname, uint32_t len)
+void UOrmSession::init(const char* dbname, uint32_t len, bool bnew)
 {
-   U_TRACE_REGISTER_OBJECT(0, UOrmSession, "%.*S,%u", len, dbname, len)
+   U_TRACE(0, "UOrmSession::init(%.*S,%u,%b)", len, dbname, len, bnew)
 
    pdrv = 0;
 
@@ -92,7 +100,7 @@ UOrmSession::UOrmSession(const char* dbname, uint32_t len)
 
       option.snprintf(UOrmDriver::env_option, strlen(UOrmDriver::env_option), len, dbname);
 
-      loadDriver(UOrmDriver::env_driver, UOrmDriver::env_driver_len, option);
+      loadDriver(UOrmDriver::env_driver, UOrmDriver::env_driver_len, option, bnew);
       }
 #endif
 }
@@ -106,6 +114,8 @@ UOrmSession::~UOrmSession()
 
    if (pdrv)
       {
+      pdrv->clearStatement(); // NB: the prepared statement die with the connection...
+
       pdrv->handlerDisConnect();
 
       if (UOrmDriver::vdriver->find(pdrv) == U_NOT_FOUND) delete pdrv;
@@ -188,16 +198,244 @@ unsigned long long UOrmSession::last_insert_rowid(const char* sequence)
    U_RETURN(result);
 }
 
+bool UOrmSession::startPipeline()
+{
+   U_TRACE_NO_PARAM(0, "UOrmSession::startPipeline()")
+
+   U_INTERNAL_ASSERT_POINTER(pdrv)
+
+   bool result = pdrv->handlerPipeline(true);
+
+   U_RETURN(result);
+}
+
+void UOrmSession::endPipeline()
+{
+   U_TRACE_NO_PARAM(0, "UOrmSession::endPipeline()")
+
+   U_INTERNAL_ASSERT_POINTER(pdrv)
+
+   (void) pdrv->handlerPipeline(false);
+}
+
+bool UOrmSession::sendAsync(vPFospv callback, void* arg)
+{
+   U_TRACE(0, "UOrmSession::sendAsync(%p,%p)", callback, arg)
+
+   U_INTERNAL_ASSERT_POINTER(pdrv)
+   U_INTERNAL_ASSERT_POINTER(callback)
+
+   bool result = pdrv->sendAsync(this, callback, arg);
+
+   U_RETURN(result);
+}
+
+// POOL
+
+class U_NO_EXPORT UOrmPoolReaper : public UEventTime {
+public:
+
+   UOrmPoolReaper(UOrmPool* p, long sec) : UEventTime(sec, 0L), ppool(p)
+      {
+      U_TRACE_REGISTER_OBJECT(0, UOrmPoolReaper, "%p,%ld", p, sec)
+      }
+
+   virtual ~UOrmPoolReaper() U_DECL_FINAL
+      {
+      U_TRACE_UNREGISTER_OBJECT(0, UOrmPoolReaper)
+      }
+
+   // define method VIRTUAL of class UEventTime
+
+   virtual int handlerTime() U_DECL_FINAL
+      {
+      U_TRACE_NO_PARAM(0, "UOrmPoolReaper::handlerTime()")
+
+      ppool->reap();
+
+      U_RETURN(0); // monitoring
+      }
+
+#if defined(DEBUG) && defined(U_STDCPP_ENABLE)
+   const char* dump(bool _reset) const { return UEventTime::dump(_reset); }
+#endif
+
+protected:
+   UOrmPool* ppool;
+
+private:
+   U_DISALLOW_COPY_AND_ASSIGN(UOrmPoolReaper)
+};
+
+UOrmPool::UOrmPool(const char* _dbname, uint32_t len, uint32_t _min, uint32_t _max, uint32_t _idle_timeout) : dbname(_dbname, len)
+{
+   U_TRACE_REGISTER_OBJECT(0, UOrmPool, "%.*S,%u,%u,%u,%u", len, _dbname, len, _min, _max, _idle_timeout)
+
+   U_INTERNAL_ASSERT_MAJOR(_max, 0)
+   U_INTERNAL_ASSERT_MAJOR(_idle_timeout, 0)
+   U_INTERNAL_ASSERT(_min <= _max)
+
+   min          = _min;
+   max          = _max;
+   idle_timeout = _idle_timeout;
+   nidle        = nbusy = 0;
+
+   vidle = new idle_session[max];
+
+   // NB: the min session are opened now (in the worker, after the fork) so they are ready for the first request...
+
+   UOrmSession* psession;
+
+   while (nidle < min &&
+          (psession = open()))
+      {
+      vidle[nidle].psession = psession;
+      vidle[nidle].last     = u_now->tv_sec;
+
+      ++nidle;
+      }
+
+   U_NEW(UOrmPoolReaper, reaper, UOrmPoolReaper(this, idle_timeout));
+
+   UTimer::insert(reaper);
+}
+
+UOrmPool::~UOrmPool()
+{
+   U_TRACE_UNREGISTER_OBJECT(0, UOrmPool)
+
+   U_INTERNAL_DUMP("nidle = %u nbusy = %u", nidle, nbusy)
+
+   // NB: if the timers are already cleared the reaper is already deleted...
+
+   if (UTimer::isHandler(reaper))
+      {
+      UTimer::erase(reaper);
+
+      delete reaper;
+      }
+
+   for (uint32_t i = 0; i < nidle; ++i) delete vidle[i].psession;
+
+   delete[] vidle;
+}
+
+UOrmSession* UOrmPool::open()
+{
+   U_TRACE_NO_PARAM(0, "UOrmPool::open()")
+
+   UOrmSession* psession;
+
+   U_NEW(UOrmSession, psession, UOrmSession(this, U_STRING_TO_PARAM(dbname)));
+
+   if (psession->isReady() == false)
+      {
+      U_WARNING("UOrmPool::open(): we couldn't connect to db %V", dbname.rep);
+
+      delete psession;
+
+      U_RETURN_POINTER(0, UOrmSession);
+      }
+
+   U_RETURN_POINTER(psession, UOrmSession);
+}
+
+UOrmSession* UOrmPool::get()
+{
+   U_TRACE_NO_PARAM(0, "UOrmPool::get()")
+
+   U_INTERNAL_DUMP("nidle = %u nbusy = %u max = %u", nidle, nbusy, max)
+
+   UOrmSession* psession;
+
+   if (nidle) psession = vidle[--nidle].psession;
+   else
+      {
+      if (nbusy >= max ||
+          (psession = open()) == 0)
+         {
+         U_RETURN_POINTER(0, UOrmSession);
+         }
+      }
+
+   ++nbusy;
+
+   U_RETURN_POINTER(psession, UOrmSession);
+}
+
+void UOrmPool::release(UOrmSession* psession)
+{
+   U_TRACE(0, "UOrmPool::release(%p)", psession)
+
+   U_INTERNAL_ASSERT_POINTER(psession)
+   U_INTERNAL_ASSERT_MAJOR(nbusy, 0)
+   U_INTERNAL_ASSERT_MINOR(nidle, max)
+
+   --nbusy;
+
+   vidle[nidle].psession = psession;
+   vidle[nidle].last     = u_now->tv_sec;
+
+   ++nidle;
+}
+
+void UOrmPool::reap()
+{
+   U_TRACE_NO_PARAM(0, "UOrmPool::reap()")
+
+   U_INTERNAL_DUMP("nidle = %u nbusy = %u min = %u", nidle, nbusy, min)
+
+   UOrmSession* psession;
+   uint32_t i, n, total = nidle + nbusy;
+   long limit = u_now->tv_sec - idle_timeout;
+
+   // NB: the stack is ordered by time of release, so the expired session are at the bottom...
+
+   for (i = n = 0; i < nidle; ++i)
+      {
+      psession = vidle[i].psession;
+
+      if ((vidle[i].last <= limit &&
+           total > min)           ||
+          psession->pdrv->handlerPing() == false)
+         {
+         delete psession;
+
+         --total;
+
+         continue;
+         }
+
+      vidle[n++] = vidle[i];
+      }
+
+   nidle = n;
+
+   while (size() < min &&
+          (psession = open()))
+      {
+      vidle[nidle].psession = psession;
+      vidle[nidle].last     = u_now->tv_sec;
+
+      ++nidle;
+      }
+
+   U_INTERNAL_DUMP("nidle = %u", nidle)
+}
+
 // creat the SQL statement string with some placeholder (?) 
 
 UOrmStatement::UOrmStatement(UOrmSession& session, const char* stmt, uint32_t len)
 {
    U_TRACE_REGISTER_OBJECT(0, UOrmStatement, "%p,%.*S,%u", &session, len, stmt, len)
 
+   nbatch    = npending = 0;
+   bpipeline = berror   = false;
+
 #if defined(USE_SQLITE) || defined(USE_MYSQL) || defined(USE_PGSQL)
    pdrv = session.pdrv;
 
-        if (pdrv) pstmt = pdrv->handlerStatementCreation(stmt, len);
+        if (pdrv) pstmt = pdrv->getStatement(stmt, len);
    else if (UOrmDriver::env_driver_len) UOrmSession::loadDriverFail(UOrmDriver::env_driver, UOrmDriver::env_driver_len);
 #else
    pdrv  = 0;
@@ -214,7 +452,7 @@ UOrmStatement::~UOrmStatement()
 
    U_INTERNAL_DUMP("pstmt = %p", pstmt)
 
-   if (pstmt) pdrv->remove(pstmt);
+   if (pstmt) pdrv->releaseStatement(pstmt);
 #endif
 }
 
@@ -230,6 +468,134 @@ void UOrmStatement::execute()
 #endif
 }
 
+bool UOrmStatement::asyncExecute()
+{
+   U_TRACE_NO_PARAM(0, "UOrmStatement::asyncExecute()")
+
+#if defined(USE_SQLITE) || defined(USE_MYSQL) || defined(USE_PGSQL)
+   U_INTERNAL_ASSERT_POINTER(pdrv)
+   U_INTERNAL_ASSERT_POINTER(pstmt)
+
+   if (pdrv->asyncExecute(pstmt)) U_RETURN(true);
+#endif
+
+   U_RETURN(false);
+}
+
+bool UOrmStatement::asyncResult()
+{
+   U_TRACE_NO_PARAM(0, "UOrmStatement::asyncResult()")
+
+#if defined(USE_SQLITE) || defined(USE_MYSQL) || defined(USE_PGSQL)
+   U_INTERNAL_ASSERT_POINTER(pdrv)
+   U_INTERNAL_ASSERT_POINTER(pstmt)
+
+   if (pdrv->asyncResult(pstmt)) U_RETURN(true);
+#endif
+
+   U_RETURN(false);
+}
+
+// BATCH
+
+bool UOrmStatement::beginBatch()
+{
+   U_TRACE_NO_PARAM(0, "UOrmStatement::beginBatch()")
+
+#if defined(USE_SQLITE) || defined(USE_MYSQL) || defined(USE_PGSQL)
+   U_INTERNAL_ASSERT_POINTER(pdrv)
+   U_INTERNAL_ASSERT_POINTER(pstmt)
+   U_INTERNAL_ASSERT_EQUALS(nbatch, 0)
+
+   if (pdrv->handlerQuery(U_CONSTANT_TO_PARAM("BEGIN")))
+      {
+      // NB: the transaction must start before the pipeline, where the synchronous query are not allowed...
+
+      bpipeline = pdrv->handlerPipeline(true);
+
+      nbatch = npending = 0;
+      berror = false;
+
+      U_RETURN(true);
+      }
+#endif
+
+   U_RETURN(false);
+}
+
+void UOrmStatement::readBatch()
+{
+   U_TRACE_NO_PARAM(0, "UOrmStatement::readBatch()")
+
+   U_INTERNAL_DUMP("npending = %u", npending)
+
+   for (; npending; --npending)
+      {
+      if (pdrv->asyncResult(pstmt) == false) berror = true;
+      }
+}
+
+bool UOrmStatement::addBatch()
+{
+   U_TRACE_NO_PARAM(0, "UOrmStatement::addBatch()")
+
+#if defined(USE_SQLITE) || defined(USE_MYSQL) || defined(USE_PGSQL)
+   U_INTERNAL_ASSERT_POINTER(pdrv)
+   U_INTERNAL_ASSERT_POINTER(pstmt)
+
+   if (pdrv->asyncExecute(pstmt) == false) berror = true;
+   else
+      {
+      ++nbatch;
+
+      // NB: we read the results every U_ORM_BATCH_SIZE rows to bound the memory of the pipeline (client and server side)...
+
+      if (bpipeline &&
+          ++npending >= U_ORM_BATCH_SIZE)
+         {
+         readBatch();
+         }
+      }
+
+   if (berror == false) U_RETURN(true);
+#endif
+
+   U_RETURN(false);
+}
+
+bool UOrmStatement::endBatch()
+{
+   U_TRACE_NO_PARAM(0, "UOrmStatement::endBatch()")
+
+#if defined(USE_SQLITE) || defined(USE_MYSQL) || defined(USE_PGSQL)
+   U_INTERNAL_ASSERT_POINTER(pdrv)
+   U_INTERNAL_ASSERT_POINTER(pstmt)
+
+   U_INTERNAL_DUMP("nbatch = %u npending = %u bpipeline = %b berror = %b", nbatch, npending, bpipeline, berror)
+
+   if (bpipeline)
+      {
+      readBatch();
+
+      (void) pdrv->handlerPipeline(false);
+
+      bpipeline = false;
+      }
+
+   nbatch = 0;
+
+   if (berror == false &&
+       pdrv->handlerQuery(U_CONSTANT_TO_PARAM("COMMIT")))
+      {
+      U_RETURN(true);
+      }
+
+   (void) pdrv->handlerQuery(U_CONSTANT_TO_PARAM("ROLLBACK"));
+#endif
+
+   U_RETURN(false);
+}
+
 // This function returns the number of database rows that were changed
 // or inserted or deleted by the most recently completed SQL statement
 
@@ -765,9 +1131,33 @@ const char* UOrmSession::dump(bool _reset) const
    return 0;
 }
 
+const char* UOrmPool::dump(bool _reset) const
+{
+   *UObjectIO::os << "min                " << min          << '\n'
+                  << "max                " << max          << '\n'
+                  << "nidle              " << nidle        << '\n'
+                  << "nbusy              " << nbusy        << '\n'
+                  << "reaper             " << (void*)reaper << '\n'
+                  << "idle_timeout       " << idle_timeout << '\n'
+                  << "dbname  (UString   " << (void*)&dbname << ')';
+
+   if (_reset)
+      {
+      UObjectIO::output();
+
+      return UObjectIO::buffer_output;
+      }
+
+   return 0;
+}
+
 const char* UOrmStatement::dump(bool _reset) const
 {
    *UObjectIO::os << "pstmt            " << pstmt       << '\n'
+                  << "nbatch           " << nbatch      << '\n'
+                  << "berror           " << berror      << '\n'
+                  << "npending         " << npending    << '\n'
+                  << "bpipeline        " << bpipeline   << '\n'
                   << "pdrv (UOrmDriver " << (void*)pdrv << ')';
 
    if (_reset)
@@ -37,6 +37,110 @@ UVector<UOrmDriver*>* UOrmDriver::vdriver;
 UOrmDriver::~UOrmDriver()
 {
    U_TRACE_UNREGISTER_OBJECT(0, UOrmDriver)
+
+   if (vstmt) delete[] vstmt;
+}
+
+USqlStatement* UOrmDriver::getStatement(const char* stmt, uint32_t len)
+{
+   U_TRACE(0, "UOrmDriver::getStatement(%.*S,%u)", len, stmt, len)
+
+   stmt_cache* ptr;
+   stmt_cache* end;
+   stmt_cache* pfree = 0; // the least recently used slot not busy
+   USqlStatement* pstmt;
+
+   if (vstmt == 0) vstmt = new stmt_cache[U_ORM_STMT_CACHE_SIZE]();
+
+   for (ptr = vstmt, end = vstmt + U_ORM_STMT_CACHE_SIZE; ptr < end; ++ptr)
+      {
+      if (ptr->busy) continue;
+
+      if (ptr->pstmt &&
+          ptr->sql.equal(stmt, len))
+         {
+         ptr->busy = true;
+         ptr->last = ++stmt_clock;
+
+         U_RETURN_POINTER(ptr->pstmt, USqlStatement); // NB: the bindings was reset by releaseStatement()...
+         }
+
+      if (pfree == 0 ||
+          ptr->last < pfree->last)
+         {
+         pfree = ptr;
+         }
+      }
+
+   pstmt = handlerStatementCreation(stmt, len);
+
+   if (pstmt &&
+       pfree)
+      {
+      if (pfree->pstmt) handlerStatementRemove(pfree->pstmt);
+
+      (void) pfree->sql.replace(stmt, len);
+
+      pfree->pstmt = pstmt;
+      pfree->last  = ++stmt_clock;
+      pfree->busy  = true;
+      }
+
+   U_RETURN_POINTER(pstmt, USqlStatement);
+}
+
+void UOrmDriver::releaseStatement(USqlStatement* pstmt)
+{
+   U_TRACE(0, "UOrmDriver::releaseStatement(%p)", pstmt)
+
+   U_INTERNAL_ASSERT_POINTER(pstmt)
+
+   if (vstmt &&
+       connection)
+      {
+      for (stmt_cache* ptr = vstmt, *end = vstmt + U_ORM_STMT_CACHE_SIZE; ptr < end; ++ptr)
+         {
+         if (ptr->pstmt == pstmt)
+            {
+            U_INTERNAL_ASSERT(ptr->busy)
+
+            reset(pstmt); // NB: the bindings refer to the variable of the owner...
+
+            ptr->busy = false;
+
+            return;
+            }
+         }
+      }
+
+   handlerStatementRemove(pstmt);
+}
+
+void UOrmDriver::clearStatement()
+{
+   U_TRACE_NO_PARAM(0, "UOrmDriver::clearStatement()")
+
+   if (vstmt)
+      {
+      // NB: the statement still owned by a UOrmStatement are removed by its destructor...
+
+      for (stmt_cache* ptr = vstmt, *end = vstmt + U_ORM_STMT_CACHE_SIZE; ptr < end; ++ptr)
+         {
+         if (ptr->pstmt &&
+             ptr->busy == false)
+            {
+            handlerStatementRemove(ptr->pstmt);
+            }
+
+         ptr->pstmt = 0;
+         ptr->last  = 0;
+         ptr->busy  = false;
+
+         ptr->sql.clear();
+         }
+
+      stmt_clock = 0;
+      }
 }
 
 void UOrmDriver::clear()
@@ -206,6 +310,8 @@ void UOrmDriver::printError(const char* function)
 {
    U_TRACE(0, "UOrmDriver::printError(%S)", function)
 
+   ++num_error;
+
    handlerError();
 
    const char* ptr1 = (errname  == 0 ? (errname = "")
@@ -696,6 +802,7 @@ const char* UOrmDriver::dump(bool _reset) const
 {
    *UObjectIO::os << "errmsg                   " << (void*)errmsg     << '\n'
                   << "errcode                  " << errcode           << '\n'
+                  << "num_error                " << num_error         << '\n'
                   << "connection               " << (void*)connection << '\n'
                   << "opt    (UString          " << (void*)&opt       << ")\n"
                   << "name   (UString          " << (void*)&name      << ")\n"
@@ -134,7 +134,11 @@ U_NO_EXPORT bool UPCRE::checkBrackets()
 
       if (p_pcre_extra)
          {
+#     ifdef PCRE_STUDY_JIT_COMPILE
+         U_SYSCALL_VOID(pcre_free_study, "%p", p_pcre_extra); // NB: it free also the JIT code...
+#     else
          U_SYSCALL_VOID(pcre_free, "%p", p_pcre_extra);
+#     endif
 
          p_pcre_extra = 0;
          }
@@ -260,7 +264,11 @@ void UPCRE::clear()
 
    if (p_pcre_extra)
       {
+#  ifdef PCRE_STUDY_JIT_COMPILE
+      U_SYSCALL_VOID(pcre_free_study, "%p", p_pcre_extra);
+#  else
       U_SYSCALL_VOID(pcre_free, "%p", p_pcre_extra);
+#  endif
                                       p_pcre_extra = 0;
       }
 
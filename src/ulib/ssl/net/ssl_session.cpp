@@ -11,10 +11,11 @@
 //
 // ============================================================================
 
-#include <ulib/db/rdb.h>
-#include <ulib/utility/uhttp.h>
+#include <ulib/timer.h>
 #include <ulib/ssl/net/ssl_session.h>
 
+#include <openssl/rand.h>
+
 /**
  * Forward secrecy
  *
@@ -32,119 +33,319 @@
  * past connections. Most servers will generate a random Session Ticket key at startup unless otherwise configured, but you should check
  */
 
-SSL_SESSION* USSLSession::sess;
+USSLSession::cache* USSLSession::ptr;
 
-// define method VIRTUAL of class UDataStorage
+class U_NO_EXPORT USSLSessionTicketKey : public UEventTime {
+public:
 
-char* USSLSession::toBuffer()
-{
-   U_TRACE_NO_PARAM(0, "USSLSession::toBuffer()")
+   USSLSessionTicketKey() : UEventTime(U_SSL_TICKET_KEY_ROTATION, 0L)
+      {
+      U_TRACE_REGISTER_OBJECT(0, USSLSessionTicketKey, "", 0)
+      }
 
-   U_INTERNAL_ASSERT_POINTER(sess)
+   virtual ~USSLSessionTicketKey() U_DECL_FINAL
+      {
+      U_TRACE_UNREGISTER_OBJECT(0, USSLSessionTicketKey)
+      }
 
-   // converts SSL_SESSION object to ASN1 representation
+   // define method VIRTUAL of class UEventTime
 
-   unsigned char* p = (unsigned char*)u_buffer;
+   virtual int handlerTime() U_DECL_FINAL
+      {
+      U_TRACE_NO_PARAM(0, "USSLSessionTicketKey::handlerTime()")
 
-   u_buffer_len = U_SYSCALL(i2d_SSL_SESSION, "%p,%p", sess, &p);
+      // NB: every preforked process has this timer, the first that expire make the rotation for all and the others are rearmed at the new time...
 
-   U_INTERNAL_ASSERT_MAJOR(u_buffer_len, 0)
+      UEventTime::setTimeToExpire(USSLSession::checkTicketKey());
 
-   buffer_len = u_buffer_len;
+      U_RETURN(0); // monitoring
+      }
 
-   U_RETURN(u_buffer);
-}
+#if defined(DEBUG) && defined(U_STDCPP_ENABLE)
+   const char* dump(bool _reset) const { return UEventTime::dump(_reset); }
+#endif
 
-void USSLSession::fromData(const char* ptr, uint32_t len)
+private:
+   U_DISALLOW_COPY_AND_ASSIGN(USSLSessionTicketKey)
+};
+
+void USSLSession::init(SSL_CTX* ctx)
 {
-   U_TRACE(0, "USSLSession::fromData(%.*S,%u)", len, ptr, len)
+   U_TRACE(1, "USSLSession::init(%p)", ctx)
 
    U_INTERNAL_ASSERT_POINTER(ptr)
 
-   // converts SSL_SESSION object from ASN1 representation
+   if (U_SYSCALL(RAND_bytes, "%p,%d", (unsigned char*)ptr->key, sizeof(ptr->key)) <= 0) U_ERROR("SSL: RAND_bytes() failed for the session ticket keys");
 
-#ifdef HAVE_OPENSSL_97
-         unsigned char* p =       (unsigned char*)ptr;
+   ptr->key_rotate = u_now->tv_sec + U_SSL_TICKET_KEY_ROTATION;
+
+#if OPENSSL_VERSION_NUMBER < 0x30000000L
+   (void) U_SYSCALL(SSL_CTX_set_tlsext_ticket_key_cb,     "%p,%p", ctx, USSLSession::ticketKeyCallback);
 #else
-   const unsigned char* p = (const unsigned char*)ptr;
+   (void) U_SYSCALL(SSL_CTX_set_tlsext_ticket_key_evp_cb, "%p,%p", ctx, USSLSession::ticketKeyCallback);
 #endif
 
-   sess = (SSL_SESSION*) U_SYSCALL(d2i_SSL_SESSION, "%p,%p,%ld", 0, &p, (long)len);
+   UEventTime* rotation;
+
+   U_NEW(USSLSessionTicketKey, rotation, USSLSessionTicketKey);
+
+   UTimer::insert(rotation);
 }
 
-int USSLSession::newSession(SSL* ssl, SSL_SESSION* _sess)
+long USSLSession::checkTicketKey()
 {
-   U_TRACE(0, "USSLSession::newSession(%p,%p)", ssl, _sess)
+   U_TRACE_NO_PARAM(0, "USSLSession::checkTicketKey()")
+
+   U_INTERNAL_ASSERT_POINTER(ptr)
+
+   if (u_now->tv_sec >= ptr->key_rotate) (void) rotateTicketKey();
+
+   long remain = ptr->key_rotate - u_now->tv_sec;
+
+   if (remain <= 0) remain = 1; // NB: another process hold the seqlock for the rotation, we check again soon...
+
+   U_RETURN(remain);
+}
+
+bool USSLSession::rotateTicketKey()
+{
+   U_TRACE_NO_PARAM(1, "USSLSession::rotateTicketKey()")
+
+   U_INTERNAL_ASSERT_POINTER(ptr)
+
+   ticket_key key;
+
+   // NB: the new key is generated before to take the seqlock, so the readers wait only for the copy...
+
+   if (U_SYSCALL(RAND_bytes, "%p,%d", (unsigned char*)&key, sizeof(ticket_key)) <= 0) U_RETURN(false);
 
-/*
-#ifdef DEBUG
-   static FILE* fp = (FILE*) U_SYSCALL(fopen, "%S,%S", "/tmp/ssl_session.new", "a");
-   if (fp) (void) U_SYSCALL(SSL_SESSION_print_fp, "%p,%p", fp, _sess);
+   uint32_t seq = ptr->key_seq;
+
+   if ((seq & 1) == 0 &&
+       __sync_bool_compare_and_swap(&(ptr->key_seq), seq, seq+1))
+      {
+      // NB: another process can have made the rotation after we have read key_rotate, in this case we must not lose the previous key...
+
+      if (u_now->tv_sec < ptr->key_rotate)
+         {
+         __atomic_store_n(&(ptr->key_seq), seq, __ATOMIC_RELEASE); // the keys are not changed
+
+         U_RETURN(false);
+         }
+
+      ptr->key[1] = ptr->key[0];
+      ptr->key[0] = key;
+
+      ptr->key_rotate = u_now->tv_sec + U_SSL_TICKET_KEY_ROTATION;
+
+      __atomic_store_n(&(ptr->key_seq), seq+2, __ATOMIC_RELEASE);
+
+      U_RETURN(true);
+      }
+
+   U_RETURN(false);
+}
+
+bool USSLSession::getTicketKey(ticket_key* key)
+{
+   U_TRACE(0, "USSLSession::getTicketKey(%p)", key)
+
+   U_INTERNAL_ASSERT_POINTER(ptr)
+
+   uint32_t seq;
+
+   // NB: the writer can be preempted (or die) while it hold the seqlock, so we don't wait forever: the caller fall back to the full handshake...
+
+   for (uint32_t i = 0; i < U_SSL_TICKET_KEY_MAX_RETRY; ++i)
+      {
+      seq = __atomic_load_n(&(ptr->key_seq), __ATOMIC_ACQUIRE);
+
+      if (seq & 1) continue;
+
+      U_MEMCPY(key, ptr->key, sizeof(ptr->key));
+
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+      if (__atomic_load_n(&(ptr->key_seq), __ATOMIC_RELAXED) == seq) U_RETURN(true);
+      }
+
+   U_RETURN(false);
+}
+
+/**
+ * The callback is called for every ticket encrypted or decrypted. When the ticket is encrypted we use the current key,
+ * on decryption we accept also the previous key but in this case we ask the renewal of the ticket (return value 2)
+ */
+
+#if OPENSSL_VERSION_NUMBER < 0x30000000L
+int USSLSession::ticketKeyCallback(SSL* ssl, unsigned char* name, unsigned char* iv, EVP_CIPHER_CTX* ectx, HMAC_CTX* hctx, int enc)
+#else
+int USSLSession::ticketKeyCallback(SSL* ssl, unsigned char* name, unsigned char* iv, EVP_CIPHER_CTX* ectx, EVP_MAC_CTX* hctx, int enc)
 #endif
-*/
+{
+   U_TRACE(0, "USSLSession::ticketKeyCallback(%p,%p,%p,%p,%p,%d)", ssl, name, iv, ectx, hctx, enc)
 
-   sess = _sess;
+   int i, result;
+   ticket_key key[2];
 
-#if OPENSSL_VERSION_NUMBER < 0x10100000L
-   UHTTP::db_session_ssl->insertDataStorage((const char*)sess->session_id, sess->session_id_length);
+   if (u_now->tv_sec >= ptr->key_rotate) (void) rotateTicketKey(); // NB: in case the timer is late...
+
+   if (getTicketKey(key) == false) U_RETURN(0); // NB: the keys are being rotated, no ticket (full handshake)...
+
+   if (enc)
+      {
+      if (RAND_bytes(iv, EVP_MAX_IV_LENGTH) <= 0) U_RETURN(-1);
+
+      U_MEMCPY(name, key[0].name, 16);
+
+      i      = 0;
+      result = 1;
+
+      if (EVP_EncryptInit_ex(ectx, EVP_aes_256_cbc(), 0, key[0].aes_key, iv) == 0) U_RETURN(-1);
+      }
+   else
+      {
+           if (memcmp(name, key[0].name, 16) == 0) { i = 0; result = 1; }
+      else if (memcmp(name, key[1].name, 16) == 0) { i = 1; result = 2; } // renew the ticket
+      else
+         {
+         U_RETURN(0); // unknown key (expired): full handshake
+         }
+
+      if (EVP_DecryptInit_ex(ectx, EVP_aes_256_cbc(), 0, key[i].aes_key, iv) == 0) U_RETURN(-1);
+      }
+
+#if OPENSSL_VERSION_NUMBER < 0x30000000L
+   if (HMAC_Init_ex(hctx, key[i].hmac_key, sizeof(key[i].hmac_key), EVP_sha256(), 0) == 0) U_RETURN(-1);
 #else
+   OSSL_PARAM params[2] = { OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char*)"SHA256", 0), OSSL_PARAM_construct_end() };
+
+   if (EVP_MAC_init(hctx, key[i].hmac_key, sizeof(key[i].hmac_key), params) == 0) U_RETURN(-1);
+#endif
+
+   U_RETURN(result);
+}
+
+// SESSION ID CACHE
+
+int USSLSession::newSession(SSL* ssl, SSL_SESSION* sess)
+{
+   U_TRACE(1, "USSLSession::newSession(%p,%p)", ssl, sess)
+
+   U_INTERNAL_ASSERT_POINTER(ptr)
+
    unsigned int idlen;
-   const unsigned char* id = (const unsigned char*) U_SYSCALL(SSL_SESSION_get_id, "", sess, &idlen);
+   const unsigned char* id;
 
-   UHTTP::db_session_ssl->insertDataStorage((const char*)id, idlen);
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+   id    = sess->session_id;
+   idlen = sess->session_id_length;
+#else
+   id = (const unsigned char*) U_SYSCALL(SSL_SESSION_get_id, "%p,%p", sess, &idlen);
 #endif
 
+   int len = U_SYSCALL(i2d_SSL_SESSION, "%p,%p", sess, 0);
+
+   if (len > 0                      &&
+       len <= U_SSL_SESSION_MAX_SIZE &&
+       idlen <= SSL_MAX_SSL_SESSION_ID_LENGTH)
+      {
+      slot* s = ptr->slots + getSlot(id, idlen);
+
+      uint32_t seq = s->seq;
+
+      // NB: if another process is writing the same slot we give up, it is only a cache...
+
+      if ((seq & 1) == 0 &&
+          __sync_bool_compare_and_swap(&(s->seq), seq, seq+1))
+         {
+         unsigned char* p = s->data;
+
+         s->len    = U_SYSCALL(i2d_SSL_SESSION, "%p,%p", sess, &p);
+         s->id_len = idlen;
+         s->expire = u_now->tv_sec + SSL_SESSION_get_timeout(sess);
+
+         U_MEMCPY(s->id, id, idlen);
+
+         __atomic_store_n(&(s->seq), seq+2, __ATOMIC_RELEASE);
+         }
+      }
+
    U_RETURN(0);
 }
 
 SSL_SESSION* USSLSession::getSession(SSL* ssl, unsigned char* id, int len, int* copy)
 {
-   U_TRACE(0, "USSLSession::getSession(%p,%.*S,%d,%p)", ssl, len, id, len, copy)
+   U_TRACE(1, "USSLSession::getSession(%p,%.*S,%d,%p)", ssl, len, id, len, copy)
+
+   U_INTERNAL_ASSERT_POINTER(ptr)
 
-   sess  = 0;
    *copy = 0;
 
-   UHTTP::db_session_ssl->getDataStorage((const char*)id, (uint32_t)len);
+   if (len > SSL_MAX_SSL_SESSION_ID_LENGTH) U_RETURN_POINTER(0, SSL_SESSION);
+
+   uint32_t sz;
+   slot* s = ptr->slots + getSlot(id, len);
+   unsigned char buffer[U_SSL_SESSION_MAX_SIZE];
+   uint32_t seq = __atomic_load_n(&(s->seq), __ATOMIC_ACQUIRE);
+
+   if ((seq & 1)                        ||
+       s->id_len != (uint32_t)len       ||
+       s->expire < u_now->tv_sec        ||
+       memcmp(s->id, id, len) != 0      ||
+       (sz = s->len) > U_SSL_SESSION_MAX_SIZE)
+      {
+      U_RETURN_POINTER(0, SSL_SESSION);
+      }
+
+   U_MEMCPY(buffer, s->data, sz);
+
+   __atomic_thread_fence(__ATOMIC_ACQUIRE);
 
-/*
-#ifdef DEBUG
-   static FILE* fp = (FILE*) U_SYSCALL(fopen, "%S,%S", "/tmp/ssl_session.get", "a");
-   if (fp) (void) U_SYSCALL(SSL_SESSION_print_fp, "%p,%p", fp, sess);
+   if (__atomic_load_n(&(s->seq), __ATOMIC_RELAXED) != seq) U_RETURN_POINTER(0, SSL_SESSION); // NB: a writer changed the slot while we read it...
+
+   // converts SSL_SESSION object from ASN1 representation
+
+#ifdef HAVE_OPENSSL_97
+         unsigned char* p =       (unsigned char*)buffer;
+#else
+   const unsigned char* p = (const unsigned char*)buffer;
 #endif
-*/
+
+   SSL_SESSION* sess = (SSL_SESSION*) U_SYSCALL(d2i_SSL_SESSION, "%p,%p,%ld", 0, &p, (long)sz);
 
    U_RETURN_POINTER(sess, SSL_SESSION);
 }
 
-void USSLSession::removeSession(SSL_CTX* ctx, SSL_SESSION* _sess)
+void USSLSession::removeSession(SSL_CTX* ctx, SSL_SESSION* sess)
 {
-   U_TRACE(0, "USSLSession::removeSession(%p,%p)", ctx, _sess)
-
-/*
-#ifdef DEBUG
-   static FILE* fp = (FILE*) U_SYSCALL(fopen, "%S,%S", "/tmp/ssl_session.del", "a");
-   if (fp) (void) U_SYSCALL(SSL_SESSION_print_fp, "%p,%p", fp, _sess);
-#endif
-*/
+   U_TRACE(1, "USSLSession::removeSession(%p,%p)", ctx, sess)
 
-   U_INTERNAL_ASSERT_POINTER(UHTTP::db_session_ssl)
+   U_INTERNAL_ASSERT_POINTER(ptr)
 
-   int result;
+   unsigned int idlen;
+   const unsigned char* id;
 
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
-   result = UHTTP::db_session_ssl->remove((const char*)_sess->session_id, (uint32_t)_sess->session_id_length);
+   id    = sess->session_id;
+   idlen = sess->session_id_length;
 #else
-   unsigned int idlen;
-   const unsigned char* id = (const unsigned char*) U_SYSCALL(SSL_SESSION_get_id, "", sess, &idlen);
-
-   result = UHTTP::db_session_ssl->remove((const char*)id, (uint32_t)idlen);
+   id = (const unsigned char*) U_SYSCALL(SSL_SESSION_get_id, "%p,%p", sess, &idlen);
 #endif
 
-   // -2: The entry was already marked deleted in the hash-tree
+   slot* s = ptr->slots + getSlot(id, idlen);
+
+   uint32_t seq = s->seq;
 
-   if (result &&
-       result != -2)
+   if ((seq & 1) == 0 &&
+       __sync_bool_compare_and_swap(&(s->seq), seq, seq+1))
       {
-      U_WARNING("Remove of SSL session on db failed with error %d", result);
+      if (s->id_len == idlen &&
+          memcmp(s->id, id, idlen) == 0)
+         {
+         s->id_len = 0;
+         }
+
+      __atomic_store_n(&(s->seq), seq+2, __ATOMIC_RELEASE);
       }
 }
@@ -31,7 +31,14 @@
 #define SSL_ERROR_WANT_ACCEPT SSL_ERROR_WANT_READ
 #endif
 
+#if defined(U_USE_KTLS) && !defined(TCP_ULP)
+#define TCP_ULP 31 // attach a ULP (f.e. tls) to a TCP connection (Linux >= 4.13)
+#endif
+
 int      USSLSocket::session_cache_index;
+bool     USSLSocket::bktls;
+bool     USSLSocket::bktls_checked;
+bool     USSLSocket::bdefer_handshake;
 SSL_CTX* USSLSocket::cctx; // client
 SSL_CTX* USSLSocket::sctx; // server
 
@@ -703,11 +710,11 @@ bool USSLSocket::setContext(const char* dh_file, const char* cert_file, const ch
    U_RETURN(true);
 }
 
-void USSLSocket::setStatus(SSL* _ssl, int _ret, bool _flag)
+uint32_t USSLSocket::setStatus(char* buffer, uint32_t size, SSL* _ssl, int _ret, bool _flag)
 {
-   U_TRACE(1, "USSLSocket::setStatus(%p,%d,%b)", _ssl, _ret, _flag)
+   U_TRACE(1, "USSLSocket::setStatus(%p,%u,%p,%d,%b)", buffer, size, _ssl, _ret, _flag)
 
-   uint32_t sz;
+   uint32_t sz, len;
    char buf[1024];
    long i1 = 0, i2;
    const char* descr  = "SSL_ERROR_NONE";
@@ -792,9 +799,7 @@ void USSLSocket::setStatus(SSL* _ssl, int _ret, bool _flag)
          }
       }
 
-   U_INTERNAL_ASSERT_EQUALS(u_buffer_len, 0)
-
-   u_buffer_len = u__snprintf(u_buffer, U_BUFFER_SIZE, U_CONSTANT_TO_PARAM("(%d, %s) - %s"), _ret, descr, errstr);
+   len = u__snprintf(buffer, size, U_CONSTANT_TO_PARAM("(%d, %s) - %s"), _ret, descr, errstr);
 
    while ((i2 = ERR_get_error()))
       {
@@ -806,10 +811,12 @@ void USSLSocket::setStatus(SSL* _ssl, int _ret, bool _flag)
 
       U_INTERNAL_DUMP("buf = %.*S", sz, buf)
 
-      u_buffer_len += u__snprintf(u_buffer + u_buffer_len, U_BUFFER_SIZE - u_buffer_len, U_CONSTANT_TO_PARAM(" (%ld, %.*s)"), i2, sz, buf);
+      len += u__snprintf(buffer + len, size - len, U_CONSTANT_TO_PARAM(" (%ld, %.*s)"), i2, sz, buf);
       }
 
-   U_INTERNAL_DUMP("status = %.*S", u_buffer_len, u_buffer)
+   U_INTERNAL_DUMP("status = %.*S", len, buffer)
+
+   U_RETURN(len);
 }
 
 bool USSLSocket::secureConnection()
@@ -880,6 +887,36 @@ loop:
    U_RETURN(false);
 }
 
+bool USSLSocket::enableKTLS(SSL_CTX* _ctx)
+{
+   U_TRACE(1, "USSLSocket::enableKTLS(%p)", _ctx)
+
+   U_INTERNAL_ASSERT_POINTER(_ctx)
+
+#ifdef U_USE_KTLS
+   // NB: OpenSSL continue silently in userspace if the kernel don't have the tls ULP (module tls), so we probe it on a socket:
+   //     ENOENT => no tls ULP (the kernel try to load the module), ENOPROTOOPT => no TCP_ULP, ENOTCONN (or 0) => the tls ULP is available...
+
+   int fd = U_SYSCALL(socket, "%d,%d,%d", AF_INET, SOCK_STREAM, 0);
+
+   if (fd != -1)
+      {
+      bool bulp = (U_SYSCALL(setsockopt, "%d,%d,%d,%p,%u", fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) == 0 || errno == ENOTCONN);
+
+      (void) U_SYSCALL(close, "%d", fd);
+
+      if (bulp)
+         {
+         (void) U_SYSCALL(SSL_CTX_set_options, "%p,%d", _ctx, SSL_OP_ENABLE_KTLS);
+
+         U_RETURN(true);
+         }
+      }
+#endif
+
+   U_RETURN(false);
+}
+
 // server side RE-NEGOTIATE asking for client cert
 
 bool USSLSocket::askForClientCertificate()
@@ -946,43 +983,63 @@ bool USSLSocket::askForClientCertificate()
    U_RETURN(true);
 }
 
-bool USSLSocket::acceptSSL(USSLSocket* pcNewConnection)
+bool USSLSocket::acceptSSL(USSLSocket* pcNewConnection, int timeoutMS)
 {
-   U_TRACE(1+256, "USSLSocket::acceptSSL(%p)", pcNewConnection)
+   U_TRACE(1+256, "USSLSocket::acceptSSL(%p,%d)", pcNewConnection, timeoutMS)
 
-   int fd         = pcNewConnection->iSockDesc;
+   struct timespec ts;
+   long deadline = 0;
+   int fd        = pcNewConnection->iSockDesc;
    uint32_t count = 0;
 
    U_DUMP("fd = %d isBlocking() = %b", fd, pcNewConnection->isBlocking())
 
-   U_INTERNAL_ASSERT_EQUALS(ssl, 0)
+   U_INTERNAL_ASSERT_EQUALS(pcNewConnection->ssl, 0)
+
+   // NB: we don't use the member ssl of the listening socket, so we can be called at the same time by more thread (see handshake offload)...
 
-   ssl = (SSL*) U_SYSCALL(SSL_new, "%p", ctx);
+   SSL* _ssl = (SSL*) U_SYSCALL(SSL_new, "%p", ctx);
 
    // --------------------------------------------------------------------------------------------------
    // When beginning a new handshake, the SSL engine must know whether it must call the connect (client)
    // or accept (server) routines. Even though it may be clear from the method chosen, whether client or
    // server mode was requested, the handshake routines must be explicitly set
    // --------------------------------------------------------------------------------------------------
-   // U_SYSCALL_VOID(SSL_set_accept_state, "%p", ssl); // init SSL server session
+   // U_SYSCALL_VOID(SSL_set_accept_state, "%p", _ssl); // init SSL server session
    // --------------------------------------------------------------------------------------------------
 
-   (void) U_SYSCALL(SSL_set_fd, "%p,%d", ssl, fd); // get SSL to use our socket
+   (void) U_SYSCALL(SSL_set_fd, "%p,%d", _ssl, fd); // get SSL to use our socket
 
 loop:
    errno = 0;
-   ret   = U_SYSCALL(SSL_accept, "%p", ssl); // get SSL handshake with client
+   int _ret = U_SYSCALL(SSL_accept, "%p", _ssl); // get SSL handshake with client
 
-   if (ret == 1)
+   if (_ret == 1)
       {
-      SSL_set_app_data(ssl, pcNewConnection);
+      SSL_set_app_data(_ssl, pcNewConnection);
 
-      pcNewConnection->ssl            = ssl;
+      pcNewConnection->ssl            = _ssl;
       pcNewConnection->ret            = SSL_ERROR_NONE;
       pcNewConnection->iState         = CONNECT;
       pcNewConnection->renegotiations = 0;
 
-      ssl = 0;
+#  ifdef U_USE_KTLS
+      if (bktls)
+         {
+         bool bactive = pcNewConnection->isKTLSActive();
+
+         pcNewConnection->USocket::setKTLS(bactive);
+
+         // NB: the kernel can refuse the keys (f.e. for the negotiated cipher) and OpenSSL continue in userspace, so we report the real state...
+
+         if (bktls_checked == false)
+            {
+            bktls_checked = true;
+
+            U_SRV_LOG("SSL: kernel TLS offload is %sactive on the first connection (cipher %s)", (bactive ? "" : "NOT "), SSL_get_cipher_name(_ssl));
+            }
+         }
+#  endif
 
       U_RETURN(true);
       }
@@ -991,24 +1048,56 @@ loop:
 
    if (errno) pcNewConnection->iState = -errno;
 
-   pcNewConnection->ret = U_SYSCALL(SSL_get_error, "%p,%d", ssl, ret);
+   pcNewConnection->ret = U_SYSCALL(SSL_get_error, "%p,%d", _ssl, _ret);
 
 #ifdef DEBUG
-   dumpStatus(pcNewConnection->ret, false);
+   char status[1024]; // NB: not u_buffer, we can be on a helper thread (see handshake offload)...
+   uint32_t len = setStatus(status, sizeof(status), _ssl, pcNewConnection->ret, false);
+
+   U_INTERNAL_DUMP("status = %.*S", len, status)
 #endif
 
    U_INTERNAL_DUMP("count = %u", count)
 
    if (count++ < 5)
       {
-           if (pcNewConnection->ret == SSL_ERROR_WANT_READ)  { if (UNotifier::waitForRead( fd, U_SSL_TIMEOUT_MS) > 0) goto loop; }
-      else if (pcNewConnection->ret == SSL_ERROR_WANT_WRITE) { if (UNotifier::waitForWrite(fd, U_SSL_TIMEOUT_MS) > 0) goto loop; }
+      // NB: the timeout is for the whole handshake and not for every step, so a slow client can't keep busy a helper thread for long...
+
+      (void) clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+
+      long now = (ts.tv_sec * 1000L) + (ts.tv_nsec / 1000000L);
+
+      if (deadline == 0) deadline = now + timeoutMS;
+
+      int ms = (int)(deadline - now);
+
+      U_INTERNAL_DUMP("ms = %d", ms)
+
+      if (ms >= 100 &&
+          (pcNewConnection->ret == SSL_ERROR_WANT_READ ||
+           pcNewConnection->ret == SSL_ERROR_WANT_WRITE))
+         {
+         // NB: not UNotifier::waitForRead()/waitForWrite(), they use the static UNotifier::fds[] shared with the event loop and the other helper thread...
+
+         struct pollfd pfd;
+
+         pfd.fd      = fd;
+         pfd.events  = (pcNewConnection->ret == SSL_ERROR_WANT_READ ? POLLIN : POLLOUT);
+         pfd.revents = 0;
+
+         int n = U_SYSCALL(poll, "%p,%d,%d", &pfd, 1, ms);
+
+         if (n > 0 ||
+             (n == -1 && errno == EINTR)) // NB: the deadline is checked again...
+            {
+            goto loop;
+            }
+         }
       }
 
    errno = -pcNewConnection->iState;
 
-   U_SYSCALL_VOID(SSL_free, "%p", ssl);
-                                  ssl = 0;
+   U_SYSCALL_VOID(SSL_free, "%p", _ssl);
 
    pcNewConnection->USocket::_close_socket();
 
@@ -1051,6 +1140,7 @@ loop: ret = U_SYSCALL(SSL_shutdown, "%p", ssl); // Send SSL shutdown signal to p
                                      ssl = 0;                
       }
 
+   USocket::setKTLS(false);
    USocket::setSSLActive(false);
 }
 
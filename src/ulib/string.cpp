@@ -19,6 +19,10 @@
 UString*    UString::string_null        = ULib::uustringnull.p2;
 UStringRep* UStringRep::string_rep_null = ULib::uustringrepnull.p2;
 
+#ifdef U_THREAD_SAFE_STRING
+bool UStringRep::bthread;
+#endif
+
 // OPTMIZE APPEND (BUFFERED)
 char* UString::appbuf;
 char* UString::ptrbuf;
@@ -611,7 +615,7 @@ UStringRep* UStringRep::create(uint32_t length, uint32_t need, const char* ptr)
 
       if (_ptr == MAP_FAILED)
          {
-         string_rep_null->references++;
+         string_rep_null->hold();
 
          U_RETURN_POINTER(string_rep_null, UStringRep);
          }
@@ -642,7 +646,12 @@ UStringRep* UStringRep::create(uint32_t length, uint32_t need, const char* ptr)
          int stack_index;
          uint32_t sz = need + (1+sizeof(UStringRep));
 
-         if (sz <= U_STACK_TYPE_4) // 128
+         if (sz <= U_STACK_TYPE_3) // 56 (64 with DEBUG)
+            {
+            need        = U_CAPACITY_SMALL;
+            stack_index = 3;
+            }
+         else if (sz <= U_STACK_TYPE_4) // 128
             {
             need        = U_STACK_TYPE_4-(1+sizeof(UStringRep));
             stack_index = 4;
@@ -720,7 +729,12 @@ bool UString::shrink()
       int stack_index;
       uint32_t _capacity;
 
-      if (sz <= U_STACK_TYPE_4) // 128
+      if (sz <= U_STACK_TYPE_3) // 56 (64 with DEBUG)
+         {
+         _capacity   = U_CAPACITY_SMALL;
+         stack_index = 3;
+         }
+      else if (sz <= U_STACK_TYPE_4) // 128
          {
          _capacity   = U_STACK_TYPE_4-(1+sizeof(UStringRep));
          stack_index = 4;
@@ -857,6 +871,7 @@ void UStringRep::_release()
    if (_capacity <= U_CAPACITY)
       {
       if (_capacity == 0) UMemoryPool::push(this, U_SIZE_TO_STACK_INDEX(sizeof(UStringRep))); // NB: no room for data, which mean constant string...
+      else if (_capacity == U_CAPACITY_SMALL) UMemoryPool::push(this, 3); // NB: short string, see UStringRep::create()...
       else
          {
          // NB: we need an array of char[_capacity], plus a terminating null char element, plus enough for the UStringRep data structure...
@@ -958,7 +973,7 @@ UStringRep* UStringRep::substr(const char* t, uint32_t tlen) const
       {
       r = string_rep_null;
 
-      r->references++;
+      r->hold();
       }
    else
       {
@@ -979,7 +994,7 @@ UStringRep* UStringRep::substr(const char* t, uint32_t tlen) const
       r->parent = p;
 
 #    ifdef U_SUBSTR_INC_REF
-      p->references++; // substring increment reference of source string
+      p->hold(); // substring increment reference of source string
 #    else
       p->child++;      // substring capture event 'DEAD OF SOURCE STRING WITH CHILD ALIVE'...
 
@@ -1268,7 +1283,11 @@ void UString::setBuffer(uint32_t n)
       {
       if (n < U_CAPACITY) n = U_CAPACITY;
 
+      bool barena = UArena::suspend(this);
+
       _set(UStringRep::create(0U, n, 0));
+
+      UArena::resume(barena);
       }
 
    U_INTERNAL_ASSERT(invariant())
@@ -1318,8 +1337,12 @@ void UString::_reserve(UString& buffer, uint32_t n)
                               need += PAGESIZE; // NB: to avoid duplication on realloc...
       }
 
+   bool barena = UArena::suspend(&buffer); // NB: the buffer can be persistent (ex: UClientImage_Base::wbuffer)...
+
    buffer._set(UStringRep::create(rep->_length, need, rep->str));
 
+   UArena::resume(barena);
+
    U_INTERNAL_ASSERT(buffer.invariant())
    U_INTERNAL_ASSERT(buffer.space() >= n)
 }
@@ -1395,8 +1418,11 @@ char* UString::__replace(uint32_t pos, uint32_t n1, uint32_t n2)
 
       if (__capacity < n) __capacity = n;
 
+      bool barena   = UArena::suspend(this);
       UStringRep* r = UStringRep::create(n, __capacity, 0);
 
+      UArena::resume(barena);
+
       if (pos)      U_MEMCPY((void*)r->str,            str, pos);
       if (how_much) U_MEMCPY((char*)r->str + pos + n2, src, how_much);
 
@@ -1462,8 +1488,12 @@ char* UString::__append(uint32_t n)
    if (rep->references ||
        need > rep->_capacity)
       {
+      bool barena = UArena::suspend(this);
+
       r = UStringRep::create(sz, (need < U_CAPACITY ? U_CAPACITY : (need * 2) + (PAGESIZE * 2)), str);
 
+      UArena::resume(barena);
+
       _set(r);
 
       str = (char*)r->str;
@@ -1498,6 +1528,7 @@ void UString::duplicate() const
    U_TRACE_NO_PARAM(0, "UString::duplicate()")
 
    uint32_t sz = size();
+   bool barena = UArena::suspend(this);
 
    if (sz) ((UString*)this)->_set(UStringRep::create(sz, sz, rep->str));
    else
@@ -1507,6 +1538,8 @@ void UString::duplicate() const
       *(((UString*)this)->UString::rep->data()) = '\0';
       }
 
+   UArena::resume(barena);
+
    U_INTERNAL_ASSERT(invariant())
    U_INTERNAL_ASSERT(isNullTerminated())
 }
@@ -413,6 +413,10 @@ bool UThread::start(uint32_t timeoutMS)
 #else
    bool result;
    pthread_attr_t attr;
+
+#  ifdef U_THREAD_SAFE_STRING
+   UStringRep::bthread = true; // NB: from now on the strings can be shared between threads...
+#  endif
    
    (void) U_SYSCALL(pthread_attr_init,           "%p",    &attr);
    (void) U_SYSCALL(pthread_attr_setdetachstate, "%p,%d", &attr, detachstate);
@@ -625,6 +629,10 @@ UThreadPool::UThreadPool(uint32_t size) : UThread(PTHREAD_CREATE_DETACHED), pool
    (void) pthread_attr_init(&attr);
    (void) pthread_attr_setdetachstate(&attr, UThread::detachstate);
 
+#  ifdef U_THREAD_SAFE_STRING
+   UStringRep::bthread = true; // NB: from now on the strings can be shared between threads...
+#  endif
+
    for (uint32_t i = 0; i < size; ++i)
       {
       U_NEW(UThread, th, UThread(UThread::detachstate));
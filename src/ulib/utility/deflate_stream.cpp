@@ -0,0 +1,180 @@
+// ============================================================================
+//
+// = LIBRARY
+//    ULib - c++ library
+//
+// = FILENAME
+//    deflate_stream.cpp - incremental gzip compression of a content feeded in chunk
+//
+// = AUTHOR
+//    Stefano Casazza
+//
+// ============================================================================
+
+#include <ulib/utility/deflate_stream.h>
+
+#define U_CHUNK_HEADER_SIZE 10 // NB: chunk-size is 1*HEXDIG so we can reserve 8 digit (with leading zero) before to know the size...
+
+bool UDeflateStream::init(uint32_t size, bool bheader)
+{
+   U_TRACE(0, "UDeflateStream::init(%u,%b)", size, bheader)
+
+   end();
+
+#ifdef USE_LIBZ
+   if (u_gz_deflate_init(&stream, u_gz_deflate_level(size), bheader)) bactive = true;
+#endif
+
+   U_RETURN(bactive);
+}
+
+void UDeflateStream::end()
+{
+   U_TRACE_NO_PARAM(0, "UDeflateStream::end()")
+
+   if (bactive)
+      {
+      bactive = false;
+
+#  ifdef USE_LIBZ
+      U_INTERNAL_DUMP("total_in = %lu total_out = %lu", stream.total_in, stream.total_out)
+
+      u_gz_deflate_end(&stream);
+#  endif
+      }
+}
+
+bool UDeflateStream::write(const char* ptr, uint32_t len, UString& output, bool bflush, bool bfinish)
+{
+   U_TRACE(0, "UDeflateStream::write(%.*S,%u,%V,%b,%b)", len, ptr, len, output.rep, bflush, bfinish)
+
+   if (bactive == false) U_RETURN(false);
+
+#ifdef USE_LIBZ
+   uint32_t n;
+   int flush = (bfinish ? Z_FINISH :
+                bflush  ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+
+   if (ptr == 0)
+      {
+      U_INTERNAL_ASSERT_EQUALS(len, 0)
+
+      ptr = "";
+      }
+
+   // NB: the compressed data are almost always smaller, the loop is only for the incompressible data and the flush of the pending data...
+
+   (void) output.reserve(len + (len / 10) + 64);
+
+   do {
+      if (output.space() < 64) (void) output.reserve(U_CAPACITY);
+
+      n = u_gz_deflate_chunk(&stream, ptr, len, output.pend(), output.space(), flush);
+
+      if (n == U_NOT_FOUND)
+         {
+         end();
+
+         U_RETURN(false);
+         }
+
+      ptr = 0;
+
+      output.size_adjust(output.size() + n);
+      }
+   while (stream.avail_out == 0);
+
+   U_INTERNAL_DUMP("total_in = %lu total_out = %lu", stream.total_in, stream.total_out)
+
+   U_INTERNAL_ASSERT_EQUALS(stream.avail_in, 0)
+#endif
+
+   U_RETURN(true);
+}
+
+void UDeflateStream::addChunk(const char* ptr, uint32_t len, UString& output, bool bfinish)
+{
+   U_TRACE(0, "UDeflateStream::addChunk(%.*S,%u,%V,%b)", len, ptr, len, output.rep, bfinish)
+
+   if (len)
+      {
+      (void) output.reserve(U_CHUNK_HEADER_SIZE + len + 2 + (bfinish ? U_CONSTANT_SIZE("0\r\n\r\n") : 0));
+
+      char* p = output.pend();
+
+      u_int2hex(p, len);
+
+      u_put_unalignedp16(p+8, U_MULTICHAR_CONSTANT16('\r','\n'));
+
+      U_MEMCPY(p+U_CHUNK_HEADER_SIZE, ptr, len);
+
+      u_put_unalignedp16(p+U_CHUNK_HEADER_SIZE+len, U_MULTICHAR_CONSTANT16('\r','\n'));
+
+      output.size_adjust(output.size() + U_CHUNK_HEADER_SIZE + len + 2);
+      }
+
+   if (bfinish) (void) output.append(U_CONSTANT_TO_PARAM("0\r\n\r\n")); // last-chunk
+}
+
+bool UDeflateStream::writeChunk(const char* ptr, uint32_t len, UString& output, bool bfinish)
+{
+   U_TRACE(0, "UDeflateStream::writeChunk(%.*S,%u,%V,%b)", len, ptr, len, output.rep, bfinish)
+
+   uint32_t n, start = output.size();
+
+   // NB: we reserve the space for the chunk-size, we know it only after the compression...
+
+   (void) output.reserve(U_CHUNK_HEADER_SIZE);
+
+   output.size_adjust(start + U_CHUNK_HEADER_SIZE);
+
+   if (write(ptr, len, output, true, bfinish) == false)
+      {
+      output.size_adjust(start);
+
+      U_RETURN(false);
+      }
+
+   n = output.size() - start - U_CHUNK_HEADER_SIZE;
+
+   U_INTERNAL_DUMP("n = %u", n)
+
+   if (n == 0) output.size_adjust(start); // NB: a chunk with size zero is the last-chunk...
+   else
+      {
+      char* p = output.c_pointer(start);
+
+      u_int2hex(p, n);
+
+      u_put_unalignedp16(p+8, U_MULTICHAR_CONSTANT16('\r','\n'));
+
+      (void) output.append(U_CONSTANT_TO_PARAM(U_CRLF));
+      }
+
+   if (bfinish)
+      {
+      end();
+
+      (void) output.append(U_CONSTANT_TO_PARAM("0\r\n\r\n")); // last-chunk
+      }
+
+   U_RETURN(true);
+}
+
+// DEBUG
+
+#if defined(U_STDCPP_ENABLE) && defined(DEBUG)
+const char* UDeflateStream::dump(bool reset) const
+{
+   *UObjectIO::os << "bactive " << bactive;
+
+   if (reset)
+      {
+      UObjectIO::output();
+
+      return UObjectIO::buffer_output;
+      }
+
+   return 0;
+}
+#endif
@@ -13,6 +13,7 @@
 
 #include <ulib/file.h>
 #include <ulib/container/tree.h>
+#include <ulib/utility/lock.h>
 #include <ulib/utility/dir_walk.h>
 #include <ulib/utility/services.h>
 #include <ulib/container/hash_map.h>
@@ -49,6 +50,34 @@
 #  define U_DT_TYPE DT_UNKNOWN
 #endif
 
+#if defined(U_LINUX) && defined(HAVE_SYS_SYSCALL_H)
+#  include <sys/syscall.h>
+#  ifdef SYS_getdents64
+#     define U_DIRWALK_GETDENTS
+/**
+ * NB: with readdir() the libc read the directory with getdents64() in block of 32k, we read directly the record
+ *     of the kernel in block of 256k so that we need much less syscall for the directory with a lot of entries.
+ *     The buffer are allocated one for level of recursion and reused until the end of walk()...
+ */
+#     define U_DIRWALK_GETDENTS_SIZE      (256U * 1024U)
+#     define U_DIRWALK_GETDENTS_MAX_DEPTH  64
+
+struct u_dirent64 {
+   uint64_t       d_ino;
+   int64_t        d_off;
+   unsigned short d_reclen;
+   unsigned char  d_type;
+   char           d_name[1];
+};
+
+static char* getdents_buffer[U_DIRWALK_GETDENTS_MAX_DEPTH];
+#  endif
+#endif
+
+#define U_DIRWALK_PREFETCH_CHUNK      32L
+#define U_DIRWALK_PREFETCH_MIN_FILE  256U
+#define U_DIRWALK_PREFETCH_MAX_THREAD 64U
+
 vPF               UDirWalk::call_if_up;
 vPF               UDirWalk::call_internal;
 int               UDirWalk::filter_flags;
@@ -58,6 +87,8 @@ bool              UDirWalk::tree_root;
 bool              UDirWalk::call_if_directory;
 uint32_t          UDirWalk::max;
 uint32_t          UDirWalk::filter_len;
+uint32_t          UDirWalk::prefetch_thread;
+uint32_t          UDirWalk::prefetch_max_size;
 qcompare          UDirWalk::sort_by;
 UString*          UDirWalk::suffix_file_type;
 UDirWalk*         UDirWalk::pthis;
@@ -179,21 +210,101 @@ U_NO_EXPORT bool UDirWalk::isFile()
    U_RETURN(false);
 }
 
+U_NO_EXPORT void UDirWalk::readEntry(dir_s* pqdir, char* d_name, uint32_t d_namlen, ino_t d_ino, unsigned char d_type)
+{
+   U_TRACE(0, "UDirWalk::readEntry(%p,%.*S,%u,%lu,%d)", pqdir, d_namlen, d_name, d_namlen, d_ino, d_type)
+
+   U_INTERNAL_DUMP("filter(%u) = %.*S filter_flags = %d sort_by = %p", filter_len, filter_len, filter, filter_flags, sort_by)
+
+   if (U_ISDOTS(d_name)) return;
+
+   if (filter_len == 0 ||
+       UServices::dosMatchWithOR(d_name, d_namlen, filter, filter_len, filter_flags))
+      {
+      if (sort_by == 0) prepareForCallingRecurse(d_name, d_namlen, d_type);
+      else
+         {
+         dirent_s* ds;
+
+         // NB: check if we must do reallocation...
+
+         if (pqdir->num >= pqdir->max)
+            {
+            uint32_t  old_max   = pqdir->max;
+            dirent_s* old_block = pqdir->dp;
+
+            pqdir->max <<= 1;
+
+            U_INTERNAL_DUMP("Reallocating dirent (%u => %u)", old_max, pqdir->max)
+
+            pqdir->dp = (dirent_s*) UMemoryPool::_malloc(&pqdir->max, sizeof(dirent_s));
+
+            U_MEMCPY(pqdir->dp, old_block, old_max * sizeof(dirent_s));
+
+            UMemoryPool::_free(old_block, old_max, sizeof(dirent_s));
+            }
+
+         if (d_namlen > pqdir->nfree)
+            {
+            char*    old_block = pqdir->free;
+            uint32_t old_free  = pqdir->szfree;
+
+            pqdir->szfree <<= 1;
+
+            pqdir->free  = (char*) UMemoryPool::_malloc(&pqdir->szfree);
+            pqdir->nfree = (pqdir->szfree - pqdir->pfree);
+
+            U_INTERNAL_DUMP("Reallocating dirname (%u => %u) nfree = %u", old_free, pqdir->szfree, pqdir->nfree)
+
+            U_MEMCPY(pqdir->free, old_block, pqdir->pfree);
+
+            UMemoryPool::_free(old_block, old_free);
+            }
+
+         ds         = pqdir->dp + pqdir->num++;
+         ds->d_ino  = d_ino;
+         ds->d_type = d_type;
+
+         U_MEMCPY(pqdir->free + (ds->d_name = pqdir->pfree), d_name, (ds->d_namlen = d_namlen));
+
+         pqdir->pfree += d_namlen;
+         pqdir->nfree -= d_namlen;
+
+         U_INTERNAL_DUMP("readdir: %lu %.*s %d", ds->d_ino, ds->d_namlen, pqdir->free + ds->d_name, ds->d_type);
+         }
+      }
+}
+
 void UDirWalk::recurse()
 {
    U_TRACE_NO_PARAM(1+256, "UDirWalk::recurse()")
 
    U_INTERNAL_ASSERT_EQUALS(pthis, this)
 
+#ifdef U_DIRWALK_GETDENTS
+   int fd = -1;
+#else
    DIR* dirp = 0;
+#endif
+
+   // NB: if we are called by prepareForCallingRecurse() with d_type == DT_DIR the entry cannot be a symbolic link...
+
+   bool bdt_dir = (depth >= 0 && is_directory);
 
    ++depth; // if this has been called, then we're one level lower
 
-   U_INTERNAL_DUMP("depth = %d pathlen = %u pathname(%u) = %S", depth, pathlen, u__strlen(pathname, __PRETTY_FUNCTION__), pathname)
+   U_INTERNAL_DUMP("depth = %d pathlen = %u pathname(%u) = %S bdt_dir = %b", depth, pathlen, u__strlen(pathname, __PRETTY_FUNCTION__), pathname, bdt_dir)
 
    U_INTERNAL_ASSERT_EQUALS(u__strlen(pathname, __PRETTY_FUNCTION__), pathlen)
 
-   if (depth == 0) dirp = (DIR*) U_SYSCALL(opendir, "%S", "."); // NB: if pathname it is not '.' we have already make chdir()... 
+   if (depth == 0) // NB: if pathname it is not '.' we have already make chdir()... 
+      {
+#  ifdef U_DIRWALK_GETDENTS
+      fd = U_SYSCALL(open, "%S,%d", ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+#  else
+      dirp = (DIR*) U_SYSCALL(opendir, "%S", ".");
+#  endif
+      }
    else
       {
       if (isFile()) // NB: we check if this item is a file so we don't need to try opendir()...
@@ -208,10 +319,18 @@ found_file:
          goto end;
          }
 
+#  ifdef U_DIRWALK_GETDENTS
+      fd = U_SYSCALL(open, "%S,%d", pathname, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+#  else
       dirp = (DIR*) U_SYSCALL(opendir, "%S", U_PATH_CONV(pathname));
+#  endif
       }
 
+#ifdef U_DIRWALK_GETDENTS
+   is_directory = (fd != -1);
+#else
    is_directory = (dirp != 0);
+#endif
 
    if (is_directory == false ||
        call_if_directory)
@@ -222,7 +341,8 @@ found_file:
    if (is_directory)
       {
 #  ifndef _MSWINDOWS_ 
-      if (bfollowlinks == false)
+      if (bfollowlinks == false &&
+          bdt_dir      == false)
          {
          struct stat st;
 
@@ -243,7 +363,14 @@ found_file:
 
       dir_s qdir;
       dirent_s* ds;
+#  ifdef U_DIRWALK_GETDENTS
+      long nread;
+      char* buffer;
+      struct u_dirent64* dp;
+      uint32_t szbuffer = U_DIRWALK_GETDENTS_SIZE;
+#  else
       struct dirent* dp;
+#  endif
 
       qdir.num            = 0;
       pathname[pathlen++] = '/';
@@ -268,70 +395,33 @@ found_file:
       // (void) readdir(dirp); // skip '..'
       // -----------------------------------------------
 
-      while ((dp = readdir(dirp))) // NB: we don't use the macro U_SYSCALL to avoid warning on stderr...
+#  ifdef U_DIRWALK_GETDENTS
+      if (depth >= U_DIRWALK_GETDENTS_MAX_DEPTH) buffer = (char*) UMemoryPool::_malloc(&szbuffer);
+      else
          {
-         uint32_t d_namlen = NAMLEN(dp);
+         if (getdents_buffer[depth] == 0) getdents_buffer[depth] = (char*) UMemoryPool::_malloc(&szbuffer);
 
-         U_INTERNAL_DUMP("d_namlen = %u d_name = %.*s filter(%u) = %.*S filter_flags = %d sort_by = %p",
-                          d_namlen,     d_namlen, dp->d_name, filter_len, filter_len, filter, filter_flags, sort_by)
-
-         if (U_ISDOTS(dp->d_name)) continue;
+         buffer = getdents_buffer[depth];
+         }
 
-         if (filter_len == 0 ||
-             UServices::dosMatchWithOR(dp->d_name, d_namlen, filter, filter_len, filter_flags))
+      while ((nread = syscall(SYS_getdents64, fd, buffer, szbuffer)) > 0) // NB: we don't use the macro U_SYSCALL to avoid warning on stderr...
+         {
+         for (long bpos = 0; bpos < nread; bpos += dp->d_reclen)
             {
-            if (sort_by == 0) prepareForCallingRecurse(dp->d_name, d_namlen, U_DT_TYPE);
-            else
-               {
-               // NB: check if we must do reallocation...
-
-               if (qdir.num >= qdir.max)
-                  {
-                  uint32_t  old_max   = qdir.max;
-                  dirent_s* old_block = qdir.dp;
-
-                  qdir.max <<= 1;
+            dp = (struct u_dirent64*)(buffer + bpos);
 
-                  U_INTERNAL_DUMP("Reallocating dirent (%u => %u)", old_max, qdir.max)
-
-                  qdir.dp = (dirent_s*) UMemoryPool::_malloc(&qdir.max, sizeof(dirent_s));
-
-                  U_MEMCPY(qdir.dp, old_block, old_max * sizeof(dirent_s));
-
-                  UMemoryPool::_free(old_block, old_max, sizeof(dirent_s));
-                  }
-
-               if (d_namlen > qdir.nfree)
-                  {
-                  char*    old_block = qdir.free;
-                  uint32_t old_free  = qdir.szfree;
-
-                  qdir.szfree <<= 1;
-
-                  qdir.free  = (char*) UMemoryPool::_malloc(&qdir.szfree);
-                  qdir.nfree = (qdir.szfree - qdir.pfree);
-
-                  U_INTERNAL_DUMP("Reallocating dirname (%u => %u) nfree = %u", old_free, qdir.szfree, qdir.nfree)
-
-                  U_MEMCPY(qdir.free, old_block, qdir.pfree);
-
-                  UMemoryPool::_free(old_block, old_free);
-                  }
-
-               ds         = qdir.dp + qdir.num++;
-               ds->d_ino  = dp->d_ino;
-               ds->d_type = U_DT_TYPE;
-
-               U_MEMCPY(qdir.free + (ds->d_name = qdir.pfree), dp->d_name, (ds->d_namlen = d_namlen));
-
-               qdir.pfree += d_namlen;
-               qdir.nfree -= d_namlen;
-
-               U_INTERNAL_DUMP("readdir: %lu %.*s %d", ds->d_ino, ds->d_namlen, qdir.free + ds->d_name, ds->d_type);
-               }
+            readEntry(&qdir, dp->d_name, u__strlen(dp->d_name, __PRETTY_FUNCTION__), dp->d_ino, dp->d_type);
             }
          }
 
+      if (depth >= U_DIRWALK_GETDENTS_MAX_DEPTH) UMemoryPool::_free(buffer, szbuffer);
+#  else
+      while ((dp = readdir(dirp))) // NB: we don't use the macro U_SYSCALL to avoid warning on stderr...
+         {
+         readEntry(&qdir, dp->d_name, NAMLEN(dp), dp->d_ino, U_DT_TYPE);
+         }
+#  endif
+
       U_INTERNAL_DUMP("qdir.num = %u", qdir.num)
 
       if (qdir.num)
@@ -362,7 +452,11 @@ end:
 
    U_INTERNAL_DUMP("depth = %d", depth)
 
+#ifdef U_DIRWALK_GETDENTS
+   if (fd != -1) (void) U_SYSCALL(close, "%d", fd);
+#else
    if (dirp) (void) U_SYSCALL(closedir, "%p", dirp);
+#endif
 }
 
 void UDirWalk::walk()
@@ -409,6 +503,15 @@ void UDirWalk::walk()
          }
       }
 
+#ifdef U_DIRWALK_GETDENTS
+   for (int i = 0; i < U_DIRWALK_GETDENTS_MAX_DEPTH && getdents_buffer[i]; ++i)
+      {
+      UMemoryPool::_free(getdents_buffer[i], U_DIRWALK_GETDENTS_SIZE);
+
+      getdents_buffer[i] = 0;
+      }
+#endif
+
    U_INTERNAL_DUMP("pathname = %S", pathname)
    U_INTERNAL_DUMP("u_cwd(%u) = %.*S", u_cwd_len, u_cwd_len, u_cwd)
 }
@@ -484,6 +587,140 @@ U_NO_EXPORT int UDirWalk::cmp_modify(const void* a, const void* b)
    U_RETURN(diff);
 }
 
+// NB: stat() and read ahead of the found files (it must not use the memory pool because it is called by more thread)...
+
+static long prefetch_next;
+
+U_NO_EXPORT void UDirWalk::prefetchRange()
+{
+   U_TRACE_NO_PARAM(0, "UDirWalk::prefetchRange()")
+
+   U_INTERNAL_ASSERT_POINTER(pvector)
+
+   int fd;
+   long i, end;
+   struct stat st;
+   const UStringRep* rep;
+   char buffer[U_PATH_MAX+1];
+   long n = pvector->size();
+
+   while ((i = ULock::atomicIncrement(&prefetch_next, U_DIRWALK_PREFETCH_CHUNK) - U_DIRWALK_PREFETCH_CHUNK) < n)
+      {
+      for (end = U_min(i + U_DIRWALK_PREFETCH_CHUNK, n); i < end; ++i)
+         {
+         rep = pvector->UVector<UStringRep*>::at(i);
+
+         if (rep->size() > U_PATH_MAX) continue;
+
+         U_MEMCPY(buffer, rep->data(), rep->size());
+
+         buffer[rep->size()] = '\0';
+
+         if (U_SYSCALL(stat, "%S,%p", buffer, &st) == 0 &&
+             S_ISREG(st.st_mode)                         &&
+             st.st_size > 0                              &&
+             st.st_size <= (off_t)prefetch_max_size)
+            {
+            fd = U_SYSCALL(open, "%S,%d", buffer, O_RDONLY | O_CLOEXEC);
+
+            if (fd != -1)
+               {
+               // NB: it is only a hint, the kernel can read less (the limit of the device) and can drop the pages from
+               //     the cache before checkFileForCache() read them. It can block while reading, so it is done by the pool...
+
+#           ifdef U_LINUX
+               (void) U_SYSCALL(readahead, "%d,%u,%u", fd, 0, st.st_size);
+#           elif defined(POSIX_FADV_WILLNEED)
+               (void) U_SYSCALL(posix_fadvise, "%d,%u,%u,%d", fd, 0, st.st_size, POSIX_FADV_WILLNEED);
+#           endif
+
+               (void) U_SYSCALL(close, "%d", fd);
+               }
+            }
+         }
+      }
+}
+
+#if defined(ENABLE_THREAD) && !defined(_MSWINDOWS_)
+#  include <ulib/thread.h>
+
+static long prefetch_done;
+static pthread_cond_t  prefetch_cond  = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t prefetch_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+class U_NO_EXPORT UDirWalkPrefetch : public UThread {
+public:
+
+   UDirWalkPrefetch() : UThread(PTHREAD_CREATE_JOINABLE) {}
+
+   virtual void run() U_DECL_FINAL
+      {
+      U_TRACE_NO_PARAM(0, "UDirWalkPrefetch::run()")
+
+      UDirWalk::prefetchRange();
+
+      UThread::lock(&prefetch_mutex);
+
+      ++prefetch_done;
+
+      UThread::unlock(&prefetch_mutex);
+
+      UThread::signal(&prefetch_cond);
+
+      // NB: the work is done so we exit, but not returning from run() because UThread::threadStart() call close() that cancel
+      //     the thread itself and then nobody join it. The destructor called by the main thread call close() that join us...
+
+      U_SYSCALL_VOID(pthread_exit, "%p", 0);
+      }
+
+private:
+   U_DISALLOW_COPY_AND_ASSIGN(UDirWalkPrefetch)
+};
+#endif
+
+U_NO_EXPORT void UDirWalk::prefetch()
+{
+   U_TRACE_NO_PARAM(0, "UDirWalk::prefetch()")
+
+   U_INTERNAL_ASSERT_POINTER(pvector)
+   U_INTERNAL_ASSERT_MAJOR(prefetch_thread, 1)
+
+   prefetch_next = 0;
+
+#if defined(ENABLE_THREAD) && !defined(_MSWINDOWS_)
+   uint32_t i, num_thread = U_min(prefetch_thread, U_DIRWALK_PREFETCH_MAX_THREAD) - 1; // NB: the calling thread do its part of work...
+   UDirWalkPrefetch* vth[U_DIRWALK_PREFETCH_MAX_THREAD];
+
+   prefetch_done = 0;
+
+   for (i = 0; i < num_thread; ++i)
+      {
+      U_NEW(UDirWalkPrefetch, vth[i], UDirWalkPrefetch);
+
+      if (vth[i]->start() == false)
+         {
+         delete vth[i];
+
+         break;
+         }
+      }
+
+   U_INTERNAL_DUMP("num_thread = %u", i)
+
+   prefetchRange();
+
+   UThread::lock(&prefetch_mutex);
+
+   while (prefetch_done < (long)i) UThread::wait(&prefetch_mutex, &prefetch_cond);
+
+   UThread::unlock(&prefetch_mutex);
+
+   while (i) delete vth[--i]; // NB: pthread_join()...
+#else
+   prefetchRange();
+#endif
+}
+
 uint32_t UDirWalk::walk(UVector<UString>& vec, qcompare compare_obj)
 {
    U_TRACE(0, "UDirWalk::walk(%p,%p)", &vec, compare_obj)
@@ -498,6 +735,12 @@ uint32_t UDirWalk::walk(UVector<UString>& vec, qcompare compare_obj)
 
    uint32_t n = vec.size();
 
+   if (prefetch_thread > 1 &&
+       n >= U_DIRWALK_PREFETCH_MIN_FILE)
+      {
+      prefetch();
+      }
+
    if (compare_obj &&
        n > 1)
       {
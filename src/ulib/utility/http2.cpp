@@ -21,10 +21,13 @@ bool                          UHTTP2::bcontinue100;
 bool                          UHTTP2::bsetting_ack;
 bool                          UHTTP2::bsetting_send;
 bool                          UHTTP2::priority_exclusive;
-uint8_t                       UHTTP2::priority_weight;     // 0 if not set
+uint16_t                      UHTTP2::priority_weight;     // 0 if not set
 uint32_t                      UHTTP2::priority_dependency; // 0 if not set
 uint32_t                      UHTTP2::hash_static_table[61];
 uint32_t                      UHTTP2::wait_for_continuation;
+uint32_t                      UHTTP2::npush;
+uint32_t                      UHTTP2::push_id[HTTP2_MAX_PUSH_STREAMS];
+UHTTP::UFileCacheData*        UHTTP2::push_data[HTTP2_MAX_PUSH_STREAMS];
 UHTTP2::Stream*               UHTTP2::pStream;
 UHTTP2::Stream*               UHTTP2::pStreamEnd;
 UHTTP2::FrameHeader           UHTTP2::frame;
@@ -133,8 +136,10 @@ UHTTP2::Connection::Connection() : itable(53, setIndexStaticTable)
 
    reset();
 
-   state    = CONN_STATE_IDLE; 
-   bnghttp2 = false;
+   state            = CONN_STATE_IDLE; 
+   streams          = 0;
+   bnghttp2         = false;
+   streams_capacity = 0;
 
    (void) memset(&idyntbl, 0, sizeof(HpackDynamicTable));
    (void) memset(&odyntbl, 0, sizeof(HpackDynamicTable));
@@ -144,8 +149,6 @@ UHTTP2::Connection::Connection() : itable(53, setIndexStaticTable)
    odyntbl.hpack_capacity     =
    odyntbl.hpack_max_capacity = 4096;
 
-   for (uint32_t i = 0; i < HTTP2_MAX_CONCURRENT_STREAMS; ++i) (void) U_SYSCALL(memset, "%p,%d,%u", &(streams[i].id), 0, sizeof(uint32_t) * 3);
-
 #ifdef DEBUG
    (void) memset(&ddyntbl, 0, sizeof(HpackDynamicTable));
 
@@ -154,6 +157,28 @@ UHTTP2::Connection::Connection() : itable(53, setIndexStaticTable)
 #endif
 }
 
+void UHTTP2::Connection::resizeStreams(uint32_t n)
+{
+   U_TRACE(0, "UHTTP2::Connection::resizeStreams(%u)", n)
+
+   U_INTERNAL_DUMP("streams = %p streams_capacity = %u", streams, streams_capacity)
+
+   U_INTERNAL_ASSERT_RANGE(HTTP2_MIN_STREAMS,n,HTTP2_MAX_CONCURRENT_STREAMS)
+
+   Stream* old = streams;
+
+   U_NEW(Stream, streams, Stream[n]); // NB: the memory of the table come from the pool (see U_MEMORY_ALLOCATOR of Stream)...
+
+   if (old)
+      {
+      for (uint32_t i = 0, sz = U_min(n, streams_capacity); i < sz; ++i) streams[i] = old[i];
+
+      delete[] old;
+      }
+
+   streams_capacity = n;
+}
+
 #ifdef DEBUG
 #define U_HTTP2_HPACK_ERROR_SET_ENTRY(i,s,v,d) \
    hpack_error[i].str   = s; \
@@ -361,7 +386,12 @@ void UHTTP2::updateSetting(unsigned char* ptr, uint32_t len)
                return;
                }
 
-            pConnection->out_window                        =
+            // NB: it change the window of all the streams (but not the window of the connection)...
+
+            int32_t delta = (int32_t)value - (int32_t)pConnection->peer_settings.initial_window_size;
+
+            for (Stream* ps = pConnection->streams; ps <= pStreamEnd; ++ps) ps->out_window += delta;
+
             pConnection->peer_settings.initial_window_size = value;
             }
          break;
@@ -2036,6 +2066,8 @@ manage_headers:
          {
          pStream->id = frame.stream_id;
 
+         initStream();
+
          if (pConnection->max_processed_stream_id < frame.stream_id) pConnection->max_processed_stream_id = frame.stream_id;
          }
 
@@ -2044,14 +2076,16 @@ manage_headers:
 
    if (frame.stream_id > pConnection->max_processed_stream_id)
       {
-      if (++pStream >= (pConnection->streams+HTTP2_MAX_CONCURRENT_STREAMS))
+      Stream* ps = addStream();
+
+      if (ps == 0)
          {
          nerror = REFUSED_STREAM;
 
          return;
          }
 
-      ++pStreamEnd;
+      pStream = ps;
 
       goto manage_headers;
       }
@@ -2079,6 +2113,144 @@ manage_headers:
    nerror = PROTOCOL_ERROR;
 }
 
+UHTTP2::Stream* UHTTP2::addStream()
+{
+   U_TRACE_NO_PARAM(0, "UHTTP2::addStream()")
+
+   uint32_t n = (pStreamEnd - pConnection->streams) + 1; // number of slot in use
+
+   U_INTERNAL_DUMP("n = %u pConnection->streams_capacity = %u", n, pConnection->streams_capacity)
+
+   if (n == pConnection->streams_capacity)
+      {
+      if (n >= HTTP2_MAX_CONCURRENT_STREAMS) U_RETURN_POINTER(0, Stream);
+
+      uint32_t index = (pStream - pConnection->streams);
+
+      pConnection->resizeStreams(U_min(n * 2, HTTP2_MAX_CONCURRENT_STREAMS));
+
+      pStream    = pConnection->streams + index;
+      pStreamEnd = pConnection->streams + n - 1;
+      }
+
+   Stream* ps = ++pStreamEnd;
+
+   U_ASSERT(ps->body.empty())
+   U_ASSERT(ps->output.empty())
+   U_ASSERT(ps->headers.empty())
+
+   ps->id      =
+   ps->state   =
+   ps->offset  =
+   ps->clength = 0;
+
+   U_RETURN_POINTER(ps, Stream);
+}
+
+UHTTP2::Stream* UHTTP2::findStream(uint32_t id)
+{
+   U_TRACE(0, "UHTTP2::findStream(%u)", id)
+
+   for (Stream* ps = pConnection->streams; ps <= pStreamEnd; ++ps)
+      {
+      if (ps->id == id) U_RETURN_POINTER(ps, Stream);
+      }
+
+   U_RETURN_POINTER(0, Stream);
+}
+
+UHTTP2::Stream* UHTTP2::pickStream()
+{
+   U_TRACE_NO_PARAM(0, "UHTTP2::pickStream()")
+
+   /**
+    * Weighted fair queuing: between the streams with a pending response allowed by the flow control window we pick the one with
+    * the smaller virtual finish time of the next DATA frame (so with the same start the stream with the greater weight go first).
+    * In the first pass we skip the streams that depend on a stream that has itself DATA to send (RFC 7540 5.3.1), if we don't find
+    * anything we try again ignoring the dependency...
+    */
+
+   Stream* ps;
+   Stream* dep;
+   Stream* best = 0;
+   uint32_t len;
+   uint64_t finish, best_finish = 0;
+
+   if (pConnection->out_window <= 0) U_RETURN_POINTER(0, Stream);
+
+   for (int pass = 0; pass < 2 && best == 0; ++pass)
+      {
+      for (ps = pConnection->streams; ps <= pStreamEnd; ++ps)
+         {
+         if (ps->out_window <= 0 ||
+             ps->offset >= ps->output.size())
+            {
+            continue;
+            }
+
+         if (pass == 0 &&
+             ps->parent)
+            {
+            dep = pConnection->streams + ps->parent - 1;
+
+            if (dep <= pStreamEnd                &&
+                dep->id     == ps->dependency    &&
+                dep->offset  < dep->output.size())
+               {
+               continue;
+               }
+            }
+
+         len = ps->output.size() - ps->offset;
+
+         if (len > pConnection->peer_settings.max_frame_size) len = pConnection->peer_settings.max_frame_size;
+
+         finish = ps->vfinish + ((uint64_t)len << 8) / ps->weight;
+
+         if (best == 0 ||
+             finish < best_finish)
+            {
+            best        = ps;
+            best_finish = finish;
+            }
+         }
+      }
+
+   U_RETURN_POINTER(best, Stream);
+}
+
+void UHTTP2::updateWindow(int32_t* pwindow)
+{
+   U_TRACE(0, "UHTTP2::updateWindow(%p)", pwindow)
+
+   if (frame.length != 4)
+      {
+      nerror = FRAME_SIZE_ERROR;
+
+      return;
+      }
+
+   uint32_t window_size_increment = u_http2_parse_window(frame.payload);
+
+   U_INTERNAL_DUMP("window = %d window_size_increment = %u frame.stream_id = %u", *pwindow, window_size_increment, frame.stream_id)
+
+   if (window_size_increment == 0)
+      {
+      nerror = PROTOCOL_ERROR;
+
+      return;
+      }
+
+   if (((int64_t)*pwindow + window_size_increment) > HTTP2_MAX_WINDOW_SIZE)
+      {
+      nerror = FLOW_CONTROL_ERROR;
+
+      return;
+      }
+
+   *pwindow += window_size_increment;
+}
+
 void UHTTP2::readFrame()
 {
    U_TRACE_NO_PARAM(0, "UHTTP2::readFrame()")
@@ -2253,33 +2425,9 @@ loop:
       {
       if (frame.type == WINDOW_UPDATE)
          {
-window_update:
-         if (frame.length != 4)
-            {
-            nerror = FRAME_SIZE_ERROR;
-
-            goto end;
-            }
-
-         uint32_t window_size_increment = u_http2_parse_window(frame.payload);
-
-         U_INTERNAL_DUMP("pConnection->out_window = %d window_size_increment = %u", pConnection->out_window, window_size_increment)
-
-         if (window_size_increment == 0)
-            {
-            nerror = PROTOCOL_ERROR;
-
-            goto end;
-            }
+         updateWindow(&(pConnection->out_window));
 
-         if ((pConnection->out_window + window_size_increment) > HTTP2_MAX_WINDOW_SIZE)
-            {
-            nerror = FLOW_CONTROL_ERROR;
-
-            goto end;
-            }
-
-         if (frame.stream_id) pConnection->out_window += window_size_increment;
+         if (nerror != NO_ERROR) goto end;
 
          goto ret;
          }
@@ -2326,28 +2474,96 @@ window_update:
       goto end;
       }
 
-   if ((frame.stream_id & 1) == 0)
+   if (frame.type == PRIORITY      ||
+       frame.type == RST_STREAM    ||
+       frame.type == WINDOW_UPDATE)
       {
-      nerror = PROTOCOL_ERROR;
+      // NB: these frames don't change the current stream, and the client can send them also for the streams that we have reserved with PUSH_PROMISE...
 
-      goto end;
-      }
+      if ((frame.stream_id & 1) == 0 &&
+           frame.stream_id > pConnection->max_pushed_stream_id)
+         {
+         nerror = PROTOCOL_ERROR;
 
-   if (frame.type == PRIORITY)
-      {
-      if (frame.length != 5) nerror = FRAME_SIZE_ERROR;
-      else
+         goto end;
+         }
+
+      Stream* ps = findStream(frame.stream_id);
+
+      U_INTERNAL_DUMP("ps = %p", ps)
+
+      if (frame.type == PRIORITY)
          {
+         if (frame.length != 5)
+            {
+            nerror = FRAME_SIZE_ERROR;
+
+            goto end;
+            }
+
          readPriority(frame.payload);
 
-         if (nerror == NO_ERROR)
+         if (nerror != NO_ERROR) goto end;
+
+         if (ps) setPriority(ps);
+
+         goto ret;
+         }
+
+      if (ps == 0)
+         {
+         if (frame.stream_id > pConnection->max_processed_stream_id &&
+             (frame.stream_id & 1) != 0)
             {
-            // TODO
+            nerror = PROTOCOL_ERROR; // idle stream
 
-            goto ret;
+            goto end;
             }
+
+         goto ret; // closed stream
+         }
+
+      if (frame.type == WINDOW_UPDATE)
+         {
+         updateWindow(&(ps->out_window));
+
+         if (nerror != NO_ERROR) goto end;
+
+         goto ret;
+         }
+
+      if (frame.length != 4)
+         {
+         nerror = FRAME_SIZE_ERROR;
+
+         goto end;
+         }
+
+      error = u_parse_unalignedp32(frame.payload);
+      descr = getFrameErrorCodeDescription(error);
+
+      U_DEBUG("Received RST_STREAM frame for stream %u with error (%u, %s)", frame.stream_id, error, descr)
+
+      U_SRV_LOG("received RST_STREAM frame for stream %u with error (%u, %s)", frame.stream_id, error, descr);
+
+      ps->state = STREAM_STATE_CLOSED;
+
+      if (ps->output)
+         {
+         ps->output.clear();
+
+         ps->offset = 0;
+
+         --pConnection->npending;
          }
 
+      goto ret;
+      }
+
+   if ((frame.stream_id & 1) == 0)
+      {
+      nerror = PROTOCOL_ERROR;
+
       goto end;
       }
 
@@ -2406,39 +2622,6 @@ window_update:
       goto ret;
       }
 
-   if (frame.type == WINDOW_UPDATE)
-      {
-      if (pStream->state == STREAM_STATE_IDLE)
-         {
-         nerror = PROTOCOL_ERROR;
-
-         goto end;
-         }
-
-      goto window_update;
-      }
-
-   if (frame.type == RST_STREAM)
-      {
-      if (frame.length != 4)
-         {
-         nerror = FRAME_SIZE_ERROR;
-
-         goto end;
-         }
-
-      error = u_parse_unalignedp32(frame.payload);
-      descr = getFrameErrorCodeDescription(error);
-
-      U_DEBUG("Received RST_STREAM frame for stream %u with error (%u, %s)", frame.stream_id, error, descr)
-
-      U_SRV_LOG("received RST_STREAM frame for stream %u with error (%u, %s)", frame.stream_id, error, descr);
-
-      pStream->state = STREAM_STATE_CLOSED;
-
-      goto ret;
-      }
-
    U_DUMP("frame.type = (%u, %s)", frame.type, getFrameTypeDescription(frame.type))
 
    nerror = PROTOCOL_ERROR;
@@ -2766,243 +2949,395 @@ void UHTTP2::handlerResponse()
    U_INTERNAL_ASSERT_MINOR(UClientImage_Base::wbuffer->size(), pConnection->peer_settings.max_frame_size)
 }
 
-void UHTTP2::writeData(struct iovec* iov, bool bdata, bool flag)
+void UHTTP2::writeResponse()
 {
-   U_TRACE(0, "UHTTP2::writeData(%p,%b,%b,%b)", iov, bdata, flag)
+   U_TRACE_NO_PARAM(0, "UHTTP2::writeResponse()")
 
-   char* ptr               = (char*)iov[3].iov_base;
-   char* ptr2              = (char*)iov[2].iov_base;
-   uint32_t sz1            =        iov[1].iov_len,
-            sz2            =        iov[3].iov_len,
-            max_frame_size = pConnection->peer_settings.max_frame_size;
+   U_INTERNAL_ASSERT_DIFFERS(U_ClientImage_parallelization, U_PARALLELIZATION_PARENT)
 
-   if (sz2 <= max_frame_size)
-      {
-      u_http2_write_len_and_type(ptr2,sz2,DATA);
+   char buffer1[HTTP2_FRAME_HEADER_SIZE];
+   char buffer2[HTTP2_FRAME_HEADER_SIZE];
+
+   if (UHTTP::isHEAD()) UClientImage_Base::body->clear();
 
-      ptr2[4] = flag;
+   char* ptr  = UClientImage_Base::body->data();
+   char* ptr0 = UClientImage_Base::wbuffer->data();
+   char* ptr1 = buffer1;
 
-      if (bdata) (void) writev(iov,  4, HTTP2_FRAME_HEADER_SIZE+sz1+HTTP2_FRAME_HEADER_SIZE+sz2);
-      else       (void) writev(iov+2, 2,                            HTTP2_FRAME_HEADER_SIZE+sz2);
+   uint32_t sz0     = UClientImage_Base::wbuffer->size(),
+            body_sz = UClientImage_Base::body->size();
 
-      return;
-      }
+   struct iovec iov_vec[4] = { { (caddr_t)buffer1, HTTP2_FRAME_HEADER_SIZE },
+                               { (caddr_t)ptr0, sz0 },
+                               { (caddr_t)buffer2, HTTP2_FRAME_HEADER_SIZE },
+                               { (caddr_t)ptr, body_sz } };
+
+   U_INTERNAL_DUMP("UClientImage_Base::wbuffer(%u) = %V", sz0, UClientImage_Base::wbuffer->rep)
 
-   u_http2_write_len_and_type(ptr2,max_frame_size,DATA);
+   U_INTERNAL_ASSERT(*UClientImage_Base::wbuffer)
 
-   ptr2[4] = 0;
+   u_http2_write_len_and_type(ptr1,sz0,HEADERS);
 
-   iov[3].iov_len = max_frame_size;
+   ptr1[4] = FLAG_END_HEADERS | (body_sz == 0); // FLAG_END_STREAM (1)
 
-   if (pConnection->bnghttp2)
-      {
-      if (bdata) (void) writev(iov,   4, HTTP2_FRAME_HEADER_SIZE+sz1+HTTP2_FRAME_HEADER_SIZE+max_frame_size);
-      else       (void) writev(iov+2, 2,                            HTTP2_FRAME_HEADER_SIZE+max_frame_size);
+   u_write_unalignedp32(ptr1+5,pStream->id);
 
-      U_INTERNAL_DUMP("nerror = %u", nerror)
+   U_SRV_LOG_WITH_ADDR("send response (%s,id:%u,bytes:%u) %#.*S to", pConnection->bnghttp2 ? "nghttp2" : "HTTP2",
+                           pStream->id, sz0+HTTP2_FRAME_HEADER_SIZE+(body_sz ? body_sz+HTTP2_FRAME_HEADER_SIZE : 0), sz0, ptr0);
 
-      if (nerror != NO_ERROR) return;
+   if (body_sz == 0)
+      {
+#  ifdef DEBUG
+   // decodeHeadersResponse(ptr0, sz0);
+#  endif
 
-loop1:
-      iov[3].iov_base = (ptr += max_frame_size);
-                         sz2 -= max_frame_size;
+      (void) writev(iov_vec, 2, HTTP2_FRAME_HEADER_SIZE+sz0);
 
-      U_INTERNAL_DUMP("pConnection->peer_settings.max_frame_size = %u sz2 = %u", max_frame_size, sz2)
+      return;
+      }
 
-      if (sz2 > max_frame_size)
-         {
-         if (writev(iov+2, 2, HTTP2_FRAME_HEADER_SIZE+max_frame_size) == false) return;
+   U_INTERNAL_ASSERT_MAJOR(body_sz, 0)
 
-         goto loop1;
-         }
+   if (body_sz <= pConnection->peer_settings.max_frame_size &&
+       (int32_t)body_sz <= pConnection->out_window          &&
+       (int32_t)body_sz <= pStream->out_window)
+      {
+      char* ptr2 = buffer2;
+
+      u_http2_write_len_and_type(ptr2,body_sz,DATA);
 
-      u_http2_write_len_and_type(ptr2,sz2,DATA);
+      ptr2[4] = FLAG_END_STREAM;
 
-      ptr2[4] = flag;
+      u_write_unalignedp32(ptr2+5,pStream->id);
 
-      iov[3].iov_len = sz2;
+      pConnection->out_window -= body_sz;
+          pStream->out_window -= body_sz;
 
-      (void) writev(iov+2, 2, HTTP2_FRAME_HEADER_SIZE+sz2);
+      (void) writev(iov_vec, 4, HTTP2_FRAME_HEADER_SIZE+sz0+HTTP2_FRAME_HEADER_SIZE+body_sz);
 
       return;
       }
 
-   uint32_t iovcnt, count;
-   struct iovec iov_vec[1024];
+   /**
+    * The body don't fit in a single DATA frame or in the flow control window: we send only the HEADERS frame, and the DATA frames
+    * are written by the scheduler (flushStreams()) interleaved with the ones of the other streams of the connection...
+    */
+
+   ptr1[4] = FLAG_END_HEADERS;
 
-   if (bdata)
+   if (writev(iov_vec, 2, HTTP2_FRAME_HEADER_SIZE+sz0))
       {
-      U_MEMCPY(iov_vec, iov, sizeof(struct iovec) * (iovcnt = 4));
+      pStream->output = *UClientImage_Base::body;
+      pStream->offset = 0;
 
-      count = HTTP2_FRAME_HEADER_SIZE+sz1+HTTP2_FRAME_HEADER_SIZE+max_frame_size;
-      }
-   else
-      {
-      U_MEMCPY(iov_vec, iov+2, sizeof(struct iovec) * (iovcnt = 2));
+      if (pStream->vfinish < pConnection->vclock) pStream->vfinish = pConnection->vclock;
 
-      count = HTTP2_FRAME_HEADER_SIZE+max_frame_size;
+      ++pConnection->npending;
+
+      U_INTERNAL_DUMP("pConnection->npending = %u pStream->vfinish = %llu pStream->out_window = %d", pConnection->npending, pStream->vfinish, pStream->out_window)
       }
+}
+
+void UHTTP2::flushStreams()
+{
+   U_TRACE_NO_PARAM(0, "UHTTP2::flushStreams()")
+
+   U_INTERNAL_ASSERT_MAJOR(pConnection->npending, 0)
+
+   Stream* ps;
+   char* ptr;
+   uint32_t len, count, iovcnt, nframe, max_frame = (pConnection->bnghttp2 ? 1 : HTTP2_MAX_BATCH_FRAMES); // NB: nghttp2 want a frame for write...
+   struct iovec iov_vec[HTTP2_MAX_BATCH_FRAMES * 2];
+   char buffer[HTTP2_MAX_BATCH_FRAMES * HTTP2_FRAME_HEADER_SIZE];
+
+loop:
+   U_INTERNAL_DUMP("pConnection->npending = %u pConnection->out_window = %d pConnection->vclock = %llu", pConnection->npending, pConnection->out_window, pConnection->vclock)
 
-loop2:
-   ptr += max_frame_size;
+   count = iovcnt = nframe = 0;
 
-   if ((sz2 -= max_frame_size) > max_frame_size)
+   while (nframe < max_frame &&
+          (ps = pickStream()))
       {
-      U_MEMCPY(iov_vec+iovcnt, iov+2, sizeof(struct iovec) * 2);
+      len = ps->output.size() - ps->offset;
 
-      ++iovcnt;
+      if (len > pConnection->peer_settings.max_frame_size) len = pConnection->peer_settings.max_frame_size;
+      if (len > (uint32_t)pConnection->out_window)         len = pConnection->out_window;
+      if (len > (uint32_t)ps->out_window)                  len = ps->out_window;
 
-                               iov_vec[iovcnt].iov_base = ptr;
-      U_INTERNAL_ASSERT_EQUALS(iov_vec[iovcnt].iov_len, max_frame_size)
+      ptr = buffer + (nframe++ * HTTP2_FRAME_HEADER_SIZE);
 
-      ++iovcnt;
+      u_http2_write_len_and_type(ptr,len,DATA);
 
-      U_INTERNAL_ASSERT_MINOR(iovcnt, 1024)
+      iov_vec[iovcnt].iov_base   = (caddr_t)ptr;
+      iov_vec[iovcnt++].iov_len  = HTTP2_FRAME_HEADER_SIZE;
+      iov_vec[iovcnt].iov_base   = (caddr_t)ps->output.c_pointer(ps->offset);
+      iov_vec[iovcnt++].iov_len  = len;
 
-      count += HTTP2_FRAME_HEADER_SIZE+max_frame_size;
+      count += HTTP2_FRAME_HEADER_SIZE + len;
 
-      goto loop2;
+      ptr[4] = ((ps->offset += len) == ps->output.size() ? FLAG_END_STREAM : 0);
+
+      u_write_unalignedp32(ptr+5,ps->id);
+
+      pConnection->out_window -= len;
+               ps->out_window -= len;
+
+      // the virtual clock advance to the start of the frame, the stream is charged for the frame in proportion to its weight
+
+      pConnection->vclock = ps->vfinish;
+                ps->vfinish += ((uint64_t)len << 8) / ps->weight;
       }
 
-   iov_vec[iovcnt] = iov[2];
+   if (nframe)
+      {
+      if (writev(iov_vec, iovcnt, count) == false) return;
 
-   ++iovcnt;
+      for (ps = pConnection->streams; ps <= pStreamEnd; ++ps)
+         {
+         if (ps->output &&
+             ps->offset == ps->output.size())
+            {
+            ps->output.clear();
 
-   iov_vec[iovcnt].iov_len  = sz2;
-   iov_vec[iovcnt].iov_base = ptr;
+            ps->offset = 0;
 
-   ++iovcnt;
+            --pConnection->npending;
+            }
+         }
+
+      if (pConnection->npending) goto loop;
 
-   U_INTERNAL_ASSERT_MINOR(iovcnt, 1024)
+      return;
+      }
 
-   count += HTTP2_FRAME_HEADER_SIZE+sz2;
+   /**
+    * We must wait for a WINDOW_UPDATE frame: we don't block the worker reading it here, the streams stay pending in the table
+    * and the connection go back to the event loop. When the client send the WINDOW_UPDATE (or a new request) handlerRequest()
+    * is called by the read handler and it resume the DATA frames from where we have stopped...
+    */
 
-   (void) writev(iov_vec, iovcnt, count);
+   U_DEBUG("Current window size (%d) is not sufficient for the pending response of %u streams", pConnection->out_window, pConnection->npending)
 }
 
-void UHTTP2::writeResponse()
+void UHTTP2::sendEarlyHints()
 {
-   U_TRACE_NO_PARAM(0, "UHTTP2::writeResponse()")
+   U_TRACE_NO_PARAM(0, "UHTTP2::sendEarlyHints()")
 
-   U_INTERNAL_ASSERT_DIFFERS(U_ClientImage_parallelization, U_PARALLELIZATION_PARENT)
+   U_INTERNAL_ASSERT_POINTER(UHTTP::preload_manifest)
 
-   char buffer1[HTTP2_FRAME_HEADER_SIZE];
-   char buffer2[HTTP2_FRAME_HEADER_SIZE];
+   U_INTERNAL_DUMP("enable_push = %u", pConnection->peer_settings.enable_push)
 
-   if (UHTTP::isHEAD()) UClientImage_Base::body->clear();
+   if (pConnection->peer_settings.enable_push) return; // NB: the resources are pushed after the response (see sendPushPromise())...
 
-   char* ptr  = UClientImage_Base::body->data();
-   char* ptr0 = UClientImage_Base::wbuffer->data();
-   char* ptr1 = buffer1;
+   /**
+    * The client has disabled the server push, we send instead the interim response 103 (Early Hints) as HEADERS frame
+    * on the stream of the request, before the processing of the request as for HTTP/1.1 (see UHTTP::sendEarlyHints())
+    */
 
-   uint32_t sz0     = UClientImage_Base::wbuffer->size(),
-            body_sz = UClientImage_Base::body->size();
+   UString link = UHTTP::getPreload();
 
-   struct iovec iov_vec[4] = { { (caddr_t)buffer1, HTTP2_FRAME_HEADER_SIZE },
-                               { (caddr_t)ptr0, sz0 },
-                               { (caddr_t)buffer2, HTTP2_FRAME_HEADER_SIZE },
-                               { (caddr_t)ptr, body_sz } };
+   if (link.empty() ||
+       (link.size() + 32) > pConnection->peer_settings.max_frame_size)
+      {
+      return;
+      }
 
-   U_INTERNAL_DUMP("UClientImage_Base::wbuffer(%u) = %V", sz0, UClientImage_Base::wbuffer->rep)
+   UString hints(HTTP2_FRAME_HEADER_SIZE + 32 + link.size());
 
-   U_INTERNAL_ASSERT(*UClientImage_Base::wbuffer)
+   char* ptr          = hints.data();
+   unsigned char* dst = (unsigned char*)ptr + HTTP2_FRAME_HEADER_SIZE;
 
-   u_http2_write_len_and_type(ptr1,sz0,HEADERS);
+   /**
+    * dst = hpackEncodeInt(dst, 8, (1<<4)-1, 0x00);
+    * dst = hpackEncodeString(dst, U_CONSTANT_TO_PARAM("103"), false);
+    */
 
-   ptr1[4] = FLAG_END_HEADERS | (body_sz == 0); // FLAG_END_STREAM (1)
+   u_put_unalignedp32(dst, U_MULTICHAR_CONSTANT32(0x08,0x03,'1','0'));
+                      dst[4] = '3';
+                      dst   += 5;
 
-   u_write_unalignedp32(ptr1+5,pStream->id);
+   dst = hpackEncodeInt(dst, 45, (1<<4)-1, 0x00); // link (literal)
+   dst = hpackEncodeString(dst, link, false);
 
-   U_SRV_LOG_WITH_ADDR("send response (%s,id:%u,bytes:%u) %#.*S to", pConnection->bnghttp2 ? "nghttp2" : "HTTP2",
-                           pStream->id, sz0+HTTP2_FRAME_HEADER_SIZE+(body_sz ? body_sz+HTTP2_FRAME_HEADER_SIZE : 0), sz0, ptr0);
+   uint32_t sz = (char*)dst - ptr;
 
-   if (body_sz == 0)
+   u_http2_write_len_and_type(ptr,sz-HTTP2_FRAME_HEADER_SIZE,HEADERS);
+
+   ptr[4] = FLAG_END_HEADERS;
+
+   u_write_unalignedp32(ptr+5,pStream->id);
+
+   if (USocketExt::write(UServer_Base::csocket, ptr, sz, 0) != (int)sz) nerror = CONNECT_ERROR;
+   else
       {
-#  ifdef DEBUG
-   // decodeHeadersResponse(ptr0, sz0);
-#  endif
+      U_SRV_LOG_WITH_ADDR("send interim response (HTTP2,id:%u) 103 Early Hints %V to", pStream->id, link.rep);
+      }
+}
 
-      (void) writev(iov_vec, 2, HTTP2_FRAME_HEADER_SIZE+sz0);
+void UHTTP2::sendPushPromise()
+{
+   U_TRACE_NO_PARAM(0, "UHTTP2::sendPushPromise()")
+
+   U_INTERNAL_ASSERT_POINTER(UHTTP::preload_manifest)
 
+   npush = 0;
+
+   U_INTERNAL_DUMP("U_http_info.nResponseCode = %d U_http_host_len = %u enable_push = %u", U_http_info.nResponseCode, U_http_host_len, pConnection->peer_settings.enable_push)
+
+   if (U_http_info.nResponseCode != HTTP_OK          ||
+       U_http_host_len == 0                          ||
+       pConnection->peer_settings.enable_push == 0 || // NB: we have already sent the interim response 103 (see sendEarlyHints())...
+       UHTTP::isGET() == false)
+      {
       return;
       }
 
-   U_INTERNAL_ASSERT_MAJOR(body_sz, 0)
+   UString link = UHTTP::getPreload();
 
-   char* ptr2 = buffer2;
+   if (link.empty()) return;
 
-   u_write_unalignedp32(ptr2+5,pStream->id);
+   char* ptr;
+   uint32_t sz;
+   unsigned char* dst;
 
-   if ((uint32_t)pConnection->out_window >= body_sz)
-      {
-      pConnection->out_window -= body_sz;
+   /**
+    * Push only the resource in the memory cache, and only if we have a free slot in the stream table for every resource pushed (the
+    * DATA frames are sent by the scheduler with the pushed stream that depend on the stream of the response). The header block of
+    * PUSH_PROMISE don't use the dynamic table, so it is independent from the order in which the header block of the response are encoded...
+    */
 
-      writeData(iov_vec, true, FLAG_END_STREAM);
+   UHTTP::UFileCacheData* ptr_file_data;
+   const char* end = (ptr = link.data()) + link.size();
+   unsigned char buffer[HTTP2_FRAME_HEADER_SIZE + 4 + 16 + 255 + U_PATH_MAX];
+   uint32_t max_push = HTTP2_MAX_CONCURRENT_STREAMS - (pStreamEnd - pConnection->streams) - 1;
 
-      return;
-      }
+   if (max_push > HTTP2_MAX_PUSH_STREAMS)                           max_push = HTTP2_MAX_PUSH_STREAMS;
+   if (max_push > pConnection->peer_settings.max_concurrent_streams) max_push = pConnection->peer_settings.max_concurrent_streams;
 
-   U_DEBUG("Current window size (%d) is not sufficient for data size: %u", pConnection->out_window, body_sz)
+   U_INTERNAL_DUMP("max_push = %u", max_push)
 
-   U_SRV_LOG("WARNING: Current window size (%d) is not sufficient for data size: %u", pConnection->out_window, body_sz);
+   if (max_push == 0) return;
 
-   if (pConnection->out_window == 0)
+   while ((ptr = (char*)memchr(ptr, '<', end - ptr)))
       {
-      if (writev(iov_vec, 2, HTTP2_FRAME_HEADER_SIZE+sz0) == false) return;
-      }
-   else
-      {
-      ptr               += pConnection->out_window;
-      body_sz           -= pConnection->out_window;
-      iov_vec[3].iov_len = pConnection->out_window;
-                           pConnection->out_window = 0;
+      const char* path = ++ptr;
 
-      writeData(iov_vec, true, false);
+      if ((ptr = (char*)memchr(ptr, '>', end - ptr)) == 0) break;
 
-      U_INTERNAL_DUMP("nerror = %u", nerror)
+      uint32_t len = ptr - path;
 
-      if (nerror != NO_ERROR) return;
+      if (len < 2           ||
+          len >= U_PATH_MAX ||
+          path[0] != '/')
+         {
+         continue;
+         }
+
+      ptr_file_data = UHTTP::getFileInCache(path+1, len-1);
+
+      if (ptr_file_data == 0        ||
+          ptr_file_data->array == 0 ||
+          u_now->tv_sec > ptr_file_data->expire)
+         {
+         continue;
+         }
+
+      // :method GET, :scheme https|http, :authority host, :path path
+
+      dst = buffer + HTTP2_FRAME_HEADER_SIZE + 4;
+
+      *dst++ = 0x82; // :method GET
+#  ifdef USE_LIBSSL
+      *dst++ = (UServer_Base::bssl ? 0x87 : 0x86); // :scheme https|http
+#  else
+      *dst++ = 0x86; // :scheme http
+#  endif
+      *dst++ = 0x01; // :authority (literal)
+       dst   = hpackEncodeString(dst, U_HTTP_HOST_TO_PARAM, false);
+      *dst++ = 0x04; // :path (literal)
+       dst   = hpackEncodeString(dst, path, len, false);
+
+      push_id[npush] = (pConnection->max_pushed_stream_id += 2);
+
+      ptr = (char*)buffer;
+       sz = (char*)dst - ptr;
+
+      u_http2_write_len_and_type(ptr,sz-HTTP2_FRAME_HEADER_SIZE,PUSH_PROMISE);
+
+      ptr[4] = FLAG_END_HEADERS;
+
+      u_write_unalignedp32(ptr+5,pStream->id);
+      u_write_unalignedp32(ptr+9,push_id[npush]);
+
+      if (USocketExt::write(UServer_Base::csocket, ptr, sz, 0) != (int)sz)
+         {
+         nerror = CONNECT_ERROR;
+
+         return;
+         }
+
+      U_SRV_LOG_WITH_ADDR("send PUSH_PROMISE (HTTP2,id:%u,promised:%u) %.*S to", pStream->id, push_id[npush], len, path);
+
+      push_data[npush] = ptr_file_data;
+
+      if (++npush == max_push) break;
+
+      ptr = (char*)path + len;
       }
+}
 
-   // we must wait for a Window Update frame if the current window size is not sufficient...
+void UHTTP2::writePushResponse()
+{
+   U_TRACE_NO_PARAM(0, "UHTTP2::writePushResponse()")
 
-#ifdef DEBUG
-   Stream* pStreamEndOld = pStreamEnd;
-#endif
+   U_INTERNAL_ASSERT_MAJOR(npush, 0)
 
-loop:
-   readFrame();
+   uint32_t parent = pStream->id,
+            index  = (pStream - pConnection->streams); // NB: addStream() can move the stream table...
+   UHTTP::UFileCacheData* file_data_old = UHTTP::file_data; // NB: UHTTP::checkFileInCacheOld() depend on it...
 
-   U_INTERNAL_DUMP("nerror = %u", nerror)
+   priority_weight     = 0;
+   priority_dependency = parent;
 
-   if (nerror == NO_ERROR)
+   for (uint32_t i = 0; i < npush && nerror == NO_ERROR; ++i)
       {
-      U_INTERNAL_ASSERT_MAJOR(pConnection->out_window, 0)
-      U_INTERNAL_ASSERT_EQUALS(pStreamEnd, pStreamEndOld)
+      pStream = addStream();
 
-      iov_vec[3].iov_base = ptr;
+      U_INTERNAL_ASSERT_POINTER(pStream) // NB: sendPushPromise() check for the free slot...
 
-      if (body_sz > (uint32_t)pConnection->out_window)
-         {
-         ptr               += pConnection->out_window;
-         body_sz           -= pConnection->out_window;
-         iov_vec[3].iov_len = pConnection->out_window;
-                              pConnection->out_window = 0;
+      pStream->id    = push_id[i];
+      pStream->state = STREAM_STATE_HALF_CLOSED; // reserved (local) => half-closed (remote)
 
-         writeData(iov_vec, false, false);
+      initStream();
 
-         U_INTERNAL_DUMP("nerror = %u", nerror)
+      UHTTP::file_data = push_data[i];
 
-         if (nerror != NO_ERROR) return;
+      U_http_info.nResponseCode = HTTP_OK;
 
-         goto loop;
+#  ifdef USE_LIBZ
+      if (U_http_is_accept_gzip &&
+          UHTTP::isDataCompressFromCache())
+         {
+         *UHTTP::ext              = UHTTP::file_data->array->operator[](3);
+         *UClientImage_Base::body = UHTTP::file_data->array->operator[](2);
          }
+      else
+#  endif
+      {
+      *UHTTP::ext              = UHTTP::file_data->array->operator[](1);
+      *UClientImage_Base::body = UHTTP::file_data->array->operator[](0);
+      }
 
-      iov_vec[3].iov_len       = body_sz;
-      pConnection->out_window -= body_sz;
-
-      writeData(iov_vec, false, true);
+      handlerResponse();
+      writeResponse();
       }
+
+   npush = 0;
+
+   UHTTP::ext->clear();
+
+   UHTTP::file_data = file_data_old;
+   pStream          = pConnection->streams + index;
 }
 
 // HTTP2 => HTTP1
@@ -3140,10 +3475,10 @@ void UHTTP2::handlerDelete(UClientImage_Base* pclient, bool& bsocket_open)
 #ifdef DEBUG
    U_DUMP("pConnection->state = (%u, %s) pConnection->max_processed_stream_id = %u", pConnection->state, getConnectionStatusDescription(), pConnection->max_processed_stream_id)
 
-   for (pStream = pConnection->streams, pStreamEnd = (pStream+HTTP2_MAX_CONCURRENT_STREAMS); pStream < pStreamEnd; ++pStream)
+   for (pStream = pConnection->streams, pStreamEnd = (pStream+pConnection->streams_capacity); pStream < pStreamEnd; ++pStream)
       {
       U_ASSERT(pStream->body.empty())
-      U_ASSERT(pStream->headers.empty())
+      U_ASSERT(pStream->headers.empty()) // NB: the output can be not empty if the connection is closed with DATA frames deferred...
 
       U_INTERNAL_ASSERT_EQUALS(pStream->clength, 0)
       }
@@ -3152,6 +3487,15 @@ void UHTTP2::handlerDelete(UClientImage_Base* pclient, bool& bsocket_open)
    clearHpackDynTbl(&(pConnection->idyntbl));
    clearHpackDynTbl(&(pConnection->odyntbl));
 
+   if (pConnection->streams)
+      {
+      delete[] pConnection->streams;
+
+      pConnection->streams          = 0;
+      pConnection->streams_capacity =
+      pConnection->last_slot        = 0;
+      }
+
    pConnection->state = CONN_STATE_IS_CLOSING;
 
    U_INTERNAL_DUMP("pclient->socket->iState = %u", pclient->socket->iState)
@@ -3181,8 +3525,10 @@ bool UHTTP2::initRequest()
 
    U_DUMP("pConnection->state = (%u, %s) pConnection->max_processed_stream_id = %u", pConnection->state, getConnectionStatusDescription(), pConnection->max_processed_stream_id)
 
-   pStream    =
-   pStreamEnd = pConnection->streams;
+   if (pConnection->streams == 0) pConnection->resizeStreams(HTTP2_MIN_STREAMS); // NB: the stream table is allocated only for the active connection...
+
+   pStream    = pConnection->streams;
+   pStreamEnd = pConnection->streams + pConnection->last_slot; // NB: with DATA frames deferred we keep the streams of the previous event...
 
    U_ASSERT(pStream->body.empty())
    U_ASSERT(pStream->headers.empty())
@@ -3292,6 +3638,11 @@ void UHTTP2::handlerRequest()
 
          pStream->state = STREAM_STATE_HALF_CLOSED;
 
+         priority_weight     =
+         priority_dependency = 0;
+
+         initStream();
+
          if ((pStream->clength = U_http_info.clength))
             {
             pStream->body.setBuffer(U_http_info.clength);
@@ -3367,6 +3718,14 @@ read_request:
 
       if (sz == 0)
          {
+         if (pConnection->npending ||
+             pConnection->last_slot)
+            {
+            UClientImage_Base::setRequestProcessed(); // NB: no new request, only the resume of the pending streams...
+
+            goto flush;
+            }
+
          U_INTERNAL_ASSERT_EQUALS(pStream,    pConnection->streams)
          U_INTERNAL_ASSERT_EQUALS(pStreamEnd, pConnection->streams)
 
@@ -3407,8 +3766,12 @@ read_request:
 
          if (U_ClientImage_parallelization == U_PARALLELIZATION_PARENT) goto end;
 
+         if (UHTTP::preload_manifest) sendPushPromise(); // NB: the PUSH_PROMISE must precede the response that reference the pushed resource...
+
          writeResponse();
 
+         if (npush) writePushResponse();
+
          U_INTERNAL_DUMP("nerror = %u", nerror)
 
          if (nerror != NO_ERROR) goto err;
@@ -3513,8 +3876,14 @@ process_request:
             }
          else
 #     endif
+         {
+         if (UHTTP::preload_manifest) sendPushPromise(); // NB: the PUSH_PROMISE must precede the response that reference the pushed resource...
+
          writeResponse();
 
+         if (npush) writePushResponse();
+         }
+
          U_INTERNAL_DUMP("nerror = %u", nerror)
 
          if (nerror != NO_ERROR) goto err;
@@ -3539,6 +3908,13 @@ process_request:
             }
          }
 
+flush:
+      if (pConnection->npending) flushStreams();
+
+      U_INTERNAL_DUMP("nerror = %u pConnection->npending = %u", nerror, pConnection->npending)
+
+      if (nerror != NO_ERROR) goto err;
+
       UClientImage_Base::wbuffer->clear();
 
 #  ifdef DEBUG
@@ -3551,7 +3927,31 @@ process_request:
 
       U_INTERNAL_DUMP("U_ClientImage_close = %b", U_ClientImage_close)
 
-      if (U_ClientImage_close == false) return;
+      if (U_ClientImage_close == false)
+         {
+         if (pConnection->npending)
+            {
+            // NB: the streams with DATA frames deferred must be found again by the next event (see initRequest())...
+
+            pConnection->last_slot = (pStreamEnd - pConnection->streams);
+
+            return;
+            }
+
+         pConnection->last_slot = 0;
+
+         if (pConnection->streams_capacity > HTTP2_MIN_STREAMS)
+            {
+            // NB: we keep only the first slot (the next event start from it), the connection can stay idle for long time...
+
+            pConnection->resizeStreams(HTTP2_MIN_STREAMS);
+
+            pStream    =
+            pStreamEnd = pConnection->streams;
+            }
+
+         return;
+         }
       }
 
 err:
@@ -3977,6 +4377,9 @@ U_EXPORT const char* UHTTP2::Connection::dump(bool reset) const
    *UObjectIO::os << "state                     " << state                   << '\n'
                   << "inp_window                " << inp_window              << '\n'
                   << "out_window                " << out_window              << '\n'
+                  << "npending                  " << npending                << '\n'
+                  << "last_slot                 " << last_slot               << '\n'
+                  << "streams_capacity          " << streams_capacity        << '\n'
                   << "max_processed_stream_id   " << max_processed_stream_id << '\n'
                   << "itable (UHashMap<UString> " << (void*)&itable          << ')';
 
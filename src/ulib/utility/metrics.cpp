@@ -0,0 +1,399 @@
+// ============================================================================
+//
+// = LIBRARY
+//    ULib - c++ library
+//
+// = FILENAME
+//    metrics.cpp - latency histograms and counters of the server (Prometheus format)
+//
+// = AUTHOR
+//    Stefano Casazza
+//
+// ============================================================================
+
+#include <ulib/utility/uhttp.h>
+#include <ulib/utility/metrics.h>
+#include <ulib/net/server/server.h>
+
+#define U_METRICS_CTYPE "text/plain; version=0.0.4" U_CRLF
+
+UString*               UMetrics::uri;
+uint64_t*              UMetrics::vaccept;
+uint64_t               UMetrics::t_start;
+uint64_t               UMetrics::t_last;
+uint32_t               UMetrics::num_slot;
+uint32_t               UMetrics::max_connection;
+UMetrics::worker_data* UMetrics::pworker;
+UMetrics::worker_data* UMetrics::vworker;
+
+static const char* phase_name[U_METRICS_PHASE_MAX] = { "accept", "parse", "handler", "write" };
+
+// NB: the bucket of Prometheus (in second) are computed from the bucket of the histogram with a upper bound not greater...
+
+static const char*    le_name[] = { "0.0001", "0.00025", "0.0005", "0.001", "0.0025", "0.005", "0.01", "0.025", "0.05", "0.1", "0.25", "0.5", "1", "2.5", "5", "10" };
+static const uint64_t le_value[] = { 100000ULL, 250000ULL, 500000ULL, 1000000ULL, 2500000ULL, 5000000ULL, 10000000ULL, 25000000ULL, 50000000ULL,
+                                     100000000ULL, 250000000ULL, 500000000ULL, 1000000000ULL, 2500000000ULL, 5000000000ULL, 10000000000ULL };
+
+static const char*  quantile_name[] = { "0.5", "0.9", "0.99", "0.999" };
+static const double quantile_value[] = { 0.5,   0.9,   0.99,   0.999 };
+
+// NB: the value less than U_METRICS_SUB_BUCKET have a bucket for each value, then for each power of 2 (2^e) there are
+//     U_METRICS_SUB_BUCKET bucket that are indexed by the 3 bit after the most significant one...
+
+uint32_t UMetrics::getBucket(uint64_t value)
+{
+   U_TRACE(0, "UMetrics::getBucket(%llu)", value)
+
+   if (value < U_METRICS_SUB_BUCKET) U_RETURN((uint32_t)value);
+
+   uint32_t e   = 63 - __builtin_clzll(value),
+            idx = ((e - 2) * U_METRICS_SUB_BUCKET) + (uint32_t)((value >> (e - 3)) & (U_METRICS_SUB_BUCKET - 1));
+
+   if (idx >= U_METRICS_BUCKET) idx = U_METRICS_BUCKET - 1;
+
+   U_RETURN(idx);
+}
+
+uint64_t UMetrics::getBucketLimit(uint32_t idx)
+{
+   U_TRACE(0, "UMetrics::getBucketLimit(%u)", idx)
+
+   U_INTERNAL_ASSERT_MINOR(idx, U_METRICS_BUCKET)
+
+   if (idx < U_METRICS_SUB_BUCKET) U_RETURN(idx + 1);
+
+   uint32_t e   = (idx / U_METRICS_SUB_BUCKET) + 2,
+            sub =  idx % U_METRICS_SUB_BUCKET;
+
+   uint64_t limit = (uint64_t)(U_METRICS_SUB_BUCKET + 1 + sub) << (e - 3);
+
+   U_RETURN(limit);
+}
+
+void UMetrics::init()
+{
+   U_TRACE_NO_PARAM(0, "UMetrics::init()")
+
+   U_INTERNAL_ASSERT_POINTER(uri)
+   U_INTERNAL_ASSERT_EQUALS(vworker, 0)
+
+   num_slot = (UServer_Base::preforked_num_kids > 1 ? UServer_Base::preforked_num_kids : 1);
+   vworker  = (worker_data*) UServer_Base::getOffsetToDataShare(num_slot * sizeof(worker_data));
+
+   U_INTERNAL_DUMP("num_slot = %u sizeof(worker_data) = %u", num_slot, sizeof(worker_data))
+}
+
+void UMetrics::run(uint32_t _max_connection)
+{
+   U_TRACE(0, "UMetrics::run(%u)", _max_connection)
+
+   U_INTERNAL_ASSERT_EQUALS(vaccept, 0)
+
+   vworker = (worker_data*) UServer_Base::getPointerToDataShare(vworker);
+
+   max_connection = _max_connection;
+
+   vaccept = (uint64_t*) UMemoryPool::_malloc(max_connection, sizeof(uint64_t), true);
+
+   U_SRV_LOG("metrics: %u slot of %u bytes, scrape URI %V", num_slot, sizeof(worker_data), uri->rep);
+}
+
+void UMetrics::start()
+{
+   U_TRACE_NO_PARAM(0, "UMetrics::start()")
+
+   U_INTERNAL_ASSERT_POINTER(vworker)
+
+   // NB: we claim the first slot free or of a worker that is dead (respawn), so the counters are not lost...
+
+   pid_t p, pid = U_SYSCALL_NO_PARAM(getpid);
+
+   for (uint32_t i = 0; i < num_slot; ++i)
+      {
+      p = vworker[i].pid;
+
+      if ((p == 0 ||
+           (p != pid && U_SYSCALL(kill, "%d,%d", p, 0) == -1 && errno == ESRCH)) &&
+          __sync_bool_compare_and_swap(&(vworker[i].pid), p, pid))
+         {
+         pworker = vworker+i;
+
+         U_INTERNAL_DUMP("slot = %u", i)
+
+         return;
+         }
+      }
+
+   U_WARNING("metrics: no slot available for the process %P, the latency of the requests is not measured");
+}
+
+void UMetrics::clear()
+{
+   U_TRACE_NO_PARAM(0, "UMetrics::clear()")
+
+   if (vaccept)
+      {
+      UMemoryPool::_free(vaccept, max_connection, sizeof(uint64_t));
+
+      vaccept = 0;
+      }
+
+   if (uri)
+      {
+      delete uri;
+             uri = 0;
+      }
+
+   pworker = 0;
+}
+
+void UMetrics::observe(int phase, uint64_t value)
+{
+   U_TRACE(0, "UMetrics::observe(%d,%llu)", phase, value)
+
+   U_INTERNAL_ASSERT_POINTER(pworker)
+   U_INTERNAL_ASSERT_RANGE(0, phase, U_METRICS_PHASE_MAX-1)
+
+   histogram* h = pworker->phase + phase;
+
+   h->sum += value;
+
+   h->bucket[getBucket(value)]++;
+}
+
+void UMetrics::startRequest(UClientImage_Base* pclient)
+{
+   U_TRACE(0, "UMetrics::startRequest(%p)", pclient)
+
+   U_INTERNAL_ASSERT_POINTER(pworker)
+
+   // NB: the message of a connection upgraded to websocket or SSE is not a request...
+
+   if (U_ClientImage_http(pclient) == 'W' ||
+       U_ClientImage_http(pclient) == 'S')
+      {
+      t_start = 0;
+
+      return;
+      }
+
+   t_start = t_last = now();
+
+   // NB: with only one plugin the request hook is called directly (see UHttpPlugIn::handlerRun())...
+
+   UServer_Base::plugin_index = (UServer_Base::vplugin_size == 1 ? 0 : U_NOT_FOUND);
+
+   uint32_t idx = pclient - UServer_Base::vClientImage;
+
+   U_INTERNAL_ASSERT_MINOR(idx, max_connection)
+
+   if (vaccept[idx])
+      {
+      if (t_start > vaccept[idx]) observe(U_METRICS_PHASE_ACCEPT, t_start - vaccept[idx]);
+
+      vaccept[idx] = 0;
+      }
+}
+
+void UMetrics::setPhase(int phase)
+{
+   U_TRACE(0, "UMetrics::setPhase(%d)", phase)
+
+   U_INTERNAL_ASSERT_POINTER(pworker)
+
+   // NB: with the parallelization the request is processed by the child (that inherit t_start)...
+
+   if (t_start &&
+       UServer_Base::isParallelizationParent() == false)
+      {
+      uint64_t t = now(), delta = t - t_last;
+
+      observe(phase, delta);
+
+      t_last = t;
+
+      if (phase == U_METRICS_PHASE_HANDLER)
+         {
+         uint32_t i = UServer_Base::plugin_index;
+
+         U_INTERNAL_DUMP("plugin_index = %u", i)
+
+         if (i < U_METRICS_PLUGIN_MAX)
+            {
+            pworker->plugin_count[i]++;
+            pworker->plugin_time[i] += delta;
+            }
+         }
+      }
+}
+
+void UMetrics::endRequest()
+{
+   U_TRACE_NO_PARAM(0, "UMetrics::endRequest()")
+
+   U_INTERNAL_ASSERT_POINTER(pworker)
+
+   U_INTERNAL_DUMP("t_start = %llu U_http_info.nResponseCode = %u", t_start, U_http_info.nResponseCode)
+
+   if (t_start)
+      {
+      if (U_http_info.nResponseCode >= 100 &&
+          U_http_info.nResponseCode <  100 + U_METRICS_STATUS_MAX)
+         {
+         pworker->status[U_http_info.nResponseCode - 100]++;
+         }
+
+      t_start = 0;
+      }
+}
+
+U_NO_EXPORT void UMetrics::sum(histogram& h, int phase)
+{
+   U_TRACE(0, "UMetrics::sum(%p,%d)", &h, phase)
+
+   (void) U_SYSCALL(memset, "%p,%d,%u", &h, 0, sizeof(histogram));
+
+   for (uint32_t i = 0, j; i < num_slot; ++i)
+      {
+      const histogram* p = vworker[i].phase + phase;
+
+      h.sum += p->sum;
+
+      for (j = 0; j < U_METRICS_BUCKET; ++j) h.bucket[j] += p->bucket[j];
+      }
+}
+
+__pure uint64_t UMetrics::getQuantile(const histogram& h, uint64_t count, double q)
+{
+   U_TRACE(0, "UMetrics::getQuantile(%p,%llu,%g)", &h, count, q)
+
+   if (count == 0) U_RETURN(0);
+
+   uint64_t cum = 0;
+   double target = q * count;
+
+   for (uint32_t i = 0; i < U_METRICS_BUCKET; ++i)
+      {
+      cum += h.bucket[i];
+
+      if (cum &&
+          cum >= target)
+         {
+         U_RETURN(getBucketLimit(i));
+         }
+      }
+
+   U_RETURN(getBucketLimit(U_METRICS_BUCKET - 1));
+}
+
+void UMetrics::getText(UString& body)
+{
+   U_TRACE(0, "UMetrics::getText(%V)", body.rep)
+
+   U_INTERNAL_ASSERT_POINTER(vworker)
+
+   int phase;
+   histogram h;
+   uint64_t count, cum;
+   uint32_t i, j, k, n = U_NUM_ELEMENTS(le_value);
+
+   body.snprintf_add(U_CONSTANT_TO_PARAM("# HELP userver_request_duration_seconds Latency of each phase of the processing of a request\n"
+                                         "# TYPE userver_request_duration_seconds histogram\n"));
+
+   for (phase = 0; phase < U_METRICS_PHASE_MAX; ++phase)
+      {
+      sum(h, phase);
+
+      (void) body.reserve((n + 3) * 96);
+
+      for (i = j = 0, cum = 0; i < n; ++i)
+         {
+         for (; j < U_METRICS_BUCKET && getBucketLimit(j) <= le_value[i]; ++j) cum += h.bucket[j];
+
+         body.snprintf_add(U_CONSTANT_TO_PARAM("userver_request_duration_seconds_bucket{phase=\"%s\",le=\"%s\"} %llu\n"), phase_name[phase], le_name[i], cum);
+         }
+
+      for (count = cum; j < U_METRICS_BUCKET; ++j) count += h.bucket[j];
+
+      body.snprintf_add(U_CONSTANT_TO_PARAM("userver_request_duration_seconds_bucket{phase=\"%s\",le=\"+Inf\"} %llu\n"
+                                            "userver_request_duration_seconds_sum{phase=\"%s\"} %.9f\n"
+                                            "userver_request_duration_seconds_count{phase=\"%s\"} %llu\n"),
+                        phase_name[phase], count, phase_name[phase], (double)h.sum / 1e9, phase_name[phase], count);
+      }
+
+   (void) body.reserve(U_METRICS_PHASE_MAX * U_NUM_ELEMENTS(quantile_value) * 96 + 256);
+
+   body.snprintf_add(U_CONSTANT_TO_PARAM("# HELP userver_request_duration_quantile_seconds Quantile of the latency of each phase (upper bound of the bucket)\n"
+                                         "# TYPE userver_request_duration_quantile_seconds gauge\n"));
+
+   for (phase = 0; phase < U_METRICS_PHASE_MAX; ++phase)
+      {
+      sum(h, phase);
+
+      for (count = j = 0; j < U_METRICS_BUCKET; ++j) count += h.bucket[j];
+
+      for (k = 0; k < U_NUM_ELEMENTS(quantile_value); ++k)
+         {
+         body.snprintf_add(U_CONSTANT_TO_PARAM("userver_request_duration_quantile_seconds{phase=\"%s\",quantile=\"%s\"} %.9f\n"),
+                           phase_name[phase], quantile_name[k], (double)getQuantile(h, count, quantile_value[k]) / 1e9);
+         }
+      }
+
+   body.snprintf_add(U_CONSTANT_TO_PARAM("# HELP userver_responses_total Responses for each status code\n"
+                                         "# TYPE userver_responses_total counter\n"));
+
+   for (i = 0; i < U_METRICS_STATUS_MAX; ++i)
+      {
+      for (count = j = 0; j < num_slot; ++j) count += vworker[j].status[i];
+
+      if (count)
+         {
+         (void) body.reserve(96);
+
+         body.snprintf_add(U_CONSTANT_TO_PARAM("userver_responses_total{code=\"%u\"} %llu\n"), i + 100, count);
+         }
+      }
+
+   // NB: the samples of a metric must be contiguous...
+
+   for (k = 0; k < 2; ++k)
+      {
+      (void) body.reserve(256);
+
+      if (k == 0)
+         {
+         body.snprintf_add(U_CONSTANT_TO_PARAM("# HELP userver_plugin_requests_total Requests completed by each plugin\n"
+                                               "# TYPE userver_plugin_requests_total counter\n"));
+         }
+      else
+         {
+         body.snprintf_add(U_CONSTANT_TO_PARAM("# HELP userver_plugin_handler_seconds_total Time spent in the request hook of each plugin\n"
+                                               "# TYPE userver_plugin_handler_seconds_total counter\n"));
+         }
+
+      for (i = 0; i < UServer_Base::vplugin_size && i < U_METRICS_PLUGIN_MAX; ++i)
+         {
+         for (count = j = 0; j < num_slot; ++j) count += (k == 0 ? vworker[j].plugin_count[i] : vworker[j].plugin_time[i]);
+
+         UString name = UServer_Base::vplugin_name->at(i);
+
+         (void) body.reserve(name.size() + 128);
+
+         if (k == 0) body.snprintf_add(U_CONSTANT_TO_PARAM("userver_plugin_requests_total{plugin=\"%v\"} %llu\n"), name.rep, count);
+         else        body.snprintf_add(U_CONSTANT_TO_PARAM("userver_plugin_handler_seconds_total{plugin=\"%v\"} %.9f\n"), name.rep, (double)count / 1e9);
+         }
+      }
+}
+
+void UMetrics::handlerRequest()
+{
+   U_TRACE_NO_PARAM(0, "UMetrics::handlerRequest()")
+
+   UString body(U_CAPACITY), ctype(U_CONSTANT_TO_PARAM(U_METRICS_CTYPE));
+
+   getText(body);
+
+   U_http_info.nResponseCode = HTTP_OK;
+
+   UHTTP::setResponse(true, ctype, &body);
+}
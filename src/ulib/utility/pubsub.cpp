@@ -0,0 +1,869 @@
+// ============================================================================
+//
+// = LIBRARY
+//    ULib - c++ library
+//
+// = FILENAME
+//    pubsub.cpp - topic based broadcast to WebSocket and SSE clients
+//
+// = AUTHOR
+//    Stefano Casazza
+//
+// ============================================================================
+
+#include <ulib/utility/uhttp.h>
+#include <ulib/utility/pubsub.h>
+#include <ulib/utility/websocket.h>
+#include <ulib/net/server/server.h>
+
+#ifdef U_LINUX
+#  include <sys/un.h>
+#  include <sys/eventfd.h>
+#endif
+
+#define U_PUBSUB_BINARY              0x80000000U
+#define U_PUBSUB_RECORD_SIZE(len)    (((len) + sizeof(uint32_t) + 7) & ~7)
+#define U_PUBSUB_SLOT_SIZE           ((num_slot * sizeof(pid_t) + 7) & ~7)
+#define U_PUBSUB_SSE_RESPONSE        "HTTP/1.1 200 OK\r\n" \
+                                     "Content-Type: text/event-stream\r\n" \
+                                     "Cache-Control: no-cache\r\n\r\n"
+
+ULock*                UPubSub::lock;
+int*                  UPubSub::vslot_fd;
+char*                 UPubSub::vring;
+pid_t*                UPubSub::vslot_pid;
+UString*              UPubSub::frame;
+UString*              UPubSub::buffer;
+UString*              UPubSub::sse_uri;
+UString*              UPubSub::socket_path;
+uint64_t*             UPubSub::vmask;
+uint64_t              UPubSub::cursor[U_PUBSUB_TOPIC_MAX];
+uint32_t              UPubSub::num_subscriber[U_PUBSUB_TOPIC_MAX];
+uint32_t              UPubSub::topic_max;
+uint32_t              UPubSub::ring_size;
+uint32_t              UPubSub::num_slot;
+uint32_t              UPubSub::index_max;
+uint32_t              UPubSub::max_connection;
+UEventFd*             UPubSub::control;
+UPubSub::pubsub_data* UPubSub::ptr;
+
+/**
+ * The wakeup of the worker: the eventfd of the slot claimed by the worker (see UPubSub::start()), the publisher write on all the slot...
+ */
+
+class U_NO_EXPORT UPubSubNotify : public UEventFd {
+public:
+
+   // Check for memory error
+   U_MEMORY_TEST
+
+   // Allocator e Deallocator
+   U_MEMORY_ALLOCATOR
+   U_MEMORY_DEALLOCATOR
+
+   UPubSubNotify()
+      {
+      U_TRACE_REGISTER_OBJECT(0, UPubSubNotify, "")
+
+      UEventFd::op_mask &= ~EPOLLRDHUP;
+      }
+
+   virtual ~UPubSubNotify() U_DECL_FINAL
+      {
+      U_TRACE_UNREGISTER_OBJECT(0, UPubSubNotify)
+      }
+
+   // define method VIRTUAL of class UEventFd
+
+   virtual int handlerRead() U_DECL_FINAL
+      {
+      U_TRACE_NO_PARAM(1, "UPubSubNotify::handlerRead()")
+
+      uint64_t value;
+
+      (void) U_SYSCALL(read, "%d,%p,%u", UEventFd::fd, &value, sizeof(uint64_t));
+
+      UPubSub::drain();
+
+      U_RETURN(U_NOTIFIER_OK);
+      }
+
+#if defined(DEBUG) && defined(U_STDCPP_ENABLE)
+   const char* dump(bool _reset) const { return UEventFd::dump(_reset); }
+#endif
+
+private:
+   U_DISALLOW_COPY_AND_ASSIGN(UPubSubNotify)
+};
+
+/**
+ * The control channel: a UNIX datagram socket where every datagram is a message to publish in the form 'topic payload'. It is
+ * registered as UServer_Base::handler_other, so only one of the workers is notified for every datagram...
+ */
+
+class U_NO_EXPORT UPubSubControl : public UEventFd {
+public:
+
+   // Check for memory error
+   U_MEMORY_TEST
+
+   // Allocator e Deallocator
+   U_MEMORY_ALLOCATOR
+   U_MEMORY_DEALLOCATOR
+
+   UPubSubControl()
+      {
+      U_TRACE_REGISTER_OBJECT(0, UPubSubControl, "")
+
+      UEventFd::op_mask &= ~EPOLLRDHUP;
+      }
+
+   virtual ~UPubSubControl() U_DECL_FINAL
+      {
+      U_TRACE_UNREGISTER_OBJECT(0, UPubSubControl)
+
+      if (UEventFd::fd != -1) (void) U_SYSCALL(close, "%d", UEventFd::fd);
+      }
+
+   bool open(const UString& socket_path);
+
+   // define method VIRTUAL of class UEventFd
+
+   virtual int handlerRead() U_DECL_FINAL;
+
+#if defined(DEBUG) && defined(U_STDCPP_ENABLE)
+   const char* dump(bool _reset) const { return UEventFd::dump(_reset); }
+#endif
+
+private:
+   U_DISALLOW_COPY_AND_ASSIGN(UPubSubControl)
+};
+
+bool UPubSubControl::open(const UString& socket_path)
+{
+   U_TRACE(1, "UPubSubControl::open(%V)", socket_path.rep)
+
+#ifdef U_LINUX
+   struct sockaddr_un addr;
+
+   if (socket_path.size() >= sizeof(addr.sun_path)) U_RETURN(false);
+
+   UEventFd::fd = U_SYSCALL(socket, "%d,%d,%d", AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+   if (UEventFd::fd == -1) U_RETURN(false);
+
+   (void) U_SYSCALL(memset, "%p,%d,%u", &addr, 0, sizeof(addr));
+
+   addr.sun_family = AF_UNIX;
+
+   U_MEMCPY(addr.sun_path, socket_path.data(), socket_path.size());
+
+   // NB: the socket file of a previous run...
+
+   (void) U_SYSCALL(unlink, "%S", addr.sun_path);
+
+   if (U_SYSCALL(bind, "%d,%p,%d", UEventFd::fd, (sockaddr*)&addr, sizeof(addr)) == 0) U_RETURN(true);
+
+   (void) U_SYSCALL(close, "%d", UEventFd::fd);
+
+   UEventFd::fd = -1;
+#endif
+
+   U_RETURN(false);
+}
+
+int UPubSubControl::handlerRead()
+{
+   U_TRACE_NO_PARAM(1, "UPubSubControl::handlerRead()")
+
+   U_INTERNAL_ASSERT_POINTER(UPubSub::frame)
+
+   ssize_t n;
+   const char* sep;
+   char* ptr = UPubSub::frame->data();
+   uint32_t sz = UPubSub::frame->capacity();
+
+   // NB: with MSG_TRUNC recv() return the real length of the datagram, also when it don't fit in the buffer...
+
+   while ((n = U_SYSCALL(recv, "%d,%p,%u,%d", UEventFd::fd, ptr, sz, MSG_DONTWAIT | MSG_TRUNC)) > 0)
+      {
+      if (n > (ssize_t)sz)
+         {
+         U_SRV_LOG("WARNING: pubsub: truncated message on the control channel (%d bytes)", n);
+
+         continue;
+         }
+
+      U_INTERNAL_DUMP("datagram(%d) = %#.*S", n, n, ptr)
+
+      // NB: the datagram is 'topic payload'...
+
+      if ((sep = (const char*)memchr(ptr, ' ', n)) == 0 ||
+          UPubSub::publish(ptr, sep-ptr, sep+1, ptr+n-(sep+1)) == false)
+         {
+         U_SRV_LOG("WARNING: pubsub: invalid message on the control channel: %.*S", U_min(n, 128), ptr);
+         }
+      }
+
+   U_RETURN(U_NOTIFIER_OK);
+}
+
+bool UPubSub::init()
+{
+   U_TRACE_NO_PARAM(0, "UPubSub::init()")
+
+   U_INTERNAL_ASSERT_EQUALS(ptr, 0)
+   U_INTERNAL_ASSERT_MAJOR(topic_max, 0)
+
+#ifndef U_LINUX
+   U_RETURN(false);
+#else
+   if (topic_max > U_PUBSUB_TOPIC_MAX) topic_max = U_PUBSUB_TOPIC_MAX;
+
+   // NB: the position in the ring is computed with a mask...
+
+   ring_size = (ring_size < 4096 ? 4096 : 1U << (32 - __builtin_clz(ring_size - 1)));
+
+   U_INTERNAL_DUMP("topic_max = %u ring_size = %u", topic_max, ring_size)
+
+   // NB: a slot is free again only when the pid of the dead worker is reaped, and the worker respawned can start before that,
+   //     so we have twice the slot of the preforked process...
+
+   num_slot = (UServer_Base::preforked_num_kids > 0 ? UServer_Base::preforked_num_kids * 2 : 1);
+   vslot_fd = (int*) UMemoryPool::_malloc(num_slot, sizeof(int));
+
+   for (uint32_t i = 0; i < num_slot; ++i)
+      {
+      vslot_fd[i] = U_SYSCALL(eventfd, "%u,%d", 0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+      if (vslot_fd[i] == -1)
+         {
+         while (i--) (void) U_SYSCALL(close, "%d", vslot_fd[i]);
+
+         UMemoryPool::_free(vslot_fd, num_slot, sizeof(int));
+
+         vslot_fd = 0;
+
+         U_RETURN(false);
+         }
+      }
+
+   U_NEW(UPubSubNotify, UServer_Base::handler_pubsub, UPubSubNotify);
+
+   UServer_Base::handler_pubsub->fd = vslot_fd[0]; // NB: the slot is claimed after the fork (see start())...
+
+   if (socket_path)
+      {
+      U_INTERNAL_ASSERT_EQUALS(UServer_Base::handler_other, 0)
+
+      UPubSubControl* pcontrol;
+
+      U_NEW(UPubSubControl, pcontrol, UPubSubControl);
+
+      if (pcontrol->open(*socket_path) == false)
+         {
+         U_WARNING("pubsub: bind on the UNIX socket %V failed", socket_path->rep);
+
+         delete pcontrol;
+         }
+      else
+         {
+         UServer_Base::handler_other = control = pcontrol;
+         }
+      }
+
+   ptr = (pubsub_data*) UServer_Base::getOffsetToDataShare(sizeof(pubsub_data) + U_PUBSUB_SLOT_SIZE + topic_max * ring_size);
+
+   U_RETURN(true);
+#endif
+}
+
+void UPubSub::run(uint32_t _max_connection)
+{
+   U_TRACE(0, "UPubSub::run(%u)", _max_connection)
+
+   U_INTERNAL_ASSERT_EQUALS(lock, 0)
+
+   ptr       = (pubsub_data*) UServer_Base::getPointerToDataShare(ptr);
+   vslot_pid = (pid_t*)(ptr + 1);
+   vring     = (char*)vslot_pid + U_PUBSUB_SLOT_SIZE;
+
+   U_NEW(ULock, lock, ULock);
+
+   lock->init(&(ptr->lock_publish), ptr->spinlock_publish);
+
+   max_connection = _max_connection;
+
+   vmask = (uint64_t*) UMemoryPool::_malloc(max_connection, sizeof(uint64_t), true);
+
+   U_NEW(UString, frame,  UString(getMaxMessageSize() + U_PUBSUB_TOPIC_NAME_MAX + U_CONSTANT_SIZE(U_PUBSUB_SSE_RESPONSE)));
+   U_NEW(UString, buffer, UString(getMaxMessageSize()));
+
+   U_SRV_LOG("pubsub: %u topic with a ring of %u bytes, max message size %u bytes", topic_max, ring_size, getMaxMessageSize());
+}
+
+void UPubSub::start()
+{
+   U_TRACE_NO_PARAM(0, "UPubSub::start()")
+
+   U_INTERNAL_ASSERT_POINTER(vmask)
+   U_INTERNAL_ASSERT_POINTER(vslot_fd)
+
+   // NB: we claim the first slot free or of a worker that is dead (respawn), a slot is never shared (a worker don't read the message of the other)...
+
+   pid_t p, pid = U_SYSCALL_NO_PARAM(getpid);
+   uint32_t i;
+
+   for (i = 0; i < num_slot; ++i)
+      {
+      p = vslot_pid[i];
+
+      if (p == pid) break;
+
+      if ((p == 0 ||
+           (U_SYSCALL(kill, "%d,%d", p, 0) == -1 && errno == ESRCH)) &&
+          __sync_bool_compare_and_swap(vslot_pid+i, p, pid))
+         {
+         break;
+         }
+      }
+
+   if (i == num_slot) U_ERROR("pubsub: no slot free (%u) for the wakeup of the worker (pid %d)", num_slot, pid);
+
+   U_INTERNAL_DUMP("slot = %u fd = %d", i, vslot_fd[i])
+
+   UServer_Base::handler_pubsub->fd = vslot_fd[i];
+
+   // NB: a worker (re)started don't send the message published before...
+
+   for (i = 0; i < ptr->num_topic; ++i) cursor[i] = ptr->topic[i].head;
+}
+
+void UPubSub::clear()
+{
+   U_TRACE_NO_PARAM(0, "UPubSub::clear()")
+
+   if (vmask)
+      {
+      UMemoryPool::_free(vmask, max_connection, sizeof(uint64_t));
+
+      vmask = 0;
+      }
+
+   if (lock)
+      {
+      delete lock;
+             lock = 0;
+      }
+
+   if (frame)
+      {
+      delete frame;
+      delete buffer;
+
+      frame = buffer = 0;
+      }
+
+   if (sse_uri)
+      {
+      delete sse_uri;
+             sse_uri = 0;
+      }
+
+   if (socket_path)
+      {
+      delete socket_path;
+             socket_path = 0;
+      }
+
+   if (control)
+      {
+      if (UServer_Base::handler_other == control) UServer_Base::handler_other = 0;
+
+      delete control;
+             control = 0;
+      }
+
+   if (UServer_Base::handler_pubsub)
+      {
+      delete UServer_Base::handler_pubsub;
+             UServer_Base::handler_pubsub = 0;
+      }
+
+   if (vslot_fd)
+      {
+      for (uint32_t i = 0; i < num_slot; ++i) (void) U_SYSCALL(close, "%d", vslot_fd[i]);
+
+      UMemoryPool::_free(vslot_fd, num_slot, sizeof(int));
+
+      vslot_fd = 0;
+      }
+
+   ptr = 0;
+}
+
+int UPubSub::getTopic(const char* topic, uint32_t len, bool bcreate)
+{
+   U_TRACE(0, "UPubSub::getTopic(%.*S,%u,%b)", len, topic, len, bcreate)
+
+   U_INTERNAL_ASSERT_POINTER(ptr)
+
+   if (len == 0 ||
+       len >= U_PUBSUB_TOPIC_NAME_MAX)
+      {
+      U_RETURN(-1);
+      }
+
+   uint32_t i, n = ptr->num_topic;
+
+   for (i = 0; i < n; ++i)
+      {
+      if (ptr->topic[i].name_len == len &&
+          memcmp(ptr->topic[i].name, topic, len) == 0)
+         {
+         U_RETURN(i);
+         }
+      }
+
+   if (bcreate == false) U_RETURN(-1);
+
+   lock->lock();
+
+   // NB: the topic can be created by another process in the meantime...
+
+   for (n = ptr->num_topic; i < n; ++i)
+      {
+      if (ptr->topic[i].name_len == len &&
+          memcmp(ptr->topic[i].name, topic, len) == 0)
+         {
+         lock->unlock();
+
+         U_RETURN(i);
+         }
+      }
+
+   if (n >= topic_max)
+      {
+      lock->unlock();
+
+      U_SRV_LOG("WARNING: pubsub: max number of topic (%u) reached", topic_max);
+
+      U_RETURN(-1);
+      }
+
+   U_MEMCPY(ptr->topic[n].name, topic, len);
+
+   ptr->topic[n].head     = 0;
+   ptr->topic[n].name_len = len;
+
+   __sync_synchronize();
+
+   ptr->num_topic = n+1;
+
+   lock->unlock();
+
+   U_RETURN(n);
+}
+
+void UPubSub::readRing(const char* ring, uint64_t pos, char* data, uint32_t len)
+{
+   U_TRACE(0, "UPubSub::readRing(%p,%llu,%p,%u)", ring, pos, data, len)
+
+   uint32_t off = (pos & (ring_size-1)), first = U_min(len, ring_size - off);
+
+                      U_MEMCPY(data, ring+off, first);
+   if (first < len) U_MEMCPY(data+first, ring, len-first);
+}
+
+void UPubSub::writeRing(char* ring, uint64_t pos, const char* data, uint32_t len)
+{
+   U_TRACE(0, "UPubSub::writeRing(%p,%llu,%p,%u)", ring, pos, data, len)
+
+   uint32_t off = (pos & (ring_size-1)), first = U_min(len, ring_size - off);
+
+                      U_MEMCPY(ring+off, data, first);
+   if (first < len) U_MEMCPY(ring, data+first, len-first);
+}
+
+bool UPubSub::publish(const char* topic, uint32_t len, const char* data, uint32_t data_len, bool binary)
+{
+   U_TRACE(1, "UPubSub::publish(%.*S,%u,%.*S,%u,%b)", len, topic, len, data_len, data, data_len, binary)
+
+   if (ptr == 0 ||
+       data_len > getMaxMessageSize())
+      {
+      U_RETURN(false);
+      }
+
+   int idx = getTopic(topic, len, true);
+
+   if (idx == -1) U_RETURN(false);
+
+   char* ring = vring + idx * ring_size;
+   uint32_t hdr = data_len | (binary ? U_PUBSUB_BINARY : 0);
+
+   lock->lock();
+
+   uint64_t head = ptr->topic[idx].head;
+
+   writeRing(ring, head,                    (const char*)&hdr, sizeof(uint32_t));
+   writeRing(ring, head + sizeof(uint32_t),              data, data_len);
+
+   __sync_synchronize(); // NB: the record must be visible before the new head...
+
+   ptr->topic[idx].head = head + U_PUBSUB_RECORD_SIZE(data_len);
+
+   ptr->num_message++;
+
+   lock->unlock();
+
+   // wakeup all the workers
+
+   uint64_t one = 1;
+
+   for (uint32_t i = 0; i < num_slot; ++i)
+      {
+      if (vslot_pid[i]) (void) U_SYSCALL(write, "%d,%p,%u", vslot_fd[i], &one, sizeof(uint64_t));
+      }
+
+   U_RETURN(true);
+}
+
+bool UPubSub::setSubscription(const char* topic, uint32_t len, bool bsubscribe)
+{
+   U_TRACE(0, "UPubSub::setSubscription(%.*S,%u,%b)", len, topic, len, bsubscribe)
+
+   if (vmask == 0) U_RETURN(false);
+
+   char http = U_ClientImage_http(UServer_Base::pClientImage);
+
+   U_INTERNAL_DUMP("U_ClientImage_http = %C", http)
+
+   if (http != 'W' &&
+       http != 'S')
+      {
+      U_RETURN(false);
+      }
+
+   // NB: the topics are created only by publish(), so a client can't exhaust the table of the topics with names never published...
+
+   int t = getTopic(topic, len, false);
+
+   if (t == -1) U_RETURN(false);
+
+   uint64_t bit = 1ULL << t;
+   uint32_t idx = (UServer_Base::pClientImage - UServer_Base::vClientImage);
+
+   U_INTERNAL_DUMP("idx = %u t = %d num_subscriber[%d] = %u", idx, t, t, num_subscriber[t])
+
+   U_INTERNAL_ASSERT_MINOR(idx, max_connection)
+
+   if (bsubscribe)
+      {
+      if ((vmask[idx] & bit) == 0)
+         {
+         vmask[idx] |= bit;
+
+         // NB: with no subscriber the cursor is not advanced, so the first subscriber start from the current head...
+
+         if (num_subscriber[t]++ == 0) cursor[t] = ptr->topic[t].head;
+
+         if (idx >= index_max) index_max = idx+1;
+         }
+      }
+   else if ((vmask[idx] & bit) != 0)
+      {
+      vmask[idx] &= ~bit;
+
+      --num_subscriber[t];
+      }
+
+   U_RETURN(true);
+}
+
+bool UPubSub::subscribe(const char* topic, uint32_t len)
+{
+   U_TRACE(0, "UPubSub::subscribe(%.*S,%u)", len, topic, len)
+
+   bool result = setSubscription(topic, len, true);
+
+   U_RETURN(result);
+}
+
+bool UPubSub::unsubscribe(const char* topic, uint32_t len)
+{
+   U_TRACE(0, "UPubSub::unsubscribe(%.*S,%u)", len, topic, len)
+
+   bool result = setSubscription(topic, len, false);
+
+   U_RETURN(result);
+}
+
+void UPubSub::handlerDelete(UClientImage_Base* pclient)
+{
+   U_TRACE(0, "UPubSub::handlerDelete(%p)", pclient)
+
+   if (vmask == 0) return;
+
+   uint32_t idx = (pclient - UServer_Base::vClientImage);
+
+   U_INTERNAL_DUMP("idx = %u vmask[%u] = %llx", idx, idx, vmask[idx])
+
+   U_INTERNAL_ASSERT_MINOR(idx, max_connection)
+
+   for (uint64_t mask = vmask[idx]; mask; mask &= mask - 1) --num_subscriber[__builtin_ctzll(mask)];
+
+   vmask[idx] = 0;
+}
+
+int UPubSub::initSSE()
+{
+   U_TRACE_NO_PARAM(0, "UPubSub::initSSE()")
+
+   U_INTERNAL_ASSERT_POINTER(vmask)
+
+   if (U_http_method_type != HTTP_GET ||
+       U_ClientImage_http(UServer_Base::pClientImage) == '2')
+      {
+      U_RETURN(U_PLUGIN_HANDLER_GO_ON);
+      }
+
+   if (USocketExt::write(UServer_Base::csocket, U_CONSTANT_TO_PARAM(U_PUBSUB_SSE_RESPONSE), UServer_Base::timeoutMS) != U_CONSTANT_SIZE(U_PUBSUB_SSE_RESPONSE)) U_RETURN(U_PLUGIN_HANDLER_ERROR);
+
+   // NB: from now the connection is not closed for inactivity and the data read on it are discarded (see UHTTP::handlerREAD())...
+
+   U_ClientImage_close = false;
+
+   U_ClientImage_http(UServer_Base::pClientImage) = 'S';
+   U_ClientImage_idle(UServer_Base::pClientImage) = U_YES;
+
+   if (U_ClientImage_pipeline) UClientImage_Base::resetPipeline();
+
+   UClientImage_Base::setRequestProcessed();
+
+   UClientImage_Base::size_request = 0;
+
+   // GET <SSE_URI>?topic=name1,name2,...
+
+   const char* ptr1 = (U_http_info.query_len ? (const char*)u_find(U_HTTP_QUERY_TO_PARAM, U_CONSTANT_TO_PARAM("topic=")) : 0);
+
+   if (ptr1)
+      {
+      const char* ptr2;
+      const char* end = U_http_info.query + U_http_info.query_len;
+
+      for (ptr1 += U_CONSTANT_SIZE("topic="); ptr1 < end; ptr1 = ptr2 + 1)
+         {
+         for (ptr2 = ptr1; ptr2 < end && *ptr2 != ',' && *ptr2 != '&'; ++ptr2) {}
+
+         if (subscribe(ptr1, ptr2-ptr1) == false) U_SRV_LOG("WARNING: pubsub: SSE subscription to the topic %.*S failed", ptr2-ptr1, ptr1);
+
+         if (ptr2 == end || *ptr2 == '&') break;
+         }
+      }
+
+   U_RETURN(U_PLUGIN_HANDLER_FINISHED);
+}
+
+int UPubSub::handlerRequest()
+{
+   U_TRACE_NO_PARAM(0, "UPubSub::handlerRequest()")
+
+   U_INTERNAL_ASSERT_EQUALS(U_ClientImage_http(UServer_Base::pClientImage), 'S')
+
+   // NB: the SSE client don't send anything after the request...
+
+   UClientImage_Base::size_request = 0;
+
+   UClientImage_Base::setRequestProcessed();
+
+   U_RETURN(U_PLUGIN_HANDLER_FINISHED);
+}
+
+void UPubSub::fanOut(uint32_t t, const char* data, uint32_t len, bool binary)
+{
+   U_TRACE(1, "UPubSub::fanOut(%u,%.*S,%u,%b)", t, len, data, len, binary)
+
+   USocket* sk;
+   ssize_t value;
+   struct msghdr msg;
+   UClientImage_Base* cimg;
+   uint64_t bit = 1ULL << t;
+   uint32_t i, count, hlen, count_ws, count_sse;
+   unsigned char header[16];
+
+   // NB: the message is encoded once: websocket frame (header + payload) and SSE event ('data:' for each line + empty line)...
+
+   hlen     = UWebSocket::setFrameHeader(header, (binary ? MESSAGE_TYPE_BINARY : MESSAGE_TYPE_TEXT), len);
+   count_ws = hlen + len;
+
+   struct iovec iov_ws[2]  = { { (caddr_t)header, hlen },
+                               { (caddr_t)data,   len } },
+                iov_sse[3] = { { (caddr_t)U_CONSTANT_TO_PARAM("data: ") },
+                               { (caddr_t)data,   len },
+                               { (caddr_t)U_CONSTANT_TO_PARAM("\n\n") } };
+
+   int iovcnt_sse = 3;
+
+   if (memchr(data, '\n', len) == 0) count_sse = len + U_CONSTANT_SIZE("data: \n\n");
+   else
+      {
+      frame->setEmpty();
+
+      (void) frame->append(U_CONSTANT_TO_PARAM("data: "));
+
+      for (const char* ptr1 = data, *end = data + len, *ptr2; ptr1 < end; ptr1 = ptr2 + 1)
+         {
+         if ((ptr2 = (const char*)memchr(ptr1, '\n', end-ptr1)) == 0) ptr2 = end;
+
+         (void) frame->append(ptr1, ptr2-ptr1);
+         (void) frame->append(U_CONSTANT_TO_PARAM("\ndata: "));
+         }
+
+      frame->size_adjust(frame->size() - U_CONSTANT_SIZE("data: "));
+
+      (void) frame->append(U_CONSTANT_TO_PARAM("\n"));
+
+      iov_sse[0].iov_base = frame->data();
+      iov_sse[0].iov_len  = count_sse = frame->size();
+
+      iovcnt_sse = 1;
+      }
+
+   (void) U_SYSCALL(memset, "%p,%d,%u", &msg, 0, sizeof(msg));
+
+   for (i = 0; i < index_max; ++i)
+      {
+      if ((vmask[i] & bit) == 0) continue;
+
+      cimg = UServer_Base::vClientImage + i;
+      sk   = cimg->socket;
+
+      if (sk->isOpen() == false) continue;
+
+      if (U_ClientImage_http(cimg) == 'W')
+         {
+         msg.msg_iov    = iov_ws;
+         msg.msg_iovlen = 2;
+         count          = count_ws;
+         }
+      else
+         {
+         msg.msg_iov    = iov_sse;
+         msg.msg_iovlen = iovcnt_sse;
+         count          = count_sse;
+         }
+
+      if (sk->isSSLActive())
+         {
+         UString tmp(count);
+
+         for (uint32_t j = 0; j < msg.msg_iovlen; ++j) (void) tmp.append((const char*)msg.msg_iov[j].iov_base, msg.msg_iov[j].iov_len);
+
+         value = sk->send(tmp.data(), count);
+         }
+      else
+         {
+         value = U_SYSCALL(sendmsg, "%d,%p,%d", sk->getFd(), &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+         }
+
+      if (value != (ssize_t)count)
+         {
+         // NB: a partial frame can't be completed later, so the slow consumer is shut down and the notifier delete the connection...
+
+         U_SRV_LOG("WARNING: pubsub: shutdown of the subscriber (fd %d) that can't keep up (%d of %u bytes sent)", sk->getFd(), (int)value, count);
+
+         (void) sk->shutdown(SHUT_RDWR);
+
+         handlerDelete(cimg);
+         }
+      }
+}
+
+bool UPubSub::readMessage(uint32_t t, bool& binary)
+{
+   U_TRACE(0, "UPubSub::readMessage(%u,%p)", t, &binary)
+
+   U_INTERNAL_ASSERT_POINTER(ptr)
+   U_INTERNAL_ASSERT_MINOR(t, ptr->num_topic)
+
+   uint32_t hdr, len;
+   char* ring = vring + t * ring_size;
+   uint64_t head, pos = cursor[t], half = ring_size / 2;
+
+   while (true)
+      {
+      head = ptr->topic[t].head;
+
+      __sync_synchronize(); // NB: the record are read after the head...
+
+      U_INTERNAL_DUMP("t = %u head = %llu cursor = %llu", t, head, pos)
+
+      if (pos >= head) break;
+
+      // NB: the publisher can overwrite at most half of the ring beyond the head, so the record behind it by less than half are intact...
+
+      if ((head - pos) > half)
+         {
+         U_SRV_LOG("WARNING: pubsub: lost %llu bytes of message on the topic %.*S", head - pos, ptr->topic[t].name_len, ptr->topic[t].name);
+
+         pos = head;
+
+         break;
+         }
+
+      readRing(ring, pos, (char*)&hdr, sizeof(uint32_t));
+
+      len = (hdr & ~U_PUBSUB_BINARY);
+
+      if (len > getMaxMessageSize())
+         {
+         pos = ptr->topic[t].head;
+
+         break;
+         }
+
+      readRing(ring, pos + sizeof(uint32_t), buffer->data(), len);
+
+      __sync_synchronize();
+
+      if ((ptr->topic[t].head - pos) > half) continue; // NB: overwritten while we copied it (lost at the next check)...
+
+      cursor[t] = pos + U_PUBSUB_RECORD_SIZE(len);
+
+      buffer->size_adjust(len);
+
+      binary = ((hdr & U_PUBSUB_BINARY) != 0);
+
+      U_RETURN(true);
+      }
+
+   cursor[t] = pos;
+
+   U_RETURN(false);
+}
+
+void UPubSub::drain()
+{
+   U_TRACE_NO_PARAM(0, "UPubSub::drain()")
+
+   U_INTERNAL_ASSERT_POINTER(ptr)
+
+   bool binary;
+
+   for (uint32_t t = 0, n = ptr->num_topic; t < n; ++t)
+      {
+      U_INTERNAL_DUMP("t = %u head = %llu cursor = %llu num_subscriber = %u", t, ptr->topic[t].head, cursor[t], num_subscriber[t])
+
+      if (cursor[t] == ptr->topic[t].head) continue;
+
+      if (num_subscriber[t] == 0)
+         {
+         cursor[t] = ptr->topic[t].head;
+
+         continue;
+         }
+
+      while (readMessage(t, binary)) fanOut(t, buffer->data(), buffer->size(), binary);
+      }
+}
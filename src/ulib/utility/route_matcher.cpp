@@ -0,0 +1,461 @@
+// ============================================================================
+//
+// = LIBRARY
+//    ULib - c++ library
+//
+// = FILENAME
+//    route_matcher.cpp - compiled matcher for a set of DOS mask and regex
+//
+// = AUTHOR
+//    Stefano Casazza
+//
+// ============================================================================
+
+#include <ulib/utility/route_matcher.h>
+
+#define U_ROUTE_EXACT    1 // 'abc'      => node of the prefix trie, match only at the end of the string
+#define U_ROUTE_PREFIX   2 // 'abc*'     => node of the prefix trie
+#define U_ROUTE_SUFFIX   3 // '*abc'     => node of the suffix trie
+#define U_ROUTE_DOSMATCH 4 // 'ab?c*d'   => node of the trie of the literal part, verified with u_dosmatch()
+#define U_ROUTE_INVERT   5 // '!mask'    => generic list, verified with u_dosmatch_with_OR()
+#define U_ROUTE_REGEX    6 // '^/abc.*'  => node of the prefix trie, verified by the caller
+
+URouteMatcher::URouteMatcher(int _flags) : text(U_CAPACITY)
+{
+   U_TRACE_REGISTER_OBJECT(0, URouteMatcher, "%d", _flags)
+
+   flags     = (_flags & FNM_IGNORECASE);
+   max_node  = 64;
+   max_entry = 64;
+
+   vnode  = (node*)  UMemoryPool::_malloc(&max_node,  sizeof(node),  true);
+   ventry = (entry*) UMemoryPool::_malloc(&max_entry, sizeof(entry), true);
+
+   num_node  = 3; // [0] none, [1] root of the prefix trie, [2] root of the suffix trie
+   num_entry = 1; // [0] none
+
+   num_rule = generic = generic_last = 0;
+}
+
+URouteMatcher::~URouteMatcher()
+{
+   U_TRACE_UNREGISTER_OBJECT(0, URouteMatcher)
+
+   UMemoryPool::_free(vnode,  max_node,  sizeof(node));
+   UMemoryPool::_free(ventry, max_entry, sizeof(entry));
+}
+
+uint32_t URouteMatcher::newNode(uint32_t label, uint32_t label_len)
+{
+   U_TRACE(0, "URouteMatcher::newNode(%u,%u)", label, label_len)
+
+   if (num_node == max_node)
+      {
+      node* old         = vnode;
+      uint32_t old_max  = max_node;
+
+      max_node *= 2;
+
+      vnode = (node*) UMemoryPool::_malloc(&max_node, sizeof(node), true);
+
+      U_MEMCPY(vnode, old, num_node * sizeof(node));
+
+      UMemoryPool::_free(old, old_max, sizeof(node));
+      }
+
+   node* n = vnode + num_node;
+
+   n->label     = label;
+   n->label_len = label_len;
+   n->child     = n->sibling = n->entry = 0;
+
+   U_RETURN(num_node++);
+}
+
+uint32_t URouteMatcher::newEntry(uint32_t id, int type, uint32_t mask, uint32_t mask_len)
+{
+   U_TRACE(0, "URouteMatcher::newEntry(%u,%d,%u,%u)", id, type, mask, mask_len)
+
+   if (num_entry == max_entry)
+      {
+      entry* old        = ventry;
+      uint32_t old_max  = max_entry;
+
+      max_entry *= 2;
+
+      ventry = (entry*) UMemoryPool::_malloc(&max_entry, sizeof(entry), true);
+
+      U_MEMCPY(ventry, old, num_entry * sizeof(entry));
+
+      UMemoryPool::_free(old, old_max, sizeof(entry));
+      }
+
+   entry* e = ventry + num_entry;
+
+   e->id       = id;
+   e->type     = type;
+   e->next     = 0;
+   e->mask     = mask;
+   e->mask_len = mask_len;
+
+   U_RETURN(num_entry++);
+}
+
+void URouteMatcher::addGeneric(uint32_t e)
+{
+   U_TRACE(0, "URouteMatcher::addGeneric(%u)", e)
+
+   // NB: the generic list is kept in order of rule, so the search can stop at the first match...
+
+   if (generic == 0) generic                   = e;
+   else              ventry[generic_last].next = e;
+
+   generic_last = e;
+}
+
+uint32_t URouteMatcher::insert(uint32_t root, uint32_t key, uint32_t key_len)
+{
+   U_TRACE(0, "URouteMatcher::insert(%u,%u,%u)", root, key, key_len)
+
+   uint32_t n = root, c, m, common;
+
+   while (key_len)
+      {
+      const char* t = text.data();
+
+      for (c = vnode[n].child; c; c = vnode[c].sibling)
+         {
+         if (t[vnode[c].label] == t[key]) break;
+         }
+
+      if (c == 0)
+         {
+         c = newNode(key, key_len);
+
+         vnode[c].sibling = vnode[n].child;
+         vnode[n].child   = c;
+
+         U_RETURN(c);
+         }
+
+      for (common = 1; common < key_len             &&
+                       common < vnode[c].label_len &&
+                       t[vnode[c].label+common] == t[key+common]; ++common) {}
+
+      if (common < vnode[c].label_len)
+         {
+         // NB: split the node, the new one take the common part of the label and the place of the old one in the list of child...
+
+         m = newNode(vnode[c].label, common);
+
+         uint32_t* link = &(vnode[n].child);
+
+         while (*link != c) link = &(vnode[*link].sibling);
+
+         *link = m;
+
+         vnode[m].child      = c;
+         vnode[m].sibling    = vnode[c].sibling;
+         vnode[c].sibling    = 0;
+         vnode[c].label     += common;
+         vnode[c].label_len -= common;
+
+         c = m;
+         }
+
+      n        = c;
+      key     += common;
+      key_len -= common;
+      }
+
+   U_RETURN(n);
+}
+
+void URouteMatcher::addAlternative(uint32_t id, const char* mask, uint32_t len)
+{
+   U_TRACE(0, "URouteMatcher::addAlternative(%u,%.*S,%u)", id, len, mask, len)
+
+   U_INTERNAL_ASSERT_MAJOR(len, 0)
+
+   uint32_t i, j, k, pos = text.size(); // NB: we save the alternative as is (for u_dosmatch())...
+
+   (void) text.append(mask, len);
+          text.push_back('\0'); // NB: u_dosmatch() read the mask until the null terminator, not only mask_len...
+
+   for (i = 0; i < len && mask[i] != '*' && mask[i] != '?'; ++i) {} // literal prefix
+
+   if (i == len)
+      {
+      k = text.size();
+
+      for (j = 0; j < len; ++j) text.push_back(flags ? u__tolower(mask[j]) : mask[j]);
+
+      addEntry(insert(1, k, len), newEntry(id, U_ROUTE_EXACT, pos, len));
+
+      return;
+      }
+
+   for (j = i; j < len && mask[j] == '*'; ++j) {}
+
+   if (i  > 0 &&
+       j == len)
+      {
+      k = text.size();
+
+      for (j = 0; j < i; ++j) text.push_back(flags ? u__tolower(mask[j]) : mask[j]);
+
+      addEntry(insert(1, k, i), newEntry(id, U_ROUTE_PREFIX, pos, len));
+
+      return;
+      }
+
+   if (i > 0)
+      {
+      k = text.size();
+
+      for (j = 0; j < i; ++j) text.push_back(flags ? u__tolower(mask[j]) : mask[j]);
+
+      addEntry(insert(1, k, i), newEntry(id, U_ROUTE_DOSMATCH, pos, len));
+
+      return;
+      }
+
+   for (j = len; j > 0 && mask[j-1] != '*' && mask[j-1] != '?'; --j) {} // literal suffix
+
+   if (j == len)
+      {
+      if (len == 1 &&
+          mask[0] == '*')
+         {
+         addEntry(1, newEntry(id, U_ROUTE_PREFIX, pos, len)); // NB: '*' match all...
+         }
+      else
+         {
+         addGeneric(newEntry(id, U_ROUTE_DOSMATCH, pos, len));
+         }
+
+      return;
+      }
+
+   k = text.size();
+
+   for (i = len; i > j; --i) text.push_back(flags ? u__tolower(mask[i-1]) : mask[i-1]);
+
+   addEntry(insert(2, k, len-j), newEntry(id, (j == 1 && mask[0] == '*' ? U_ROUTE_SUFFIX : U_ROUTE_DOSMATCH), pos, len));
+}
+
+uint32_t URouteMatcher::addMask(const char* mask, uint32_t len, int mflags)
+{
+   U_TRACE(0, "URouteMatcher::addMask(%.*S,%u,%d)", len, mask, len, mflags)
+
+   U_INTERNAL_ASSERT_MAJOR(len, 0)
+
+   uint32_t id = num_rule++;
+
+   if ((mflags & FNM_INVERT) != 0)
+      {
+      uint32_t pos = text.size();
+
+      (void) text.append(mask, len);
+             text.push_back('\0');
+
+      addGeneric(newEntry(id, U_ROUTE_INVERT, pos, len));
+
+      U_RETURN(id);
+      }
+
+   const char* p_or;
+   const char* end = mask + len;
+
+   while (mask < end)
+      {
+      p_or = (const char*) memchr(mask, '|', end - mask);
+
+      if (p_or == 0) p_or = end;
+
+      if (p_or > mask) addAlternative(id, mask, p_or - mask);
+
+      mask = p_or + 1;
+      }
+
+   U_RETURN(id);
+}
+
+uint32_t URouteMatcher::addRegex(const char* pattern, uint32_t len)
+{
+   U_TRACE(0, "URouteMatcher::addRegex(%.*S,%u)", len, pattern, len)
+
+   U_INTERNAL_ASSERT_MAJOR(len, 0)
+
+   uint32_t id = num_rule++, e = newEntry(id, U_ROUTE_REGEX, 0, 0);
+
+   // NB: only the literal prefix of a pattern anchored without alternation can be used as prefilter...
+
+   if (pattern[0] != '^' ||
+       memchr(pattern, '|', len))
+      {
+      addGeneric(e);
+
+      U_RETURN(id);
+      }
+
+   uint32_t i = 1, k = text.size();
+
+   while (i < len &&
+          strchr("\\^$.[|()?*+{", pattern[i]) == 0)
+      {
+      text.push_back(flags ? u__tolower(pattern[i]) : pattern[i]);
+
+      ++i;
+      }
+
+   uint32_t n = i-1; // NB: a quantifier that allow zero occurrence apply to the last literal...
+
+   if (n   &&
+       i < len &&
+       (pattern[i] == '?' ||
+        pattern[i] == '*' ||
+        pattern[i] == '{'))
+      {
+      --n;
+      }
+
+   addEntry(insert(1, k, n), e);
+
+   U_RETURN(id);
+}
+
+bool URouteMatcher::check(const entry* e, const char* s, uint32_t len, bool bend) const
+{
+   U_TRACE(0, "URouteMatcher::check(%p,%.*S,%u,%b)", e, len, s, len, bend)
+
+   switch (e->type)
+      {
+      case U_ROUTE_EXACT:  U_RETURN(bend);
+      case U_ROUTE_PREFIX:
+      case U_ROUTE_SUFFIX:
+      case U_ROUTE_REGEX:  U_RETURN(true);
+
+      case U_ROUTE_DOSMATCH:
+         {
+         if (u_dosmatch(s, len, text.c_pointer(e->mask), e->mask_len, flags)) U_RETURN(true);
+         }
+      break;
+
+      case U_ROUTE_INVERT:
+         {
+         if (u_dosmatch_with_OR(s, len, text.c_pointer(e->mask), e->mask_len, flags | FNM_INVERT)) U_RETURN(true);
+         }
+      break;
+      }
+
+   U_RETURN(false);
+}
+
+uint32_t URouteMatcher::match(const char* s, uint32_t len, uint32_t from) const
+{
+   U_TRACE(0, "URouteMatcher::match(%.*S,%u,%u)", len, s, len, from)
+
+   U_INTERNAL_ASSERT_MAJOR(len, 0)
+
+   const entry* e;
+   const char* label;
+   uint32_t n, c, i, j, best = U_NOT_FOUND;
+   const char* t = text.data();
+
+   for (int k = 1; k <= 2; ++k) // [1] prefix trie, [2] suffix trie (walked on the reversed string)
+      {
+      n = k;
+      i = 0;
+
+      while (true)
+         {
+         for (uint32_t x = vnode[n].entry; x; x = e->next)
+            {
+            e = ventry + x;
+
+            if (e->id >= from &&
+                e->id <  best &&
+                check(e, s, len, (i == len)))
+               {
+               best = e->id;
+               }
+            }
+
+         if (i == len) break;
+
+         unsigned char ch = (k == 1 ? s[i] : s[len-1-i]);
+
+         if (flags) ch = u__tolower(ch);
+
+         for (c = vnode[n].child; c; c = vnode[c].sibling)
+            {
+            if ((unsigned char)t[vnode[c].label] == ch) break;
+            }
+
+         if (c == 0 ||
+             vnode[c].label_len > (len - i))
+            {
+            break;
+            }
+
+         label = t + vnode[c].label;
+
+         for (j = 1; j < vnode[c].label_len; ++j)
+            {
+            ch = (k == 1 ? s[i+j] : s[len-1-i-j]);
+
+            if (flags) ch = u__tolower(ch);
+
+            if ((unsigned char)label[j] != ch) break;
+            }
+
+         if (j < vnode[c].label_len) break;
+
+         n  = c;
+         i += j;
+         }
+      }
+
+   for (uint32_t x = generic; x; x = e->next)
+      {
+      e = ventry + x;
+
+      if (e->id >= best) break;
+
+      if (e->id >= from &&
+          check(e, s, len, true))
+         {
+         best = e->id;
+
+         break;
+         }
+      }
+
+   U_RETURN(best);
+}
+
+// DEBUG
+
+#if defined(U_STDCPP_ENABLE) && defined(DEBUG)
+const char* URouteMatcher::dump(bool reset) const
+{
+   *UObjectIO::os << "flags        " << flags        << '\n'
+                  << "vnode        " << (void*)vnode  << '\n'
+                  << "ventry       " << (void*)ventry << '\n'
+                  << "generic      " << generic      << '\n'
+                  << "num_node     " << num_node     << '\n'
+                  << "num_rule     " << num_rule     << '\n'
+                  << "num_entry    " << num_entry    << '\n'
+                  << "text (UString " << (void*)&text << ')';
+
+   if (reset)
+      {
+      UObjectIO::output();
+
+      return UObjectIO::buffer_output;
+      }
+
+   return 0;
+}
+#endif
@@ -0,0 +1,455 @@
+// ============================================================================
+//
+// = LIBRARY
+//    ULib - c++ library
+//
+// = FILENAME
+//    session_store.cpp - HTTP session data in the shared memory
+//
+// = AUTHOR
+//    Stefano Casazza
+//
+// ============================================================================
+
+#include <ulib/timer.h>
+#include <ulib/db/rdb.h>
+#include <ulib/net/server/server.h>
+#include <ulib/utility/data_session.h>
+#include <ulib/utility/session_store.h>
+
+bool                       USessionStore::bsnapshot;
+char*                      USessionStore::vbucket;
+char*                      USessionStore::buffer;
+URDB*                      USessionStore::db;
+uint32_t                   USessionStore::max_session = 1024;
+uint32_t                   USessionStore::slot_size   = 1024;
+uint32_t                   USessionStore::ttl         = U_ONE_DAY_IN_SECOND;
+uint32_t                   USessionStore::bucket_size;
+USessionStore::store_info* USessionStore::info;
+
+class U_NO_EXPORT USessionSweep : public UEventTime {
+public:
+
+   USessionSweep() : UEventTime(U_SESSION_STORE_SWEEP, 0L)
+      {
+      U_TRACE_REGISTER_OBJECT(0, USessionSweep, "", 0)
+      }
+
+   virtual ~USessionSweep() U_DECL_FINAL
+      {
+      U_TRACE_UNREGISTER_OBJECT(0, USessionSweep)
+      }
+
+   // define method VIRTUAL of class UEventTime
+
+   virtual int handlerTime() U_DECL_FINAL
+      {
+      U_TRACE_NO_PARAM(0, "USessionSweep::handlerTime()")
+
+      USessionStore::sweep();
+
+      U_RETURN(0); // monitoring
+      }
+
+#if defined(DEBUG) && defined(U_STDCPP_ENABLE)
+   const char* dump(bool _reset) const { return UEventTime::dump(_reset); }
+#endif
+
+private:
+   U_DISALLOW_COPY_AND_ASSIGN(USessionSweep)
+};
+
+void USessionStore::init()
+{
+   U_TRACE_NO_PARAM(0, "USessionStore::init()")
+
+   U_INTERNAL_ASSERT_MAJOR(max_session, 0)
+   U_INTERNAL_ASSERT_EQUALS(info, 0)
+
+   if (slot_size > U_BUFFER_SIZE) slot_size = U_BUFFER_SIZE; // NB: the record is serialized with toBuffer()...
+
+   slot_size   = (slot_size + 7) & ~7;
+   bucket_size = sizeof(bucket) + U_SESSION_STORE_WAY * (sizeof(slot) + slot_size);
+
+   uint32_t num_bucket = (max_session + U_SESSION_STORE_WAY - 1) / U_SESSION_STORE_WAY;
+
+   num_bucket = (num_bucket <= 1 ? 1 : 1U << (32 - __builtin_clz(num_bucket - 1))); // NB: must be a power of 2...
+
+   max_session = num_bucket * U_SESSION_STORE_WAY;
+
+   U_INTERNAL_DUMP("num_bucket = %u bucket_size = %u", num_bucket, bucket_size)
+
+   // NB: +8 for the alignment of the word updated with CAS (see run())...
+
+   info = (store_info*) UServer_Base::getOffsetToDataShare(sizeof(store_info) + num_bucket * bucket_size + 8);
+}
+
+void USessionStore::run()
+{
+   U_TRACE_NO_PARAM(0, "USessionStore::run()")
+
+   U_INTERNAL_ASSERT_EQUALS(vbucket, 0)
+
+   char* ptr = (char*) UServer_Base::getPointerToDataShare(info);
+
+   info    = (store_info*)(((ptrdiff_t)ptr + 7) & ~7L);
+   vbucket = (char*)(info+1);
+
+   info->num_bucket = max_session / U_SESSION_STORE_WAY;
+   info->last_sweep = u_now->tv_sec;
+
+   buffer = (char*) UMemoryPool::_malloc(slot_size);
+
+   U_SRV_LOG("session store: %u slot of %u bytes, ttl %u second%s", max_session, slot_size, ttl, (bsnapshot ? ", with snapshot on db" : ""));
+}
+
+void USessionStore::start()
+{
+   U_TRACE_NO_PARAM(0, "USessionStore::start()")
+
+   U_INTERNAL_ASSERT(isActive())
+
+   UEventTime* sweep_time;
+
+   U_NEW(USessionSweep, sweep_time, USessionSweep);
+
+   UTimer::insert(sweep_time);
+}
+
+void USessionStore::clear()
+{
+   U_TRACE_NO_PARAM(0, "USessionStore::clear()")
+
+   if (buffer)
+      {
+      UMemoryPool::_free(buffer, slot_size);
+
+      buffer = 0;
+      }
+
+   db      = 0;
+   vbucket = 0;
+}
+
+__pure U_NO_EXPORT uint32_t USessionStore::getHash(const char* key, uint32_t len)
+{
+   U_TRACE(0, "USessionStore::getHash(%.*S,%u)", len, key, len)
+
+   uint32_t hash = u_hash((unsigned char*)key, len);
+
+   if (hash == 0) hash = 1; // NB: 0 => free slot...
+
+   U_RETURN(hash);
+}
+
+__pure U_NO_EXPORT USessionStore::slot* USessionStore::find(bucket* b, uint32_t hash, const char* key, uint32_t len)
+{
+   U_TRACE(0, "USessionStore::find(%p,%u,%.*S,%u)", b, hash, len, key, len)
+
+   slot* s;
+
+   for (uint32_t i = 0; i < U_SESSION_STORE_WAY; ++i)
+      {
+      s = getSlot(b, i);
+
+      if (s->hash    == hash &&
+          s->key_len == len  &&
+          memcmp(s+1, key, len) == 0)
+         {
+         U_RETURN_POINTER(s, slot);
+         }
+      }
+
+   U_RETURN_POINTER(0, slot);
+}
+
+bool USessionStore::get(UDataStorage* pdata)
+{
+   U_TRACE(0, "USessionStore::get(%p)", pdata)
+
+   U_INTERNAL_ASSERT(isActive())
+   U_INTERNAL_ASSERT(pdata->keyid)
+
+   const char* key = pdata->keyid.data();
+   uint32_t len    = pdata->keyid.size(),
+            hash   = getHash(key, len),
+            data_len;
+
+   bucket* b = getBucket(hash);
+
+   lock(b);
+
+   slot* s = find(b, hash, key, len);
+
+   if (s == 0)
+      {
+      unlock(b);
+
+      U_RETURN(false);
+      }
+
+   s->last_access = u_now->tv_sec;
+
+   U_MEMCPY(buffer, (char*)(s+1) + len, data_len = s->data_len);
+
+   unlock(b);
+
+   // NB: the record is parsed out of the lock...
+
+   pdata->clear();
+   pdata->fromData(buffer, data_len);
+
+   U_RETURN(true);
+}
+
+U_NO_EXPORT bool USessionStore::store(const char* key, uint32_t len, const char* data, uint32_t data_len, bool bdirty)
+{
+   U_TRACE(0, "USessionStore::store(%.*S,%u,%.*S,%u,%b)", len, key, len, data_len, data, data_len, bdirty)
+
+   slot* s;
+   slot* lru = 0;
+   uint32_t hash = getHash(key, len), evicted_len = 0, evicted_data_len = 0;
+   bucket* b = getBucket(hash);
+
+   lock(b);
+
+   s = find(b, hash, key, len);
+
+   if ((len + data_len) > slot_size)
+      {
+      // NB: the record go in the db, so the old copy in the store must not be found anymore by get()...
+
+      if (s)
+         {
+         s->hash = 0;
+
+         (void) __sync_sub_and_fetch(&(info->num_session), 1);
+         }
+
+      unlock(b);
+
+      U_RETURN(false);
+      }
+
+   if (s == 0)
+      {
+      // NB: we take a free slot, otherwise we evict the least recently used of the bucket...
+
+      for (uint32_t i = 0; i < U_SESSION_STORE_WAY; ++i)
+         {
+         s = getSlot(b, i);
+
+         if (s->hash == 0) break;
+
+         if (lru == 0 ||
+             lru->last_access > s->last_access)
+            {
+            lru = s;
+            }
+
+         s = 0;
+         }
+
+      if (s == 0)
+         {
+         s = lru;
+
+         info->num_evicted++;
+
+         // NB: a session modified after the last snapshot is written in the db (out of the lock) before to reuse the slot...
+
+         if (s->dirty &&
+             db)
+            {
+            evicted_len      = s->key_len;
+            evicted_data_len = s->data_len;
+
+            U_MEMCPY(buffer, s+1, evicted_len + evicted_data_len);
+            }
+         }
+      else
+         {
+         (void) __sync_add_and_fetch(&(info->num_session), 1);
+         }
+
+      s->hash    = hash;
+      s->key_len = len;
+
+      U_MEMCPY(s+1, key, len);
+      }
+
+   s->dirty       = bdirty;
+   s->data_len    = data_len;
+   s->last_access = u_now->tv_sec;
+
+   U_MEMCPY((char*)(s+1) + len, data, data_len);
+
+   unlock(b);
+
+   if (evicted_len) (void) db->store(buffer, evicted_len, buffer + evicted_len, evicted_data_len, RDB_REPLACE);
+
+   U_RETURN(true);
+}
+
+bool USessionStore::put(UDataStorage* pdata)
+{
+   U_TRACE(0, "USessionStore::put(%p)", pdata)
+
+   U_INTERNAL_ASSERT(isActive())
+   U_INTERNAL_ASSERT(pdata->keyid)
+
+   const char* data = pdata->toBuffer();
+
+   u_buffer_len = 0;
+
+   bool result = store(U_STRING_TO_PARAM(pdata->keyid), data, UDataStorage::buffer_len, true);
+
+   U_RETURN(result);
+}
+
+bool USessionStore::remove(const UString& key)
+{
+   U_TRACE(0, "USessionStore::remove(%V)", key.rep)
+
+   U_INTERNAL_ASSERT(isActive())
+
+   uint32_t hash = getHash(U_STRING_TO_PARAM(key));
+   bucket* b     = getBucket(hash);
+
+   lock(b);
+
+   slot* s = find(b, hash, U_STRING_TO_PARAM(key));
+
+   if (s)
+      {
+      s->hash = 0;
+
+      (void) __sync_sub_and_fetch(&(info->num_session), 1);
+      }
+
+   unlock(b);
+
+   U_RETURN(s != 0);
+}
+
+void USessionStore::sweep()
+{
+   U_TRACE_NO_PARAM(0, "USessionStore::sweep()")
+
+   U_INTERNAL_ASSERT(isActive())
+
+   U_gettimeofday // NB: optimization if it is enough a time resolution of one second...
+
+   // NB: only one of the workers make the sweep for each period...
+
+   long t    = u_now->tv_sec,
+        last = info->last_sweep;
+
+   if ((t - last) < (U_SESSION_STORE_SWEEP - 1) ||
+       __sync_bool_compare_and_swap(&(info->last_sweep), last, t) == false)
+      {
+      return;
+      }
+
+   slot* s;
+   bucket* b;
+   bool bexpired;
+   uint32_t i, j, len, data_len, num_expired = 0, num_saved = 0;
+
+   for (i = 0; i < info->num_bucket; ++i)
+      {
+      b = (bucket*)(vbucket + i * bucket_size);
+
+      for (j = 0; j < U_SESSION_STORE_WAY; ++j)
+         {
+         s = getSlot(b, j);
+
+         if (s->hash == 0) continue;
+
+         lock(b);
+
+         if (s->hash == 0) // NB: check again with the lock...
+            {
+            unlock(b);
+
+            continue;
+            }
+
+         bexpired = ((t - s->last_access) > (long)ttl);
+
+         if (bexpired == false &&
+             (bsnapshot == false || db == 0 || s->dirty == 0))
+            {
+            unlock(b);
+
+            continue;
+            }
+
+         // NB: the record is copied and written in the db out of the lock...
+
+         len      = s->key_len;
+         data_len = s->data_len;
+
+         U_MEMCPY(buffer, s+1, len + data_len);
+
+         if (bexpired)
+            {
+            s->hash = 0;
+
+            (void) __sync_sub_and_fetch(&(info->num_session), 1);
+            }
+
+         s->dirty = 0;
+
+         unlock(b);
+
+         if (bexpired)
+            {
+            ++num_expired;
+
+            if (bsnapshot && db) (void) db->remove(buffer, len);
+            }
+         else
+            {
+            ++num_saved;
+
+            (void) db->store(buffer, len, buffer + len, data_len, RDB_REPLACE);
+            }
+         }
+      }
+
+   info->num_expired += num_expired;
+
+   if (num_expired ||
+       num_saved)
+      {
+      U_SRV_LOG("session store: %u session expired, %u saved on db - %u active, %llu evicted", num_expired, num_saved, info->num_session, info->num_evicted);
+      }
+}
+
+U_NO_EXPORT int USessionStore::loadEntry(UStringRep* key, UStringRep* data)
+{
+   U_TRACE(0, "USessionStore::loadEntry(%V,%V)", key, data)
+
+   (void) store(U_STRING_TO_PARAM(*key), U_STRING_TO_PARAM(*data), false);
+
+   U_RETURN(1);
+}
+
+void USessionStore::load(URDB* pdb)
+{
+   U_TRACE(0, "USessionStore::load(%p)", pdb)
+
+   U_INTERNAL_ASSERT(isActive())
+   U_INTERNAL_ASSERT_POINTER(pdb)
+
+   db = pdb;
+
+   if (bsnapshot &&
+       info->num_session == 0)
+      {
+      pdb->callForAllEntry((iPFprpr)loadEntry);
+
+      if (info->num_session) U_SRV_LOG("session store: %u session loaded from the snapshot on db", info->num_session);
+      }
+}
@@ -24,9 +24,14 @@
 #include <ulib/utility/base64.h>
 #include <ulib/base/coder/url.h>
 #include <ulib/utility/dir_walk.h>
+#include <ulib/utility/pubsub.h>
+#include <ulib/utility/metrics.h>
 #include <ulib/net/client/client.h>
 #include <ulib/utility/websocket.h>
 #include <ulib/utility/socket_ext.h>
+#include <ulib/utility/route_matcher.h>
+#include <ulib/utility/session_store.h>
+#include <ulib/utility/deflate_stream.h>
 #include <ulib/net/server/plugin/mod_proxy.h>
 #include <ulib/net/server/plugin/mod_proxy_service.h>
 
@@ -74,6 +79,7 @@ bool        UHTTP::bnph;
 bool        UHTTP::bcallInitForAllUSP;
 bool        UHTTP::digest_authentication;
 bool        UHTTP::skip_check_cookie_ip_address;
+bool        UHTTP::preload_learn;
 bool        UHTTP::enable_caching_by_proxy_servers;
 char        UHTTP::response_buffer[64];
 vPFi        UHTTP::on_upload;
@@ -98,18 +104,26 @@ UString*    UHTTP::cache_file_mask;
 UString*    UHTTP::nocache_file_mask;
 UString*    UHTTP::cache_avoid_mask;
 UString*    UHTTP::cache_file_store;
+URouteMatcher* UHTTP::cache_file_matcher;
+URouteMatcher* UHTTP::nocache_file_matcher;
 UString*    UHTTP::cgi_cookie_option;
 UString*    UHTTP::set_cookie_option;
 UString*    UHTTP::string_HTTP_Variables;
 uint32_t    UHTTP::range_size;
+uint32_t    UHTTP::preload_learn_max;
 uint32_t    UHTTP::range_start;
 uint32_t    UHTTP::old_path_len;
 uint32_t    UHTTP::old_response_code;
+char        UHTTP::stream_mode;
+UString*    UHTTP::stream_buffer;
+UString*    UHTTP::stream_pending;
+UDeflateStream* UHTTP::stream_deflate;
 uint32_t    UHTTP::sid_counter_gen;
 uint32_t    UHTTP::sid_counter_cur;
 uint32_t    UHTTP::usp_page_key_len;
 uint32_t    UHTTP::limit_request_body = U_STRING_MAX_SIZE;
 uint32_t    UHTTP::request_read_timeout;
+uint32_t    UHTTP::request_body_min_rate;
 const char* UHTTP::usp_page_key;
 
 UCommand*                         UHTTP::pcmd;
@@ -127,6 +141,7 @@ URDBObjectHandler<UDataStorage*>* UHTTP::db_session;
          UHTTP::UFileCacheData*   UHTTP::file_data;
          UHTTP::UFileCacheData*   UHTTP::file_not_in_cache_data;
 UHashMap<UHTTP::UFileCacheData*>* UHTTP::cache_file;
+UHashMap<UString>*                UHTTP::preload_manifest;
 
 #ifdef USE_PHP
 UHTTP::UPHP* UHTTP::php_embed;
@@ -156,13 +171,12 @@ UString*          UHTTP::alias;
 UString*          UHTTP::global_alias;
 UString*          UHTTP::maintenance_mode_page;
 UVector<UString>* UHTTP::valias;
+URouteMatcher*    UHTTP::alias_matcher;
 #endif
 #ifdef USE_LIBSSL
-UString*                          UHTTP::uri_protected_mask;
-UString*                          UHTTP::uri_request_cert_mask;
-USSLSession*                      UHTTP::data_session_ssl;
-UVector<UIPAllow*>*               UHTTP::vallow_IP;
-URDBObjectHandler<UDataStorage*>* UHTTP::db_session_ssl;
+UString*            UHTTP::uri_protected_mask;
+UString*            UHTTP::uri_request_cert_mask;
+UVector<UIPAllow*>* UHTTP::vallow_IP;
 #endif
 #ifdef USE_LOAD_BALANCE
 UClient<USSLSocket>* UHTTP::client_http;
@@ -1136,11 +1150,18 @@ void UHTTP::init()
       UDirWalk::setRecurseSubDirs(true, true);
       UDirWalk::setSuffixFileType(U_CONSTANT_TO_PARAM("usp|c|cgi|template|" U_LIB_SUFFIX));
 
+      // NB: with a lot of file the cold start wait for the disk, so we stat() and read ahead in parallel the content for checkFileForCache()...
+
+      UDirWalk::setPrefetch(u_get_num_cpu(), UServer_Base::min_size_for_sendfile);
+
       n = dirwalk.walk(vec);
 
+      UDirWalk::setPrefetch(0);
       UDirWalk::setRecurseSubDirs(false, false);
       }
 
+   initRouteMatcher(); // NB: checkFileForCache() use the (no)cache mask...
+
    if (cache_file_store)
       {
       content_cache = (UStringExt::endsWith(U_STRING_TO_PARAM(*cache_file_store), U_CONSTANT_TO_PARAM(".gz"))
@@ -1384,6 +1405,72 @@ void UHTTP::setGlobalAlias(const UString& _alias) // NB: automatic alias for all
 }
 #endif
 
+void UHTTP::initRouteMatcher()
+{
+   U_TRACE_NO_PARAM(0, "UHTTP::initRouteMatcher()")
+
+   // NB: the mask are compiled in a radix trie, so the cost of the match don't depend on the number of rule.
+   //     We are called again after the init of all the plugin (ex: mod_fcgi add an alias)...
+
+   if (  cache_file_matcher) delete   cache_file_matcher;
+   if (nocache_file_matcher) delete nocache_file_matcher;
+
+     cache_file_matcher =
+   nocache_file_matcher = 0;
+
+   if (cache_file_mask)
+      {
+      U_NEW(URouteMatcher, cache_file_matcher, URouteMatcher);
+
+      (void) cache_file_matcher->addMask(*cache_file_mask);
+      }
+
+   if (nocache_file_mask)
+      {
+      U_NEW(URouteMatcher, nocache_file_matcher, URouteMatcher);
+
+      (void) nocache_file_matcher->addMask(*nocache_file_mask);
+      }
+
+#ifdef U_ALIAS
+   if (alias_matcher)
+      {
+      delete alias_matcher;
+             alias_matcher = 0;
+      }
+
+   if (valias)
+      {
+      UString str;
+
+      U_NEW(URouteMatcher, alias_matcher, URouteMatcher);
+
+      for (uint32_t i = 0, n = valias->size(); i < n; i += 2) // Ex: /admin /admin.html
+         {
+         str = (*valias)[i];
+
+         if (str.first_char() == '!') (void) alias_matcher->addMask(str.c_pointer(1), str.size()-1, FNM_INVERT);
+         else                         (void) alias_matcher->addMask(str);
+         }
+      }
+
+#  ifdef USE_LIBPCRE
+   if (rewrite_matcher)
+      {
+      delete rewrite_matcher;
+             rewrite_matcher = 0;
+      }
+
+   if (vRewriteRule)
+      {
+      U_NEW(URouteMatcher, rewrite_matcher, URouteMatcher);
+
+      for (uint32_t i = 0, n = vRewriteRule->size(); i < n; ++i) (void) rewrite_matcher->addRegex((*vRewriteRule)[i]->key.getMask());
+      }
+#  endif
+#endif
+}
+
 void UHTTP::dtor()
 {
    U_TRACE_NO_PARAM(0, "UHTTP::dtor()")
@@ -1405,8 +1492,16 @@ void UHTTP::dtor()
    if (fcgi_uri_mask)         delete fcgi_uri_mask;
    if (scgi_uri_mask)         delete scgi_uri_mask;
    if (cache_file_store)      delete cache_file_store;
+   if (preload_manifest)      delete preload_manifest;
    if (string_HTTP_Variables) delete string_HTTP_Variables;
 
+   if (stream_buffer)
+      {
+      delete stream_buffer;
+      delete stream_pending;
+      delete stream_deflate;
+      }
+
    if (file)
       {
       delete ext;
@@ -1433,13 +1528,18 @@ void UHTTP::dtor()
       if (  cache_file_mask) delete   cache_file_mask;
       if (nocache_file_mask) delete nocache_file_mask;
 
+      if (  cache_file_matcher) delete   cache_file_matcher;
+      if (nocache_file_matcher) delete nocache_file_matcher;
+
 #  ifdef U_ALIAS
                                  delete  alias;
       if (valias)                delete valias;
+      if (alias_matcher)         delete alias_matcher;
       if (global_alias)          delete global_alias;
       if (maintenance_mode_page) delete maintenance_mode_page;
 #    ifdef USE_LIBPCRE
-      if (vRewriteRule) delete vRewriteRule;
+      if (vRewriteRule)    delete vRewriteRule;
+      if (rewrite_matcher) delete rewrite_matcher;
 #    endif
 #  endif
 
@@ -1491,8 +1591,6 @@ void UHTTP::dtor()
          }
          
 #  ifdef USE_LIBSSL
-      if (db_session_ssl) clearSessionSSL();
-
       if (vallow_IP)             delete vallow_IP;
       if (uri_protected_mask)    delete uri_protected_mask;
       if (uri_request_cert_mask) delete uri_request_cert_mask;
@@ -2329,6 +2427,67 @@ U_NO_EXPORT bool UHTTP::readDataChunked(USocket* sk, UString* pbuffer, UString&
    U_RETURN(false);
 }
 
+__pure U_NO_EXPORT bool UHTTP::isBodyRateTooLow(uint32_t byte_read, long elapsed)
+{
+   U_TRACE(0, "UHTTP::isBodyRateTooLow(%u,%ld)", byte_read, elapsed)
+
+   U_INTERNAL_ASSERT_MAJOR(request_body_min_rate, 0)
+
+   // NB: after one second of grace the bytes received must be almost REQUEST_BODY_MIN_RATE for each second elapsed...
+
+   if (elapsed > 1 &&
+       byte_read < (uint64_t)(elapsed - 1) * request_body_min_rate)
+      {
+      U_RETURN(true);
+      }
+
+   U_RETURN(false);
+}
+
+U_NO_EXPORT bool UHTTP::readBody(uint32_t count)
+{
+   U_TRACE(0, "UHTTP::readBody(%u)", count)
+
+   if (request_body_min_rate == 0)
+      {
+      if (USocketExt::read(UServer_Base::csocket, *UClientImage_Base::request, count, U_SSL_TIMEOUT_MS, request_read_timeout)) U_RETURN(true);
+
+      U_RETURN(false);
+      }
+
+   // NB: with REQUEST_BODY_MIN_RATE the body is read chunk by chunk, and the rate is checked at every chunk received...
+
+   U_gettimeofday // NB: optimization if it is enough a time resolution of one second...
+
+   long elapsed, start = u_now->tv_sec;
+   uint32_t byte_read, size = UClientImage_Base::request->size();
+
+   do {
+      if (USocketExt::read(UServer_Base::csocket, *UClientImage_Base::request, U_SINGLE_READ, U_SSL_TIMEOUT_MS, 0) == false) U_RETURN(false);
+
+      U_gettimeofday // NB: optimization if it is enough a time resolution of one second...
+
+      elapsed   = u_now->tv_sec - start;
+      byte_read = UClientImage_Base::request->size() - size;
+
+      U_INTERNAL_DUMP("byte_read = %u elapsed = %ld", byte_read, elapsed)
+
+      if (byte_read >= count) U_RETURN(true);
+      }
+   while (isBodyRateTooLow(byte_read, elapsed) == false &&
+          (request_read_timeout == 0 || elapsed < (long)request_read_timeout));
+
+   U_SRV_LOG_WITH_ADDR("body of request too slow (%u bytes in %ld seconds) from", byte_read, elapsed);
+
+   UClientImage_Base::setCloseConnection();
+
+   U_http_info.nResponseCode = HTTP_CLIENT_TIMEOUT;
+
+   setResponse();
+
+   U_RETURN(false);
+}
+
 U_NO_EXPORT bool UHTTP::readBodyRequest()
 {
    U_TRACE_NO_PARAM(0, "UHTTP::readBodyRequest()")
@@ -2378,7 +2537,7 @@ parallelization: // parent
 
       // NB: wait for other data to complete the read of the request...
 
-      if (USocketExt::read(UServer_Base::csocket, *UClientImage_Base::request, U_http_info.clength - body_byte_read, U_SSL_TIMEOUT_MS, request_read_timeout) == false)
+      if (readBody(U_http_info.clength - body_byte_read) == false)
          {
          U_INTERNAL_DUMP("UClientImage_Base::request->size() = %u Content-Length = %u", UClientImage_Base::request->size(), U_http_info.clength)
 
@@ -2414,7 +2573,7 @@ parallelization: // parent
 
       // NB: wait for other data (max 256k) to complete the read of the request...
 
-      if (USocketExt::read(UServer_Base::csocket, *UClientImage_Base::request, 256 * 1024, U_SSL_TIMEOUT_MS, request_read_timeout) == false)
+      if (readBody(256 * 1024) == false)
          {
          if (UServer_Base::csocket->isTimeout() &&
              UServer_Base::startParallelization())
@@ -3605,6 +3764,8 @@ bool UHTTP::callService(const UString& path) // NB: it is used also by server_pl
 
       ((UServletPage*)(file_data->ptr))->runDynamicPage(0);
 
+      UArena::end(); // NB: the page can have used the arena (see UArena::begin())...
+
       mime_index = mime_index_save;
       }
    else
@@ -3861,6 +4022,11 @@ int UHTTP::handlerREAD()
       }
 #endif
 
+#ifndef U_SERVER_CAPTIVE_PORTAL
+   if (U_ClientImage_http(UServer_Base::pClientImage) == 'W') U_RETURN(UWebSocket::handlerRequest()); // NB: the connection is upgraded to websocket...
+   if (U_ClientImage_http(UServer_Base::pClientImage) == 'S') U_RETURN(UPubSub::handlerRequest());    // NB: the connection is a SSE subscription...
+#endif
+
    if (readHeaderRequest() == false)
       {
       U_INTERNAL_DUMP("U_http_version = %C", U_http_version)
@@ -4031,6 +4197,20 @@ int UHTTP::manageRequest()
    U_ASSERT(ext->empty())
    U_ASSERT(UClientImage_Base::isRequestNotFound())
 
+   if (preload_manifest &&
+       isGET())
+      {
+#  ifndef U_HTTP2_DISABLE
+      if (U_http_version == '2') UHTTP2::sendEarlyHints(); // NB: the write error is checked by UHTTP2::handlerRequest() (nerror)...
+      else
+#  endif
+      if (U_http_version == '1' &&
+          U_ClientImage_pipeline == false)
+         {
+         sendEarlyHints();
+         }
+      }
+
    // manage alias uri
 
 #ifdef U_ALIAS
@@ -4058,49 +4238,26 @@ int UHTTP::manageRequest()
 
    if (valias)
       {
-      UString str;
-      int i, n = valias->size();
-
       // Ex: /admin /admin.html
 
       U_DUMP("valias = %S", UObject2String(*valias))
 
-      for (i = 0; i < n; i += 2)
-         {
-         int flag = 0;
-
-         str = (*valias)[i];
-
-         const char* ptr = str.data();
-
-         int len = str.size();
-
-         if (ptr[0] == '!')
-            {
-            ++ptr;
-            --len;
-
-            flag = FNM_INVERT;
-            }
+      U_INTERNAL_ASSERT_POINTER(alias_matcher)
 
-         if (U_HTTP_URI_DOSMATCH(ptr, len, flag))
-            {
-            str = (*valias)[i+1];
+      uint32_t i = alias_matcher->match(U_HTTP_URI_TO_PARAM);
 
-            U_INTERNAL_DUMP("ALIAS MATCH: %.*S => %V", U_HTTP_URI_TO_TRACE, str.rep)
+      if (i != U_NOT_FOUND)
+         {
+         UString str = (*valias)[i*2+1];
 
-            // NB: this is exclusive with global alias...
+         U_INTERNAL_DUMP("ALIAS MATCH: %.*S => %V", U_HTTP_URI_TO_TRACE, str.rep)
 
-            (void) UClientImage_Base::request_uri->assign(U_HTTP_URI_TO_PARAM);
+         // NB: this is exclusive with global alias...
 
-            (void) alias->append(str);
+         (void) UClientImage_Base::request_uri->assign(U_HTTP_URI_TO_PARAM);
 
-            break;
-            }
-         }
+         (void) alias->append(str);
 
-      if (i < n)
-         {
          if (UStringExt::endsWith(U_STRING_TO_PARAM(str), U_CONSTANT_TO_PARAM("nostat"))) U_http_flag |= HTTP_IS_REQUEST_NOSTAT; // NOT a static page...
 
          U_INTERNAL_DUMP("U_http_is_request_nostat = %b", U_http_is_request_nostat)
@@ -4151,12 +4308,17 @@ set_uri: U_http_info.uri     = alias->data();
    // process the HTTP message
 
 #ifdef U_THROTTLING_SUPPORT
-   if (isGETorHEAD() &&
-       UServer_Base::checkThrottling() == false)
+   if (UServer_Base::isThrottling())
       {
-      setServiceUnavailable();
+      int code = UServer_Base::checkThrottling(isGETorHEAD());
 
-      U_RETURN(U_PLUGIN_HANDLER_FINISHED);
+      if (code)
+         {
+         if (code == HTTP_TOO_MANY_REQUESTS) setTooManyRequests();
+         else                                setServiceUnavailable();
+
+         U_RETURN(U_PLUGIN_HANDLER_FINISHED);
+         }
       }
 #endif
 
@@ -4342,10 +4504,20 @@ file_in_cache:
 
          usp_page->runDynamicPage(0);
 
+         UArena::end(); // NB: the page can have used the arena (see UArena::begin())...
+
          U_DUMP("U_http_info.nResponseCode = %u U_ClientImage_parallelization = %d UClientImage_Base::isNoHeaderForResponse() = %b",
                  U_http_info.nResponseCode,     U_ClientImage_parallelization,     UClientImage_Base::isNoHeaderForResponse())
 
-         if (U_http_info.nResponseCode == HTTP_OK)
+         U_INTERNAL_DUMP("stream_mode = %C", stream_mode)
+
+         if (stream_mode) // NB: the page has used the streaming interface...
+            {
+            if (stream_mode != 'E') (void) endStreamResponse();
+
+            stream_mode = 0;
+            }
+         else if (U_http_info.nResponseCode == HTTP_OK)
             {
             U_INTERNAL_ASSERT_DIFFERS(U_ClientImage_parallelization, U_PARALLELIZATION_PARENT)
 
@@ -4601,6 +4773,15 @@ int UHTTP::processRequest()
 
    U_ASSERT(UClientImage_Base::isRequestNeedProcessing())
 
+   if (UMetrics::uri &&
+       isGETorHEAD() &&
+       U_HTTP_URI_EQUAL(*UMetrics::uri))
+      {
+      UMetrics::handlerRequest();
+
+      U_RETURN(U_PLUGIN_HANDLER_FINISHED);
+      }
+
    if (isGETorHEADorPOST() == false)
       {
       if (isPUT())
@@ -5280,6 +5461,10 @@ void UHTTP::initSession()
          else if (data_storage) db_session->setPointerToDataStorage(data_storage);
 
          if (UServer_Base::isPreForked()) db_session->setShared(U_SRV_LOCK_DATA_SESSION, U_SRV_SPINLOCK_DATA_SESSION);
+
+         // NB: with the session store the db is used only for the record that don't fit in a slot (and for the snapshot)...
+
+         if (USessionStore::isActive()) USessionStore::load(db_session);
          }
       else
          {
@@ -5297,6 +5482,8 @@ void UHTTP::clearSession()
 
    U_INTERNAL_ASSERT_POINTER(db_session)
 
+   if (USessionStore::isActive()) USessionStore::clear();
+
    db_session->close();
 
    if (data_session) delete data_session;
@@ -5311,39 +5498,36 @@ void UHTTP::initSessionSSL()
 {
    U_TRACE_NO_PARAM(0, "UHTTP::initSessionSSL()")
 
-   U_INTERNAL_ASSERT_EQUALS(db_session_ssl, 0)
-   U_INTERNAL_ASSERT_EQUALS(data_session_ssl, 0)
+   U_INTERNAL_ASSERT_POINTER(USSLSession::ptr)
 
-   U_NEW(USSLSession, data_session_ssl, USSLSession);
-   U_NEW(URDBObjectHandler<UDataStorage*>, db_session_ssl, URDBObjectHandler<UDataStorage*>(U_STRING_FROM_CONSTANT("../db/session.ssl"), -1, data_session_ssl));
+   // NB: the cache of session and the keys for the session ticket are in the shared memory (see UHttpPlugIn::handlerInit())...
 
-   if (db_session_ssl->open(4 * 1024 * 1024, false, true)) // NB: we don't want truncate (we have only the journal)...
-      {
-      U_SRV_LOG("db initialization of SSL session success");
+   USSLSession::ptr = (USSLSession::cache*) UServer_Base::getPointerToDataShare(USSLSession::ptr);
 
-      db_session_ssl->reset(); // Initialize the cache to contain no entries
+   USSLSession::init(USSLSocket::sctx);
 
-      if (UServer_Base::isPreForked()) db_session_ssl->setShared(U_SRV_LOCK_SSL_SESSION, U_SRV_SPINLOCK_SSL_SESSION);
+   U_SRV_LOG("SSL: shared session cache initialization success (%u slots), rotation of session ticket key every %u hours",
+               U_SSL_SESSION_CACHE_SIZE, U_SSL_TICKET_KEY_ROTATION / U_ONE_HOUR_IN_SECOND);
 
-      /**
-       * In order to allow external session caching, synchronization with the internal session cache is realized via callback functions.
-       * Inside these callback functions, session can be saved to disk or put into a database using the d2i_SSL_SESSION(3) interface.
-       *
-       * The new_session_cb() is called, whenever a new session has been negotiated and session caching is enabled
-       * (see SSL_CTX_set_session_cache_mode(3)). The new_session_cb() is passed the ssl connection and the ssl session sess.
-       * If the callback returns 0, the session will be immediately removed again.
-       *
-       * The remove_session_cb() is called, whenever the SSL engine removes a session from the internal cache. This happens when
-       * the session is removed because it is expired or when a connection was not shutdown cleanly. It also happens for all sessions
-       * in the internal session cache when SSL_CTX_free(3) is called. The remove_session_cb() is passed the ctx and the ssl session sess.
-       * It does not provide any feedback.
-       *
-       * The get_session_cb() is only called on SSL/TLS servers with the session id proposed by the client. The get_session_cb() is
-       * always called, also when session caching was disabled. The get_session_cb() is passed the ssl connection, the session id and
-       * the length at the memory location data. With the parameter copy the callback can require the SSL engine to increment the
-       * reference count of the SSL_SESSION object, Normally the reference count is not incremented and therefore the session must not
-       * be explicitly freed with SSL_SESSION_free(3)
-       */
+   /**
+    * In order to allow external session caching, synchronization with the internal session cache is realized via callback functions.
+    * Inside these callback functions, session can be saved to disk or put into a database using the d2i_SSL_SESSION(3) interface.
+    *
+    * The new_session_cb() is called, whenever a new session has been negotiated and session caching is enabled
+    * (see SSL_CTX_set_session_cache_mode(3)). The new_session_cb() is passed the ssl connection and the ssl session sess.
+    * If the callback returns 0, the session will be immediately removed again.
+    *
+    * The remove_session_cb() is called, whenever the SSL engine removes a session from the internal cache. This happens when
+    * the session is removed because it is expired or when a connection was not shutdown cleanly. It also happens for all sessions
+    * in the internal session cache when SSL_CTX_free(3) is called. The remove_session_cb() is passed the ctx and the ssl session sess.
+    * It does not provide any feedback.
+    *
+    * The get_session_cb() is only called on SSL/TLS servers with the session id proposed by the client. The get_session_cb() is
+    * always called, also when session caching was disabled. The get_session_cb() is passed the ssl connection, the session id and
+    * the length at the memory location data. With the parameter copy the callback can require the SSL engine to increment the
+    * reference count of the SSL_SESSION object, Normally the reference count is not incremented and therefore the session must not
+    * be explicitly freed with SSL_SESSION_free(3)
+    */
 
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
 typedef SSL_SESSION* (*psPFpspcipi) (SSL*,      unsigned char*,int,int*);
@@ -5351,38 +5535,16 @@ typedef SSL_SESSION* (*psPFpspcipi) (SSL*,      unsigned char*,int,int*);
 typedef SSL_SESSION* (*psPFpspcipi) (SSL*,const unsigned char*,int,int*);
 #endif
 
-      U_SYSCALL_VOID(SSL_CTX_sess_set_new_cb,    "%p,%p", USSLSocket::sctx,              USSLSession::newSession);
-      U_SYSCALL_VOID(SSL_CTX_sess_set_get_cb,    "%p,%p", USSLSocket::sctx, (psPFpspcipi)USSLSession::getSession);
-      U_SYSCALL_VOID(SSL_CTX_sess_set_remove_cb, "%p,%p", USSLSocket::sctx,              USSLSession::removeSession);
+   U_SYSCALL_VOID(SSL_CTX_sess_set_new_cb,    "%p,%p", USSLSocket::sctx,              USSLSession::newSession);
+   U_SYSCALL_VOID(SSL_CTX_sess_set_get_cb,    "%p,%p", USSLSocket::sctx, (psPFpspcipi)USSLSession::getSession);
+   U_SYSCALL_VOID(SSL_CTX_sess_set_remove_cb, "%p,%p", USSLSocket::sctx,              USSLSession::removeSession);
 
-      // NB: All currently supported protocols have the same default timeout value of 300 seconds
-      // ----------------------------------------------------------------------------------------
-      // (void) U_SYSCALL(SSL_CTX_set_timeout,         "%p,%u", USSLSocket::sctx, 300);
-         (void) U_SYSCALL(SSL_CTX_sess_set_cache_size, "%p,%u", USSLSocket::sctx, 1024 * 1024);
-
-      U_INTERNAL_DUMP("timeout = %d", SSL_CTX_get_timeout(USSLSocket::sctx))
-      }
-   else
-      {
-      U_SRV_LOG("WARNING: db initialization of SSL session failed");
-
-      delete db_session_ssl;
-             db_session_ssl = 0;
-      }
-}
-
-void UHTTP::clearSessionSSL()
-{
-   U_TRACE_NO_PARAM(0, "UHTTP::clearSessionSSL()")
-
-   U_INTERNAL_ASSERT_POINTER(db_session_ssl)
-
-   db_session_ssl->close();
-
-   delete data_session_ssl;
+   // NB: All currently supported protocols have the same default timeout value of 300 seconds
+   // ----------------------------------------------------------------------------------------
+   // (void) U_SYSCALL(SSL_CTX_set_timeout,         "%p,%u", USSLSocket::sctx, 300);
+      (void) U_SYSCALL(SSL_CTX_sess_set_cache_size, "%p,%u", USSLSocket::sctx, 1024 * 1024);
 
-   delete db_session_ssl;
-          db_session_ssl = 0;
+   U_INTERNAL_DUMP("timeout = %d", SSL_CTX_get_timeout(USSLSocket::sctx))
 }
 #endif
 
@@ -5431,13 +5593,23 @@ void UHTTP::removeDataSession()
 
       U_SRV_LOG("Delete session ulib.s%u: %V", sid_counter_cur, data_session->keyid.rep);
 
-#  ifdef U_LOG_DISABLE
-            (void) db_session->remove(data_session->keyid);
-#  else
-      int result = db_session->remove(data_session->keyid);
+      bool bstore = (USessionStore::isActive() && USessionStore::remove(data_session->keyid));
 
-      if (result) U_SRV_LOG("WARNING: remove of session data on db failed with error %d", result);
-#  endif
+      if (bstore == false ||
+          USessionStore::bsnapshot)
+         {
+#     ifdef U_LOG_DISABLE
+               (void) db_session->remove(data_session->keyid);
+#     else
+         int result = db_session->remove(data_session->keyid);
+
+         if (result &&
+             bstore == false)
+            {
+            U_SRV_LOG("WARNING: remove of session data on db failed with error %d", result);
+            }
+#     endif
+         }
 
       data_session->resetDataSession();
       }
@@ -5625,9 +5797,7 @@ U_NO_EXPORT bool UHTTP::checkDataSession(const UString& token, time_t expire, US
       {
       data_session->keyid = token;
 
-      db_session->setPointerToDataStorage(data_session);
-
-      if (db_session->getDataStorage() &&
+      if (getSessionRecord(data_session) &&
           expire == 0                  && // 0 -> valid until browser exit
           data_session->isDataSessionExpired())
          {
@@ -5642,6 +5812,44 @@ remove:  removeDataSession();
    U_RETURN(true);
 }
 
+U_NO_EXPORT bool UHTTP::getSessionRecord(UDataSession* ptr)
+{
+   U_TRACE(0, "UHTTP::getSessionRecord(%p)", ptr)
+
+   U_INTERNAL_ASSERT_POINTER(db_session)
+
+   // NB: the session store first, then the db for the record that don't fit in a slot...
+
+   if (USessionStore::isActive() &&
+       USessionStore::get(ptr))
+      {
+      U_RETURN(true);
+      }
+
+   db_session->setPointerToDataStorage(ptr);
+
+   if (db_session->getDataStorage()) U_RETURN(true);
+
+   U_RETURN(false);
+}
+
+U_NO_EXPORT void UHTTP::putSessionRecord(UDataSession* ptr)
+{
+   U_TRACE(0, "UHTTP::putSessionRecord(%p)", ptr)
+
+   U_INTERNAL_ASSERT_POINTER(db_session)
+
+   db_session->setPointerToDataStorage(ptr);
+
+   if (USessionStore::isActive() == false) (void) db_session->putDataStorage();
+   else
+      {
+      if (USessionStore::put(ptr)) return;
+
+      (void) db_session->insertDataStorage(RDB_INSERT_WITH_PADDING); // NB: the last record read from the db can be of another session...
+      }
+}
+
 bool UHTTP::getDataStorage()
 {
    U_TRACE_NO_PARAM(0, "UHTTP::getDataStorage()")
@@ -5649,9 +5857,7 @@ bool UHTTP::getDataStorage()
    U_INTERNAL_ASSERT_POINTER(db_session)
    U_INTERNAL_ASSERT_POINTER(data_storage)
 
-   db_session->setPointerToDataStorage(data_storage);
-
-   if (db_session->getDataStorage()) U_RETURN(true);
+   if (getSessionRecord(data_storage)) U_RETURN(true);
 
    U_RETURN(false);
 }
@@ -5714,9 +5920,7 @@ void UHTTP::putDataSession()
    U_INTERNAL_ASSERT_POINTER(db_session)
    U_INTERNAL_ASSERT_POINTER(data_session)
 
-   db_session->setPointerToDataStorage(data_session);
-
-   (void) db_session->putDataStorage();
+   putSessionRecord(data_session);
 }
 
 void UHTTP::putDataSession(uint32_t index, const char* value, uint32_t size)
@@ -5743,9 +5947,7 @@ void UHTTP::putDataStorage()
    U_INTERNAL_ASSERT_POINTER(db_session)
    U_INTERNAL_ASSERT_POINTER(data_storage)
 
-   db_session->setPointerToDataStorage(data_storage);
-
-   (void) db_session->putDataStorage();
+   putSessionRecord(data_storage);
 }
 
 void UHTTP::putDataStorage(uint32_t index, const char* value, uint32_t size)
@@ -6350,6 +6552,13 @@ void UHTTP::handlerResponse()
 
    UClientImage_Base::setRequestProcessed();
 
+   if (preload_learn                        &&
+       U_http_info.nResponseCode == HTTP_OK &&
+       ext->empty() == false)
+      {
+      learnPreload();
+      }
+
    U_INTERNAL_DUMP("U_http_version = %C", U_http_version)
 
 #ifndef U_HTTP2_DISABLE
@@ -8104,11 +8313,11 @@ void UHTTP::checkFileForCache()
 
    if (file->stat()) // NB: file->stat() get also the size of the file...
       {
-      U_INTERNAL_DUMP("nocache_file_mask = %p U_http_is_nocache_file = %b", nocache_file_mask, U_http_is_nocache_file)
+      U_INTERNAL_DUMP("nocache_file_matcher = %p U_http_is_nocache_file = %b", nocache_file_matcher, U_http_is_nocache_file)
 
       if (U_http_is_nocache_file ||
-          (nocache_file_mask     &&
-           UServices::dosMatchWithOR(file_name, U_STRING_TO_PARAM(*nocache_file_mask), 0)))
+          (nocache_file_matcher  &&
+           nocache_file_matcher->isMatch(file_name)))
          {
          return;
          }
@@ -8244,8 +8453,8 @@ U_NO_EXPORT void UHTTP::manageDataForCache(const UString& file_name)
       goto end;
       }
 
-   if (cache_file_mask &&
-       UServices::dosMatchWithOR(file_name, U_STRING_TO_PARAM(*cache_file_mask), 0))
+   if (cache_file_matcher &&
+       cache_file_matcher->isMatch(file_name))
       {
       if (file_data->size == 0)
          {
@@ -8655,6 +8864,441 @@ U_NO_EXPORT bool UHTTP::processFileCache()
    U_RETURN(false);
 }
 
+// PRELOAD MANIFEST
+
+U_NO_EXPORT void UHTTP::addPreloadLink(UString& link, const char* path, uint32_t len)
+{
+   U_TRACE(0, "UHTTP::addPreloadLink(%V,%.*S,%u)", link.rep, len, path, len)
+
+   U_INTERNAL_ASSERT_MAJOR(len, 0)
+
+   // Link: </css/site.css>; rel=preload; as=style, </js/app.js>; rel=preload; as=script
+
+   const char* as     = 0;
+   const char* suffix = u_getsuffix(path, len);
+
+   if (suffix)
+      {
+      char buffer[32];
+      uint32_t sz = len - (suffix+1 - path);
+
+      if (sz < sizeof(buffer))
+         {
+         int idx = U_unknow;
+
+         U_MEMCPY(buffer, suffix+1, sz);
+                  buffer[sz] = '\0';
+
+         const char* ctype = u_get_mimetype(buffer, &idx);
+
+              if (u_is_css(idx)) as = "style";
+         else if (u_is_js(idx))  as = "script";
+         else if (ctype)
+            {
+                 if (strncmp(ctype, U_CONSTANT_TO_PARAM("image/")) == 0) as = "image";
+            else if (strstr(ctype, "font"))                                as = "font; crossorigin";
+            }
+         }
+      }
+
+   (void) link.reserve(link.size() + len + U_CONSTANT_SIZE(", <>; rel=preload; as=font; crossorigin"));
+
+   if (link) (void) link.append(U_CONSTANT_TO_PARAM(", "));
+
+   if (as == 0) link.snprintf_add(U_CONSTANT_TO_PARAM("<%.*s>; rel=preload"),        len, path);
+   else         link.snprintf_add(U_CONSTANT_TO_PARAM("<%.*s>; rel=preload; as=%s"), len, path, as);
+}
+
+void UHTTP::loadPreloadManifest(const UString& content)
+{
+   U_TRACE(0, "UHTTP::loadPreloadManifest(%V)", content.rep)
+
+   U_INTERNAL_ASSERT_POINTER(preload_manifest)
+
+   // ---------------------------------------------------------------------
+   // # uri           resources to preload (push with HTTP/2)
+   // /index.html     /css/site.css /js/app.js /img/logo.png /font/a.woff2
+   // ---------------------------------------------------------------------
+
+   UString row, uri, word;
+   UVector<UString> vrow, vword;
+
+   for (uint32_t i = 0, n = vrow.split(content, '\n'); i < n; ++i)
+      {
+      row = vrow[i];
+
+      if (row.first_char() == '#') continue;
+
+      uint32_t m = vword.split(row);
+
+      if (m >= 2)
+         {
+         uri = vword[0];
+
+         if (uri.first_char() == '/')
+            {
+            UString link(U_CAPACITY_SMALL);
+
+            for (uint32_t j = 1; j < m; ++j)
+               {
+               word = vword[j];
+
+               addPreloadLink(link, U_STRING_TO_PARAM(word));
+               }
+
+            preload_manifest->insert(uri.copy(), link); // NB: the substring of content have a dependency from content...
+            }
+         }
+
+      vword.clear();
+      }
+
+   U_SRV_LOG("Loaded preload manifest: %u uri", preload_manifest->size());
+}
+
+void UHTTP::learnPreload()
+{
+   U_TRACE_NO_PARAM(0, "UHTTP::learnPreload()")
+
+   U_INTERNAL_ASSERT(preload_learn)
+   U_INTERNAL_ASSERT_POINTER(preload_manifest)
+
+   uint32_t pos = ext->find("Link: ", 0, U_CONSTANT_SIZE("Link: "));
+
+   if (pos == U_NOT_FOUND ||
+       getPreload())
+      {
+      return;
+      }
+
+   // NB: we keep only the entry with rel=preload and a relative target (the only that we can push)...
+
+   const char* ptr = ext->c_pointer(pos + U_CONSTANT_SIZE("Link: "));
+   const char* end = (const char*) memchr(ptr, '\r', ext->remain(ptr));
+
+   if (end == 0) return;
+
+   UString link(U_CAPACITY_SMALL);
+
+   while (ptr < end)
+      {
+      const char* next = (const char*) memchr(ptr, ',', end - ptr);
+
+      if (next == 0) next = end;
+
+      while (ptr < next && u__isspace(*ptr)) ++ptr;
+
+      if (*ptr == '<'  &&
+          ptr[1] == '/' &&
+          u_find(ptr, next - ptr, U_CONSTANT_TO_PARAM("rel=preload")))
+         {
+         if (link) (void) link.append(U_CONSTANT_TO_PARAM(", "));
+
+         (void) link.append(ptr, next - ptr);
+         }
+
+      ptr = next + 1;
+      }
+
+   if (link)
+      {
+      // NB: the uri come from the client (f.e. with an alias or a catch-all page every uri can give a Link header), so the table is bounded...
+
+      UString uri = (UClientImage_Base::request_uri->empty() ? UString((void*)U_HTTP_URI_TO_PARAM) : UClientImage_Base::request_uri->copy());
+
+      if (preload_manifest->size() >= preload_learn_max)
+         {
+         U_SRV_LOG("WARNING: PRELOAD: table full (%u uri), not learned for uri %V", preload_learn_max, uri.rep);
+
+         return;
+         }
+
+      preload_manifest->insert(uri, link);
+
+      U_SRV_LOG("PRELOAD: learned for uri %V: %V", uri.rep, link.rep);
+      }
+}
+
+void UHTTP::sendEarlyHints()
+{
+   U_TRACE_NO_PARAM(0, "UHTTP::sendEarlyHints()")
+
+   U_INTERNAL_ASSERT_POINTER(preload_manifest)
+   U_INTERNAL_ASSERT_EQUALS(U_http_version, '1')
+
+   /**
+    * 103 Early Hints (RFC 8297): the client can start to fetch the resources needed by the page while the server
+    * is still preparing the response (we send it only if the request is not pipelined, so the interim response
+    * cannot be interleaved with the response of a previous request)
+    */
+
+   UString link = getPreload();
+
+   if (link)
+      {
+      UString buffer(U_CONSTANT_SIZE("HTTP/1.1 103 Early Hints\r\nLink: \r\n\r\n") + link.size());
+
+      buffer.snprintf(U_CONSTANT_TO_PARAM("HTTP/1.1 103 Early Hints\r\nLink: %v\r\n\r\n"), link.rep);
+
+      if (USocketExt::write(UServer_Base::csocket, U_STRING_TO_PARAM(buffer), 0) == (int)buffer.size())
+         {
+         U_SRV_LOG_WITH_ADDR("send interim response (103 Early Hints) for uri %.*S to", U_HTTP_URI_TO_TRACE);
+         }
+      }
+}
+
+#define U_STREAM_FLUSH_SIZE (16U * 1024U) // NB: less data for chunk means a worse compression ratio and more overhead of the chunk format...
+
+bool UHTTP::startStreamResponse(const UString& content_type, uint32_t size)
+{
+   U_TRACE(0, "UHTTP::startStreamResponse(%V,%u)", content_type.rep, size)
+
+   U_INTERNAL_ASSERT(content_type)
+   U_INTERNAL_ASSERT_EQUALS(stream_mode, 0)
+   U_INTERNAL_ASSERT_DIFFERS(U_ClientImage_parallelization, U_PARALLELIZATION_PARENT)
+
+   if (stream_buffer == 0)
+      {
+      U_NEW(UString, stream_buffer, UString(U_CAPACITY));
+      U_NEW(UString, stream_pending, UString(U_STREAM_FLUSH_SIZE));
+      U_NEW(UDeflateStream, stream_deflate, UDeflateStream);
+      }
+
+   stream_buffer->setEmpty();
+   stream_pending->setEmpty();
+
+   U_http_info.nResponseCode = HTTP_OK;
+
+   UClientImage_Base::setRequestNoCache();
+
+   UClientImage_Base::body->clear();
+   UClientImage_Base::wbuffer->setEmpty();
+
+   ext->setBuffer(U_CAPACITY);
+
+   ext->snprintf(U_CONSTANT_TO_PARAM("Content-Type: %v\r\n"), content_type.rep);
+
+#ifdef USE_LIBZ
+   if (U_http_is_accept_gzip &&
+       stream_deflate->init(size))
+      {
+      (void) ext->append(U_CONSTANT_TO_PARAM("Content-Encoding: gzip\r\n"));
+      }
+#endif
+
+   U_INTERNAL_DUMP("U_http_version = %C U_ClientImage_pipeline = %b", U_http_version, U_ClientImage_pipeline)
+
+   if (U_http_version == '2' ||
+       U_ClientImage_pipeline)
+      {
+      // NB: the response is sent at the end (we need the Content-Length), the content is only compressed while it is produced...
+
+      stream_mode = 'B';
+
+      U_RETURN(true);
+      }
+
+   if (U_http_version == '1')
+      {
+      stream_mode = 'C';
+
+      (void) ext->append(U_CONSTANT_TO_PARAM("Transfer-Encoding: chunked\r\n\r\n"));
+      }
+   else
+      {
+      stream_mode = 'R'; // HTTP/1.0: the end of the content is the close of the connection
+
+      UClientImage_Base::setCloseConnection();
+
+      (void) ext->append(U_CONSTANT_TO_PARAM(U_CRLF));
+      }
+
+   handlerResponse();
+
+   // NB: we send now the header of the response (the same of UClientImage_Base::writeResponse() but we must wait for the write)...
+
+   struct iovec iov[3] = { UClientImage_Base::iov_vec[0],
+                           UClientImage_Base::iov_vec[1],
+                           { (caddr_t)UClientImage_Base::wbuffer->data(), UClientImage_Base::wbuffer->size() } };
+
+   if (U_ClientImage_close) iov[1].iov_len += 17+2; // Connection: close\r\n
+
+   uint32_t ncount = iov[0].iov_len + iov[1].iov_len + iov[2].iov_len;
+
+#if !defined(U_LINUX) || !defined(ENABLE_THREAD) || !defined(U_LOG_DISABLE) || defined(USE_LIBZ)
+   ULog::updateDate3(0);
+#endif
+
+   bool result = (USocketExt::writev(UServer_Base::csocket, iov, 3, ncount, U_TIMEOUT_MS) == (int)ncount);
+
+   UClientImage_Base::wbuffer->setEmpty(); // NB: to avoid the write of the response when the page return...
+
+   if (result == false)
+      {
+      stream_mode = 'E';
+
+      stream_deflate->end();
+
+      UClientImage_Base::setCloseConnection();
+
+      U_RETURN(false);
+      }
+
+   U_SRV_LOG_WITH_ADDR("send stream response header (%u bytes) %s for uri %.*S to", ncount, (stream_mode == 'C' ? "[chunked]" : "[until close]"), U_HTTP_URI_TO_TRACE);
+
+   U_RETURN(true);
+}
+
+U_NO_EXPORT bool UHTTP::sendStream(const char* ptr, uint32_t len, bool bfinish)
+{
+   U_TRACE(0, "UHTTP::sendStream(%.*S,%u,%b)", len, ptr, len, bfinish)
+
+   U_INTERNAL_ASSERT(stream_buffer->empty())
+
+   bool result = true;
+
+   if (stream_mode == 'C')
+      {
+      if (stream_deflate->isActive()) result = stream_deflate->writeChunk(ptr, len, *stream_buffer, bfinish);
+      else                                     UDeflateStream::addChunk(ptr, len, *stream_buffer, bfinish);
+      }
+   else
+      {
+      U_INTERNAL_ASSERT_EQUALS(stream_mode, 'R')
+
+      if (stream_deflate->isActive() == false) (void) stream_buffer->append(ptr, len);
+      else
+         {
+         result = stream_deflate->write(ptr, len, *stream_buffer, true, bfinish);
+
+         if (bfinish) stream_deflate->end();
+         }
+      }
+
+   U_INTERNAL_DUMP("stream_buffer(%u) = %V", stream_buffer->size(), stream_buffer->rep)
+
+   if (result                  &&
+       stream_buffer->empty() == false)
+      {
+      result = (USocketExt::write(UServer_Base::csocket, U_STRING_TO_PARAM(*stream_buffer), U_TIMEOUT_MS) == (int)stream_buffer->size());
+      }
+
+   stream_buffer->setEmpty();
+
+   if (result == false)
+      {
+      stream_mode = 'E'; // NB: the peer cannot know where the content is truncated, so we must close the connection...
+
+      stream_deflate->end();
+
+      UClientImage_Base::setCloseConnection();
+      }
+
+   U_RETURN(result);
+}
+
+bool UHTTP::writeStreamResponse(const char* ptr, uint32_t len, bool bflush)
+{
+   U_TRACE(0, "UHTTP::writeStreamResponse(%.*S,%u,%b)", len, ptr, len, bflush)
+
+   U_INTERNAL_DUMP("stream_mode = %C", stream_mode)
+
+   U_INTERNAL_ASSERT(stream_mode)
+
+   if (stream_mode == 'E') U_RETURN(false);
+
+   if (stream_mode == 'B')
+      {
+      if (stream_deflate->isActive()) U_RETURN(stream_deflate->write(ptr, len, *UClientImage_Base::body));
+
+      (void) UClientImage_Base::body->append(ptr, len);
+
+      U_RETURN(true);
+      }
+
+   if (U_http_method_type == HTTP_HEAD) U_RETURN(true);
+
+   // NB: to avoid a lot of small chunk we accumulate the data until U_STREAM_FLUSH_SIZE (bflush => we send anyway what we have)...
+
+   if (stream_pending->empty() &&
+       (bflush || len >= U_STREAM_FLUSH_SIZE))
+      {
+      if (len == 0) U_RETURN(true);
+
+      U_RETURN(sendStream(ptr, len, false));
+      }
+
+   (void) stream_pending->append(ptr, len);
+
+   if (bflush ||
+       stream_pending->size() >= U_STREAM_FLUSH_SIZE)
+      {
+      bool result = sendStream(U_STRING_TO_PARAM(*stream_pending), false);
+
+      stream_pending->setEmpty();
+
+      U_RETURN(result);
+      }
+
+   U_RETURN(true);
+}
+
+bool UHTTP::endStreamResponse()
+{
+   U_TRACE_NO_PARAM(0, "UHTTP::endStreamResponse()")
+
+   U_INTERNAL_DUMP("stream_mode = %C", stream_mode)
+
+   U_INTERNAL_ASSERT(stream_mode)
+
+   bool result = true;
+
+   if (stream_mode == 'E') result = false;
+   else if (stream_mode == 'B')
+      {
+      if (stream_deflate->isActive())
+         {
+         result = stream_deflate->write(0, 0, *UClientImage_Base::body, false, true);
+
+         U_SRV_LOG("stream response: %u bytes - (%u%%) compression ratio", stream_deflate->getTotalOut(),
+                   100U - (stream_deflate->getTotalOut() * 100U) / U_max(stream_deflate->getTotalIn(), 1U));
+
+         stream_deflate->end();
+         }
+
+      if (result == false)
+         {
+         UClientImage_Base::body->clear();
+
+         setInternalError();
+         }
+      else
+         {
+         ext->snprintf_add(U_CONSTANT_TO_PARAM("Content-Length: %u\r\n\r\n"), UClientImage_Base::body->size());
+
+         handlerResponse();
+         }
+      }
+   else
+      {
+      if (U_http_method_type != HTTP_HEAD)
+         {
+         result = sendStream(U_STRING_TO_PARAM(*stream_pending), true);
+
+         stream_pending->setEmpty();
+         }
+
+      stream_deflate->end();
+
+      UClientImage_Base::body->clear();
+      UClientImage_Base::wbuffer->setEmpty();
+      }
+
+   stream_mode = 'E';
+
+   U_RETURN(result);
+}
+
 U_NO_EXPORT bool UHTTP::checkPathName(uint32_t len)
 {
    U_TRACE(0, "UHTTP::checkPathName(%u)", len)
@@ -8729,12 +9373,12 @@ U_NO_EXPORT void UHTTP::checkPathName()
    U_INTERNAL_DUMP("file = %.*S", U_FILE_TO_TRACE(*file))
 
 #ifndef U_SERVER_CAPTIVE_PORTAL
-   if (nocache_file_mask)
+   if (nocache_file_matcher)
       {
       UString basename = UStringExt::basename(U_FILE_TO_PARAM(*file));
 
       if (basename &&
-          UServices::dosMatchWithOR(basename, U_STRING_TO_PARAM(*nocache_file_mask), 0))
+          nocache_file_matcher->isMatch(basename))
          {
          U_http_flag |= HTTP_IS_NOCACHE_FILE | HTTP_IS_REQUEST_NOSTAT;
 
@@ -8905,6 +9549,7 @@ nocontent:
 
 #if defined(U_ALIAS) && defined(USE_LIBPCRE)
 UVector<UHTTP::RewriteRule*>* UHTTP::vRewriteRule;
+URouteMatcher*                UHTTP::rewrite_matcher;
 
 U_NO_EXPORT void UHTTP::processRewriteRule()
 {
@@ -8914,7 +9559,11 @@ U_NO_EXPORT void UHTTP::processRewriteRule()
    UHTTP::RewriteRule* rule;
    UString _uri(U_HTTP_URI_TO_PARAM), new_uri;
 
-   for (uint32_t i = 0, n = vRewriteRule->size(); i < n; ++i)
+   U_INTERNAL_ASSERT_POINTER(rewrite_matcher)
+
+   // NB: the matcher give only the candidate (by the literal prefix of the regex), in order of rule...
+
+   for (uint32_t i = rewrite_matcher->match(_uri); i != U_NOT_FOUND; i = rewrite_matcher->match(_uri, i+1))
       {
       rule    = (*vRewriteRule)[i];
       new_uri = rule->key.replace(_uri, rule->replacement);
@@ -10949,7 +11598,7 @@ U_EXPORT istream& operator>>(istream& is, UHTTP::UFileCacheData& d)
 
             U_INTERNAL_DUMP("d.ptr = %p d.mime_index(%d) = %C d.size = %u", d.ptr, d.mime_index, d.mime_index, d.size)
 
-            if (UHTTP::isSizeForSendfile(d.size))
+            if (d.size >= UServer_Base::min_size_for_sendfile)
                {
                // NB: we can't use sendfile() for this...
 
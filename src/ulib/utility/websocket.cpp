@@ -14,8 +14,15 @@
 #include <ulib/utility/uhttp.h>
 #include <ulib/utility/services.h>
 #include <ulib/utility/websocket.h>
+#include <ulib/base/coder/gzio.h>
 #include <ulib/net/server/server.h>
 
+#ifdef __AVX2__
+#  include <immintrin.h>
+#elif defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
 #define OPCODE_CONTINUATION 0x0
 #define OPCODE_TEXT         0x1
 #define OPCODE_BINARY       0x2
@@ -40,6 +47,7 @@
 #define FRAME_GET_PAYLOAD_LEN(BYTE) ( (BYTE)       & 0x7F)
 
 #define FRAME_SET_FIN(BYTE)         (((BYTE) & 0x01) << 7)
+#define FRAME_SET_RSV1(BYTE)        (((BYTE) & 0x01) << 6)
 #define FRAME_SET_OPCODE(BYTE)       ((BYTE) & 0x0F)
 #define FRAME_SET_MASK(BYTE)        (((BYTE) & 0x01) << 7)
 #define FRAME_SET_LENGTH(X64, IDX)  (unsigned char)(((uint64_t)(X64) >> ((IDX)*8)) & 0xFF)
@@ -47,14 +55,132 @@
 #define WEBSOCKET_GUID     "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
 #define WEBSOCKET_GUID_LEN 36
 
+#define DEFLATE_ENABLE                    0x01 // permessage-deflate (RFC 7692)
+#define DEFLATE_SERVER_NO_CONTEXT_TAKEOVER 0x02
+#define DEFLATE_CLIENT_NO_CONTEXT_TAKEOVER 0x04
+#define DEFLATE_SERVER_MAX_WINDOW_BITS     0x08
+#define DEFLATE_CLIENT_MAX_WINDOW_BITS     0x10
+#define DEFLATE_MIN_SIZE                  128  // NB: a smaller message is sent without compression (RSV1 is for each message)...
+#define DEFLATE_TAIL                      "\x00\x00\xff\xff" // the empty block of Z_SYNC_FLUSH, removed by the sender and added back by the receiver
+
+bool        UWebSocket::bdeflate;
+bool        UWebSocket::bcontext_takeover = true;
 int         UWebSocket::status_code;
 int         UWebSocket::message_type;
+vPFi        UWebSocket::on_message;
 UString*    UWebSocket::rbuffer;
 uint32_t    UWebSocket::max_message_size;
 const char* UWebSocket::upgrade_settings;
 
-UWebSocket::WebSocketFrameData UWebSocket::control_frame = { 0, 0, 1, 8, 0 };
-UWebSocket::WebSocketFrameData UWebSocket::message_frame = { 0, 0, 1, 0, 0 };
+unsigned char UWebSocket::deflate_negotiated;
+
+#ifdef USE_LIBZ
+UString*  UWebSocket::zbuffer;
+z_stream* UWebSocket::zinflate_shared;
+z_stream* UWebSocket::zdeflate_shared;
+#endif
+
+UWebSocket::WebSocketConnection  UWebSocket::blocking;
+UWebSocket::WebSocketConnection* UWebSocket::vconnection;
+
+/**
+ * Sec-WebSocket-Extensions: permessage-deflate; client_max_window_bits, permessage-deflate
+ *
+ * We accept the first offer of permessage-deflate that we can satisfy: the parameters are server_no_context_takeover,
+ * client_no_context_takeover, client_max_window_bits (we inflate always with the max window) and server_max_window_bits
+ * only if it is 15 (zlib can't produce a stream for a window of 256 bytes, so we decline a smaller window). Every parameter
+ * accepted is echoed in the response (the window bits with the value 15 that we use)...
+ */
+
+void UWebSocket::negotiateDeflate()
+{
+   U_TRACE_NO_PARAM(0, "UWebSocket::negotiateDeflate()")
+
+   deflate_negotiated = 0;
+
+#ifdef USE_LIBZ
+   const char* ptr = UHTTP::getHeaderValuePtr(U_CONSTANT_TO_PARAM("Sec-WebSocket-Extensions"), true);
+
+   if (ptr == 0) return;
+
+   const char* end = ptr;
+
+   while (*end != '\r' &&
+          *end != '\n' &&
+          *end != '\0')
+      {
+      ++end;
+      }
+
+   U_INTERNAL_DUMP("Sec-WebSocket-Extensions: = %.*S", end-ptr, ptr)
+
+   bool bok = false;
+   uint32_t len;
+   const char* token;
+   unsigned char flags = 0;
+
+   for (int i = 0; ptr <= end; ++ptr)
+      {
+      // NB: i is the index of the token in the offer (0 => the name of the extension)...
+
+      while (ptr < end && u__isspace(*ptr)) ++ptr;
+
+      for (token = ptr; ptr < end && *ptr != ';' && *ptr != ','; ++ptr) {}
+
+      for (len = ptr - token; len && u__isspace(token[len-1]); --len) {}
+
+      if (i++ == 0) bok = (len == U_CONSTANT_SIZE("permessage-deflate") && u__strncasecmp(token, U_CONSTANT_TO_PARAM("permessage-deflate")) == 0);
+      else if (bok)
+         {
+              if (len == U_CONSTANT_SIZE("server_no_context_takeover") && u__strncasecmp(token, U_CONSTANT_TO_PARAM("server_no_context_takeover")) == 0) flags |= DEFLATE_SERVER_NO_CONTEXT_TAKEOVER;
+         else if (len == U_CONSTANT_SIZE("client_no_context_takeover") && u__strncasecmp(token, U_CONSTANT_TO_PARAM("client_no_context_takeover")) == 0) flags |= DEFLATE_CLIENT_NO_CONTEXT_TAKEOVER;
+         else if (len >= U_CONSTANT_SIZE("client_max_window_bits")    && u__strncasecmp(token, U_CONSTANT_TO_PARAM("client_max_window_bits"))    == 0) flags |= DEFLATE_CLIENT_MAX_WINDOW_BITS;
+         else if (len >= U_CONSTANT_SIZE("server_max_window_bits")    && u__strncasecmp(token, U_CONSTANT_TO_PARAM("server_max_window_bits"))    == 0)
+            {
+            const char* value = (const char*) memchr(token, '=', len);
+
+            if (value == 0) bok = false;
+            else
+               {
+               do { ++value; } while (value < (token + len) && (u__isspace(*value) || *value == '"'));
+
+               if ((token + len - value) < 2 ||
+                   u_get_unalignedp16(value) != U_MULTICHAR_CONSTANT16('1','5'))
+                  {
+                  bok = false;
+                  }
+               else
+                  {
+                  flags |= DEFLATE_SERVER_MAX_WINDOW_BITS;
+                  }
+               }
+            }
+         else
+            {
+            bok = false; // unknown parameter: we decline this offer
+            }
+         }
+
+      if (ptr == end ||
+          *ptr == ',')
+         {
+         if (bok)
+            {
+            deflate_negotiated = DEFLATE_ENABLE | flags;
+
+            if (bcontext_takeover == false) deflate_negotiated |= DEFLATE_SERVER_NO_CONTEXT_TAKEOVER | DEFLATE_CLIENT_NO_CONTEXT_TAKEOVER;
+
+            break;
+            }
+
+         i     = 0;
+         flags = 0;
+         }
+      }
+
+   U_INTERNAL_DUMP("deflate_negotiated = %u", deflate_negotiated)
+#endif
+}
 
 bool UWebSocket::sendAccept()
 {
@@ -80,10 +206,32 @@ bool UWebSocket::sendAccept()
 
    UServices::generateDigest(U_HASH_SHA1, 0, challenge, U_http_websocket_len + WEBSOCKET_GUID_LEN, accept, true);
 
-   UClientImage_Base::wbuffer->snprintf(U_CONSTANT_TO_PARAM("HTTP/1.1 101 Switching Protocols\r\n"
-                                        "Upgrade: websocket\r\n"
-                                        "Connection: Upgrade\r\n"
-                                        "Sec-WebSocket-Accept: %v\r\n\r\n"), accept.rep);
+   if (bdeflate) negotiateDeflate();
+   else          deflate_negotiated = 0;
+
+   if (deflate_negotiated == 0)
+      {
+      UClientImage_Base::wbuffer->snprintf(U_CONSTANT_TO_PARAM("HTTP/1.1 101 Switching Protocols\r\n"
+                                           "Upgrade: websocket\r\n"
+                                           "Connection: Upgrade\r\n"
+                                           "Sec-WebSocket-Accept: %v\r\n\r\n"), accept.rep);
+      }
+   else
+      {
+#  ifdef USE_LIBZ
+      if (zbuffer == 0) U_NEW(UString, zbuffer, UString(U_CAPACITY));
+#  endif
+
+      UClientImage_Base::wbuffer->snprintf(U_CONSTANT_TO_PARAM("HTTP/1.1 101 Switching Protocols\r\n"
+                                           "Upgrade: websocket\r\n"
+                                           "Connection: Upgrade\r\n"
+                                           "Sec-WebSocket-Accept: %v\r\n"
+                                           "Sec-WebSocket-Extensions: permessage-deflate%.*s%.*s%.*s%.*s\r\n\r\n"), accept.rep,
+                                           (deflate_negotiated & DEFLATE_SERVER_NO_CONTEXT_TAKEOVER ? (int)U_CONSTANT_SIZE("; server_no_context_takeover") : 0), "; server_no_context_takeover",
+                                           (deflate_negotiated & DEFLATE_CLIENT_NO_CONTEXT_TAKEOVER ? (int)U_CONSTANT_SIZE("; client_no_context_takeover") : 0), "; client_no_context_takeover",
+                                           (deflate_negotiated & DEFLATE_SERVER_MAX_WINDOW_BITS     ? (int)U_CONSTANT_SIZE("; server_max_window_bits=15") : 0), "; server_max_window_bits=15",
+                                           (deflate_negotiated & DEFLATE_CLIENT_MAX_WINDOW_BITS     ? (int)U_CONSTANT_SIZE("; client_max_window_bits=15") : 0), "; client_max_window_bits=15");
+      }
 
    if (USocketExt::write(UServer_Base::csocket, *UClientImage_Base::wbuffer, UServer_Base::timeoutMS))
       {
@@ -105,6 +253,10 @@ void UWebSocket::checkForInitialData()
    U_INTERNAL_ASSERT_POINTER(rbuffer)
    U_INTERNAL_ASSERT_MAJOR(UClientImage_Base::size_request, 0)
 
+   // NB: the state of the connection (with the context of permessage-deflate) is kept between the calls of handleDataFraming(USocket*)...
+
+   resetConnection(&blocking);
+
    uint32_t sz = UClientImage_Base::rbuffer->size();
 
    U_INTERNAL_DUMP("UClientImage_Base::rbuffer(%u) = %V", sz, UClientImage_Base::rbuffer->rep)
@@ -121,6 +273,313 @@ void UWebSocket::checkForInitialData()
       }
 }
 
+void UWebSocket::clearDeflate(WebSocketConnection* pconn)
+{
+   U_TRACE(0, "UWebSocket::clearDeflate(%p)", pconn)
+
+#ifdef USE_LIBZ
+   if (pconn->zinflate)
+      {
+      u_gz_inflate_end(pconn->zinflate);
+
+      U_FREE_TYPE(pconn->zinflate, z_stream);
+
+      pconn->zinflate = 0;
+      }
+
+   if (pconn->zdeflate)
+      {
+      u_gz_deflate_end(pconn->zdeflate);
+
+      U_FREE_TYPE(pconn->zdeflate, z_stream);
+
+      pconn->zdeflate = 0;
+      }
+#endif
+
+   pconn->extension = 0;
+}
+
+void UWebSocket::resetConnection(WebSocketConnection* pconn)
+{
+   U_TRACE(0, "UWebSocket::resetConnection(%p)", pconn)
+
+   if (pconn->message)
+      {
+      delete pconn->message;
+             pconn->message = 0;
+      }
+
+   clearDeflate(pconn);
+
+   (void) U_SYSCALL(memset, "%p,%d,%u", pconn, 0, sizeof(WebSocketConnection));
+
+   pconn->control_frame.fin    = 1;
+   pconn->control_frame.opcode = OPCODE_CLOSE;
+   pconn->message_frame.fin    = 1;
+   pconn->framing_state        = DATA_FRAMING_START;
+   pconn->extension            = deflate_negotiated; // NB: the result of the handshake (sendAccept())...
+}
+
+void UWebSocket::clear()
+{
+   U_TRACE_NO_PARAM(0, "UWebSocket::clear()")
+
+   clearDeflate(&blocking);
+
+#ifdef USE_LIBZ
+   if (zbuffer)
+      {
+      delete zbuffer;
+             zbuffer = 0;
+      }
+
+   if (zinflate_shared)
+      {
+      u_gz_inflate_end(zinflate_shared);
+
+      U_FREE_TYPE(zinflate_shared, z_stream);
+
+      zinflate_shared = 0;
+      }
+
+   if (zdeflate_shared)
+      {
+      u_gz_deflate_end(zdeflate_shared);
+
+      U_FREE_TYPE(zdeflate_shared, z_stream);
+
+      zdeflate_shared = 0;
+      }
+#endif
+}
+
+void UWebSocket::preallocate(uint32_t max_connection)
+{
+   U_TRACE(0, "UWebSocket::preallocate(%u)", max_connection)
+
+   U_INTERNAL_ASSERT_EQUALS(vconnection, 0)
+
+   vconnection = (WebSocketConnection*) UMemoryPool::_malloc(max_connection, sizeof(WebSocketConnection), true);
+}
+
+void UWebSocket::deallocate(uint32_t max_connection)
+{
+   U_TRACE(0, "UWebSocket::deallocate(%u)", max_connection)
+
+   U_INTERNAL_ASSERT_POINTER(vconnection)
+
+   for (uint32_t i = 0; i < max_connection; ++i)
+      {
+      if (vconnection[i].message) delete vconnection[i].message;
+
+      clearDeflate(vconnection+i);
+      }
+
+   UMemoryPool::_free(vconnection, max_connection, sizeof(WebSocketConnection));
+
+   vconnection = 0;
+}
+
+/**
+ * The payload of a frame of the client is masked with a key of 4 bytes, so the XOR is done with the key repeated on a
+ * block of 32 (AVX2), 16 (SSE2) and 8 bytes, the key is rotated by the offset in the payload (the frame can be split
+ * between two read) and only the tail of the payload is processed for each byte...
+ */
+
+void UWebSocket::unmask(unsigned char* dst, const unsigned char* src, uint32_t len, const unsigned char* mask, uint32_t mask_offset)
+{
+   U_TRACE(0, "UWebSocket::unmask(%p,%p,%u,%p,%u)", dst, src, len, mask, mask_offset)
+
+   uint32_t i = 0;
+   unsigned char key[4] = { mask[ mask_offset      & 3],
+                            mask[(mask_offset + 1) & 3],
+                            mask[(mask_offset + 2) & 3],
+                            mask[(mask_offset + 3) & 3] };
+
+   uint32_t key32 = u_get_unalignedp32(key);
+   uint64_t key64 = ((uint64_t)key32 << 32) | key32;
+
+#ifdef __AVX2__
+   __m256i key256 = _mm256_set1_epi32((int)key32);
+
+   for (; (i + 32) <= len; i += 32) _mm256_storeu_si256((__m256i*)(dst+i), _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(src+i)), key256));
+#endif
+
+#ifdef __SSE2__
+   __m128i key128 = _mm_set1_epi32((int)key32);
+
+   for (; (i + 16) <= len; i += 16) _mm_storeu_si128((__m128i*)(dst+i), _mm_xor_si128(_mm_loadu_si128((const __m128i*)(src+i)), key128));
+#endif
+
+   for (; (i + 8) <= len; i += 8) u_put_unalignedp64(dst+i, u_get_unalignedp64(src+i) ^ key64);
+
+   for (; i < len; ++i) dst[i] = src[i] ^ key[i & 3];
+}
+
+#ifdef USE_LIBZ
+/**
+ * NB: with the context takeover the stream is of the connection, otherwise we use a stream shared by all the connections
+ *     of the process (we are single thread) that is reset after every message...
+ */
+
+int UWebSocket::inflateMessage(WebSocketConnection* pconn, uint32_t len)
+{
+   U_TRACE(0, "UWebSocket::inflateMessage(%p,%u)", pconn, len)
+
+   U_INTERNAL_ASSERT_POINTER(zbuffer)
+
+   z_stream* stream;
+   bool bshared = (pconn->extension & DEFLATE_CLIENT_NO_CONTEXT_TAKEOVER);
+
+   if (bshared) stream = zinflate_shared;
+   else         stream = pconn->zinflate;
+
+   if (stream == 0)
+      {
+      stream = U_MALLOC_TYPE(z_stream);
+
+      if (u_gz_inflate_init(stream) == false)
+         {
+         U_FREE_TYPE(stream, z_stream);
+
+         U_RETURN(STATUS_CODE_INTERNAL_ERROR);
+         }
+
+      if (bshared) zinflate_shared = stream;
+      else         pconn->zinflate = stream;
+      }
+
+   int result = 0;
+   uint32_t n;
+   const char* ptr;
+
+   UClientImage_Base::wbuffer->size_adjust_force(len);
+
+   (void) UClientImage_Base::wbuffer->append(U_CONSTANT_TO_PARAM(DEFLATE_TAIL));
+
+   ptr  = UClientImage_Base::wbuffer->data();
+   len += U_CONSTANT_SIZE(DEFLATE_TAIL);
+
+   zbuffer->setEmpty();
+
+   (void) zbuffer->reserve(len * 3);
+
+   do {
+      if (zbuffer->space() < 64) (void) zbuffer->reserve(zbuffer->size());
+
+      n = u_gz_inflate_chunk(stream, ptr, len, zbuffer->pend(), zbuffer->space());
+
+      if (n == U_NOT_FOUND)
+         {
+         U_SRV_LOG_WITH_ADDR("Got invalid compressed websocket data (%u bytes) from", len);
+
+         result = STATUS_CODE_PROTOCOL_ERROR;
+
+         break;
+         }
+
+      ptr = 0;
+
+      zbuffer->size_adjust(zbuffer->size() + n);
+
+      if (zbuffer->size() > max_message_size)
+         {
+         U_SRV_LOG_WITH_ADDR("Got compressed message greater than maximum frame buffer size: (%u > %u) from", zbuffer->size(), max_message_size);
+
+         result = STATUS_CODE_MESSAGE_TOO_LARGE;
+
+         break;
+         }
+      }
+   while (stream->avail_out == 0);
+
+   if (bshared) (void) zlib_inflateReset(stream);
+
+   if (result == 0)
+      {
+      U_INTERNAL_DUMP("inflate: %u => %u bytes", len, zbuffer->size())
+
+      UClientImage_Base::wbuffer->swap(*zbuffer);
+      }
+
+   U_RETURN(result);
+}
+
+bool UWebSocket::deflateMessage(WebSocketConnection* pconn, const unsigned char* buffer, uint32_t buffer_size)
+{
+   U_TRACE(0, "UWebSocket::deflateMessage(%p,%.*S,%u)", pconn, buffer_size, buffer, buffer_size)
+
+   U_INTERNAL_ASSERT_POINTER(zbuffer)
+
+   z_stream* stream;
+   bool bshared = (pconn->extension & DEFLATE_SERVER_NO_CONTEXT_TAKEOVER);
+
+   if (bshared) stream = zdeflate_shared;
+   else         stream = pconn->zdeflate;
+
+   if (stream == 0)
+      {
+      stream = U_MALLOC_TYPE(z_stream);
+
+      if (u_gz_deflate_init(stream, u_gz_deflate_level(0), false) == false)
+         {
+         U_FREE_TYPE(stream, z_stream);
+
+         U_RETURN(false);
+         }
+
+      if (bshared) zdeflate_shared = stream;
+      else         pconn->zdeflate = stream;
+      }
+
+   uint32_t n;
+   const char* ptr = (const char*)buffer;
+
+   zbuffer->setEmpty();
+
+   (void) zbuffer->reserve(buffer_size + (buffer_size / 10) + 64);
+
+   do {
+      if (zbuffer->space() < 64) (void) zbuffer->reserve(U_CAPACITY);
+
+      n = u_gz_deflate_chunk(stream, ptr, buffer_size, zbuffer->pend(), zbuffer->space(), Z_SYNC_FLUSH);
+
+      if (n == U_NOT_FOUND)
+         {
+         // NB: the stream is lost, the next message start a new one (the peer don't need our previous window to inflate it)...
+
+         u_gz_deflate_end(stream);
+
+         U_FREE_TYPE(stream, z_stream);
+
+         if (bshared) zdeflate_shared = 0;
+         else         pconn->zdeflate = 0;
+
+         U_RETURN(false);
+         }
+
+      ptr = 0;
+
+      zbuffer->size_adjust(zbuffer->size() + n);
+      }
+   while (stream->avail_out == 0);
+
+   if (bshared) (void) zlib_deflateReset(stream);
+
+   // NB: the data end with the empty block of Z_SYNC_FLUSH, that the receiver add back...
+
+   U_INTERNAL_ASSERT(zbuffer->size() >= U_CONSTANT_SIZE(DEFLATE_TAIL))
+   U_INTERNAL_ASSERT_EQUALS(memcmp(zbuffer->c_pointer(zbuffer->size() - U_CONSTANT_SIZE(DEFLATE_TAIL)), DEFLATE_TAIL, U_CONSTANT_SIZE(DEFLATE_TAIL)), 0)
+
+   zbuffer->size_adjust(zbuffer->size() - U_CONSTANT_SIZE(DEFLATE_TAIL));
+
+   U_INTERNAL_DUMP("deflate: %u => %u bytes", buffer_size, zbuffer->size())
+
+   U_RETURN(true);
+}
+#endif
+
 /**
  * So, WebSockets presents a sequence of infinitely long byte streams
  * with a termination indicator (the FIN bit in the frame header) and
@@ -148,407 +607,521 @@ void UWebSocket::checkForInitialData()
  * + - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - +
  * |                     Payload Data continued ...                |
  * +---------------------------------------------------------------+
+ *
+ * NB: the parser consume the block starting from block_offset and return 0 if it need more data, otherwise the status code
+ *     with block_offset set after the last frame processed. A complete message (message_type == MESSAGE_TYPE_TEXT|BINARY)
+ *     is in UClientImage_Base::wbuffer, a closing handshake from the peer is signaled by message_type == MESSAGE_TYPE_CLOSE...
  */
 
-int UWebSocket::handleDataFraming(USocket* socket)
+int UWebSocket::handleDataFraming(WebSocketConnection* pconn, const unsigned char* block, uint32_t block_size, uint32_t& block_offset)
 {
-   U_TRACE(0, "UWebSocket::handleDataFraming(%p)", socket)
+   U_TRACE(0, "UWebSocket::handleDataFraming(%p,%.*S,%u,%u)", pconn, block_size, block, block_size, block_offset)
 
-   unsigned char* block;
-   uint32_t block_offset, ncount = 0, block_size;
-   WebSocketFrameData* frame = &UWebSocket::control_frame;
-   unsigned char fin = 0, opcode = 0xFF, mask[4] = { 0, 0, 0, 0 };
-   int32_t extension_bytes_remaining = 0, payload_length = 0, mask_offset = 0;
-   int framing_state = DATA_FRAMING_START, payload_length_bytes_remaining = 0, mask_index = 0, masking = 0;
+   WebSocketFrameData* frame = (pconn->opcode >= 0x8 ? &(pconn->control_frame) : &(pconn->message_frame));
 
-loop:
-   if (rbuffer->empty() &&
-       USocketExt::read(socket, *rbuffer, U_SINGLE_READ, UServer_Base::timeoutMS) == false)
+   while (block_offset < block_size)
       {
-      U_RETURN(STATUS_CODE_INTERNAL_ERROR);
-      }
+      U_INTERNAL_DUMP("framing_state = %d", pconn->framing_state)
 
-              block        = (unsigned char*) rbuffer->data();
-   ncount += (block_size   =                  rbuffer->size());
-              block_offset = 0;
-
-   do {
-      U_INTERNAL_DUMP("framing_state = %d", framing_state)
-
-      switch (framing_state)
+      switch (pconn->framing_state)
          {
          case DATA_FRAMING_START: // 1
             {
-            // Since we don't currently support any extensions, the reserve bits must be 0
+            // The only extension that we support is permessage-deflate: RSV1 mark the first frame of a compressed message, the other reserve bits must be 0
 
-            if ((FRAME_GET_RSV1(block[block_offset]) != 0) ||
-                (FRAME_GET_RSV2(block[block_offset]) != 0) ||
-                (FRAME_GET_RSV3(block[block_offset]) != 0))
-               {
-               // framing_state = DATA_FRAMING_CLOSE; // 6
+            unsigned char rsv1 = FRAME_GET_RSV1(block[block_offset]);
 
+            if ((FRAME_GET_RSV2(block[block_offset]) != 0) ||
+                (FRAME_GET_RSV3(block[block_offset]) != 0) ||
+                (rsv1 && pconn->extension == 0))
+               {
                U_RETURN(status_code = STATUS_CODE_PROTOCOL_ERROR);
                }
 
-            fin    = FRAME_GET_FIN(   block[block_offset]);
-            opcode = FRAME_GET_OPCODE(block[block_offset++]);
+            pconn->fin    = FRAME_GET_FIN(   block[block_offset]);
+            pconn->opcode = FRAME_GET_OPCODE(block[block_offset++]);
 
-            U_INTERNAL_DUMP("fin = %d opcode = %X", fin, opcode)
+            U_INTERNAL_DUMP("fin = %d opcode = %X", pconn->fin, pconn->opcode)
 
-            framing_state = DATA_FRAMING_PAYLOAD_LENGTH; // 2
+            pconn->framing_state = DATA_FRAMING_PAYLOAD_LENGTH; // 2
 
-            if (opcode >= 0x8) // Control frame
+            if (pconn->opcode >= 0x8) // Control frame
                {
-               if (fin == 0)
+               if (pconn->fin == 0 ||
+                   rsv1)
                   {
-                  // framing_state = DATA_FRAMING_CLOSE; // 6
-
                   U_RETURN(status_code = STATUS_CODE_PROTOCOL_ERROR);
                   }
 
-               frame             = &UWebSocket::control_frame;
-               frame->opcode     = opcode;
-               frame->utf8_state = 0;
+               frame                          = &(pconn->control_frame);
+               frame->opcode                  = pconn->opcode;
+               frame->utf8_state              = 0;
+               frame->application_data_offset = 0;
                }
             else // Message frame
                {
-               frame = &UWebSocket::message_frame;
+               frame = &(pconn->message_frame);
 
-               if (opcode)
+               if (pconn->opcode)
                   {
-                  if (frame->fin == 0)
-                     {
-                     // framing_state = DATA_FRAMING_CLOSE; // 6
+                  if (frame->fin == 0) U_RETURN(status_code = STATUS_CODE_PROTOCOL_ERROR);
 
-                     U_RETURN(status_code = STATUS_CODE_PROTOCOL_ERROR);
-                     }
-
-                  frame->opcode     = opcode;
+                  frame->opcode     = pconn->opcode;
                   frame->utf8_state = 0;
+                  pconn->rsv1       = rsv1;
                   }
-               else if (frame->fin ||
-                        ((opcode = frame->opcode) == 0))
+               else if (rsv1       ||
+                        frame->fin ||
+                        (pconn->opcode = frame->opcode) == 0)
                   {
-                  // framing_state = DATA_FRAMING_CLOSE; // 6
-
                   U_RETURN(status_code = STATUS_CODE_PROTOCOL_ERROR);
                   }
 
-               frame->fin = fin;
+               frame->fin = pconn->fin;
                }
 
-            payload_length                 = 0;
-            payload_length_bytes_remaining = 0;
-
-            if (block_offset >= block_size) break; // Only break if we need more data
+            pconn->payload_length                 = 0;
+            pconn->payload_length_bytes_remaining = 0;
             }
-
-         U_INTERNAL_DUMP("framing_state = %d", framing_state)
+         break;
 
          case DATA_FRAMING_PAYLOAD_LENGTH: // 2
             {
-            payload_length = FRAME_GET_PAYLOAD_LEN(block[block_offset]);
-            masking        = FRAME_GET_MASK(       block[block_offset++]);
+            pconn->payload_length = FRAME_GET_PAYLOAD_LEN(block[block_offset]);
+            pconn->masking        = FRAME_GET_MASK(       block[block_offset++]);
 
-            U_INTERNAL_DUMP("masking = %d payload_length = %d", masking, payload_length)
+            U_INTERNAL_DUMP("masking = %d payload_length = %d", pconn->masking, pconn->payload_length)
 
-            if (payload_length == 126)
+            if (pconn->payload_length == 126)
                {
-               payload_length                 = 0;
-               payload_length_bytes_remaining = 2;
+               pconn->payload_length                 = 0;
+               pconn->payload_length_bytes_remaining = 2;
                }
-            else if (payload_length == 127)
+            else if (pconn->payload_length == 127)
                {
-               payload_length                 = 0;
-               payload_length_bytes_remaining = 8;
-               }
-            else
-               {
-               payload_length_bytes_remaining = 0;
+               pconn->payload_length                 = 0;
+               pconn->payload_length_bytes_remaining = 8;
                }
 
-            if ((masking == 0)   || // Client-side mask is required
-                ((opcode >= 0x8) && // Control opcodes cannot have a payload larger than 125 bytes
-                (payload_length_bytes_remaining != 0)))
+            if ((pconn->masking == 0)   || // Client-side mask is required
+                ((pconn->opcode >= 0x8) && // Control opcodes cannot have a payload larger than 125 bytes
+                (pconn->payload_length_bytes_remaining != 0)))
                {
-               // framing_state = DATA_FRAMING_CLOSE; // 6
-
                U_RETURN(status_code = STATUS_CODE_PROTOCOL_ERROR);
                }
 
-            framing_state = DATA_FRAMING_PAYLOAD_LENGTH_EXT; // 3
-
-            if (block_offset >= block_size) break; // Only break if we need more data
+            pconn->framing_state = DATA_FRAMING_PAYLOAD_LENGTH_EXT; // 3
             }
-
-         U_INTERNAL_DUMP("framing_state = %d", framing_state)
+         break;
 
          case DATA_FRAMING_PAYLOAD_LENGTH_EXT: // 3
             {
-            while ((payload_length_bytes_remaining > 0) &&
+            while ((pconn->payload_length_bytes_remaining > 0) &&
                    (block_offset < block_size))
                {
-               payload_length *= 256;
-               payload_length += block[block_offset++];
+               pconn->payload_length *= 256;
+               pconn->payload_length += block[block_offset++];
 
-               payload_length_bytes_remaining--;
+               pconn->payload_length_bytes_remaining--;
                }
 
-            if (payload_length_bytes_remaining == 0)
+            if (pconn->payload_length_bytes_remaining == 0)
                {
-               if ((          payload_length < 0) ||
-                   ((uint32_t)payload_length > max_message_size))
+               if ((          pconn->payload_length < 0) ||
+                   ((uint32_t)pconn->payload_length > max_message_size))
                   {
-                  U_SRV_LOG_WITH_ADDR("Got frame with payload greater than maximum frame buffer size: (%u > %u) from", payload_length, max_message_size);
-
-                  // framing_state = DATA_FRAMING_CLOSE; // 6
+                  U_SRV_LOG_WITH_ADDR("Got frame with payload greater than maximum frame buffer size: (%u > %u) from", pconn->payload_length, max_message_size);
 
                   U_RETURN(status_code = STATUS_CODE_MESSAGE_TOO_LARGE); // Invalid payload length
                   }
 
-               if (masking == 0)
-                  {
-                  framing_state = DATA_FRAMING_EXTENSION_DATA; // 4
-
-                  break;
-                  }
-
-               framing_state = DATA_FRAMING_MASK; // 0
+               pconn->mask_index    = 0;
+               pconn->framing_state = DATA_FRAMING_MASK; // 0
                }
-
-            if (block_offset >= block_size) break; // Only break if we need more data
             }
-
-         U_INTERNAL_DUMP("framing_state = %d", framing_state)
+         break;
 
          case DATA_FRAMING_MASK: // 0
             {
-            U_INTERNAL_DUMP("mask_index = %d", mask_index)
+            U_INTERNAL_DUMP("mask_index = %d", pconn->mask_index)
 
-            while ((mask_index < 4) && (block_offset < block_size)) mask[mask_index++] = block[block_offset++];
+            while ((pconn->mask_index < 4) && (block_offset < block_size)) pconn->mask[pconn->mask_index++] = block[block_offset++];
 
-            U_INTERNAL_DUMP("mask_index = %d", mask_index)
+            U_INTERNAL_DUMP("mask_index = %d", pconn->mask_index)
 
-            if (mask_index != 4) break;
+            if (pconn->mask_index != 4) break;
 
-            mask_index    = 0;
-            mask_offset   = 0;
-            framing_state = DATA_FRAMING_EXTENSION_DATA; // 4
+            pconn->mask_offset = 0;
 
-            if ((mask[0] == 0) &&
-                (mask[1] == 0) &&
-                (mask[2] == 0) &&
-                (mask[3] == 0))
+            if ((pconn->mask[0] == 0) &&
+                (pconn->mask[1] == 0) &&
+                (pconn->mask[2] == 0) &&
+                (pconn->mask[3] == 0))
                {
-               masking = 0;
+               pconn->masking = 0;
                }
 
-            U_INTERNAL_DUMP("masking = %d", masking)
-            }
-
-         // Fall through
+            U_INTERNAL_DUMP("masking = %d", pconn->masking)
 
-         U_INTERNAL_DUMP("framing_state = %d", framing_state)
-
-         case DATA_FRAMING_EXTENSION_DATA: // 4
-            {
             // Deal with extension data when we support them -- FIXME
 
-            U_INTERNAL_DUMP("extension_bytes_remaining = %d", extension_bytes_remaining)
-
-            if (extension_bytes_remaining == 0)
+            if (pconn->payload_length > 0       &&
+                frame == &(pconn->message_frame) &&
+                (uint32_t)pconn->payload_length > (max_message_size - frame->application_data_offset))
                {
-               if (payload_length > 0)
-                  {
-                  (void) UClientImage_Base::wbuffer->reserve(frame->application_data_offset + payload_length);
-
-                  frame->application_data = (unsigned char*) UClientImage_Base::wbuffer->data();
-                  }
+               U_SRV_LOG_WITH_ADDR("Got message greater than maximum frame buffer size: (%u > %u) from", frame->application_data_offset + pconn->payload_length, max_message_size);
 
-               framing_state = DATA_FRAMING_APPLICATION_DATA; // 5
+               U_RETURN(status_code = STATUS_CODE_MESSAGE_TOO_LARGE);
                }
+
+            if (frame == &(pconn->message_frame)) (void) UClientImage_Base::wbuffer->reserve(frame->application_data_offset + pconn->payload_length);
+
+            pconn->framing_state = DATA_FRAMING_APPLICATION_DATA; // 5
             }
 
          // Fall through
 
-         U_INTERNAL_DUMP("framing_state = %d", framing_state)
-
          case DATA_FRAMING_APPLICATION_DATA: // 5
             {
             int32_t block_length      = block_size - block_offset,
-                    block_data_length = (payload_length > block_length ? block_length
-                                                                       : payload_length);
+                    block_data_length = (pconn->payload_length > block_length ? block_length
+                                                                              : pconn->payload_length);
 
             uint32_t       application_data_offset = frame->application_data_offset;
-            unsigned char* application_data        = frame->application_data;
+            unsigned char* application_data        = (frame == &(pconn->control_frame) ? pconn->control_data
+                                                                                       : (unsigned char*)UClientImage_Base::wbuffer->data());
 
-            if (masking)
+            if (block_data_length > 0)
                {
-               int32_t i;
-
-               if (opcode == OPCODE_TEXT)
+               if (pconn->masking)
                   {
-                  unsigned int utf8_state = frame->utf8_state;
-
-                  for (i = 0; i < block_data_length; ++i)
-                     {
-                     unsigned char c = block[block_offset++] ^ mask[mask_offset++ & 3];
-
-                     utf8_state = u_validate_utf8[utf8_state + c];
+                  unmask(application_data + application_data_offset, block + block_offset, block_data_length, pconn->mask, pconn->mask_offset);
 
-                     if (utf8_state == 1)
-                        {
-                        payload_length = block_data_length;
-
-                        break;
-                        }
-
-                     application_data[application_data_offset++] = c;
-                     }
-
-                  frame->utf8_state = utf8_state;
+                  pconn->mask_offset += block_data_length;
                   }
                else
                   {
-                  // Need to optimize the unmasking -- FIXME
-
-                  for (i = 0; i < block_data_length; ++i)
-                     {
-                     application_data[application_data_offset++] = block[block_offset++] ^ mask[mask_offset++ & 3];
-                     }
+                  U_MEMCPY(application_data + application_data_offset, block + block_offset, block_data_length);
                   }
-               }
-            else if (block_data_length > 0)
-               {
-               U_MEMCPY(&application_data[application_data_offset], &block[block_offset], block_data_length);
-               
-               if (opcode == OPCODE_TEXT)
+
+               // NB: the text of a compressed message is validated after the decompression...
+
+               if (pconn->opcode == OPCODE_TEXT &&
+                   pconn->rsv1 == 0)
                   {
                   unsigned int utf8_state = frame->utf8_state;
-                  int32_t i, application_data_end = application_data_offset + block_data_length;
 
-                  for (i = application_data_offset; i < application_data_end; i++)
+                  for (int32_t i = 0; i < block_data_length; ++i)
                      {
-                     utf8_state = u_validate_utf8[utf8_state + application_data[i]];
+                     utf8_state = u_validate_utf8[utf8_state + application_data[application_data_offset + i]];
 
-                     if (utf8_state == 1)
-                        {
-                        payload_length = block_data_length;
-
-                        break;
-                        }
+                     if (utf8_state == 1) break;
                      }
 
                   frame->utf8_state = utf8_state;
+
+                  if (utf8_state == 1) U_RETURN(status_code = STATUS_CODE_INVALID_UTF8);
                   }
 
                           block_offset += block_data_length;
                application_data_offset += block_data_length;
                }
 
-            payload_length -= block_data_length;
+            frame->application_data_offset = application_data_offset;
+
+            if ((pconn->payload_length -= block_data_length) > 0) break; // Only break if we need more data
 
-            if (payload_length == 0)
-               {
-               message_type = MESSAGE_TYPE_INVALID;
+            pconn->framing_state = DATA_FRAMING_START; // 1
 
-               switch (opcode)
-                  {
-                  case OPCODE_TEXT:
-                     {
-                     if ((fin &&
-                         (frame->utf8_state != 0)) ||
-                         (frame->utf8_state == 1))
-                        {
-                        // framing_state = DATA_FRAMING_CLOSE; // 6
+            message_type = MESSAGE_TYPE_INVALID;
 
-                        U_RETURN(status_code = STATUS_CODE_INVALID_UTF8);
-                        }
+#        ifdef USE_LIBZ
+            if (pconn->fin  &&
+                pconn->rsv1 &&
+                pconn->opcode < 0x8)
+               {
+               int result = inflateMessage(pconn, application_data_offset);
 
-                     message_type = MESSAGE_TYPE_TEXT;
-                     }
-                  break;
+               if (result) U_RETURN(status_code = result);
 
-                  case OPCODE_BINARY: message_type = MESSAGE_TYPE_BINARY; break;
+               application_data        = (unsigned char*)UClientImage_Base::wbuffer->data();
+               application_data_offset =                 UClientImage_Base::wbuffer->size();
 
-                  case OPCODE_CLOSE:
+               if (pconn->opcode == OPCODE_TEXT)
+                  {
+                  unsigned int utf8_state = 0;
+
+                  for (uint32_t i = 0; i < application_data_offset; ++i)
                      {
-                     // framing_state = DATA_FRAMING_CLOSE; // 6
+                     utf8_state = u_validate_utf8[utf8_state + application_data[i]];
 
-                     U_RETURN(status_code = STATUS_CODE_OK);
+                     if (utf8_state == 1) break;
                      }
 
-                  case OPCODE_PING:
+                  frame->utf8_state = utf8_state;
+                  }
+               }
+#        endif
+
+            switch (pconn->opcode)
+               {
+               case OPCODE_TEXT:
+                  {
+                  if (pconn->fin &&
+                      frame->utf8_state != 0)
                      {
-                     (void) sendData(MESSAGE_TYPE_PONG, application_data, application_data_offset);
+                     U_RETURN(status_code = STATUS_CODE_INVALID_UTF8);
                      }
-                  break;
 
-                  case OPCODE_PONG: break;
+                  message_type = MESSAGE_TYPE_TEXT;
+                  }
+               break;
 
-                  default:
-                     {
-                     // framing_state = DATA_FRAMING_CLOSE; // 6
+               case OPCODE_BINARY: message_type = MESSAGE_TYPE_BINARY; break;
 
-                     U_RETURN(status_code = STATUS_CODE_PROTOCOL_ERROR);
-                     }
+               case OPCODE_CLOSE:
+                  {
+                  message_type = MESSAGE_TYPE_CLOSE;
+
+                  U_RETURN(status_code = STATUS_CODE_OK);
                   }
 
-               if (fin)
+               case OPCODE_PING:
                   {
-                  U_INTERNAL_DUMP("framing_state = %d message_type = %d status_code = %d", framing_state, message_type, status_code)
+                  if (sendData(MESSAGE_TYPE_PONG, application_data, application_data_offset) == false) U_RETURN(status_code = STATUS_CODE_INTERNAL_ERROR);
+                  }
+               break;
 
-                  if (message_type != MESSAGE_TYPE_INVALID)
-                     {
-                     U_INTERNAL_ASSERT_EQUALS(framing_state, DATA_FRAMING_APPLICATION_DATA)
+               case OPCODE_PONG: break;
 
-                     UClientImage_Base::wbuffer->size_adjust_force(application_data_offset);
+               default: U_RETURN(status_code = STATUS_CODE_PROTOCOL_ERROR);
+               }
 
-                     U_SRV_LOG_WITH_ADDR("received websocket data (%u+%u bytes) %V from",
-                                             ncount - UClientImage_Base::wbuffer->size(),
-                                                      UClientImage_Base::wbuffer->size(), UClientImage_Base::wbuffer->rep)
+            if (pconn->fin &&
+                message_type != MESSAGE_TYPE_INVALID)
+               {
+               frame->application_data_offset = 0;
 
-                     U_RETURN(status_code = STATUS_CODE_OK);
-                     }
+               UClientImage_Base::wbuffer->size_adjust_force(application_data_offset);
 
-                  frame->application_data        = 0;
-                         application_data_offset = 0;
-                  }
+               U_SRV_LOG_WITH_ADDR("received websocket data (%u bytes) %V from", application_data_offset, UClientImage_Base::wbuffer->rep)
 
-               framing_state = DATA_FRAMING_START; // 1
+               U_RETURN(status_code = STATUS_CODE_OK);
                }
 
-            frame->application_data_offset = application_data_offset;
+            pconn->opcode = 0;
             }
          break;
 
-      // case DATA_FRAMING_CLOSE: block_offset = block_size; break;
+         default: U_RETURN(status_code = STATUS_CODE_PROTOCOL_ERROR);
+         }
+      }
 
-         default:
-            {
-            // framing_state = DATA_FRAMING_CLOSE; // 6
+   U_RETURN(0);
+}
+
+int UWebSocket::handleDataFraming(USocket* socket)
+{
+   U_TRACE(0, "UWebSocket::handleDataFraming(%p)", socket)
+
+   int result;
+   uint32_t block_offset;
+
+   // NB: the state of the connection is reset by checkForInitialData(), here we must keep the context of permessage-deflate between the messages...
 
-            U_RETURN(status_code = STATUS_CODE_PROTOCOL_ERROR);
+   while (true)
+      {
+      if (rbuffer->empty() &&
+          USocketExt::read(socket, *rbuffer, U_SINGLE_READ, UServer_Base::timeoutMS) == false)
+         {
+         U_RETURN(STATUS_CODE_INTERNAL_ERROR);
+         }
+
+      block_offset = 0;
+
+      result = handleDataFraming(&blocking, (const unsigned char*)rbuffer->data(), rbuffer->size(), block_offset);
+
+      // NB: we keep the data after the message for the next call...
+
+           if (block_offset >= rbuffer->size()) rbuffer->setEmpty();
+      else if (block_offset)                     rbuffer->moveToBeginDataInBuffer(block_offset);
+
+      if (result)
+         {
+         if (result == STATUS_CODE_OK &&
+             message_type == MESSAGE_TYPE_CLOSE)
+            {
+            U_RETURN(STATUS_CODE_GOING_AWAY);
             }
+
+         U_RETURN(result);
          }
       }
-   while (block_offset < block_size);
+}
+
+int UWebSocket::processData(WebSocketConnection* pconn, const char* ptr, uint32_t sz)
+{
+   U_TRACE(0, "UWebSocket::processData(%p,%.*S,%u)", pconn, sz, ptr, sz)
+
+   U_INTERNAL_ASSERT_POINTER(on_message)
+
+   int result;
+   uint32_t block_offset = 0;
+
+   if (pconn->message)
+      {
+      UClientImage_Base::wbuffer->swap(*(pconn->message));
+
+      delete pconn->message;
+             pconn->message = 0;
+      }
 
-   U_INTERNAL_ASSERT(block_offset >= block_size)
-   U_INTERNAL_ASSERT_DIFFERS(framing_state, DATA_FRAMING_CLOSE) // 6
+   while (block_offset < sz)
+      {
+      result = handleDataFraming(pconn, (const unsigned char*)ptr, sz, block_offset);
 
-   rbuffer->setEmpty();
+      if (result == 0) break;
 
-   goto loop;
+      if (result != STATUS_CODE_OK ||
+          message_type == MESSAGE_TYPE_CLOSE)
+         {
+         goto close;
+         }
+
+      U_http_info.nResponseCode = 0;
+
+      on_message(0);
+
+      if (U_http_info.nResponseCode == HTTP_INTERNAL_ERROR ||
+          UServer_Base::csocket->isClosed())
+         {
+         goto close;
+         }
+
+      UClientImage_Base::wbuffer->setBuffer(U_CAPACITY);
+      }
+
+   // NB: we keep the data of a message not yet complete (and nothing for an idle connection) until the next read...
+
+   if (pconn->message_frame.application_data_offset)
+      {
+      UClientImage_Base::wbuffer->size_adjust_force(pconn->message_frame.application_data_offset);
+
+      U_NEW(UString, pconn->message, UString);
+
+      pconn->message->swap(*UClientImage_Base::wbuffer);
+      }
+   else
+      {
+      UClientImage_Base::wbuffer->setEmpty();
+      }
+
+   U_RETURN(U_PLUGIN_HANDLER_FINISHED);
+
+close:
+   // Send server-side closing handshake
+
+   if (UServer_Base::csocket->isOpen()) (void) sendClose();
+
+   UClientImage_Base::close();
+
+   U_RETURN(U_PLUGIN_HANDLER_ERROR);
 }
 
-bool UWebSocket::sendData(int type, const unsigned char* buffer, uint32_t buffer_size)
+int UWebSocket::initConnection()
 {
-   U_TRACE(0, "UWebSocket::sendData(%d,%p,%u)", type, buffer, buffer_size)
+   U_TRACE_NO_PARAM(0, "UWebSocket::initConnection()")
+
+   U_INTERNAL_ASSERT_POINTER(vconnection)
+   U_INTERNAL_ASSERT_MAJOR(UClientImage_Base::size_request, 0)
+
+   uint32_t idx = (UServer_Base::pClientImage - UServer_Base::vClientImage),
+            sz  = UClientImage_Base::rbuffer->size(),
+            pos = UClientImage_Base::size_request;
+
+   U_INTERNAL_DUMP("idx = %u", idx)
+
+   U_INTERNAL_ASSERT_MINOR(idx, UNotifier::max_connection)
+
+   WebSocketConnection* pconn = vconnection + idx;
+
+   resetConnection(pconn);
+
+   // NB: from now the data read on this connection are routed by UHTTP::handlerREAD() to handlerRequest() and the connection is not closed for inactivity...
+
+   U_ClientImage_http(UServer_Base::pClientImage) = 'W';
+   U_ClientImage_idle(UServer_Base::pClientImage) = U_YES;
+
+   if (U_ClientImage_pipeline) UClientImage_Base::resetPipeline();
+
+   UClientImage_Base::setRequestProcessed();
+
+   UClientImage_Base::wbuffer->setBuffer(U_CAPACITY); // NB: it contains the response of handshake...
+
+   U_INTERNAL_DUMP("pos = %u UClientImage_Base::rbuffer(%u) = %V", pos, sz, UClientImage_Base::rbuffer->rep)
+
+   // check if we have read more data than necessary...
+
+   if (pos < sz &&
+       processData(pconn, UClientImage_Base::rbuffer->c_pointer(pos), sz - pos) == U_PLUGIN_HANDLER_ERROR)
+      {
+      U_RETURN(U_PLUGIN_HANDLER_ERROR);
+      }
+
+   UClientImage_Base::size_request = 0;
+
+   U_RETURN(U_PLUGIN_HANDLER_FINISHED);
+}
+
+int UWebSocket::handlerRequest()
+{
+   U_TRACE_NO_PARAM(0, "UWebSocket::handlerRequest()")
+
+   U_INTERNAL_ASSERT_POINTER(vconnection)
+   U_INTERNAL_ASSERT_EQUALS(U_ClientImage_http(UServer_Base::pClientImage), 'W')
+
+   uint32_t idx = (UServer_Base::pClientImage - UServer_Base::vClientImage);
+
+   U_INTERNAL_DUMP("idx = %u", idx)
+
+   U_INTERNAL_ASSERT_MINOR(idx, UNotifier::max_connection)
+
+   int result = processData(vconnection + idx, U_STRING_TO_PARAM(*UClientImage_Base::rbuffer));
+
+   UClientImage_Base::size_request = 0; // NB: to avoid the check for pipeline...
+
+   UClientImage_Base::setRequestProcessed();
+
+   U_RETURN(result);
+}
+
+void UWebSocket::handlerDelete(UClientImage_Base* pclient)
+{
+   U_TRACE(0, "UWebSocket::handlerDelete(%p)", pclient)
+
+   U_INTERNAL_ASSERT_POINTER(vconnection)
+
+   uint32_t idx = (pclient - UServer_Base::vClientImage);
+
+   U_INTERNAL_DUMP("idx = %u", idx)
+
+   U_INTERNAL_ASSERT_MINOR(idx, UNotifier::max_connection)
+
+   WebSocketConnection* pconn = vconnection + idx;
+
+   if (pconn->message)
+      {
+      delete pconn->message;
+             pconn->message = 0;
+      }
+}
+
+uint32_t UWebSocket::setFrameHeader(unsigned char* header, int type, uint32_t payload_length)
+{
+   U_TRACE(0, "UWebSocket::setFrameHeader(%p,%d,%u)", header, type, payload_length)
 
    uint32_t pos = 0;
-   unsigned char opcode, header[32];
-   uint32_t payload_length = (buffer ? buffer_size : 0);
+   unsigned char opcode;
 
    switch (type)
       {
@@ -588,10 +1161,63 @@ bool UWebSocket::sendData(int type, const unsigned char* buffer, uint32_t buffer
       header[pos++] = FRAME_SET_LENGTH(payload_length, 0);
       }
 
-   U_SRV_LOG_WITH_ADDR("send websocket data (%u+%u bytes) %.*S to", pos, buffer_size, buffer_size, buffer)
+   U_RETURN(pos);
+}
+
+__pure UWebSocket::WebSocketConnection* UWebSocket::getConnection()
+{
+   U_TRACE_NO_PARAM(0, "UWebSocket::getConnection()")
+
+   if (vconnection &&
+       U_ClientImage_http(UServer_Base::pClientImage) == 'W')
+      {
+      uint32_t idx = (UServer_Base::pClientImage - UServer_Base::vClientImage);
+
+      U_INTERNAL_DUMP("idx = %u", idx)
+
+      U_INTERNAL_ASSERT_MINOR(idx, UNotifier::max_connection)
+
+      U_RETURN_POINTER(vconnection + idx, WebSocketConnection);
+      }
+
+   U_RETURN_POINTER(&blocking, WebSocketConnection);
+}
+
+bool UWebSocket::sendData(int type, const unsigned char* buffer, uint32_t buffer_size)
+{
+   U_TRACE(0, "UWebSocket::sendData(%d,%p,%u)", type, buffer, buffer_size)
+
+   unsigned char header[32];
+   const unsigned char* payload = buffer;
+   uint32_t payload_length = (buffer ? buffer_size : 0), pos;
+   bool brsv1 = false;
+
+#ifdef USE_LIBZ
+   if (payload_length >= DEFLATE_MIN_SIZE &&
+       (type == MESSAGE_TYPE_TEXT   ||
+        type == MESSAGE_TYPE_BINARY ||
+        type == MESSAGE_TYPE_INVALID))
+      {
+      WebSocketConnection* pconn = getConnection();
+
+      if (pconn->extension &&
+          deflateMessage(pconn, buffer, payload_length))
+         {
+         brsv1          = true;
+         payload        = (const unsigned char*)zbuffer->data();
+         payload_length =                       zbuffer->size();
+         }
+      }
+#endif
+
+   pos = setFrameHeader(header, type, payload_length);
+
+   if (brsv1) header[0] |= FRAME_SET_RSV1(1);
+
+   U_SRV_LOG_WITH_ADDR("send websocket data (%u+%u bytes) %.*S to", pos, payload_length, buffer_size, buffer)
 
-   struct iovec iov[2] = { { (caddr_t)header, pos },
-                           { (caddr_t)buffer, payload_length } };
+   struct iovec iov[2] = { { (caddr_t)header,  pos },
+                           { (caddr_t)payload, payload_length } };
 
    int iBytesWrite = (payload_length
             ? (pos += payload_length, USocketExt::writev(UServer_Base::csocket, iov, 2,              pos, UServer_Base::timeoutMS))
@@ -12,7 +12,147 @@
 #define U_DECODE  0
 #define U_BUFLEN  4096
 
-static const char* usage = "Usage: test_gzio [-d]\n";
+static const char* usage = "Usage: test_gzio [-d | -s | -c]\n";
+
+#ifdef USE_LIBZ
+static void do_stream(int fd)
+{
+   z_stream stream;
+   uint32_t i, n, readlen;
+   char  buf[U_BUFLEN];
+   char ebuf[U_BUFLEN * 8];
+
+   U_INTERNAL_TRACE("do_stream(%d)", fd)
+
+   /* NB: the content is feeded in small chunk (with a flush every 4 chunk) but the result must be a single gzip stream... */
+
+   if (u_gz_deflate_init(&stream, u_gz_deflate_level(0), true) == false) exit(1);
+
+   while ((readlen = read(fd, buf, U_BUFLEN)) > 0)
+      {
+      for (i = 0; i < readlen; i += 64)
+         {
+         n = u_gz_deflate_chunk(&stream, buf+i, (readlen-i < 64 ? readlen-i : 64), ebuf, sizeof(ebuf), ((i / 64) % 4) == 3 ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+
+         if (n == U_NOT_FOUND) exit(1);
+
+         write(STDOUT_FILENO, ebuf, n);
+         }
+      }
+
+   n = u_gz_deflate_chunk(&stream, 0, 0, ebuf, sizeof(ebuf), Z_FINISH);
+
+   write(STDOUT_FILENO, ebuf, n);
+
+   u_gz_deflate_end(&stream);
+}
+
+/* NB: the result of the backend (libdeflate or zlib) must be readable by the zlib path, and vice versa... */
+
+static void print_check(const char* name, const char* input, uint32_t size, const char* result, uint32_t n)
+{
+   bool ok = (n == size && memcmp(input, result, size) == 0);
+
+   printf("%-32s %s\n", name, (ok ? "ok" : "FAILED"));
+
+   if (ok == false) exit(1);
+}
+
+static uint32_t do_inflate_chunk(const char* input, uint32_t len, char* result, uint32_t size)
+{
+   z_stream stream;
+   uint32_t j, n, csize = 0;
+
+   U_INTERNAL_TRACE("do_inflate_chunk(%p,%u,%p,%u)", input, len, result, size)
+
+   if (u_gz_inflate_init(&stream) == false) exit(1);
+
+   /* NB: the input arrive in small chunk as from the network... */
+
+   for (j = 0; j < len; j += 64)
+      {
+      n = u_gz_inflate_chunk(&stream, input+j, (len-j < 64 ? len-j : 64), result+csize, size-csize);
+
+      if (n == U_NOT_FOUND) exit(1);
+
+      csize += n;
+
+      while (stream.avail_in)
+         {
+         n = u_gz_inflate_chunk(&stream, 0, 0, result+csize, size-csize);
+
+         if (n == U_NOT_FOUND ||
+             n == 0)
+            {
+            break;
+            }
+
+         csize += n;
+         }
+      }
+
+   u_gz_inflate_end(&stream);
+
+   return csize;
+}
+
+static void do_check(int fd)
+{
+   z_stream stream;
+   struct stat st;
+   char* input;
+   char* result;
+   char* output;
+   uint32_t j, csize, size, bound;
+
+   U_INTERNAL_TRACE("do_check(%d)", fd)
+
+   if (fstat(fd, &st) != 0 || st.st_size == 0) exit(1);
+
+   size   = st.st_size;
+   bound  = size + (size / 10) + 64U;
+   input  = (char*) malloc(size);
+   output = (char*) malloc(bound);
+   result = (char*) malloc(size + 64U);
+
+   if (read(fd, input, size) != (ssize_t)size) exit(1);
+
+   /* backend gzip -> backend */
+
+   csize = u_gz_deflate(input, size, output, true);
+
+   print_check("u_gz_deflate(gzip) -> inflate", input, size, result, u_gz_inflate(output, csize, result));
+
+   /* backend raw deflate -> zlib incremental inflate */
+
+   csize = u_gz_deflate(input, size, output, false);
+
+   print_check("u_gz_deflate(raw) -> chunk", input, size, result, do_inflate_chunk(output, csize, result, size + 64U));
+
+   /* backend raw deflate -> backend (the fallback on zlib for the input without trailer) */
+
+   print_check("u_gz_deflate(raw) -> inflate", input, size, result, u_gz_inflate(output, csize, result));
+
+   /* zlib incremental gzip -> backend */
+
+   if (u_gz_deflate_init(&stream, u_gz_deflate_level(0), true) == false) exit(1);
+
+   for (j = csize = 0; j < size; j += U_BUFLEN)
+      {
+      csize += u_gz_deflate_chunk(&stream, input+j, (size-j < U_BUFLEN ? size-j : U_BUFLEN), output+csize, bound-csize, Z_NO_FLUSH);
+      }
+
+   csize += u_gz_deflate_chunk(&stream, 0, 0, output+csize, bound-csize, Z_FINISH);
+
+   u_gz_deflate_end(&stream);
+
+   print_check("u_gz_deflate_chunk -> inflate", input, size, result, u_gz_inflate(output, csize, result));
+
+   free(input);
+   free(output);
+   free(result);
+}
+#endif
 
 static void do_cipher(int fd, int operation)
 {
@@ -69,6 +209,24 @@ int main(int argc, char* argv[])
       cipher   = U_DECODE;
       filename = argv[2];
       }
+#ifdef USE_LIBZ
+   else if (argc == 3 && strcmp(argv[1], "-s") == 0)
+      {
+      fd = open(argv[2], O_RDONLY | O_BINARY);
+
+      do_stream(fd);
+
+      return 0;
+      }
+   else if (argc == 3 && strcmp(argv[1], "-c") == 0)
+      {
+      fd = open(argv[2], O_RDONLY | O_BINARY);
+
+      do_check(fd);
+
+      return 0;
+      }
+#endif
    else
       {
       fprintf(stderr, "%s", usage);
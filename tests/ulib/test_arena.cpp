@@ -0,0 +1,111 @@
+// test_arena.cpp
+
+#include <ulib/json/value.h>
+#include <ulib/container/hash_map.h>
+
+static UString* wbuffer;        // NB: like UClientImage_Base::wbuffer, it survive the request...
+static UVector<UString*>* vlog; // NB: a vector created out of the region...
+
+static bool bleak;
+
+// NB: like a usp page (ex: json.usp) that start the region and create his temporary objects in the arena...
+
+static void page(uint32_t n)
+{
+   U_TRACE(5, "page(%u)", n)
+
+   UArena::begin();
+
+   UValue json;
+   UString key(U_CONSTANT_TO_PARAM("message")), value(U_CONSTANT_TO_PARAM("Hello, World!")), body(U_CAPACITY);
+   UHashMap<UString> table;
+
+   table.insert(key, value);
+
+   body.snprintf(U_CONSTANT_TO_PARAM("{\"%v\":\"%v\",\"n\":%u}"), key.rep, table[key].rep, n);
+
+   if (json.parse(body) == false) U_ERROR("UValue::parse() failed");
+
+   if (n == 0)
+      {
+      cout << "temporary string in arena: " << UArena::isOwner(key.rep)  << '\n'
+           << "temporary buffer in arena: " << UArena::isOwner(body.rep) << endl;
+      }
+
+   // the growth of an object created out of the region stay in the pool
+
+   UValue::stringify(*wbuffer, json);
+
+   (void) wbuffer->append(U_CONSTANT_TO_PARAM("\n"));
+
+   // NB: the vector grow out of the arena but the element MUST not be a temporary, so it is created out of the region...
+
+   UString* item;
+   bool barena = UArena::suspend(vlog);
+
+   U_NEW(UString, item, UString(n == 0 ? U_STRING_FROM_CONSTANT("first") : U_STRING_FROM_CONSTANT("next")));
+
+   UArena::resume(barena);
+
+   if (UArena::isOwner(item)) bleak = true;
+
+   vlog->push(item);
+
+   table.clear();
+}
+
+int
+U_EXPORT main(int argc, char* argv[])
+{
+   U_ULIB_INIT(argv);
+
+   U_TRACE(5,"main(%d)",argc)
+
+   UArena::init(64 * 1024);
+
+   U_NEW(UString, wbuffer, UString(U_CAPACITY));
+   U_NEW(UVector<UString*>, vlog, UVector<UString*>(2));
+
+   cout << "arena enabled: " << (UArena::pstart != 0) << endl;
+
+   uint32_t i, used = 0;
+
+   for (i = 0; i < 100; ++i)
+      {
+      page(i);
+
+      UArena::end(); // NB: like UHTTP at the end of the usp page...
+
+      if (i == 0)
+         {
+         used = UArena::pcurrent - UArena::pstart;
+
+         cout << "arena used: " << (used > 0) << '\n'
+              << "persistent buffer in arena: " << UArena::isOwner(wbuffer->rep) << endl;
+         }
+      else if ((uint32_t)(UArena::pcurrent - UArena::pstart) != used)
+         {
+         U_ERROR("the usage of the arena change with the same request: %u => %u", used, UArena::pcurrent - UArena::pstart);
+         }
+
+      if (UArena::isUsed()) UArena::reset(); // NB: like UClientImage_Base::endRequest()...
+
+      if (UArena::isUsed()) U_ERROR("UArena::reset() failed");
+      }
+
+   // out of the region the pool is used as usual
+
+   UString after(U_CONSTANT_TO_PARAM("after the request"));
+
+   cout << "string after the request in arena: " << UArena::isOwner(after.rep) << '\n'
+        << "element of persistent vector in arena: " << bleak << '\n'
+        << "vector: " << vlog->size() << ' ' << *(vlog->at(0)) << ' ' << *(vlog->at(99)) << '\n'
+        << "buffer: " << wbuffer->size() << '\n'
+        << wbuffer->substr(0U, wbuffer->find('\n') + 1)
+        << wbuffer->substr(wbuffer->rfind('\n', wbuffer->size() - 2) + 1);
+
+   vlog->clear();
+
+   delete vlog;
+   delete wbuffer;
+}
@@ -154,5 +154,25 @@ int U_EXPORT main(int argc, char* argv[], char* env[])
            es.parseResponse(&json);
 
       if (ok == false) cout << "Failed to delete document" << std::endl;
+
+      // Bulk index
+
+      if (es.setBulk(64 * 1024, 50))
+         {
+         char id[32];
+
+         for (uint32_t i = 1; i <= 100; ++i)
+            {
+            ok = es.bulkIndex(U_CONSTANT_TO_PARAM("twitter"), U_CONSTANT_TO_PARAM("tweet"), id, u__snprintf(id, sizeof(id), U_CONSTANT_TO_PARAM("bulk%u"), i), U_STRING_TO_PARAM(data));
+
+            if (ok == false) cout << "Failed to bulk index document" << std::endl;
+            }
+
+         ok = es.flushBulk();
+
+         if (ok == false) cout << "Failed to flush bulk" << std::endl;
+
+         cout << "Bulk indexed " << es.getBulkIndexed() << std::endl;
+         }
       }
 }
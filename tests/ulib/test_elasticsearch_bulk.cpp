@@ -0,0 +1,300 @@
+// test_elasticsearch_bulk.cpp
+
+#include <ulib/process.h>
+#include <ulib/timeval.h>
+#include <ulib/notifier.h>
+#include <ulib/json/value.h>
+#include <ulib/utility/escape.h>
+#include <ulib/net/client/elasticsearch.h>
+
+#include <poll.h>
+
+#define U_PORT 19200
+
+/**
+ * NB: a stand-in of the _bulk API of ElasticSearch, the status of the document depend on the id:
+ *
+ * retry* => 429 the first time, then 201
+ * bad*   => 400 (permanent failure)
+ * q*     => 201 only if the id is q"uote\ after the decode of the action
+ * busy   => 429 for the whole request the first two time
+ * slow*  => 201 after 300 ms
+ * other  => 201 (400 if the action is not valid JSON)
+ */
+
+static UString* seen;
+static uint32_t nbusy;
+
+static bool isSeen(const UString& id)
+{
+   U_TRACE(5, "isSeen(%V)", id.rep)
+
+   UString key(U_CAPACITY);
+
+   key.snprintf(U_CONSTANT_TO_PARAM("|%v|"), id.rep);
+
+   if (seen->find(key) != U_NOT_FOUND) U_RETURN(true);
+
+   (void) seen->append(key);
+
+   U_RETURN(false);
+}
+
+static void answer(int fd, const char* ptr, uint32_t len)
+{
+   U_TRACE(5, "answer(%d,%.*S,%u)", fd, len, ptr, len)
+
+   UString items(U_CAPACITY), body(U_CAPACITY), response(U_CAPACITY), action, id;
+   bool berrors = false, bslow = false;
+   const char* end = ptr + len;
+   const char* next;
+   uint32_t status;
+
+   while (ptr < end)
+      {
+      next = (const char*) memchr(ptr, '\n', end - ptr);
+
+      action = UString(ptr, next - ptr);
+
+      ptr = (const char*) memchr(next+1, '\n', end - (next+1)) + 1; // NB: skip the document...
+
+      UValue json;
+      UValue* pid;
+
+      if (json.parse(action) == false         ||
+          (pid = json.at(U_CONSTANT_TO_PARAM("index"))) == 0 ||
+          (pid = pid->at(U_CONSTANT_TO_PARAM("_id")))   == 0)
+         {
+         status = 400;
+         }
+      else
+         {
+         id = pid->getString();
+
+         if (id.equal(U_CONSTANT_TO_PARAM("busy")) &&
+             nbusy++ < 2)
+            {
+            (void) response.assign(U_CONSTANT_TO_PARAM("HTTP/1.1 429 Too Many Requests\r\nContent-Length: 0\r\n\r\n"));
+
+            (void) write(fd, response.data(), response.size());
+
+            return;
+            }
+
+              if (u_startsWith(U_STRING_TO_PARAM(id), U_CONSTANT_TO_PARAM("bad")))   status = 400;
+         else if (u_startsWith(U_STRING_TO_PARAM(id), U_CONSTANT_TO_PARAM("q")))
+            {
+            UString decoded(id.size()); // NB: the string of UValue is not decoded...
+
+            UEscape::decode(id, decoded);
+
+            status = (decoded.equal(U_CONSTANT_TO_PARAM("q\"uote\\")) ? 201 : 400);
+            }
+         else if (u_startsWith(U_STRING_TO_PARAM(id), U_CONSTANT_TO_PARAM("retry"))) status = (isSeen(id) ? 201 : 429);
+         else
+            {
+            if (u_startsWith(U_STRING_TO_PARAM(id), U_CONSTANT_TO_PARAM("slow"))) bslow = true;
+
+            status = 201;
+            }
+         }
+
+      if (status != 201) berrors = true;
+
+      items.snprintf_add(U_CONSTANT_TO_PARAM("%.*s{\"index\":{\"status\":%u}}"), (items.empty() ? 0 : 1), ",", status);
+      }
+
+   body.snprintf(U_CONSTANT_TO_PARAM("{\"took\":1,\"errors\":%s,\"items\":[%v]}"), (berrors ? "true" : "false"), items.rep);
+
+   response.snprintf(U_CONSTANT_TO_PARAM("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %u\r\n\r\n%v"), body.size(), body.rep);
+
+   if (bslow) UTimeVal::nanosleep(300);
+
+   (void) write(fd, response.data(), response.size());
+}
+
+static void server(int listenfd)
+{
+   U_TRACE(5, "server(%d)", listenfd)
+
+   // NB: a poll loop, the client keep open the connection of the other API while the bulk use a dedicated connection...
+
+   int fd, n;
+   nfds_t nfds = 1;
+   struct pollfd fds[8];
+   UString request[8];
+
+   U_NEW(UString, seen, UString(U_CAPACITY));
+
+   fds[0].fd     = listenfd;
+   fds[0].events = POLLIN;
+
+   while (poll(fds, nfds, -1) > 0)
+      {
+      if ((fds[0].revents & POLLIN) &&
+          nfds < 8                  &&
+          (fd = accept(listenfd, 0, 0)) != -1)
+         {
+         fds[nfds].fd      = fd;
+         fds[nfds].events  = POLLIN;
+         fds[nfds].revents = 0; // NB: the connection of the other API is idle, a read() on it block...
+
+         request[nfds++].setBuffer(U_CAPACITY);
+         }
+
+      for (nfds_t i = 1; i < nfds; ++i)
+         {
+         if (fds[i].revents == 0) continue;
+
+         UString& buffer = request[i];
+
+         if (buffer.space() < 4096) UString::_reserve(buffer, 4096);
+
+         if ((n = read(fds[i].fd, buffer.pend(), buffer.space())) <= 0)
+            {
+            (void) close(fds[i].fd);
+
+            fds[i].fd = -1; // NB: ignored by poll()...
+
+            continue;
+            }
+
+         buffer.size_adjust(buffer.size() + n);
+
+         // POST /_bulk HTTP/1.1\r\n...Content-Length: 123\r\n\r\n...
+
+         const char* ptr = buffer.data();
+         uint32_t sz = buffer.size(), endHeader = u_findEndHeader1(ptr, sz);
+
+         if (endHeader == U_NOT_FOUND) continue;
+
+         const char* value = (const char*) u_find(ptr, endHeader, U_CONSTANT_TO_PARAM("Content-Length: "));
+
+         uint32_t clen = (value ? strtoul(value + U_CONSTANT_SIZE("Content-Length: "), 0, 10) : 0);
+
+         if ((sz - endHeader) < clen) continue;
+
+         answer(fds[i].fd, ptr + endHeader, clen);
+
+         buffer.setBuffer(U_CAPACITY);
+         }
+      }
+}
+
+static long getMilliSecond()
+{
+   U_TRACE_NO_PARAM(5, "getMilliSecond()")
+
+   u_gettimenow();
+
+   U_RETURN(u_now->tv_sec * 1000L + u_now->tv_usec / 1000L);
+}
+
+static bool bulkIndex(UElasticSearchClient& es, const char* id, uint32_t id_len)
+{
+   U_TRACE(5, "bulkIndex(%p,%.*S,%u)", &es, id_len, id, id_len)
+
+   return es.bulkIndex(U_CONSTANT_TO_PARAM("twitter"), U_CONSTANT_TO_PARAM("tweet"), id, id_len, U_CONSTANT_TO_PARAM("{\n\"user\":\"kimchy\"\n}"));
+}
+
+int
+U_EXPORT main(int argc, char* argv[])
+{
+   U_ULIB_INIT(argv);
+
+   U_TRACE(5,"main(%d)",argc)
+
+   UTCPSocket listener(false);
+
+   if (listener.setServer(U_PORT) == false) U_ERROR("setServer() failed");
+
+   listener.reusePort(O_RDWR); // NB: with SO_REUSEPORT the bind() and the listen() are done here...
+
+   UProcess x;
+
+   if (x.fork() &&
+       x.parent() == false)
+      {
+      server(listener.getFd());
+
+      U_EXIT(0);
+      }
+
+   // NB: we don't close the listener, USocket::close() call shutdown() that stop also the accept() of the child...
+
+   long start;
+   UElasticSearchClient es;
+
+   if (es.connect("127.0.0.1", U_PORT) == false ||
+       es.setBulk(64 * 1024, 4, 60 * 1000) == false)
+      {
+      U_ERROR("connect to the stand-in server failed");
+      }
+
+   // partial failure: one document is retried (429) with backoff and one is rejected (400)
+
+   start = getMilliSecond();
+
+   (void) bulkIndex(es, U_CONSTANT_TO_PARAM("ok1"));
+   (void) bulkIndex(es, U_CONSTANT_TO_PARAM("retry1"));
+   (void) bulkIndex(es, U_CONSTANT_TO_PARAM("bad1"));
+   (void) bulkIndex(es, U_CONSTANT_TO_PARAM("ok2"));
+
+   bool ok = es.flushBulk();
+
+   cout << "partial failure: indexed " << es.getBulkIndexed() << " failed " << es.getBulkFailed() << " flush " << ok << '\n'
+        << "backoff of the document: " << (getMilliSecond() - start >= (long)U_ES_BULK_BACKOFF_MS) << endl;
+
+   // the name and the id must be escaped in the action (else the stand-in answer 400)
+
+   (void) bulkIndex(es, U_CONSTANT_TO_PARAM("q\"uote\\"));
+
+   ok = es.flushBulk();
+
+   cout << "escape: indexed " << es.getBulkIndexed() << " failed " << es.getBulkFailed() << " flush " << ok << endl;
+
+   // the whole request rejected (429) two time: the backoff is exponential (100 + 200 ms)
+
+   start = getMilliSecond();
+
+   (void) bulkIndex(es, U_CONSTANT_TO_PARAM("busy"));
+
+   ok = es.flushBulk();
+
+   cout << "request overloaded: indexed " << es.getBulkIndexed() << " failed " << es.getBulkFailed() << " flush " << ok << '\n'
+        << "backoff of the request: " << (getMilliSecond() - start >= (long)(U_ES_BULK_BACKOFF_MS * 3)) << endl;
+
+   // backpressure: with event loop and the queue full (2 body) the bulkIndex() wait the response of the body in flight
+
+   UNotifier::max_connection = 10;
+
+   UNotifier::init();
+
+   UElasticSearchClient es1;
+
+   if (es1.connect("127.0.0.1", U_PORT) == false ||
+       es1.setBulk(64 * 1024, 1, 60 * 1000, 2) == false)
+      {
+      U_ERROR("connect to the stand-in server failed");
+      }
+
+   start = getMilliSecond();
+
+   (void) bulkIndex(es1, U_CONSTANT_TO_PARAM("slow1"));
+   (void) bulkIndex(es1, U_CONSTANT_TO_PARAM("slow2"));
+
+   long queued = getMilliSecond() - start;
+
+   (void) bulkIndex(es1, U_CONSTANT_TO_PARAM("slow3"));
+
+   long blocked = getMilliSecond() - start;
+
+   ok = es1.flushBulk();
+
+   cout << "backpressure: queued without wait " << (queued < 150) << " blocked " << (blocked >= 250) << '\n'
+        << "backpressure: indexed " << es1.getBulkIndexed() << " failed " << es1.getBulkFailed() << " flush " << ok << endl;
+
+   UProcess::kill(x.pid(), SIGTERM);
+
+   x.wait();
+}
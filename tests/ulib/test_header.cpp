@@ -60,4 +60,33 @@ U_EXPORT main (int argc, char* argv[], char* env[])
    U_ASSERT( y == U_STRING_FROM_CONSTANT("Basic realm=\"WallyWorld\"") )
 
    cout << h << endl;
+
+   // short header names and values are served by the small string rep (see UStringRep::create()): same result of the parse...
+
+   UString s((void*)U_CONSTANT_TO_PARAM("Content-Length"));
+
+   U_ASSERT_EQUALS( s.capacity(), U_CAPACITY_SMALL )
+
+   (void) s.append(U_CONSTANT_TO_PARAM(": 1200 (more than the capacity of the small string rep)"));
+
+   U_ASSERT( s == U_STRING_FROM_CONSTANT("Content-Length: 1200 (more than the capacity of the small string rep)") )
+   U_ASSERT( s.capacity() > U_CAPACITY_SMALL )
+
+   s.size_adjust(U_CONSTANT_SIZE("Content-Length"));
+
+   U_ASSERT( s.shrink() )
+   U_ASSERT( s == U_STRING_FROM_CONSTANT("Content-Length") )
+   U_ASSERT_EQUALS( s.capacity(), U_CAPACITY_SMALL )
+
+   UMimeHeader h3;
+   h3.setIgnoreCase(true);
+
+   n  = h3.parse(UString((void*)U_STRING_TO_PARAM(h1)));
+   n += h3.parse(UString((void*)U_STRING_TO_PARAM(h2)));
+
+   U_ASSERT( n == 18 )
+   U_ASSERT( h3.getHeader(U_STRING_FROM_CONSTANT("Set-COOkie2"))      == x )
+   U_ASSERT( h3.getHeader(U_STRING_FROM_CONSTANT("WWW-AutHENTIcate")) == y )
+   U_ASSERT( h3.getHeader(U_STRING_FROM_CONSTANT("Content-Length"))   == U_STRING_FROM_CONSTANT("1200") )
+   U_ASSERT( h3.getHeader(U_STRING_FROM_CONSTANT("ETag"))             == h.getHeader(U_STRING_FROM_CONSTANT("ETag")) )
 }
@@ -667,6 +667,27 @@ U_EXPORT main (int argc, char* argv[], char* env[])
 
    cerr.write(buffer, u__snprintf(buffer, sizeof(buffer), U_CONSTANT_TO_PARAM("# Time Consumed with              jreadArrayStep() = %4ld ms\n"), crono.getTimeElapsed()));
 
+   // parse with many short keys (small string rep, see UStringRep::create()): same values of jread() and a stable output...
+
+   U_ASSERT( json.parse(exampleJson) )
+
+   UString output = json.output();
+
+   U_ASSERT( json.at(U_CONSTANT_TO_PARAM("astring"))->getString() == U_STRING_FROM_CONSTANT("This is a string") )
+
+   result.clear();
+
+   (void) UValue::jread(output, U_STRING_FROM_CONSTANT("{'anObject'"), result);
+
+   U_ASSERT( result == U_STRING_FROM_CONSTANT("{\"one\":1,\"two\":{\"obj2.1\":21,\"obj2.2\":22},\"three\":333}") )
+
+   json.clear();
+
+   U_ASSERT( json.parse(output) )
+   U_ASSERT( json.output() == output )
+
+   json.clear();
+
    UString searchJson = U_STRING_FROM_CONSTANT("{\"took\":1,\"timed_out\":false,\"_shards\":{\"total\":1,\"successful\":1,\"failed\":0},"
                                                "\"hits\":{\"total\":1,\"max_score\":1.0,\"hits\":[{\"_index\":\"tfb\",\"_type\":\"world\",\"_id\":\"6464\",\"_score\":1.0,"
                                                "\"_source\":{ \"randomNumber\" : 9342 }}]}}");
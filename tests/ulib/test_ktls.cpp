@@ -0,0 +1,169 @@
+// test_ktls.cpp
+
+#include <ulib/ssl/net/sslsocket.h>
+
+#include <netinet/in.h>
+
+// NB: the kernel TLS offload depend from the kernel (tls ULP) and from the negotiated cipher, so the output is the same
+//     on every machine: we check that the state reported by enableKTLS() and by the connection is the real one...
+
+static bool isULPAvailable()
+{
+   U_TRACE_NO_PARAM(5, "isULPAvailable()")
+
+   char buffer[256] = { '\0' };
+   FILE* fp = fopen("/proc/sys/net/ipv4/tcp_available_ulp", "r"); // NB: after the probe of enableKTLS() the module tls is loaded (if it exists)...
+
+   if (fp)
+      {
+      if (fgets(buffer, sizeof(buffer), fp) == 0) buffer[0] = '\0';
+
+      (void) fclose(fp);
+      }
+
+   for (char* word = strtok(buffer, " \n"); word; word = strtok(0, " \n"))
+      {
+      if (strcmp(word, "tls") == 0) return true;
+      }
+
+   return false;
+}
+
+static bool handshake(SSL* server, SSL* client)
+{
+   U_TRACE(5, "handshake(%p,%p)", server, client)
+
+   // NB: the sockets are non blocking, so we can do the two side of the handshake in the same thread...
+
+   int r1 = 0, r2 = 0;
+
+   for (int i = 0; i < 1000 && (r1 != 1 || r2 != 1); ++i)
+      {
+      if (r1 != 1) r1 = SSL_accept(server);
+      if (r2 != 1) r2 = SSL_connect(client);
+
+      if (r1 != 1 && SSL_get_error(server, r1) != SSL_ERROR_WANT_READ && SSL_get_error(server, r1) != SSL_ERROR_WANT_WRITE) break;
+      if (r2 != 1 && SSL_get_error(client, r2) != SSL_ERROR_WANT_READ && SSL_get_error(client, r2) != SSL_ERROR_WANT_WRITE) break;
+
+      if (r1 != 1 || r2 != 1) (void) usleep(1000);
+      }
+
+   return (r1 == 1 && r2 == 1);
+}
+
+static int transfer(SSL* from, SSL* to, const char* msg, char* buffer, int size)
+{
+   U_TRACE(5, "transfer(%p,%p,%S,%p,%d)", from, to, msg, buffer, size)
+
+   int n = -1;
+
+   if (SSL_write(from, msg, strlen(msg)) == (int)strlen(msg))
+      {
+      for (int i = 0; i < 1000 && (n = SSL_read(to, buffer, size - 1)) <= 0; ++i) (void) usleep(1000);
+
+      if (n > 0) buffer[n] = '\0';
+      }
+
+   return n;
+}
+
+int
+U_EXPORT main(int argc, char* argv[])
+{
+   U_ULIB_INIT(argv);
+
+   U_TRACE(5,"main(%d)",argc)
+
+   // NB: the key of the test CA is 1024 bit (RSA) with a signature SHA1, so we need the security level 0...
+
+   SSL_CTX* sctx = SSL_CTX_new(SSLv23_server_method());
+   SSL_CTX* cctx = SSL_CTX_new(SSLv23_client_method());
+
+   SSL_CTX_set_security_level(sctx, 0);
+   SSL_CTX_set_security_level(cctx, 0);
+
+   // NB: a cipher that the kernel support (AES-GCM with TLS 1.2)...
+
+   (void) SSL_CTX_set_max_proto_version(sctx, TLS1_2_VERSION);
+   (void) SSL_CTX_set_cipher_list(sctx, "ECDHE-RSA-AES128-GCM-SHA256");
+
+   SSL_CTX_set_default_passwd_cb_userdata(sctx, (void*)"caciucco");
+
+   if (SSL_CTX_use_certificate_file(sctx, "CA/server.crt", SSL_FILETYPE_PEM) != 1 ||
+       SSL_CTX_use_PrivateKey_file( sctx, "CA/server.key", SSL_FILETYPE_PEM) != 1)
+      {
+      U_ERROR("SSL: certificate of the server not loaded");
+      }
+
+   bool bktls = USSLSocket::enableKTLS(sctx);
+
+   cout << "probe consistent with the kernel: " << (bktls == isULPAvailable()) << endl;
+
+#ifdef U_USE_KTLS
+   cout << "option consistent with the probe: " << (bktls == ((SSL_CTX_get_options(sctx) & SSL_OP_ENABLE_KTLS) != 0)) << endl;
+#else
+   cout << "option consistent with the probe: " << (bktls == false) << endl;
+#endif
+
+   // a TLS connection on loopback (kTLS need a TCP socket)
+
+   struct sockaddr_in addr;
+   socklen_t len = sizeof(addr);
+
+   (void) memset(&addr, 0, sizeof(addr));
+
+   addr.sin_family      = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+   int lfd = socket(AF_INET, SOCK_STREAM, 0),
+       cfd = socket(AF_INET, SOCK_STREAM, 0), sfd;
+
+   if (bind(lfd, (struct sockaddr*)&addr, sizeof(addr))  != 0 ||
+       listen(lfd, 1)                                     != 0 ||
+       getsockname(lfd, (struct sockaddr*)&addr, &len)    != 0 ||
+       connect(cfd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+       (sfd = accept(lfd, 0, 0)) == -1)
+      {
+      U_ERROR("loopback connection failed");
+      }
+
+   (void) fcntl(sfd, F_SETFL, O_NONBLOCK);
+   (void) fcntl(cfd, F_SETFL, O_NONBLOCK);
+
+   SSL* server = SSL_new(sctx);
+   SSL* client = SSL_new(cctx);
+
+   (void) SSL_set_fd(server, sfd);
+   (void) SSL_set_fd(client, cfd);
+
+   bool bhandshake = handshake(server, client);
+
+   cout << "handshake: " << bhandshake << endl;
+
+   if (bhandshake == false) ERR_print_errors_fp(stderr);
+
+   bool bactive = false;
+
+#ifdef U_USE_KTLS
+   bactive = (BIO_get_ktls_send(SSL_get_wbio(server)) != 0);
+#endif
+
+   // NB: without the tls ULP the offload cannot be active, with it depend from the kernel (cipher)...
+
+   cout << "connection consistent with the probe: " << (bktls || bactive == false) << endl;
+
+   char buffer[256];
+
+   if (transfer(server, client, "Hello from server", buffer, sizeof(buffer)) > 0) cout << "client read: " << buffer << endl;
+   if (transfer(client, server, "Hello from client", buffer, sizeof(buffer)) > 0) cout << "server read: " << buffer << endl;
+
+   SSL_free(server);
+   SSL_free(client);
+
+   (void) close(sfd);
+   (void) close(cfd);
+   (void) close(lfd);
+
+   SSL_CTX_free(sctx);
+   SSL_CTX_free(cctx);
+}
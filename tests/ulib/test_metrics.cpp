@@ -0,0 +1,84 @@
+// test_metrics.cpp
+
+#include <ulib/utility/metrics.h>
+#include <ulib/net/server/server.h>
+
+static void checkBucket(uint64_t value)
+{
+   U_TRACE(5, "checkBucket(%llu)", value)
+
+   uint32_t idx   = UMetrics::getBucket(value);
+   uint64_t limit = UMetrics::getBucketLimit(idx);
+
+   // the value is in [limit of the previous bucket, limit) and the width of the bucket is at most 1/8 of the value
+
+   if (value >= limit ||
+       (idx && UMetrics::getBucketLimit(idx-1) > value) ||
+       (limit - value) > (value / U_METRICS_SUB_BUCKET) + 1)
+      {
+      cout << "bucket of " << value << " wrong: " << idx << ' ' << limit << endl;
+      }
+}
+
+int
+U_EXPORT main(int argc, char* argv[])
+{
+   U_ULIB_INIT(argv);
+
+   U_TRACE(5,"main(%d)",argc)
+
+   uint32_t i;
+   uint64_t value;
+
+   // bucketing: exact under U_METRICS_SUB_BUCKET, then 8 bucket for each power of 2, the last one collect all the values greater
+
+   for (value = 0; value < 4096; ++value) checkBucket(value);
+
+   for (value = 4096; value < (1ULL << 35); value += value / 7) checkBucket(value);
+
+   cout << "bucket 7 = "                          << UMetrics::getBucket(7)                << '\n'
+        << "bucket 8 = "                          << UMetrics::getBucket(8)                << '\n'
+        << "bucket 1000000 = "                    << UMetrics::getBucket(1000000)          << " limit " << UMetrics::getBucketLimit(UMetrics::getBucket(1000000)) << '\n'
+        << "bucket 2^40 = "                       << UMetrics::getBucket(1ULL << 40)       << " (last " << U_METRICS_BUCKET - 1 << ")" << endl;
+
+   // quantile: the upper bound of the bucket where the count reach q * count
+
+   UMetrics::histogram h;
+
+   (void) U_SYSCALL(memset, "%p,%d,%u", &h, 0, sizeof(UMetrics::histogram));
+
+   cout << "quantile of empty = " << UMetrics::getQuantile(h, 0, 0.5) << endl;
+
+   for (i = 1; i <= 1000; ++i) h.bucket[UMetrics::getBucket(i * 1000ULL)]++; // from 1 microsecond to 1 millisecond
+
+   cout << "quantile 0.5 = "   << UMetrics::getQuantile(h, 1000, 0.5)   << '\n'
+        << "quantile 0.9 = "   << UMetrics::getQuantile(h, 1000, 0.9)   << '\n'
+        << "quantile 0.99 = "  << UMetrics::getQuantile(h, 1000, 0.99)  << '\n'
+        << "quantile 0.999 = " << UMetrics::getQuantile(h, 1000, 0.999) << '\n'
+        << "quantile 1 = "     << UMetrics::getQuantile(h, 1000, 1.0)   << endl;
+
+   // Prometheus: one worker with the same samples in the handler phase
+
+   U_NEW(UString, UMetrics::uri, U_STRING_FROM_CONSTANT("/metrics"));
+
+   UMetrics::init();
+
+   UServer_Base::ptr_shared_data = (UServer_Base::shared_data*) U_SYSCALL(calloc, "%u,%u", 1, sizeof(UServer_Base::shared_data) + UServer_Base::shared_data_add);
+
+   UMetrics::run(1);
+   UMetrics::start();
+
+   if (UMetrics::isActive() == false) U_ERROR("UMetrics::start() failed");
+
+   for (i = 1; i <= 1000; ++i) UMetrics::observe(U_METRICS_PHASE_HANDLER, i * 1000ULL);
+
+   UMetrics::observe(U_METRICS_PHASE_WRITE, 3000000000ULL);
+
+   UString body(U_CAPACITY);
+
+   UMetrics::getText(body);
+
+   cout << body;
+
+   UMetrics::clear();
+}
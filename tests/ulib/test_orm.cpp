@@ -1,5 +1,7 @@
 // test_orm.cpp
 
+#include <ulib/timeval.h>
+#include <ulib/notifier.h>
 #include <ulib/orm/orm.h>
 #include <ulib/orm/orm_driver.h>
 
@@ -391,6 +393,298 @@ static void testComplexType(UOrmSession* sql)
    U_ASSERT(p2 == c2)
 }
 
+static void testStatementCache(UOrmSession* sql)
+{
+   U_TRACE(5, "testStatementCache(%p)", sql)
+
+   // the statement released stay prepared in the cache of the connection and are given back with the same SQL text
+
+   int id;
+   const char* str = "Yossi";
+   USqlStatement* pstmt = 0;
+
+   for (int i = 0; i < 3; ++i)
+      {
+      UOrmStatement select(*sql, U_CONSTANT_TO_PARAM("SELECT id FROM users WHERE name = ?"));
+
+      // NB: from the second time it must be a hit of the cache (the same statement prepared the first time)...
+
+      if (i == 0) pstmt = select.getStatement();
+      else if (select.getStatement() != pstmt) U_ERROR("the statement is not given back by the cache of the connection");
+
+      id = 0;
+
+      select.use(str);
+      select.into(id);
+
+      select.execute();
+
+      U_ASSERT_EQUALS(id, 2)
+      }
+}
+
+static uint32_t ncallback;
+
+class Timeout : public UEventTime {
+public:
+
+   Timeout(int timeoutMS) : UEventTime() { setTimeToExpireMS(timeoutMS); } // NB: the time to wait for the event loop is absolute...
+};
+
+static void callbackAsync(UOrmSession* psession, void* arg)
+{
+   U_TRACE(5, "callbackAsync(%p,%p)", psession, arg)
+
+   ++ncallback;
+}
+
+static void testAsync(UOrmSession* sql)
+{
+   U_TRACE(5, "testAsync(%p)", sql)
+
+   // the statements sent in async mode don't block the caller: the callback is called by the event loop when the results are arrived
+
+   int id;
+   UString name(100U);
+   bool bpipeline = sql->startPipeline();
+
+   if (bpipeline &&
+       UNotifier::max_connection == 0)
+      {
+      UNotifier::max_connection = 1;
+
+      UNotifier::init();
+      }
+
+   UOrmStatement select(*sql, U_CONSTANT_TO_PARAM("SELECT name FROM users WHERE id = ?"));
+
+   select.use(id);
+   select.into(name);
+
+   // NB: the second time the connection is already registered with UNotifier...
+
+   for (id = 1; id <= 2; ++id)
+      {
+      ncallback = 0;
+
+      if (select.asyncExecute()         == false ||
+          sql->sendAsync(callbackAsync) == false)
+         {
+         U_ERROR("UOrmSession::sendAsync() failed");
+         }
+
+      // NB: a driver without pipeline mode call the callback at once...
+
+      for (int n = 0; ncallback == 0 && n < 100; ++n)
+         {
+         Timeout timeout(100);
+
+         UNotifier::waitForEvent(&timeout);
+         }
+
+      if (ncallback != 1) U_ERROR("the callback of UOrmSession::sendAsync() is not called once");
+
+      if (select.asyncResult() == false) U_ERROR("UOrmStatement::asyncResult() failed after the callback");
+
+      if (name != (id == 1 ? U_STRING_FROM_CONSTANT("Moshe") : U_STRING_FROM_CONSTANT("Yossi"))) U_ERROR("wrong result in async mode");
+      }
+
+   if (bpipeline) sql->endPipeline();
+}
+
+static void testPool()
+{
+   U_TRACE(5, "testPool()")
+
+   // NB: the session of the pool are opened with ORM_DRIVER and ORM_OPTION (the name of the db is the argument of the format)...
+
+   if (U_SYSCALL(getenv, "%S", "ORM_DRIVER") == 0) return;
+
+   int one = 0;
+   UOrmSession* s1;
+   UOrmSession* s2;
+
+   U_gettimeofday
+
+   {
+   // a db that can't be opened is not fatal: the pool stay empty and it try again at the next open
+
+   UOrmPool pool(U_CONSTANT_TO_PARAM("nodir/nodb"), 1, 2, 60);
+
+   if (pool.size() ||
+       pool.get())
+      {
+      U_ERROR("UOrmPool: we get a session of a db that can't be opened");
+      }
+
+   pool.reap();
+
+   if (pool.size()) U_ERROR("UOrmPool: we get a session of a db that can't be opened");
+   }
+
+   UOrmPool pool(U_CONSTANT_TO_PARAM(":memory:"), 1, 2, 1);
+
+   if (pool.size() != 1) U_ERROR("UOrmPool: the min session are not opened");
+
+   s1 = pool.get();
+   s2 = pool.get();
+
+   if (s1 == 0  ||
+       s2 == 0  ||
+       s1 == s2 ||
+       pool.get())
+      {
+      U_ERROR("UOrmPool: we don't get max session");
+      }
+
+   {
+   UOrmStatement select(*s2, U_CONSTANT_TO_PARAM("SELECT 1"));
+
+   select.into(one);
+
+   select.execute();
+   }
+
+   if (one != 1) U_ERROR("UOrmPool: the session opened on demand don't work");
+
+   // the session released last is given first (the warmest cache of prepared statement)
+
+   pool.release(s2);
+   pool.release(s1);
+
+   if (pool.get() != s1) U_ERROR("UOrmPool: the session released last is not given first");
+
+   pool.release(s1);
+
+   // the session idle for more than idle_timeout are closed, keeping min of them
+
+   u_now->tv_sec += 2;
+
+   pool.reap();
+
+   if (pool.size() != 1) U_ERROR("UOrmPool: the session idle are not closed");
+}
+
+static void testBatch(UOrmSession* sql, uint32_t nrows)
+{
+   U_TRACE(5, "testBatch(%p,%u)", sql, nrows)
+
+   int id, count = 0;
+   const char* name = "batch";
+   uint32_t i, nsingle = (nrows < 1000 ? nrows : 1000);
+
+   *sql << "CREATE TABLE IF NOT EXISTS batch (id INTEGER, name VARCHAR(30))";
+   *sql << "DELETE FROM batch";
+
+   UOrmStatement insert(*sql, U_CONSTANT_TO_PARAM("INSERT INTO batch VALUES(?, ?)")),
+                 select(*sql, U_CONSTANT_TO_PARAM("SELECT COUNT(*) FROM batch"));
+
+   insert.use(id, name);
+
+   select.into(count);
+
+   // one row for execute (one round trip and one transaction for row)
+
+   for (i = 0, id = 0; i < nsingle; ++i, ++id) insert.execute();
+
+   select.execute();
+
+   U_ASSERT_EQUALS(count, (int)nsingle)
+
+   // the same with the batch: it must give the same rows of the single insert
+
+   if (insert.beginBatch() == false) U_ERROR("UOrmStatement::beginBatch() failed");
+
+   for (i = 0; i < nrows; ++i, ++id) (void) insert.addBatch();
+
+   if (insert.endBatch() == false) U_ERROR("UOrmStatement::endBatch() failed");
+
+   select.execute();
+
+   U_ASSERT_EQUALS(count, (int)(nsingle + nrows))
+
+   int max_id = -1, nbatch = 0, first_id = nsingle;
+
+   UOrmStatement check(*sql, U_CONSTANT_TO_PARAM("SELECT COUNT(*), MAX(id) FROM batch WHERE name = 'batch' AND id >= ?"));
+
+   check.use(first_id);
+   check.into(nbatch, max_id);
+   check.execute();
+
+   U_ASSERT_EQUALS(nbatch, (int)nrows)
+   U_ASSERT_EQUALS(max_id, (int)(nsingle + nrows - 1))
+
+   // an empty batch commit without rows
+
+   if (insert.beginBatch() == false ||
+       insert.endBatch()   == false)
+      {
+      U_ERROR("UOrmStatement empty batch failed");
+      }
+
+   select.execute();
+
+   U_ASSERT_EQUALS(count, (int)(nsingle + nrows))
+
+   // a row that violate a constraint: endBatch() must fail and roll back, the table is unchanged
+
+   *sql << "CREATE TABLE IF NOT EXISTS batch_unique (id INTEGER PRIMARY KEY, name VARCHAR(30))";
+   *sql << "DELETE FROM batch_unique";
+   *sql << "INSERT INTO batch_unique VALUES(1, 'first')";
+
+   int uid, ucount = 0, umax_id = 0;
+
+   UOrmStatement uinsert(*sql, U_CONSTANT_TO_PARAM("INSERT INTO batch_unique VALUES(?, ?)")),
+                  ucheck(*sql, U_CONSTANT_TO_PARAM("SELECT COUNT(*), MAX(id) FROM batch_unique"));
+
+   uinsert.use(uid, name);
+
+   ucheck.into(ucount, umax_id);
+
+   if (uinsert.beginBatch() == false) U_ERROR("UOrmStatement::beginBatch() failed");
+
+   for (uid = 2; uid <= 4; ++uid) (void) uinsert.addBatch();
+
+   uid = 1; // NB: duplicate of the primary key...
+
+   (void) uinsert.addBatch();
+
+   uid = 5;
+
+   (void) uinsert.addBatch();
+
+   if (uinsert.endBatch()) U_ERROR("UOrmStatement::endBatch() with a failed row must fail");
+
+   ucheck.execute();
+
+   if (ucount  != 1 ||
+       umax_id != 1)
+      {
+      U_ERROR("UOrmStatement::endBatch() with a failed row must roll back: count = %d max(id) = %d", ucount, umax_id);
+      }
+
+   // batch of UOrmTypeHandler<T> (a row for object)
+
+   UVector<Person*> vperson;
+
+   for (i = 0; i < 100; ++i)
+      {
+      Person* p;
+
+      U_NEW(Person, p, Person(U_STRING_FROM_CONSTANT("LNB"), U_STRING_FROM_CONSTANT("FNB"), U_STRING_FROM_CONSTANT("ADDRB"), i));
+
+      vperson.push(p);
+      }
+
+   UOrmStatement insert_person(*sql, U_CONSTANT_TO_PARAM("INSERT INTO Person VALUES(?, ?, ?, ?)"));
+
+   if (insert_person.executeBatch(vperson) == false) U_ERROR("UOrmStatement::executeBatch() failed");
+
+   *sql << "DELETE FROM Person WHERE LastName = 'LNB'";
+
+   U_ASSERT_EQUALS(sql->affected(), 100)
+}
+
 #define  PGSQL_AUTO_INCREMENT "serial  primary key"
 #define  MYSQL_AUTO_INCREMENT "integer primary key auto_increment"
 #define SQLITE_AUTO_INCREMENT "integer primary key autoincrement"
@@ -467,6 +761,9 @@ U_EXPORT main(int argc, char* argv[])
 
    cout << "name = " << name << endl;
 
+   testStatementCache(&sql);
+   testAsync(&sql);
+
    // Now, we want to fetch some bigger data set. In this case we use the class Test1 that stores the output data. We use:
 
    Test1 t1;
@@ -534,4 +831,7 @@ U_EXPORT main(int argc, char* argv[])
    testSimpleAccess(&sql);
    testSimpleAccessVector(&sql);
    testComplexType(&sql);
+   testPool();
+
+   testBatch(&sql, (argc > 5 ? atoi(argv[5]) : 10000)); // NB: the number of rows of the batch can be 10k-1M...
 }
@@ -0,0 +1,221 @@
+// test_pubsub.cpp
+
+#include <ulib/utility/pubsub.h>
+#include <ulib/net/server/server.h>
+
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define SOCKET_PATH "/tmp/test_pubsub.sock"
+
+static UString readTopic(const char* topic)
+{
+   U_TRACE(5, "readTopic(%S)", topic)
+
+   bool binary;
+   UString result;
+   int t = UPubSub::getTopic(topic, u__strlen(topic, __PRETTY_FUNCTION__));
+
+   if (t != -1)
+      {
+      while (UPubSub::readMessage(t, binary))
+         {
+         if (result) (void) result.append(U_CONSTANT_TO_PARAM("|"));
+
+         if (binary) (void) result.append(U_CONSTANT_TO_PARAM("(binary)"));
+
+         (void) result.append(UPubSub::getMessage());
+         }
+      }
+
+   return result;
+}
+
+static uint64_t wakeup()
+{
+   U_TRACE_NO_PARAM(5, "wakeup()")
+
+   uint64_t value = 0;
+
+   (void) read(UServer_Base::handler_pubsub->fd, &value, sizeof(uint64_t));
+
+   return value;
+}
+
+static void sendControl(const char* datagram, uint32_t len)
+{
+   U_TRACE(5, "sendControl(%.*S,%u)", len, datagram, len)
+
+   struct sockaddr_un addr;
+
+   (void) memset(&addr, 0, sizeof(addr));
+
+   addr.sun_family = AF_UNIX;
+
+   (void) strcpy(addr.sun_path, SOCKET_PATH);
+
+   int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+
+   (void) sendto(fd, datagram, len, 0, (struct sockaddr*)&addr, sizeof(addr));
+
+   (void) close(fd);
+}
+
+int
+U_EXPORT main(int argc, char* argv[])
+{
+   U_ULIB_INIT(argv);
+
+   U_TRACE(5,"main(%d)",argc)
+
+   // NB: the setup of the server: init() in handlerInit(), the shared memory, run() in handlerRun(), start() in handlerFork()...
+
+   UServer_Base::preforked_num_kids = 2;
+
+   UPubSub::topic_max = 4;
+   UPubSub::ring_size = 4000; // NB: rounded to a power of two (4096), so the max message size is 2036 bytes...
+
+   U_NEW(UString, UPubSub::socket_path, UString(U_CONSTANT_TO_PARAM(SOCKET_PATH)));
+
+   if (UPubSub::init() == false) U_ERROR("pubsub: init failed");
+
+   UServer_Base::map_size        = sizeof(UServer_Base::shared_data) + UServer_Base::shared_data_add;
+   UServer_Base::ptr_shared_data = (UServer_Base::shared_data*) mmap(0, UServer_Base::map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+   UPubSub::run(16);
+   UPubSub::start();
+
+   cout << "ring: " << UPubSub::ring_size << " max message: " << UPubSub::getMaxMessageSize() << endl;
+
+   // WRITE/READ: a reader start from the head of a new topic, every publish wakeup the workers
+
+   cout << "unknown topic: " << UPubSub::getTopic(U_CONSTANT_TO_PARAM("news")) << endl;
+   cout << "publish: "       << UPubSub::publish(U_CONSTANT_TO_PARAM("news"), U_CONSTANT_TO_PARAM("first")) << endl;
+   cout << "publish: "       << UPubSub::publish(U_CONSTANT_TO_PARAM("news"), U_CONSTANT_TO_PARAM("second"), true) << endl;
+   cout << "wakeup: "        << wakeup() << endl;
+   cout << "read: "          << readTopic("news") << endl;
+   cout << "read again: "    << readTopic("news") << endl;
+
+   UString big(UPubSub::getMaxMessageSize() + 1);
+
+   big.size_adjust(UPubSub::getMaxMessageSize() + 1);
+
+   (void) U_SYSCALL(memset, "%p,%d,%u", big.data(), 'x', big.size());
+
+   cout << "publish too big: " << UPubSub::publish(U_CONSTANT_TO_PARAM("news"), U_STRING_TO_PARAM(big)) << endl;
+
+   // WRAP AROUND: the record (104 bytes) are written across the end of the ring (4096 bytes)
+
+   char msg[100];
+   int i, ok = 0;
+
+   for (i = 0; i < 100; ++i)
+      {
+      (void) memset(msg, 'a' + (i % 26), sizeof(msg));
+
+      (void) UPubSub::publish(U_CONSTANT_TO_PARAM("news"), msg, sizeof(msg));
+
+      if (readTopic("news") == UString(msg, sizeof(msg))) ++ok;
+      }
+
+   cout << "wrap around: " << ok << " of " << i << " read" << endl;
+
+   // OVERRUN: the reader that don't keep up lose the message overwritten and restart from the head of the ring
+
+   UString half(1000U);
+
+   half.size_adjust(1000U);
+
+   for (i = 0; i < 3; ++i)
+      {
+      (void) U_SYSCALL(memset, "%p,%d,%u", half.data(), '1' + i, half.size());
+
+      (void) UPubSub::publish(U_CONSTANT_TO_PARAM("news"), U_STRING_TO_PARAM(half));
+      }
+
+   cout << "overrun: " << readTopic("news").size() << endl;
+   cout << "publish: " << UPubSub::publish(U_CONSTANT_TO_PARAM("news"), U_CONSTANT_TO_PARAM("after the overrun")) << endl;
+   cout << "read: "    << readTopic("news") << endl;
+
+   (void) wakeup();
+
+   // CONTROL CHANNEL: every datagram is 'topic payload'
+
+   sendControl(U_CONSTANT_TO_PARAM("news from the control channel"));
+   sendControl(U_CONSTANT_TO_PARAM("sport goal"));
+   sendControl(U_CONSTANT_TO_PARAM("invalid"));
+
+   UString huge(UPubSub::getMaxMessageSize() * 2);
+
+   huge.size_adjust(UPubSub::getMaxMessageSize() * 2);
+
+   (void) U_SYSCALL(memset, "%p,%d,%u", huge.data(), 'x', huge.size());
+
+   U_MEMCPY(huge.data(), "news ", U_CONSTANT_SIZE("news "));
+
+   sendControl(U_STRING_TO_PARAM(huge));
+
+   (void) UServer_Base::handler_other->handlerRead();
+
+   cout << "control wakeup: " << wakeup() << endl;
+   cout << "control read: "   << readTopic("news") << endl;
+   cout << "control read: "   << readTopic("sport") << endl;
+
+   // SLOT: a worker keep his slot, a slot is never shared, with no slot free the worker fail...
+
+   int fd = UServer_Base::handler_pubsub->fd;
+
+   UPubSub::start();
+
+   cout << "start again: same slot " << (UServer_Base::handler_pubsub->fd == fd) << endl;
+
+   int fds[2], status;
+   pid_t pid[4];
+   char c;
+
+   (void) pipe(fds);
+
+   for (i = 0; i < 4; ++i)
+      {
+      if ((pid[i] = fork()) == 0)
+         {
+         UPubSub::start();
+
+         (void) read(fds[0], &c, 1); // NB: the worker must be alive while the other claim a slot...
+
+         _exit(0);
+         }
+
+      if (i < 3) (void) usleep(100 * 1000);
+      }
+
+   (void) waitpid(pid[3], &status, 0);
+
+   cout << "worker without slot: exited " << WIFEXITED(status) << " status " << (WEXITSTATUS(status) != 0) << endl;
+
+   (void) write(fds[1], "xxx", 3);
+
+   for (i = 0; i < 3; ++i)
+      {
+      (void) waitpid(pid[i], &status, 0);
+
+      cout << "worker " << i << ": status " << WEXITSTATUS(status) << endl;
+      }
+
+   // a slot of a dead worker is claimed by the worker respawned
+
+   if ((pid[0] = fork()) == 0)
+      {
+      UPubSub::start();
+
+      _exit(0);
+      }
+
+   (void) waitpid(pid[0], &status, 0);
+
+   cout << "worker respawned: status " << WEXITSTATUS(status) << endl;
+
+   UPubSub::clear();
+
+   (void) munmap(UServer_Base::ptr_shared_data, UServer_Base::map_size);
+}
@@ -3,12 +3,123 @@
 #include <ulib/net/tcpsocket.h>
 #include <ulib/net/client/redis.h>
 
+static uint32_t nelement;
+
+static void countElement(void* arg, const URESPParser::element* e)
+{
+   U_TRACE(5, "countElement(%p,%p)", arg, e)
+
+   if (e->type == '$')
+      {
+      // NB: the zero-copy element must be the same item of the old parser (getResponseItem())...
+
+      UVector<UString>* pvec = (UVector<UString>*)arg;
+
+      U_INTERNAL_ASSERT((*pvec)[nelement].equal(e->ptr, e->len))
+
+      ++nelement;
+      }
+}
+
+static void testParser(uint32_t n)
+{
+   U_TRACE(5, "testParser(%u)", n)
+
+   int k;
+   uint32_t i, size;
+   URESPParser parser;
+   UVector<UString> vec(n);
+   UString response(n * 20U + 32U);
+
+   // RESP3: nested aggregate, null, attribute (not counted) and map
+
+   response = U_STRING_FROM_CONSTANT("*3\r\n:1\r\n*2\r\n+a\r\n$-1\r\n|1\r\n+ttl\r\n:3600\r\n%1\r\n+k\r\n$1\r\nv\r\n+OK\r\n");
+
+   k = parser.parse(response);
+
+   U_INTERNAL_ASSERT_EQUALS(k, 2)
+   U_INTERNAL_ASSERT_EQUALS(parser.getPos(), response.size())
+
+   // NB: a reply not complete is not counted and the position stay on the first element not complete...
+
+   parser.reset();
+
+   k = parser.parse(response.data(), 10);
+
+   U_INTERNAL_ASSERT_EQUALS(k, 0)
+   U_INTERNAL_ASSERT_EQUALS(URESPParser::skip(response.data(), response.c_pointer(10)), 0)
+
+   response = U_STRING_FROM_CONSTANT("|1\r\n+ttl\r\n:3600\r\n%2\r\n+k\r\n$1\r\nv\r\n+k2\r\n_\r\n");
+
+   (void) UREDISClient_Base::getResponseItem(response, response.data(), vec, 0);
+
+   U_INTERNAL_ASSERT_EQUALS(vec.size(), 4)
+
+   vec.clear();
+
+   // big multi-bulk reply: "*n\r\n$11\r\nvalue-00000\r\n..."
+
+   response.setBuffer(n * 20U + 32U);
+
+   response.snprintf_add(U_CONSTANT_TO_PARAM("*%u\r\n"), n);
+
+   for (i = 0; i < n; ++i) response.snprintf_add(U_CONSTANT_TO_PARAM("$11\r\nvalue-%05u\r\n"), i % 100000);
+
+   (void) UREDISClient_Base::getResponseItem(response, response.data(), vec, 0);
+
+   U_INTERNAL_ASSERT_EQUALS(vec.size(), n)
+   U_INTERNAL_ASSERT(vec[n-1].equal(U_CONSTANT_TO_PARAM("value-99999")))
+
+   nelement = 0;
+
+   parser.reset();
+
+   k = parser.parse(response, countElement, &vec);
+
+   U_INTERNAL_ASSERT_EQUALS(k, 1)
+   U_INTERNAL_ASSERT_EQUALS(nelement, n)
+   U_INTERNAL_ASSERT_EQUALS(parser.getPos(), response.size())
+   U_INTERNAL_ASSERT_EQUALS(URESPParser::skip(response.data(), response.pend()), response.pend())
+
+   // incremental: the reply arrive in chunk of 4096 bytes, and it must give the same items
+
+   nelement = 0;
+
+   parser.reset();
+
+   for (k = 0, size = 0; size < response.size(); )
+      {
+      size += 4096;
+
+      if (size > response.size()) size = response.size();
+
+      k += parser.parse(response.data(), size, countElement, &vec);
+      }
+
+   U_INTERNAL_ASSERT_EQUALS(k, 1)
+   U_INTERNAL_ASSERT_EQUALS(nelement, n)
+}
+
 int main(int argc, char *argv[], char* env[])
 {
    U_ULIB_INIT(argv);
 
    U_TRACE(5,"main(%d)",argc)
 
+   // CLUSTER: hash slot of the key (CRC16 mod 16384, only the hash tag {...} if present)
+
+   U_INTERNAL_ASSERT_EQUALS(UREDISClient_Base::hashSlot(U_CONSTANT_TO_PARAM("foo")),                  12182)
+   U_INTERNAL_ASSERT_EQUALS(UREDISClient_Base::hashSlot(U_CONSTANT_TO_PARAM("somekey")),              11058)
+   U_INTERNAL_ASSERT_EQUALS(UREDISClient_Base::hashSlot(U_CONSTANT_TO_PARAM("{user1000}.following")),  3443)
+   U_INTERNAL_ASSERT_EQUALS(UREDISClient_Base::hashSlot(U_CONSTANT_TO_PARAM("{user1000}.followers")),
+                            UREDISClient_Base::hashSlot(U_CONSTANT_TO_PARAM("user1000")))
+   U_INTERNAL_ASSERT_EQUALS(UREDISClient_Base::hashSlot(U_CONSTANT_TO_PARAM("123456789")),            12739)
+   U_INTERNAL_ASSERT_EQUALS(UREDISClient_Base::hashSlot(U_CONSTANT_TO_PARAM("{user1000")),             8723) // no '}' => all the key
+   U_INTERNAL_ASSERT_EQUALS(UREDISClient_Base::hashSlot(U_CONSTANT_TO_PARAM("{}user1000")),            7326) // empty tag => all the key
+   U_INTERNAL_ASSERT_EQUALS(UREDISClient_Base::hashSlot(U_CONSTANT_TO_PARAM("foo{")),                  7673)
+
+   testParser(100000);
+
    UREDISClient<UTCPSocket> rc;
 
    if (rc.connect())
@@ -67,6 +178,23 @@ int main(int argc, char *argv[], char* env[])
 
       cout.write(buffer, u__snprintf(buffer, sizeof(buffer), U_CONSTANT_TO_PARAM("MYKEY2 = %V\n"), rc.vitem[0].rep));
 
+      // PIPELINE: the commands are written with one write and the replies read in one round trip
+
+      rc.startPipeline();
+
+      (void) rc.set(U_CONSTANT_TO_PARAM("MYKEY3"), U_CONSTANT_TO_PARAM("my-value-tester"));
+      (void) rc.get(U_CONSTANT_TO_PARAM("MYKEY3"));
+      (void) rc.echo(U_CONSTANT_TO_PARAM("puppamelo"));
+      (void) rc.del(U_CONSTANT_TO_PARAM("MYKEY3"));
+
+      ok = rc.endPipeline();
+
+      U_INTERNAL_ASSERT(ok)
+      U_INTERNAL_ASSERT_EQUALS(rc.getReplyNum(), 4)
+      U_INTERNAL_ASSERT_EQUALS(rc.getReplyPos(3), 3)
+
+      cout.write(buffer, u__snprintf(buffer, sizeof(buffer), U_CONSTANT_TO_PARAM("PIPELINE = %O\n"), U_OBJECT_TO_TRACE(rc.vitem)));
+
       ok = rc.sadd(U_CONSTANT_TO_PARAM("MY_SET"), U_CONSTANT_TO_PARAM("123 14"));
 
       U_INTERNAL_ASSERT(ok)
@@ -3,6 +3,7 @@
 #include <ulib/command.h>
 #include <ulib/utility/base64.h>
 #include <ulib/utility/services.h>
+#include <ulib/utility/route_matcher.h>
 
 #include <iostream>
 
@@ -10,6 +11,141 @@
 
 #define TESTOB "YnV0dG9uOglhZGREb2N1bWVudAlBZGQJYWRkRG9jdW1lbnQKYnV0dG9uOglzYXZlRG9jdW1l\nbnQJU2F2ZQlzYXZlRG9jdW1lbnQKI2ZyYW1lOglidWlsdGluU2F2ZQlEb2N1bWVudAktZmls\nbCBib3RoIC1leHBhbmQgeWVzCiNAYnVpbHRpblNhdmUJdGV4dAkKI2J1dHRvbjoJZGVidWdE\nb2N1bWVudAlEZWJ1ZwlkZWJ1Z0RvY3VtZW50IGJ1aWx0aW5TYXZlLnRleHQ=\n"
 
+static const char* uri[] = { "/", "/index.html", "/admin", "/admin/login.php", "/img/logo.PNG", "/css/site.css", "/cgi-bin/test.sh",
+                              "/blog/2017/post", "/app7/list", "/x.ext7", "/App7/list", "www.sito1.com" };
+
+static uint32_t checkMask(const char* mask, int flags)
+{
+   U_TRACE(5, "checkMask(%S,%d)", mask, flags)
+
+   uint32_t len = u__strlen(mask, __PRETTY_FUNCTION__), mismatch = 0;
+   URouteMatcher matcher(flags & FNM_IGNORECASE);
+
+   (void) matcher.addMask(mask, len, flags & FNM_INVERT);
+
+   for (uint32_t i = 0; i < U_NUM_ELEMENTS(uri); ++i)
+      {
+      if (matcher.isMatch(uri[i], u__strlen(uri[i], __PRETTY_FUNCTION__)) != UServices::dosMatchWithOR(uri[i], u__strlen(uri[i], __PRETTY_FUNCTION__), mask, len, flags))
+         {
+         ++mismatch;
+
+         cout << "URouteMatcher mismatch: " << mask << ' ' << uri[i] << '\n';
+         }
+      }
+
+   U_RETURN(mismatch);
+}
+
+static void testRouteMatcher()
+{
+   U_TRACE(5, "testRouteMatcher()")
+
+   static const char* mask[] = { "/admin|/admin/*", "*.css|*.png", "/cgi-bin/*.sh", "*cgi-bin*", "?img*", "*", "/blog/*/post", "/index.html", "/app?/*|*.ext?" };
+
+   uint32_t mismatch = 0;
+
+   for (uint32_t i = 0; i < U_NUM_ELEMENTS(mask); ++i)
+      {
+      mismatch += checkMask(mask[i], 0) +
+                  checkMask(mask[i], FNM_INVERT) +
+                  checkMask(mask[i], FNM_IGNORECASE);
+      }
+
+   U_ASSERT_EQUALS(mismatch, 0)
+
+   // the first rule in order of insertion win
+
+   URouteMatcher m;
+
+   U_ASSERT_EQUALS(m.addMask(U_CONSTANT_TO_PARAM("*.php")),    0)
+   U_ASSERT_EQUALS(m.addMask(U_CONSTANT_TO_PARAM("/admin/*")), 1)
+   U_ASSERT_EQUALS(m.addMask(U_CONSTANT_TO_PARAM("/admin*")),  2)
+
+   U_ASSERT_EQUALS(m.match(U_CONSTANT_TO_PARAM("/admin/login.php")),    0)
+   U_ASSERT_EQUALS(m.match(U_CONSTANT_TO_PARAM("/admin/login.php"), 1), 1)
+   U_ASSERT_EQUALS(m.match(U_CONSTANT_TO_PARAM("/adminx")),             2)
+   U_ASSERT_EQUALS(m.match(U_CONSTANT_TO_PARAM("/index.html")), U_NOT_FOUND)
+
+   // the mask must not continue in the data saved after it (the key of the trie)
+
+   URouteMatcher d;
+
+   U_ASSERT_EQUALS(d.addMask(U_CONSTANT_TO_PARAM("img?.png")), 0)
+   U_ASSERT_EQUALS(d.addMask(U_CONSTANT_TO_PARAM("img?.png"), FNM_INVERT), 1)
+
+   U_ASSERT_EQUALS(d.match(U_CONSTANT_TO_PARAM("img1.png")),       0)
+   U_ASSERT_EQUALS(d.match(U_CONSTANT_TO_PARAM("img1.pngimg")),    1)
+   U_ASSERT_EQUALS(d.match(U_CONSTANT_TO_PARAM("img1.pngimg"), 1), 1)
+   U_ASSERT_EQUALS(d.match(U_CONSTANT_TO_PARAM("img1.pngi")),      1)
+
+   // regex: the literal prefix is only a prefilter, the candidate are returned in order of rule
+
+   URouteMatcher r;
+
+   U_ASSERT_EQUALS(r.addRegex(U_CONSTANT_TO_PARAM("^/blog/(.*)")),    0)
+   U_ASSERT_EQUALS(r.addRegex(U_CONSTANT_TO_PARAM("^/a.*\\.php$")), 1)
+   U_ASSERT_EQUALS(r.addRegex(U_CONSTANT_TO_PARAM("(?i)^/X")),       2)
+   U_ASSERT_EQUALS(r.addRegex(U_CONSTANT_TO_PARAM("^/ab?c")),        3)
+
+   U_ASSERT_EQUALS(r.match(U_CONSTANT_TO_PARAM("/blog/1")),    0)
+   U_ASSERT_EQUALS(r.match(U_CONSTANT_TO_PARAM("/blog/1"), 1), 2)
+   U_ASSERT_EQUALS(r.match(U_CONSTANT_TO_PARAM("/ac")),        1)
+   U_ASSERT_EQUALS(r.match(U_CONSTANT_TO_PARAM("/ac"), 2),     2)
+   U_ASSERT_EQUALS(r.match(U_CONSTANT_TO_PARAM("/ac"), 3),     3)
+   U_ASSERT_EQUALS(r.match(U_CONSTANT_TO_PARAM("/ac"), 4),     U_NOT_FOUND)
+}
+
+static void checkRouteMatcher(uint32_t n)
+{
+   U_TRACE(5, "checkRouteMatcher(%u)", n)
+
+   URouteMatcher matcher;
+   static char mask[1000][32], request[100][32];
+   uint32_t i, j, k, len, mismatch = 0;
+
+   U_INTERNAL_ASSERT(n <= 1000)
+
+   for (i = 0; i < n; ++i)
+      {
+      len = u__snprintf(mask[i], sizeof(mask[i]), U_CONSTANT_TO_PARAM("/app%u/*|*.ext%u"), i, i);
+
+      (void) matcher.addMask(mask[i], len);
+      }
+
+   for (i = 0; i < 100; ++i)
+      {
+      if ((i % 4) == 3) (void) u__snprintf(request[i], sizeof(request[i]), U_CONSTANT_TO_PARAM("/static/file%u.none"), i); // miss
+      else              (void) u__snprintf(request[i], sizeof(request[i]), U_CONSTANT_TO_PARAM("/app%u/index"), (i * 7919) % n);
+      }
+
+   // the rule found must be the same of the linear scan with u_dosmatch_with_OR() (the first in order of insertion)
+
+   for (i = 0; i < 100; ++i)
+      {
+      const char* s = request[i];
+
+      len = u__strlen(s, __PRETTY_FUNCTION__);
+
+      for (j = 0; j < n; ++j)
+         {
+         if (u_dosmatch_with_OR(s, len, mask[j], u__strlen(mask[j], __PRETTY_FUNCTION__), 0)) break;
+         }
+
+      if (j == n) j = U_NOT_FOUND;
+
+      k = matcher.match(s, len);
+
+      if (k != j)
+         {
+         ++mismatch;
+
+         cout << "URouteMatcher: " << s << " found " << k << " expected " << j << '\n';
+         }
+      }
+
+   U_ASSERT_EQUALS(mismatch, 0)
+}
+
 int
 U_EXPORT main (int argc, char* argv[])
 {
@@ -19,6 +155,12 @@ U_EXPORT main (int argc, char* argv[])
 
    U_ASSERT_EQUALS( UServices::dosMatchWithOR(U_CONSTANT_TO_PARAM("www.sito1.com"), U_CONSTANT_TO_PARAM("SSI|benchmark|www.sito1.com|www.sito2.com"), FNM_INVERT), false)
 
+   testRouteMatcher();
+
+   checkRouteMatcher(10);
+   checkRouteMatcher(100);
+   checkRouteMatcher(1000);
+
    UString buffer(2000);
 
    u_base64_max_columns = 72;
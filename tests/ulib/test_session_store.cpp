@@ -0,0 +1,104 @@
+// test_session_store.cpp
+
+#include <ulib/db/rdb.h>
+#include <ulib/net/server/server.h>
+#include <ulib/utility/data_session.h>
+#include <ulib/utility/session_store.h>
+
+static UString vkey[U_SESSION_STORE_WAY+1];
+
+static UDataSession* newSession(uint32_t i)
+{
+   U_TRACE(5, "newSession(%u)", i)
+
+   UString value(100U);
+   UDataSession* data_session;
+
+   vkey[i].setBuffer(100U);
+   vkey[i].snprintf(U_CONSTANT_TO_PARAM("session%u"), i);
+    value.snprintf(U_CONSTANT_TO_PARAM("value%u"),   i);
+
+   U_NEW(UDataSession, data_session, UDataSession(vkey[i]));
+
+   data_session->putValueVar(0, value);
+
+   U_RETURN_POINTER(data_session, UDataSession);
+}
+
+static void get(uint32_t i)
+{
+   U_TRACE(5, "get(%u)", i)
+
+   UString value;
+   UDataSession data_session(vkey[i]);
+   bool result = USessionStore::get(&data_session);
+
+   if (result) data_session.getValueVar(0, value);
+
+   cout << "store " << vkey[i] << ' ' << (result ? "found " : "not found") << value << endl;
+}
+
+int
+U_EXPORT main(int argc, char* argv[])
+{
+   U_ULIB_INIT(argv);
+
+   U_TRACE(5,"main(%d)",argc)
+
+   URDB db(false);
+
+   if (db.open(UString(argv[1]), 1024 * 1024) == false) U_ERROR("open of db %S failed", argv[1]);
+
+   // one bucket of U_SESSION_STORE_WAY slot
+
+   USessionStore::max_session = U_SESSION_STORE_WAY;
+   USessionStore::slot_size   = 128;
+   USessionStore::ttl         = 60;
+
+   USessionStore::init();
+
+   UServer_Base::ptr_shared_data = (UServer_Base::shared_data*) U_SYSCALL(calloc, "%u,%u", 1, sizeof(UServer_Base::shared_data) + UServer_Base::shared_data_add);
+
+   USessionStore::run();
+   USessionStore::load(&db);
+
+   U_gettimeofday
+
+   uint32_t i;
+   UDataSession* vsession[U_SESSION_STORE_WAY+1];
+
+   for (i = 0; i <= U_SESSION_STORE_WAY; ++i)
+      {
+      vsession[i] = newSession(i);
+
+      u_now->tv_sec++; // NB: the least recently used slot must be the first one...
+
+      if (USessionStore::put(vsession[i]) == false) U_ERROR("USessionStore::put() failed");
+      }
+
+   // the bucket was full: the modified session of the least recently used slot is in the db and not in the store
+
+   for (i = 0; i <= U_SESSION_STORE_WAY; ++i) get(i);
+
+   UString data = db[vkey[0]];
+
+   cout << "db    " << vkey[0] << ' ' << (data.find(U_STRING_FROM_CONSTANT("value0")) != U_NOT_FOUND ? "found" : "not found") << endl;
+
+   // a session that don't fit anymore in his slot (so it is written in the db) must be removed from the store
+
+   UString big(200U);
+
+   (void) big.append(180U, 'x');
+
+   vsession[1]->putValueVar(1, big);
+
+   cout << "put   " << vkey[1] << ' ' << (USessionStore::put(vsession[1]) ? "stored" : "not stored") << endl;
+
+   get(1);
+
+   for (i = 0; i <= U_SESSION_STORE_WAY; ++i) delete vsession[i];
+
+   USessionStore::clear();
+
+   db.close();
+}
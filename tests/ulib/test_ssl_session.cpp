@@ -0,0 +1,217 @@
+// test_ssl_session.cpp
+
+#include <ulib/timer.h>
+#include <ulib/ssl/net/ssl_session.h>
+
+static USSLSession::cache cache;
+
+static SSL_SESSION* newSession(SSL* ssl, const char* id, long timeout)
+{
+   U_TRACE(5, "newSession(%p,%S,%ld)", ssl, id, timeout)
+
+   SSL_SESSION* sess = SSL_SESSION_new();
+
+   (void) SSL_SESSION_set1_id(sess, (const unsigned char*)id, u__strlen(id, __PRETTY_FUNCTION__));
+   (void) SSL_SESSION_set_protocol_version(sess, TLS1_2_VERSION);
+   (void) SSL_SESSION_set_cipher(sess, SSL_CIPHER_find(ssl, (const unsigned char*)"\xC0\x2F")); // ECDHE-RSA-AES128-GCM-SHA256
+   (void) SSL_SESSION_set_timeout(sess, timeout);
+
+   return sess;
+}
+
+static long getSession(const char* id)
+{
+   U_TRACE(5, "getSession(%S)", id)
+
+   int copy;
+   long timeout = 0;
+   SSL_SESSION* sess = USSLSession::getSession(0, (unsigned char*)id, u__strlen(id, __PRETTY_FUNCTION__), &copy);
+
+   if (sess)
+      {
+      unsigned int len;
+      const unsigned char* p = SSL_SESSION_get_id(sess, &len);
+
+      if (len == u__strlen(id, __PRETTY_FUNCTION__) &&
+          memcmp(p, id, len) == 0)
+         {
+         timeout = SSL_SESSION_get_timeout(sess);
+         }
+
+      SSL_SESSION_free(sess);
+      }
+
+   return timeout; // 0 -> miss
+}
+
+static const char* payload = "the state of the session in the ticket";
+
+#if OPENSSL_VERSION_NUMBER < 0x30000000L
+static int ticket(unsigned char* name, unsigned char* iv, unsigned char* buffer, int len, HMAC_CTX* hctx, int enc)
+#else
+static int ticket(unsigned char* name, unsigned char* iv, unsigned char* buffer, int len, EVP_MAC_CTX* hctx, int enc)
+#endif
+{
+   U_TRACE(5, "ticket(%p,%p,%p,%d,%p,%d)", name, iv, buffer, len, hctx, enc)
+
+   // NB: the same work of OpenSSL for a ticket: the callback init the cipher, then the payload is encrypted (or decrypted) in buffer...
+
+   int n1 = 0, n2 = 0;
+   EVP_CIPHER_CTX* ectx = EVP_CIPHER_CTX_new();
+   unsigned char out[256];
+
+   int result = USSLSession::ticketKeyCallback(0, name, iv, ectx, hctx, enc);
+
+   if (result > 0)
+      {
+      if (enc) { (void) EVP_EncryptUpdate(ectx, out, &n1, (const unsigned char*)payload, u__strlen(payload, __PRETTY_FUNCTION__)); (void) EVP_EncryptFinal_ex(ectx, out+n1, &n2); }
+      else     { (void) EVP_DecryptUpdate(ectx, out, &n1,                        buffer,                                       len);  if (EVP_DecryptFinal_ex(ectx, out+n1, &n2) == 0) result = -1; }
+
+      U_MEMCPY(buffer, out, n1+n2);
+
+      buffer[n1+n2] = '\0';
+      }
+
+   EVP_CIPHER_CTX_free(ectx);
+
+   return (enc ? (result > 0 ? n1+n2 : 0) : result);
+}
+
+int
+U_EXPORT main(int argc, char* argv[])
+{
+   U_ULIB_INIT(argv);
+
+   U_TRACE(5,"main(%d)",argc)
+
+   SSL_CTX* ctx = SSL_CTX_new(SSLv23_server_method());
+   SSL* ssl     = SSL_new(ctx);
+
+   USSLSession::ptr = &cache;
+
+   // SESSION ID CACHE: every slot is protected by a seqlock
+
+   SSL_SESSION* sess = newSession(ssl, "session-1", 300);
+
+   (void) USSLSession::newSession(ssl, sess);
+
+   USSLSession::slot* s = USSLSession::ptr->slots + USSLSession::getSlot((const unsigned char*)"session-1", 9);
+
+   cout << "get: " << getSession("session-1") << " seq " << s->seq << endl;
+   cout << "get unknown: " << getSession("session-2") << endl;
+
+   s->seq |= 1; // a writer is in progress (or it died while it was writing)...
+
+   SSL_SESSION* sess2 = newSession(ssl, "session-1", 600);
+
+   (void) USSLSession::newSession(ssl, sess2);
+
+   cout << "get with writer in progress: " << getSession("session-1") << endl;
+
+   s->seq &= ~1;
+
+   cout << "get after writer: " << getSession("session-1") << " seq " << s->seq << endl;
+
+   (void) USSLSession::newSession(ssl, sess2);
+
+   cout << "get after overwrite: " << getSession("session-1") << " seq " << s->seq << endl;
+
+   u_now->tv_sec += 601;
+
+   cout << "get expired: " << getSession("session-1") << endl;
+
+   u_now->tv_sec -= 601;
+
+   USSLSession::removeSession(ctx, sess2);
+
+   cout << "get removed: " << getSession("session-1") << " seq " << s->seq << endl;
+
+   SSL_SESSION_free(sess);
+   SSL_SESSION_free(sess2);
+
+   // SESSION TICKET: the keys are rotated at key_rotate, the previous key is accepted (the ticket is renewed) for one rotation interval
+
+   UTimer::init(UTimer::NOSIGNAL);
+
+   USSLSession::init(ctx);
+
+   long t0 = u_now->tv_sec;
+   unsigned char name0[16];
+
+   U_MEMCPY(name0, USSLSession::ptr->key[0].name, 16);
+
+   u_now->tv_sec = USSLSession::ptr->key_rotate - U_SSL_TICKET_KEY_ROTATION / 2;
+
+   cout << "check at half interval: next " << USSLSession::checkTicketKey() << " rotated " << (memcmp(name0, USSLSession::ptr->key[0].name, 16) != 0) << endl;
+
+   u_now->tv_sec = USSLSession::ptr->key_rotate - 1;
+
+   cout << "check before key_rotate: next " << USSLSession::checkTicketKey() << " rotated " << (memcmp(name0, USSLSession::ptr->key[0].name, 16) != 0) << endl;
+
+   u_now->tv_sec = USSLSession::ptr->key_rotate;
+
+   cout << "check at key_rotate: next " << USSLSession::checkTicketKey() << " rotated " << (memcmp(name0, USSLSession::ptr->key[0].name, 16) != 0)
+        << " previous " << (memcmp(name0, USSLSession::ptr->key[1].name, 16) == 0) << endl;
+
+   cout << "rotate again: " << USSLSession::rotateTicketKey() << endl;
+
+   int len;
+   unsigned char name[16], iv[EVP_MAX_IV_LENGTH], buffer[256];
+
+#if OPENSSL_VERSION_NUMBER < 0x30000000L
+   HMAC_CTX* hctx = HMAC_CTX_new();
+#else
+   EVP_MAC* mac = EVP_MAC_fetch(0, "HMAC", 0);
+   EVP_MAC_CTX* hctx = EVP_MAC_CTX_new(mac);
+#endif
+
+   len = ticket(name, iv, buffer, 0, hctx, 1);
+
+   cout << "encrypt: " << (len > 0) << " current key " << (memcmp(name, USSLSession::ptr->key[0].name, 16) == 0) << endl;
+
+   unsigned char ticket1[256];
+
+   U_MEMCPY(ticket1, buffer, len);
+
+   int result = ticket(name, iv, buffer, len, hctx, 0);
+
+   cout << "decrypt with the current key: " << result << " " << buffer << endl;
+
+   u_now->tv_sec = USSLSession::ptr->key_rotate;
+
+   (void) USSLSession::checkTicketKey();
+
+   U_MEMCPY(buffer, ticket1, len);
+
+   result = ticket(name, iv, buffer, len, hctx, 0);
+
+   cout << "decrypt with the previous key: " << result << " " << buffer << endl;
+
+   USSLSession::ptr->key_seq |= 1; // a rotation is in progress...
+
+   U_MEMCPY(buffer, ticket1, len);
+
+   cout << "decrypt with rotation in progress: " << ticket(name, iv, buffer, len, hctx, 0) << endl;
+
+   USSLSession::ptr->key_seq &= ~1;
+
+   u_now->tv_sec = USSLSession::ptr->key_rotate;
+
+   (void) USSLSession::checkTicketKey();
+
+   U_MEMCPY(buffer, ticket1, len);
+
+   cout << "decrypt with an expired key: " << ticket(name, iv, buffer, len, hctx, 0) << endl;
+
+   cout << "rotations: " << (u_now->tv_sec - t0) / U_SSL_TICKET_KEY_ROTATION << endl;
+
+#if OPENSSL_VERSION_NUMBER < 0x30000000L
+   HMAC_CTX_free(hctx);
+#else
+   EVP_MAC_CTX_free(hctx);
+   EVP_MAC_free(mac);
+#endif
+
+   SSL_free(ssl);
+   SSL_CTX_free(ctx);
+}
@@ -1479,6 +1479,42 @@ void U_EXPORT check_mmap(uint32_t map_size)
    UFile::munmap(place, map_size);
 }
 
+#ifdef U_THREAD_SAFE_STRING
+#  include <ulib/thread.h>
+
+#define U_NUM_THREAD        8
+#define U_NUM_ITERATION 100000
+
+static UString* shared;
+static int num_thread_done;
+
+class HoldRelease : public UThread { // NB: every thread do the hold()/release() of the same rep (the copy and the direct call)...
+public:
+
+   HoldRelease() : UThread(PTHREAD_CREATE_JOINABLE) {}
+
+   virtual void run()
+      {
+      U_TRACE_NO_PARAM(5, "HoldRelease::run()")
+
+      UStringRep* rep = shared->rep;
+
+      for (int i = 0; i < U_NUM_ITERATION; ++i)
+         {
+         UString copy(*shared);
+
+         rep->hold(3);
+
+         rep->release();
+         rep->release();
+         rep->release();
+         }
+
+      (void) __atomic_add_fetch(&num_thread_done, 1, __ATOMIC_RELEASE);
+      }
+};
+#endif
+
 #define U_STR0 "\026\003\001"
 #define U_STR1 "The string \xC3\xBC@foo-bar" // "The string @foo-bar"
 #define U_STR2 "binary: \xC3\xBC\x88\x01\x0B" 
@@ -1605,7 +1641,27 @@ U_EXPORT main(int argc, char* argv[])
    U_ASSERT( year == 2001 )
    U_ASSERT( month.shrink() == false )
    U_ASSERT( month.size() == 5 )
-   U_ASSERT( month.capacity() == (U_STACK_TYPE_4 - (1 + sizeof(UStringRep))) )
+   U_ASSERT( month.capacity() == U_CAPACITY_SMALL )
+
+   // short string: the data are inline with the rep in a block of the stack type 3 (see UStringRep::create())
+
+   UString small(U_CAPACITY_SMALL), large(U_CAPACITY_SMALL + 1);
+
+   U_ASSERT( small.capacity() == U_CAPACITY_SMALL )
+   U_ASSERT( large.capacity() == (U_STACK_TYPE_4 - (1 + sizeof(UStringRep))) )
+
+   (void) large.assign(U_CONSTANT_TO_PARAM("Content-Length"));
+
+   U_ASSERT( large.shrink() )
+   U_ASSERT( large.shrink() == false )
+   U_ASSERT( large.capacity() == U_CAPACITY_SMALL )
+   U_ASSERT( large.equal(U_CONSTANT_TO_PARAM("Content-Length")) )
+
+   (void) small.assign(U_CONSTANT_TO_PARAM("Accept"));
+   (void) small.append(U_CONSTANT_TO_PARAM("-Encoding: gzip, deflate, br, zstd"));
+
+   U_ASSERT( small.capacity() > U_CAPACITY_SMALL )
+   U_ASSERT( small.equal(U_CONSTANT_TO_PARAM("Accept-Encoding: gzip, deflate, br, zstd")) )
 
    istrstream istrs02(U_CONSTANT_TO_PARAM("\"DEBUG=1 \\\n"
                                           "  FW_CONF=etc/nodog_fw.conf \\\n"
@@ -2251,6 +2307,36 @@ U_EXPORT main(int argc, char* argv[])
 
    printf("Time Consumed for (%d) iteration = %ld ms\n", n, crono.getTimeElapsed());
 
+#ifdef U_THREAD_SAFE_STRING
+   // reference counting with a rep shared between threads: UThread::start() set UStringRep::bthread, so hold()/release() are atomic
+   // and the final reference count must be the initial one (NB: the threads must end before the delete, that cancel them)...
+
+   HoldRelease* th[U_NUM_THREAD];
+
+   U_NEW(UString, shared, UString(100U));
+
+   uint32_t references = shared->reference();
+
+   for (i = 0; i < U_NUM_THREAD; ++i)
+      {
+      U_NEW(HoldRelease, th[i], HoldRelease);
+
+      th[i]->start();
+      }
+
+   while (__atomic_load_n(&num_thread_done, __ATOMIC_ACQUIRE) < U_NUM_THREAD) UThread::nanosleep(10);
+
+   for (i = 0; i < U_NUM_THREAD; ++i) delete th[i];
+
+   if (UStringRep::bthread == false ||
+       shared->reference() != references)
+      {
+      U_ERROR("UStringRep: reference count after the hold()/release() of %u threads = %u (expected %u)", U_NUM_THREAD, shared->reference(), references);
+      }
+
+   delete shared;
+#endif
+
    /*
    check DEAD OF SOURCE STRING WITH CHILD ALIVE...
 
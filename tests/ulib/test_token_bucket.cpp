@@ -0,0 +1,87 @@
+// test_token_bucket.cpp
+
+#include <ulib/utility/token_bucket.h>
+
+#define MS 1000000ULL // nanosecond
+
+// NB: the clock is injected (t), so the test don't depend on the time of the execution...
+
+static uint64_t t0 = 1000000000ULL;
+
+static void consume(const char* msg, uint64_t* ptat, uint64_t n, uint64_t t, bool bforce = false)
+{
+   U_TRACE(5, "consume(%S,%p,%llu,%llu,%b)", msg, ptat, n, t, bforce)
+
+   // rate of 10 unit for second and burst of 5 unit => 100ms for unit, max 500ms of debt
+
+   uint64_t wait = UTokenBucket::consume(ptat, n, 10, 5, t, bforce);
+
+   cout << msg << ": " << (wait ? "deny" : "allow") << " wait " << wait / MS << "ms debt " << UTokenBucket::getDebt(ptat, t) / MS << "ms" << endl;
+}
+
+int
+U_EXPORT main(int argc, char* argv[])
+{
+   U_ULIB_INIT(argv);
+
+   U_TRACE(5,"main(%d)",argc)
+
+   uint32_t i;
+   uint64_t tat = 0;
+   char buffer[32];
+
+   // burst: the bucket start full, 5 unit are allowed at once (the last reach exactly the limit), the 6th is not charged
+
+   for (i = 1; i <= 6; ++i)
+      {
+      (void) snprintf(buffer, sizeof(buffer), "burst %u", i);
+
+      consume(buffer, &tat, 1, t0);
+      }
+
+   // refill: one unit every 100ms
+
+   consume("refill 50ms",  &tat, 1, t0 +  50 * MS);
+   consume("refill 100ms", &tat, 1, t0 + 100 * MS);
+   consume("refill 100ms", &tat, 1, t0 + 100 * MS);
+   consume("refill 299ms", &tat, 2, t0 + 299 * MS);
+   consume("refill 300ms", &tat, 2, t0 + 300 * MS);
+
+   // idle: the token don't accumulate over the burst
+
+   consume("idle 10s", &tat, 5, t0 + 10000 * MS);
+   consume("idle 10s", &tat, 1, t0 + 10000 * MS);
+
+   // a request greater than the burst never conform
+
+   tat = 0;
+
+   consume("request 6 unit", &tat, 6, t0);
+
+   // force: the unit are charged anyway and the debt must be paid before the next request
+
+   consume("force 8 unit",  &tat, 8, t0, true);
+   consume("after force",   &tat, 1, t0 + 300 * MS);
+   consume("after force",   &tat, 1, t0 + 400 * MS);
+
+   // table of slot: the same key give the same slot, a slot of a key with the buckets full (idle) can be reused
+
+   UTokenBucket::slot vslot[8], *s1, *s2;
+
+   (void) memset(vslot, 0, sizeof(vslot));
+
+   s1 = UTokenBucket::find(vslot, 8, 1234, t0);
+   s2 = UTokenBucket::find(vslot, 8, 1234, t0);
+
+   cout << "find same key: " << (s1 == s2 && s1->key == 1234) << endl;
+
+   for (i = 0; i < 8; ++i) vslot[i].tat[0] = t0 + 1000 * MS; // all the slot busy (in debt)
+
+   for (i = 0; i < 8; ++i) vslot[i].key = 100 + i;
+
+   cout << "find table busy: " << (UTokenBucket::find(vslot, 8, 5678, t0) == 0) << endl;
+
+   s2 = UTokenBucket::find(vslot, 8, 5678, t0 + 1000 * MS); // the debt is paid => the buckets are full
+
+   cout << "find reuse idle: " << (s2 != 0 && s2->key == 5678) << endl;
+}
@@ -332,6 +332,37 @@ U_EXPORT main (int argc, char* argv[])
    U_INTERNAL_ASSERT( n == 3 )
    }
 
+   {
+   UVector<UString> y1, y2;
+   UDirWalk dirwalk;
+
+   UDirWalk::setRecurseSubDirs(true, false);
+
+   uint32_t n1 = dirwalk.walk(y1, U_ALPHABETIC_SORT);
+
+   UDirWalk::setPrefetch(4);
+
+#ifdef U_LINUX
+   struct stat st1, st2; // NB: the link count of /proc/self/task is the number of thread + 2...
+
+   (void) stat("/proc/self/task", &st1);
+#endif
+
+   uint32_t n2 = dirwalk.walk(y2, U_ALPHABETIC_SORT);
+
+#ifdef U_LINUX
+   (void) stat("/proc/self/task", &st2);
+
+   U_INTERNAL_ASSERT_EQUALS(st1.st_nlink, st2.st_nlink) // NB: the prefetch thread are joined before walk() return...
+#endif
+
+   UDirWalk::setPrefetch(0);
+   UDirWalk::setRecurseSubDirs(false, false);
+
+   U_INTERNAL_ASSERT( n1 == n2 )
+   U_ASSERT( y1.isEqual(y2) )
+   }
+
    y.sort();
 
    U_DUMP("y[0] = %.*S", U_STRING_TO_TRACE(y[0]))